@@ -11,7 +11,8 @@ enum target {
     TARGET_IR_DOT,
     TARGET_ASM,
     TARGET_OBJ,
-    TARGET_EXE
+    TARGET_EXE,
+    TARGET_RUN
 };
 
 enum cstd {
@@ -20,19 +21,42 @@ enum cstd {
     STD_C11
 };
 
+/*
+ * Instruction set extensions beyond baseline x86-64 with SSE2, selected
+ * with -march and -m<feature> options.
+ */
+enum cpu_feature {
+    CPU_SSE3 = 1 << 0,
+    CPU_SSSE3 = 1 << 1,
+    CPU_SSE4_1 = 1 << 2,
+    CPU_SSE4_2 = 1 << 3,
+    CPU_POPCNT = 1 << 4,
+    CPU_AVX = 1 << 5,
+    CPU_AVX2 = 1 << 6,
+    CPU_BMI = 1 << 7,               /* TZCNT and friends. */
+    CPU_BMI2 = 1 << 8,              /* SHLX, SARX and SHRX. */
+    CPU_LZCNT = 1 << 9,
+    CPU_PRFCHW = 1 << 10            /* PREFETCHW instruction. */
+};
+
 /* Global information about translation unit. */
 INTERNAL struct context {
     int errors;
     int verbose;
     int suppress_warning;
+    int optimization_level;
     unsigned int pic : 1;            /* position independent code */
     unsigned int debug : 1;          /* Generate debug information. */
     unsigned int no_common : 1;      /* Don't use COMMON symbols. */
+    unsigned int function_sections : 1; /* Section for each function. */
+    unsigned int data_sections : 1;  /* Section for each object. */
+    unsigned int visibility : 2;     /* Default visibility of definitions. */
     unsigned int no_sse : 1;         /* Don't use SSE instructions. */
     unsigned int pedantic : 1;
     unsigned int nostdinc : 1;
     enum target target;
     enum cstd standard;
+    unsigned int cpu;                /* Set of enum cpu_feature. */
 } context;
 
 /*
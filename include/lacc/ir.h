@@ -91,6 +91,14 @@ enum kind {
  *
  * A transparent reference directly to a var is represented as IR_CAST,
  * where the type is the same as the var.
+ *
+ * Bit manipulation builtins are represented as unary operations, except
+ * rotate. The result of clz and ctz is undefined for zero.
+ *
+ * Atomic operations take the address of the object in l, and operand
+ * value in r. Compare and swap expects the old value as a param
+ * statement immediately before, and yields the value read from memory;
+ * the swap succeeded if the two are equal.
  */
 struct expression {
     enum optype {
@@ -99,6 +107,19 @@ struct expression {
         IR_OP_VA_ARG, /* va_arg(l, T) */
         IR_OP_NOT,    /* ~l     */
         IR_OP_NEG,    /* -l     */
+        IR_OP_POPCOUNT, /* popcount(l) */
+        IR_OP_CLZ,    /* clz(l) */
+        IR_OP_CTZ,    /* ctz(l) */
+        IR_OP_FFS,    /* ffs(l) */
+        IR_OP_BSWAP,  /* bswap(l) */
+        IR_OP_ATOMIC_LOAD,  /* atomic *l */
+        IR_OP_ATOMIC_STORE, /* atomic *l = r */
+        IR_OP_ATOMIC_XCHG,  /* atomic *l = r, yielding old *l */
+        IR_OP_ATOMIC_CAS,   /* atomic *l = *l == param ? r : *l */
+        IR_OP_ATOMIC_ADD,   /* atomic *l += r, yielding old *l */
+        IR_OP_ATOMIC_AND,   /* atomic *l &= r, yielding old *l */
+        IR_OP_ATOMIC_OR,    /* atomic *l |= r, yielding old *l */
+        IR_OP_ATOMIC_XOR,   /* atomic *l ^= r, yielding old *l */
         IR_OP_ADD,    /* l + r  */
         IR_OP_SUB,    /* l - r  */
         IR_OP_MUL,    /* l * r  */
@@ -109,6 +130,8 @@ struct expression {
         IR_OP_XOR,    /* l ^ r  */
         IR_OP_SHL,    /* l << r */
         IR_OP_SHR,    /* l >> r */
+        IR_OP_ROL,    /* rotate l left by r */
+        IR_OP_ROR,    /* rotate l right by r */
         IR_OP_EQ,     /* l == r */
         IR_OP_NE,     /* l != r */
         IR_OP_GE,     /* l >= r */
@@ -118,7 +141,10 @@ struct expression {
     struct var l, r;
 };
 
-#define has_side_effects(e) ((e).op == IR_OP_CALL || (e).op == IR_OP_VA_ARG)
+#define has_side_effects(e) ((e).op == IR_OP_CALL || (e).op == IR_OP_VA_ARG \
+    || is_atomic_operation(e))
+#define is_atomic_operation(e) \
+    ((e).op >= IR_OP_ATOMIC_LOAD && (e).op <= IR_OP_ATOMIC_XOR)
 #define is_identity(e) ((e).op == IR_OP_CAST && type_equal((e).type,(e).l.type))
 #define is_immediate(e) (is_identity(e) && (e).l.kind == IMMEDIATE)
 #define is_comparison(e) ((e).op >= IR_OP_EQ)
@@ -129,6 +155,8 @@ enum sttype {
     IR_VA_START,  /* va_start(expr)      */
     IR_ASSIGN,    /* t = expr            */
     IR_VLA_ALLOC, /* vla_alloc t, (expr) */
+    IR_PREFETCH,  /* prefetch(expr), t   */
+    IR_FENCE,     /* fence               */
     IR_ASM        /* */
 };
 
@@ -142,6 +170,14 @@ enum sttype {
  * Variable length arrays are allocated when declared, and deallocated
  * all at once when exiting function scope. Expression holds the size
  * in bytes to be allocated to VLA t.
+ *
+ * Prefetch is a statement never removed by optimization, but which
+ * does not fault on invalid addresses. Expression holds the address,
+ * and t is an immediate int with locality in the two lowest bits, and
+ * bit 2 set if prefetching for write.
+ *
+ * Fence is a full memory barrier, ordering all loads and stores before
+ * and after it. The statement has no operands.
  */
 struct statement {
     char st;
@@ -186,6 +222,13 @@ struct block {
      */
     struct block *jump[2];
 
+    /*
+     * Relative weight of each branch target, from __builtin_expect.
+     * Both are zero if there is no information about which branch is
+     * more likely to be taken.
+     */
+    unsigned short weight[2];
+
     /* Used to mark nodes as visited during graph traversal. */
     int color : 8;
 
@@ -203,9 +246,30 @@ struct block {
      */
     unsigned int has_init_value : 1;
 
+    /*
+     * Set if the last call in a return block is in tail position, and
+     * can be compiled as a jump after leaving the stack frame.
+     */
+    unsigned int tail_call : 1;
+
+    /*
+     * Set if control never reaches the end of the block, after calling
+     * __builtin_unreachable or __builtin_trap. Such blocks have no jump
+     * targets, but do not return from the function. A trap executes an
+     * invalid instruction instead.
+     */
+    unsigned int unreachable : 1;
+    unsigned int trap : 1;
+
     /* Liveness at the start and end of the block. */
     unsigned long in;
     unsigned long out;
+
+    /*
+     * Position in reverse postorder, assigned in loop analysis. Also
+     * used as index into block layout in the backend.
+     */
+    int order;
 };
 
 /*
@@ -32,6 +32,17 @@ enum linkage {
     LINK_EXTERN
 };
 
+/*
+ * Visibility of symbols with external linkage, set by attribute. Values
+ * correspond to ELF st_other.
+ */
+enum visibility {
+    VISIBILITY_DEFAULT = 0,
+    VISIBILITY_INTERNAL,
+    VISIBILITY_HIDDEN,
+    VISIBILITY_PROTECTED
+};
+
 /*
  * A symbol represents declarations that may have a storage location at
  * runtime, such as functions, static and local variables.
@@ -45,9 +56,19 @@ struct symbol {
     unsigned int referenced : 1; /* Mark symbol as used. */
     unsigned int memory : 1;     /* Disable register allocation. */
     unsigned int inlined : 1;    /* Inline function. */
-    unsigned int : 1;
+    unsigned int tls : 1;        /* Thread local storage. */
     unsigned int slot : 4;       /* Register allocation slot. */
     unsigned int index : 8;      /* Enumeration used in optimization. */
+    unsigned int visibility : 2; /* Visibility attribute. */
+    unsigned int has_visibility : 1;
+    unsigned int hot : 1;        /* Function attributes hot and cold. */
+    unsigned int cold : 1;
+    unsigned int noinline : 1;   /* Function attributes for inlining. */
+    unsigned int always_inline : 1;
+    unsigned int has_section : 1; /* Placed in section by attribute. */
+    unsigned int zero_init : 1;  /* Definition with all zero value. */
+    unsigned int read_only : 1;  /* Definition never written. */
+    unsigned int relro : 1;      /* Read only after relocation. */
 
     /*
      * Tag to disambiguate temporaries, strings, constants, labels, and
@@ -69,6 +90,12 @@ struct symbol {
      */
     int stack_offset;
 
+    /* Minimum alignment given by attribute, or 0 if not specified. */
+    int alignment;
+
+    /* Section given by attribute, valid if has_section is set. */
+    String section;
+
     union {
         /*
          * Hold a constant integral or floating point value. Used for
@@ -108,9 +135,19 @@ struct symbol {
 /* Holds the declaration for memcpy, which is needed for codegen. */
 EXTERNAL const struct symbol *decl_memcpy;
 
+/* Holds the declaration for __tls_get_addr, used to access TLS. */
+EXTERNAL const struct symbol *decl_tls_get_addr;
+
 /* Get the full name, including numeric value to disambiguate. */
 INTERNAL const char *sym_name(const struct symbol *sym);
 
+/*
+ * Get visibility of symbol with external linkage, either given by
+ * attribute, or -fvisibility for symbols defined in this translation
+ * unit.
+ */
+INTERNAL enum visibility sym_visibility(const struct symbol *sym);
+
 /*
  * Determine if given symbol is a temporary value generated during
  * evaluation.
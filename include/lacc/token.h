@@ -66,8 +66,11 @@ enum token_type {
     ALIGNOF,
     BOOL,
     NORETURN,
+    ATOMIC,
+    THREAD_LOCAL,
+    ATTRIBUTE,
 
-    STATIC_ASSERT = NORETURN + 5,
+    STATIC_ASSERT = ATTRIBUTE + 2,
 
     COLON = ':',
     SEMICOLON = ';',
@@ -23,7 +23,8 @@ enum type {
     T_FUNCTION,
     T_ARRAY,
     T_STRUCT,
-    T_UNION
+    T_UNION,
+    T_VECTOR
 };
 
 /*
@@ -34,22 +35,25 @@ enum type {
  *
  *     int
  *     const int * volatile
- *     unsigned short const * const restrict.
+ *     unsigned short const * const restrict
+ *     _Atomic long * _Atomic.
  *
  * For function, array, aggregate, and deeper pointer types, the type is
  * encoded in an opaque structure referenced by ref. All other types are
  * completely represented by this object, and have ref value 0.
  */
 typedef struct {
-    int type : 8;
+    int type : 6;
     unsigned int is_unsigned : 1;
     unsigned int is_const : 1;
     unsigned int is_volatile : 1;
     unsigned int is_restrict : 1;
+    unsigned int is_atomic : 1;
     unsigned int is_pointer : 1;
     unsigned int is_pointer_const : 1;
     unsigned int is_pointer_volatile : 1;
     unsigned int is_pointer_restrict : 1;
+    unsigned int is_pointer_atomic : 1;
     int ref : 16;
 } Type;
 
@@ -78,11 +82,14 @@ typedef struct {
 #define is_array(t) (type_of(t) == T_ARRAY)
 #define is_struct(t) (type_of(t) == T_STRUCT)
 #define is_union(t) (type_of(t) == T_UNION)
+#define is_vector(t) (type_of(t) == T_VECTOR)
 #define is_const(t) ((t).is_pointer ? (t).is_pointer_const : (t).is_const)
 #define is_volatile(t) ( \
     (t).is_pointer ? (t).is_pointer_volatile : (t).is_volatile)
 #define is_restrict(t) ( \
     (t).is_pointer ? (t).is_pointer_restrict : (t).is_restrict)
+#define is_atomic(t) ( \
+    (t).is_pointer ? (t).is_pointer_atomic : (t).is_atomic)
 
 /* Statically initialized, unqualified instances of common types. */
 EXTERNAL const Type
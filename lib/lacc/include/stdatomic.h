@@ -0,0 +1,117 @@
+#ifndef _STDATOMIC_H
+#define _STDATOMIC_H
+
+typedef enum memory_order {
+	memory_order_relaxed = __ATOMIC_RELAXED,
+	memory_order_consume = __ATOMIC_CONSUME,
+	memory_order_acquire = __ATOMIC_ACQUIRE,
+	memory_order_release = __ATOMIC_RELEASE,
+	memory_order_acq_rel = __ATOMIC_ACQ_REL,
+	memory_order_seq_cst = __ATOMIC_SEQ_CST
+} memory_order;
+
+#define kill_dependency(y) (y)
+
+#define ATOMIC_BOOL_LOCK_FREE 2
+#define ATOMIC_CHAR_LOCK_FREE 2
+#define ATOMIC_CHAR16_T_LOCK_FREE 2
+#define ATOMIC_CHAR32_T_LOCK_FREE 2
+#define ATOMIC_WCHAR_T_LOCK_FREE 2
+#define ATOMIC_SHORT_LOCK_FREE 2
+#define ATOMIC_INT_LOCK_FREE 2
+#define ATOMIC_LONG_LOCK_FREE 2
+#define ATOMIC_LLONG_LOCK_FREE 2
+#define ATOMIC_POINTER_LOCK_FREE 2
+
+typedef _Atomic _Bool atomic_bool;
+typedef _Atomic char atomic_char;
+typedef _Atomic signed char atomic_schar;
+typedef _Atomic unsigned char atomic_uchar;
+typedef _Atomic short atomic_short;
+typedef _Atomic unsigned short atomic_ushort;
+typedef _Atomic int atomic_int;
+typedef _Atomic unsigned int atomic_uint;
+typedef _Atomic long atomic_long;
+typedef _Atomic unsigned long atomic_ulong;
+typedef _Atomic long long atomic_llong;
+typedef _Atomic unsigned long long atomic_ullong;
+typedef _Atomic unsigned short atomic_char16_t;
+typedef _Atomic unsigned int atomic_char32_t;
+typedef _Atomic __WCHAR_TYPE__ atomic_wchar_t;
+typedef _Atomic long atomic_intptr_t;
+typedef _Atomic unsigned long atomic_uintptr_t;
+typedef _Atomic __SIZE_TYPE__ atomic_size_t;
+typedef _Atomic __PTRDIFF_TYPE__ atomic_ptrdiff_t;
+typedef _Atomic long atomic_intmax_t;
+typedef _Atomic unsigned long atomic_uintmax_t;
+
+#define ATOMIC_VAR_INIT(value) (value)
+#define atomic_init(obj, value) \
+	__atomic_store_n(obj, value, __ATOMIC_RELAXED)
+
+#define atomic_thread_fence(order) __atomic_thread_fence(order)
+#define atomic_signal_fence(order) __atomic_signal_fence(order)
+
+#define atomic_is_lock_free(obj) __atomic_is_lock_free(sizeof(*(obj)), obj)
+
+#define atomic_store_explicit(obj, value, order) \
+	__atomic_store_n(obj, value, order)
+#define atomic_store(obj, value) \
+	__atomic_store_n(obj, value, __ATOMIC_SEQ_CST)
+
+#define atomic_load_explicit(obj, order) __atomic_load_n(obj, order)
+#define atomic_load(obj) __atomic_load_n(obj, __ATOMIC_SEQ_CST)
+
+#define atomic_exchange_explicit(obj, value, order) \
+	__atomic_exchange_n(obj, value, order)
+#define atomic_exchange(obj, value) \
+	__atomic_exchange_n(obj, value, __ATOMIC_SEQ_CST)
+
+#define atomic_compare_exchange_strong_explicit(obj, exp, value, s, f) \
+	__atomic_compare_exchange_n(obj, exp, value, 0, s, f)
+#define atomic_compare_exchange_strong(obj, exp, value) \
+	__atomic_compare_exchange_n(obj, exp, value, 0, \
+		__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)
+#define atomic_compare_exchange_weak_explicit(obj, exp, value, s, f) \
+	__atomic_compare_exchange_n(obj, exp, value, 1, s, f)
+#define atomic_compare_exchange_weak(obj, exp, value) \
+	__atomic_compare_exchange_n(obj, exp, value, 1, \
+		__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)
+
+#define atomic_fetch_add_explicit(obj, value, order) \
+	__atomic_fetch_add(obj, value, order)
+#define atomic_fetch_add(obj, value) \
+	__atomic_fetch_add(obj, value, __ATOMIC_SEQ_CST)
+#define atomic_fetch_sub_explicit(obj, value, order) \
+	__atomic_fetch_sub(obj, value, order)
+#define atomic_fetch_sub(obj, value) \
+	__atomic_fetch_sub(obj, value, __ATOMIC_SEQ_CST)
+#define atomic_fetch_or_explicit(obj, value, order) \
+	__atomic_fetch_or(obj, value, order)
+#define atomic_fetch_or(obj, value) \
+	__atomic_fetch_or(obj, value, __ATOMIC_SEQ_CST)
+#define atomic_fetch_xor_explicit(obj, value, order) \
+	__atomic_fetch_xor(obj, value, order)
+#define atomic_fetch_xor(obj, value) \
+	__atomic_fetch_xor(obj, value, __ATOMIC_SEQ_CST)
+#define atomic_fetch_and_explicit(obj, value, order) \
+	__atomic_fetch_and(obj, value, order)
+#define atomic_fetch_and(obj, value) \
+	__atomic_fetch_and(obj, value, __ATOMIC_SEQ_CST)
+
+typedef struct atomic_flag {
+	_Bool __value;
+} atomic_flag;
+
+#define ATOMIC_FLAG_INIT {0}
+
+#define atomic_flag_test_and_set_explicit(obj, order) \
+	__atomic_test_and_set(&(obj)->__value, order)
+#define atomic_flag_test_and_set(obj) \
+	__atomic_test_and_set(&(obj)->__value, __ATOMIC_SEQ_CST)
+#define atomic_flag_clear_explicit(obj, order) \
+	__atomic_clear(&(obj)->__value, order)
+#define atomic_flag_clear(obj) \
+	__atomic_clear(&(obj)->__value, __ATOMIC_SEQ_CST)
+
+#endif
@@ -162,6 +162,52 @@ static void dot_print_expr(FILE *stream, struct expression expr)
     case IR_OP_NEG:
         fprintf(stream, "-%s", vartostr(expr.l));
         break;
+    case IR_OP_POPCOUNT:
+        fprintf(stream, "popcount(%s)", vartostr(expr.l));
+        break;
+    case IR_OP_CLZ:
+        fprintf(stream, "clz(%s)", vartostr(expr.l));
+        break;
+    case IR_OP_CTZ:
+        fprintf(stream, "ctz(%s)", vartostr(expr.l));
+        break;
+    case IR_OP_FFS:
+        fprintf(stream, "ffs(%s)", vartostr(expr.l));
+        break;
+    case IR_OP_BSWAP:
+        fprintf(stream, "bswap(%s)", vartostr(expr.l));
+        break;
+    case IR_OP_ATOMIC_LOAD:
+        fprintf(stream, "atomic_load(%s)", vartostr(expr.l));
+        break;
+    case IR_OP_ATOMIC_STORE:
+        fprintf(stream, "atomic_store(%s, %s)",
+            vartostr(expr.l), vartostr(expr.r));
+        break;
+    case IR_OP_ATOMIC_XCHG:
+        fprintf(stream, "atomic_xchg(%s, %s)",
+            vartostr(expr.l), vartostr(expr.r));
+        break;
+    case IR_OP_ATOMIC_CAS:
+        fprintf(stream, "atomic_cas(%s, %s)",
+            vartostr(expr.l), vartostr(expr.r));
+        break;
+    case IR_OP_ATOMIC_ADD:
+        fprintf(stream, "atomic_add(%s, %s)",
+            vartostr(expr.l), vartostr(expr.r));
+        break;
+    case IR_OP_ATOMIC_AND:
+        fprintf(stream, "atomic_and(%s, %s)",
+            vartostr(expr.l), vartostr(expr.r));
+        break;
+    case IR_OP_ATOMIC_OR:
+        fprintf(stream, "atomic_or(%s, %s)",
+            vartostr(expr.l), vartostr(expr.r));
+        break;
+    case IR_OP_ATOMIC_XOR:
+        fprintf(stream, "atomic_xor(%s, %s)",
+            vartostr(expr.l), vartostr(expr.r));
+        break;
     case IR_OP_ADD:
         fprintf(stream, "%s + %s", vartostr(expr.l), vartostr(expr.r));
         break;
@@ -192,6 +238,12 @@ static void dot_print_expr(FILE *stream, struct expression expr)
     case IR_OP_SHR:
         fprintf(stream, "%s \\>\\> %s", vartostr(expr.l), vartostr(expr.r));
         break;
+    case IR_OP_ROL:
+        fprintf(stream, "rotl(%s, %s)", vartostr(expr.l), vartostr(expr.r));
+        break;
+    case IR_OP_ROR:
+        fprintf(stream, "rotr(%s, %s)", vartostr(expr.l), vartostr(expr.r));
+        break;
     case IR_OP_EQ:
         fprintf(stream, "%s == %s", vartostr(expr.l), vartostr(expr.r));
         break;
@@ -241,6 +293,14 @@ static void dot_print_node(FILE *stream, struct definition *def, struct block *n
             fputs(" | ", stream);
             dot_print_expr(stream, s.expr);
             break;
+        case IR_PREFETCH:
+            fprintf(stream, " | prefetch %d (", (int) s.t.value.imm.i);
+            dot_print_expr(stream, s.expr);
+            fputs(")", stream);
+            break;
+        case IR_FENCE:
+            fputs(" | fence", stream);
+            break;
         case IR_VLA_ALLOC:
             fprintf(stream, " | vla_alloc %s:%s (",
                 vartostr(s.t),
@@ -3,6 +3,10 @@
 # define EXTERNAL extern
 #endif
 #include "linker.h"
+#if x86_64 && LINUX
+# include "x86_64/jit.h"
+# include "x86_64/link.h"
+#endif
 #include <lacc/array.h>
 #include <lacc/context.h>
 
@@ -16,7 +20,8 @@
 typedef array_of(char *) ArgArray;
 
 static ArgArray ld_args, ld_user_args;
-static int is_shared, is_static;
+static int is_shared, is_static, is_builtin;
+static char ld_program[32] = "/usr/bin/ld";
 
 static void add_option(ArgArray *args, const char *opt)
 {
@@ -44,9 +49,33 @@ INTERNAL void clear_linker_args(void)
     array_clear(&ld_args);
 }
 
+INTERNAL int set_linker(const char *name)
+{
+    if (!strcmp("lacc", name)) {
+#if x86_64 && LINUX
+        is_builtin = 1;
+        return 0;
+#else
+        fprintf(stderr, "Built-in linker is not supported on this target.\n");
+        return 1;
+#endif
+    }
+
+    if (strcmp("bfd", name) && strcmp("gold", name)
+        && strcmp("lld", name) && strcmp("mold", name))
+    {
+        fprintf(stderr, "Unrecognized linker %s.\n", name);
+        return 1;
+    }
+
+    is_builtin = 0;
+    sprintf(ld_program, "ld.%s", name);
+    return 0;
+}
+
 static void init_linker(void)
 {
-    add_option(&ld_args, "/usr/bin/ld");
+    add_option(&ld_args, ld_program);
 #if OpenBSD
     if (!is_shared) {
         add_option(&ld_args, "-e");
@@ -67,7 +96,7 @@ static void init_linker(void)
         add_option(&ld_args, "_start");
         add_option(&ld_args, "-dynamic-linker");
         add_option(&ld_args, "/lib/x86_64-linux-gnu/ld-linux-x86-64.so.2");
-        if (context.pic) {
+        if (context.pic && !is_static) {
             add_option(&ld_args, "/usr/lib/x86_64-linux-gnu/Scrt1.o");
         } else {
             add_option(&ld_args, "/usr/lib/x86_64-linux-gnu/crt1.o");
@@ -131,7 +160,21 @@ INTERNAL int invoke_linker(void)
     init_linker();
     array_concat(&ld_args, &ld_user_args);
 
-    add_option(&ld_args, "-lc");
+    if (!is_static) {
+        add_option(&ld_args, "-lc");
+    } else {
+#ifdef LIBGCC_PATH
+        add_option(&ld_args, "-L" LIBGCC_PATH);
+        add_option(&ld_args, "--start-group");
+        add_option(&ld_args, "-lgcc");
+        add_option(&ld_args, "-lgcc_eh");
+        add_option(&ld_args, "-lc");
+        add_option(&ld_args, "--end-group");
+#else
+        add_option(&ld_args, "-lc");
+#endif
+    }
+
 #if __OpenBSD__
     add_option(&ld_args, "/usr/lib/crtend.o");
 #elif GLIBC
@@ -140,6 +183,15 @@ INTERNAL int invoke_linker(void)
     add_option(&ld_args, "/usr/lib/crtn.o");
 #endif
 
+#if x86_64 && LINUX
+    if (is_builtin
+        && !link_executable(array_len(&ld_args), &array_get(&ld_args, 0)))
+    {
+        array_clear(&ld_user_args);
+        return 0;
+    }
+#endif
+
 #ifndef NDEBUG
     print_invocation();
 #endif
@@ -163,3 +215,13 @@ INTERNAL int invoke_linker(void)
     array_clear(&ld_user_args);
     return ret;
 }
+
+INTERNAL int run_program(int argc, char *argv[])
+{
+#if x86_64 && LINUX
+    return jit_run(argc, argv);
+#else
+    fprintf(stderr, "Option -run is not supported on this target.\n");
+    return 1;
+#endif
+}
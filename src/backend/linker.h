@@ -6,9 +6,22 @@
 /* Add command line argument to be passed to the linker. */
 INTERNAL int add_linker_arg(const char *opt);
 
+/*
+ * Select linker from -fuse-ld=<name>. The name "lacc" means linking in
+ * process, falling back to the system linker for unsupported input.
+ * Other names select ld.<name>.
+ */
+INTERNAL int set_linker(const char *name);
+
 /* Invoke the system linker. */
 INTERNAL int invoke_linker(void);
 
+/*
+ * Run program compiled in memory with -run, passing arguments to main.
+ * Return the value returned from main.
+ */
+INTERNAL int run_program(int argc, char *argv[]);
+
 /* Free memory used for linker arguments. */
 INTERNAL void clear_linker_args(void);
 
@@ -72,6 +72,10 @@ static struct param_class flatten(
             pc = flatten(pc, mb->type, mb->offset + offset);
         }
         break;
+    case T_VECTOR:
+        pc.eightbyte[i] = combine(pc.eightbyte[i], PC_SSE);
+        pc.eightbyte[i + 1] = combine(pc.eightbyte[i + 1], PC_SSEUP);
+        break;
     case T_ARRAY:
         next = type_next(type);
         for (i = 0; i < size_of(type) / size_of(next); ++i) {
@@ -85,7 +89,7 @@ static struct param_class flatten(
 
 static struct param_class merge(struct param_class pc, int n)
 {
-    int i, sseup = 0, memory = 0;
+    int i, memory = 0;
 
     for (i = 0; i < n; ++i) {
         switch (pc.eightbyte[i]) {
@@ -96,13 +100,26 @@ static struct param_class merge(struct param_class pc, int n)
             memory = 1;
             break;
         case PC_SSEUP:
-            sseup = 1;
+            if (!i || (pc.eightbyte[i - 1] != PC_SSE
+                    && pc.eightbyte[i - 1] != PC_SSEUP))
+            {
+                pc.eightbyte[i] = PC_SSE;
+            }
         default:
             break;
         }
     }
 
-    memory = memory || (i > 2 && (pc.eightbyte[0] != PC_SSE || !sseup));
+    /*
+     * Aggregates larger than two eightbytes can only be passed in a
+     * single SSE register, as SSE followed by SSEUP.
+     */
+    if (n > 2) {
+        memory = memory || pc.eightbyte[0] != PC_SSE;
+        for (i = 1; i < n; ++i) {
+            memory = memory || pc.eightbyte[i] != PC_SSEUP;
+        }
+    }
     if (memory) {
         pc.eightbyte[0] = PC_MEMORY;
     }
@@ -122,6 +139,9 @@ INTERNAL struct param_class classify(Type type)
     } else if (is_long_double(type)) {
         pc.eightbyte[0] = PC_X87;
         pc.eightbyte[1] = PC_X87UP;
+    } else if (is_vector(type)) {
+        pc.eightbyte[0] = PC_SSE;
+        pc.eightbyte[1] = PC_SSEUP;
     } else if (EIGHTBYTES(type) <= 4
         && is_struct_or_union(type)
         && !is_flexible(type)
@@ -139,14 +159,19 @@ INTERNAL struct param_class classify(Type type)
 INTERNAL int sym_alignment(const struct symbol *sym)
 {
     int align = type_alignment(sym->type);
-    if (is_array(sym->type) && align < 16) {
+    if (is_array(sym->type) && align < 16 && sym->symtype != SYM_LITERAL) {
         /*
          * A local or global array variable of at least 16 bytes should
-         * have alignment of 16.
+         * have alignment of 16. String literals are packed together in
+         * a mergeable section, and only need alignment of char.
          */
         align = 16;
     }
 
+    if (sym->alignment > align) {
+        align = sym->alignment;
+    }
+
     return align;
 }
 
@@ -165,6 +190,7 @@ void dump_classification(struct param_class pc, Type type)
             printf("\t%s\n",
                 pc.eightbyte[i] == PC_INTEGER ? "INTEGER" :
                 pc.eightbyte[i] == PC_SSE ? "SSE" :
+                pc.eightbyte[i] == PC_SSEUP ? "SSEUP" :
                 pc.eightbyte[i] == PC_X87 ? "X87" :
                 pc.eightbyte[i] == PC_X87UP ? "X87UP" :
                 pc.eightbyte[i] == PC_NO_CLASS ? "NO_CLASS" : "<invalid>");
@@ -8,6 +8,7 @@
 
 #include <assert.h>
 #include <ctype.h>
+#include <string.h>
 #include <stdarg.h>
 
 #define MAX_OPERAND_TEXT_LENGTH 256
@@ -29,7 +30,15 @@ static enum section {
     SECTION_NONE,
     SECTION_TEXT,
     SECTION_DATA,
-    SECTION_RODATA
+    SECTION_BSS,
+    SECTION_RODATA,
+    SECTION_RODATA_STR,
+    SECTION_RODATA_CST4,
+    SECTION_RODATA_CST8,
+    SECTION_RODATA_CST16,
+    SECTION_DATA_REL_RO,
+    SECTION_TDATA,
+    SECTION_TBSS
 } current_section = SECTION_NONE;
 
 static void set_section(enum section section)
@@ -41,15 +50,100 @@ static void set_section(enum section section)
     case SECTION_DATA:
         out("\t.data\n");
         break;
+    case SECTION_BSS:
+        out("\t.bss\n");
+        break;
     case SECTION_RODATA:
         out("\t.section\t.rodata\n");
         break;
+    case SECTION_RODATA_STR:
+        out("\t.section\t.rodata.str1.1,\"aMS\",@progbits,1\n");
+        break;
+    case SECTION_RODATA_CST4:
+        out("\t.section\t.rodata.cst4,\"aM\",@progbits,4\n");
+        break;
+    case SECTION_RODATA_CST8:
+        out("\t.section\t.rodata.cst8,\"aM\",@progbits,8\n");
+        break;
+    case SECTION_RODATA_CST16:
+        out("\t.section\t.rodata.cst16,\"aM\",@progbits,16\n");
+        break;
+    case SECTION_DATA_REL_RO:
+        out("\t.section\t.data.rel.ro,\"aw\"\n");
+        break;
+    case SECTION_TDATA:
+        out("\t.section\t.tdata,\"awT\",@progbits\n");
+        break;
+    case SECTION_TBSS:
+        out("\t.section\t.tbss,\"awT\",@nobits\n");
+        break;
     default: break;
     }
 
     current_section = section;
 }
 
+/*
+ * Switch to section given by attribute, or placement based on hot or
+ * cold function attributes. With -ffunction-sections and -fdata-sections,
+ * each symbol is placed in a separate section named after the default
+ * one. Return 0 if symbol goes to the default section.
+ */
+static int set_symbol_section(const struct symbol *sym, int zero)
+{
+    int separate;
+    const char *name, *flags, *type;
+
+    type = zero ? "@nobits" : "@progbits";
+    if (is_function(sym->type)) {
+        flags = "ax";
+        name = sym->cold ? ".text.unlikely"
+            : sym->hot ? ".text.hot" : ".text";
+        separate = context.function_sections;
+    } else if (sym->tls) {
+        flags = "awT";
+        name = zero ? ".tbss" : ".tdata";
+        separate = context.data_sections;
+    } else {
+        flags = sym->read_only && !sym->relro ? "a" : "aw";
+        name = sym->relro ? ".data.rel.ro"
+            : sym->read_only ? ".rodata"
+            : zero ? ".bss" : ".data";
+        separate = context.data_sections;
+    }
+
+    if (sym->has_section && !sym->tls) {
+        out("\t.section\t%s,\"%s\",@progbits\n", str_raw(sym->section),
+            is_function(sym->type) ? "ax" : "aw");
+    } else if (separate) {
+        out("\t.section\t%s.%s,\"%s\",%s\n",
+            name, sym_name(sym), flags, type);
+    } else if (is_function(sym->type) && (sym->cold || sym->hot)) {
+        out("\t.section\t%s,\"%s\",%s\n", name, flags, type);
+    } else {
+        return 0;
+    }
+
+    current_section = SECTION_NONE;
+    return 1;
+}
+
+static void visibility(const struct symbol *sym, const char *name)
+{
+    switch (sym_visibility(sym)) {
+    case VISIBILITY_INTERNAL:
+        out("\t.internal\t%s\n", name);
+        break;
+    case VISIBILITY_HIDDEN:
+        out("\t.hidden\t%s\n", name);
+        break;
+    case VISIBILITY_PROTECTED:
+        out("\t.protected\t%s\n", name);
+        break;
+    default: break;
+    }
+}
+
 static const char *reg_name[] = {
     "%al",   "%ax",   "%eax",  "%rax",
     "%cl",   "%cx",   "%ecx",  "%rcx",
@@ -123,6 +217,18 @@ static const char *asm_address(struct address addr)
             assert(addr.displacement == 0);
             w += sprintf(buf + w, "@PLT");
             break;
+        case ADDR_TPOFF:
+            assert(addr.displacement == 0);
+            w += sprintf(buf + w, "@tpoff");
+            break;
+        case ADDR_GOTTPOFF:
+            assert(addr.displacement == 0);
+            w += sprintf(buf + w, "@gottpoff");
+            break;
+        case ADDR_TLSGD:
+            assert(addr.displacement == 0);
+            w += sprintf(buf + w, "@tlsgd");
+            break;
         default:
             if (addr.displacement != 0) {
                 w += sprintf(buf + w, "%s%d",
@@ -130,7 +236,7 @@ static const char *asm_address(struct address addr)
             }
             break;
         }
-    } else if (addr.displacement != 0) {
+    } else if (addr.displacement != 0 || (!addr.base && !addr.index)) {
         w += sprintf(buf, "%d", addr.displacement);
     }
 
@@ -170,6 +276,11 @@ static const char *immediate(struct immediate imm)
     assert(imm.d.addr.sym);
     assert(imm.d.addr.sym->symtype != SYM_LITERAL);
 
+    if (imm.d.addr.type == ADDR_TPOFF) {
+        sprintf(buf, "$%s", asm_address(imm.d.addr));
+        return buf;
+    }
+
     return asm_address(imm.d.addr);
 }
 
@@ -183,8 +294,10 @@ INTERNAL void asm_init(FILE *output, const char *file)
 
 INTERNAL int asm_symbol(const struct symbol *sym)
 {
+    int zero;
     const char *name;
     size_t size;
+    String str;
 
     /*
      * Labels stay in the same function context, otherwise flush to
@@ -200,34 +313,61 @@ INTERNAL int asm_symbol(const struct symbol *sym)
     switch (sym->symtype) {
     case SYM_TENTATIVE:
         assert(is_object(sym->type));
-        if (!context.no_common) {
+        if (!context.no_common && !sym->tls && !sym->has_section
+            && !(context.data_sections && sym->linkage == LINK_INTERN))
+        {
             if (sym->linkage == LINK_INTERN)
                 out("\t.local\t%s\n", name);
-            out("\t.comm\t%s,%lu,%lu\n", name, size, type_alignment(sym->type));
+            else
+                visibility(sym, name);
+            out("\t.comm\t%s,%lu,%d\n", name, size, sym_alignment(sym));
             break;
         }
     case SYM_DEFINITION:
         if (is_function(sym->type)) {
-            set_section(SECTION_TEXT);
-            if (sym->linkage == LINK_EXTERN)
+            if (!set_symbol_section(sym, 0)) {
+                set_section(SECTION_TEXT);
+            }
+            if (sym->linkage == LINK_EXTERN) {
                 out("\t.globl\t%s\n", name);
+                visibility(sym, name);
+            }
+            if (sym->alignment) {
+                out("\t.align\t%d\n", sym->alignment);
+            }
             out("\t.type\t%s, @function\n", name);
             out("%s:\n", name);
         } else {
-            set_section(SECTION_DATA);
-            if (sym->linkage == LINK_EXTERN)
+            zero = sym->symtype == SYM_TENTATIVE || sym->zero_init;
+            if (set_symbol_section(sym, zero)) {
+                /* Section already set. */
+            } else if (sym->tls) {
+                set_section(zero ? SECTION_TBSS : SECTION_TDATA);
+            } else if (sym->relro) {
+                set_section(SECTION_DATA_REL_RO);
+            } else if (sym->read_only) {
+                set_section(SECTION_RODATA);
+            } else {
+                set_section(zero ? SECTION_BSS : SECTION_DATA);
+            }
+            if (sym->linkage == LINK_EXTERN) {
                 out("\t.globl\t%s\n", name);
+                visibility(sym, name);
+            }
             out("\t.align\t%d\n", sym_alignment(sym));
-            out("\t.type\t%s, @object\n", name);
+            out("\t.type\t%s, %s\n", name,
+                sym->tls ? "@tls_object" : "@object");
             out("\t.size\t%s, %lu\n", name, size);
             out("%s:\n", name);
-            if (sym->symtype == SYM_TENTATIVE) {
-                out("\t.zero %lu\n", size);
+            if (zero) {
+                out("\t.zero\t%lu\n", size);
             }
         }
         break;
     case SYM_LITERAL:
-        set_section(SECTION_RODATA);
+        str = sym->value.string;
+        set_section(strlen(str_raw(str)) == str_len(str)
+            ? SECTION_RODATA_STR : SECTION_RODATA);
         out("\t.align\t%d\n", sym_alignment(sym));
         out("\t.type\t%s, @object\n", name);
         out("\t.size\t%s, %lu\n", name, size);
@@ -237,7 +377,8 @@ INTERNAL int asm_symbol(const struct symbol *sym)
         out("\n");
         break;
     case SYM_CONSTANT:
-        set_section(SECTION_RODATA);
+        set_section(size == 4 ? SECTION_RODATA_CST4
+            : size == 8 ? SECTION_RODATA_CST8 : SECTION_RODATA_CST16);
         out("\t.align\t%d\n", sym_alignment(sym));
         out("%s:\n", name);
         if (is_float(sym->type)) {
@@ -267,12 +408,20 @@ INTERNAL int asm_symbol(const struct symbol *sym)
 
 INTERNAL int asm_text(struct instruction instr)
 {
-    char buf[11] = {0};
+    char buf[16] = {0};
 
     out("\t");
     switch (instr.prefix) {
     case PREFIX_REP: out("rep "); break;
     case PREFIX_REPNE: out("repne "); break;
+    case PREFIX_LOCK: out("lock "); break;
+    case PREFIX_DATA16:
+        if (instr.opcode == INSTR_CALL) {
+            out(".value\t0x6666\n\trex64\n\t");
+        } else {
+            out("data16 ");
+        }
+        break;
     default: break;
     }
 
@@ -280,7 +429,7 @@ INTERNAL int asm_text(struct instruction instr)
     out("%s", buf);
     switch (instr.optype) {
     case OPT_REG:
-        if (instr.opcode == INSTR_CALL) {
+        if (instr.opcode == INSTR_CALL || instr.opcode == INSTR_JMP) {
             out("\t*%s", regname(instr.source.reg));
             break;
         }
@@ -295,12 +444,17 @@ INTERNAL int asm_text(struct instruction instr)
         break;
     case OPT_MEM:
     case OPT_MEM_REG:
-        out("\t%s", asm_address(instr.source.mem.addr));
+        out("\t%s%s", instr.prefix == PREFIX_FS ? "%fs:" : "",
+            asm_address(instr.source.mem.addr));
         break;
     default:
         break;
     }
 
+    if (is_three_operand(instr)) {
+        out(", %s", regname(instr.dest.reg));
+    }
+
     switch (instr.optype) {
     case OPT_REG_REG:
     case OPT_MEM_REG:
@@ -365,6 +519,9 @@ INTERNAL int asm_data(struct immediate data)
         fprintstr(asm_output, data.d.string);
         out("\n");
         break;
+    case IMM_ZERO:
+        out("\t.zero\t%d\n", data.width);
+        break;
     }
     return 0;
 }
@@ -363,7 +363,7 @@ static struct instruction parse__asm__instruction(
     t = asmtok(line, &line);
     skip_whitespace(line, &line);
 
-    if (*line == '\n') {
+    if (*line == '\0' || *line == '\n') {
         instr.optype = OPT_NONE;
     } else {
         instr.optype = parse__asm__operand(line, &line, &instr.source);
@@ -412,7 +412,7 @@ INTERNAL int assemble_inline(
     struct block *target;
     const char *str, *ptr;
     size_t len, read;
-    char *buf;
+    char *buf, *text;
     int c, i;
 
     for (i = 0; i < array_len(&st.operands); ++i) {
@@ -425,8 +425,12 @@ INTERNAL int assemble_inline(
         array_push_back(&targets, target);
     }
 
+    /* Terminate last line, which is otherwise not read. */
     len = str_len(st.template);
-    str = str_raw(st.template);
+    text = malloc(len + 1);
+    memcpy(text, str_raw(st.template), len);
+    text[len++] = '\n';
+    str = text;
     buf = calloc(len + 2, sizeof(*buf));
 
     while ((read = read_line(str, len, buf + 1, &c)) != 0) {
@@ -447,6 +451,7 @@ INTERNAL int assemble_inline(
 
     array_clear(&operands);
     array_clear(&targets);
+    free(text);
     free(buf);
     return 0;
 }
@@ -8,11 +8,14 @@
 #include "dwarf.h"
 #include "elf.h"
 #include "encoding.h"
+#include "layout.h"
+#include "peephole.h"
 #include <lacc/context.h>
 
 #include <assert.h>
 #include <limits.h>
 #include <stdarg.h>
+#include <string.h>
 
 static int (*enter_context)(const struct symbol *);
 static int (*emit_instruction)(struct instruction);
@@ -47,6 +50,13 @@ static array_of(struct var) func_args;
 
 #define is_sse(c) (c > INSTR_XOR && c < INSTR_PXOR)
 
+/*
+ * Use VEX encoding for all SSE instructions when targeting AVX, to not
+ * pay for transitions between legacy SSE and AVX code.
+ */
+#define is_vex(c) ((context.cpu & CPU_AVX) \
+    && c >= INSTR_ADDS && c < INSTR_PREFETCHNTA)
+
 static enum reg
     temp_int_reg[] = {BX, R12, R13, R14, R15},
     temp_sse_reg[] = {XMM8, XMM9, XMM10, XMM11, XMM12, XMM13, XMM14, XMM15},
@@ -138,6 +148,28 @@ static void emit_rep_movs(int width)
     emit_instruction(instr);
 }
 
+static void emit_rep_stos(int width)
+{
+    struct instruction instr = {INSTR_STOS};
+
+    instr.optype = OPT_NONE;
+    instr.prefix = PREFIX_REP;
+    instr.source.width = width;
+    emit_instruction(instr);
+}
+
+static void emit_lock_rm(enum opcode op, struct registr reg, struct memory mem)
+{
+    struct instruction instr = {0};
+
+    instr.opcode = op;
+    instr.optype = OPT_REG_MEM;
+    instr.prefix = PREFIX_LOCK;
+    instr.source.reg = reg;
+    instr.dest.mem = mem;
+    emit_instruction(instr);
+}
+
 static void emit_cxy(int width)
 {
     struct instruction instr = {0};
@@ -195,6 +227,10 @@ static void emit_rm(enum opcode op, struct registr reg, struct memory mem)
     instr.optype = OPT_REG_MEM;
     instr.source.reg = reg;
     instr.dest.mem = mem;
+    if (is_vex(op)) {
+        instr.prefix = PREFIX_VEX;
+    }
+
     emit_instruction(instr);
 }
 
@@ -206,6 +242,10 @@ static void emit_rr(enum opcode op, struct registr r1, struct registr r2)
     instr.optype = OPT_REG_REG;
     instr.source.reg = r1;
     instr.dest.reg = r2;
+    if (is_vex(op)) {
+        instr.prefix = PREFIX_VEX;
+    }
+
     emit_instruction(instr);
 }
 
@@ -217,6 +257,10 @@ static void emit_mr(enum opcode op, struct memory mem, struct registr reg)
     instr.optype = OPT_MEM_REG;
     instr.source.mem = mem;
     instr.dest.reg = reg;
+    if (is_vex(op)) {
+        instr.prefix = PREFIX_VEX;
+    }
+
     emit_instruction(instr);
 }
 
@@ -268,9 +312,28 @@ static int displacement_from_offset(size_t offset)
     return (int) offset;
 }
 
+/*
+ * Symbols with default visibility can be preempted at runtime, and are
+ * addressed through the GOT or PLT in position independent code. Hidden
+ * symbols are always resolved within the same module, and protected
+ * functions defined here as well. Protected data still goes through
+ * the GOT, as the address can be taken over by a copy relocation.
+ */
 static int is_global_offset(const struct symbol *sym)
 {
-    return context.pic && sym->linkage == LINK_EXTERN;
+    if (!context.pic || sym->linkage != LINK_EXTERN) {
+        return 0;
+    }
+
+    switch (sym_visibility(sym)) {
+    case VISIBILITY_INTERNAL:
+    case VISIBILITY_HIDDEN:
+        return 0;
+    case VISIBILITY_PROTECTED:
+        return !is_function(sym->type) || sym->symtype != SYM_DEFINITION;
+    default:
+        return 1;
+    }
 }
 
 static int is_register_allocated(struct var v)
@@ -529,6 +592,87 @@ static int is_zero(union value val, Type type)
     return 0;
 }
 
+static void store_caller_saved_registers(void)
+{
+    int i;
+
+    for (i = 0; i < sse_regs_alloc; ++i) {
+        emit_ir(INSTR_SUB, constant(16, 8), reg(SP, 8));
+        emit_rm(INSTR_MOVS,
+            reg(temp_sse_reg[i], 8),
+            location(address(0, SP, 0, 0), 8));
+    }
+}
+
+static void load_caller_saved_registers(void)
+{
+    int i;
+
+    for (i = sse_regs_alloc - 1; i >= 0; --i) {
+        emit_mr(INSTR_MOVS,
+            location(address(0, SP, 0, 0), 8),
+            reg(temp_sse_reg[i], 8));
+        emit_ir(INSTR_ADD, constant(16, 8), reg(SP, 8));
+    }
+}
+
+/*
+ * Load address of thread local variable to register. Position
+ * independent code uses the general dynamic model, calling
+ * __tls_get_addr which clobbers all caller saved registers. Otherwise
+ * the offset from the thread pointer is known at link time for
+ * variables defined in this translation unit (local exec), or read
+ * from the GOT (initial exec).
+ */
+static void load_thread_local_address(const struct symbol *sym, enum reg r)
+{
+    struct instruction instr = {0};
+    struct immediate imm = {0};
+    struct address tp = {0};
+
+    assert(sym->tls);
+    ((struct symbol *) sym)->referenced = 1;
+    if (context.pic) {
+        store_caller_saved_registers();
+        tp.type = ADDR_TLSGD;
+        tp.base = IP;
+        tp.sym = sym;
+        instr.opcode = INSTR_LEA;
+        instr.optype = OPT_MEM_REG;
+        instr.prefix = PREFIX_DATA16;
+        instr.source.mem = location(tp, 8);
+        instr.dest.reg = reg(DI, 8);
+        emit_instruction(instr);
+        instr.opcode = INSTR_CALL;
+        instr.optype = OPT_IMM;
+        instr.source.imm = addr(decl_tls_get_addr);
+        emit_instruction(instr);
+        load_caller_saved_registers();
+        if (r != AX) {
+            emit_rr(INSTR_MOV, reg(AX, 8), reg(r, 8));
+        }
+    } else {
+        instr.opcode = INSTR_MOV;
+        instr.optype = OPT_MEM_REG;
+        instr.prefix = PREFIX_FS;
+        instr.source.mem = location(tp, 8);
+        instr.dest.reg = reg(r, 8);
+        emit_instruction(instr);
+        tp.sym = sym;
+        if (sym->symtype == SYM_DECLARATION) {
+            tp.type = ADDR_GOTTPOFF;
+            tp.base = IP;
+            emit_mr(INSTR_ADD, location(tp, 8), reg(r, 8));
+        } else {
+            tp.type = ADDR_TPOFF;
+            imm.type = IMM_ADDR;
+            imm.width = 8;
+            imm.d.addr = tp;
+            emit_ir(INSTR_ADD, imm, reg(r, 8));
+        }
+    }
+}
+
 /*
  * Emit instruction to load a value to specified register. Handles all
  * kinds of variables, including immediate.
@@ -612,7 +756,14 @@ static void emit_load(
     case ADDRESS:
         assert(opcode == INSTR_LEA);
         assert(dest.width == 8);
-        if (is_global_offset(source.value.symbol)) {
+        if (source.value.symbol->tls) {
+            load_thread_local_address(source.value.symbol, dest.r);
+            if (source.offset) {
+                emit_ir(INSTR_ADD,
+                    constant(displacement_from_offset(source.offset), 8),
+                    dest);
+            }
+        } else if (is_global_offset(source.value.symbol)) {
             ax = dest.r;
             emit_mr(INSTR_MOV, location(got(source.value.symbol), 8), dest);
             if (source.offset) {
@@ -772,6 +923,60 @@ static void load_address(struct var v, enum reg r)
     }
 }
 
+/*
+ * Memory operand for 16 byte vector variable. The address is loaded to
+ * register r if the variable cannot be addressed directly.
+ */
+static struct memory vector_location(struct var v, enum reg r)
+{
+    assert(size_of(v.type) == 16);
+    assert(!is_register_allocated(v));
+    if (v.kind == DIRECT && !is_global_offset(v.value.symbol)) {
+        return location_of(v, 4);
+    }
+
+    load_address(v, r);
+    return location(address(0, r, 0, 0), 4);
+}
+
+/*
+ * Vector variables are aligned to 16 bytes, but addresses computed
+ * through pointers can be anything.
+ */
+static int is_aligned_vector(struct var v)
+{
+    const struct symbol *sym;
+
+    if (v.kind != DIRECT || v.offset % 16) {
+        return 0;
+    }
+
+    sym = v.value.symbol;
+    if (sym->linkage == LINK_NONE) {
+        return sym->stack_offset % 16 == 0;
+    }
+
+    return sym_alignment(sym) >= 16;
+}
+
+static void load_vector(struct var v, enum reg r)
+{
+    enum opcode opc;
+
+    assert(r >= XMM0);
+    opc = is_aligned_vector(v) ? INSTR_MOVAP : INSTR_MOVUP;
+    emit_mr(opc, vector_location(v, R11), reg(r, 4));
+}
+
+static void store_vector(enum reg r, struct var v)
+{
+    enum opcode opc;
+
+    assert(r >= XMM0);
+    opc = is_aligned_vector(v) ? INSTR_MOVAP : INSTR_MOVUP;
+    emit_rm(opc, reg(r, 4), vector_location(v, R11));
+}
+
 /*
  * Keep reference to constant once generated, but reset between each
  * source file.
@@ -795,49 +1000,227 @@ static struct var get_x87_unsigned_adjust_constant(void)
     return var_direct(x87_unsigned_adjust_constant);
 }
 
+/*
+ * Limits for expanding calls to memcpy, memmove, memset and memcmp
+ * with constant size inline. Larger memset is done with rep stosb, and
+ * other functions are called.
+ */
+#define MEMCPY_INLINE_MAX 256
+#define MEMMOVE_INLINE_MAX 64
+#define MEMSET_INLINE_MAX 256
+#define MEMCMP_INLINE_MAX 32
+
+/* Largest integer register width not exceeding number of bytes. */
+static int chunk_width(size_t bytes)
+{
+    return bytes >= 8 ? 8 : bytes >= 4 ? 4 : bytes >= 2 ? 2 : 1;
+}
+
 /*
  * Emit code for copying given nymber of bytes between %rsi and %rdi.
+ * Objects smaller than 16 bytes are copied using integer registers,
+ * and larger objects in 16 byte chunks with SSE. The last chunk
+ * overlaps with the previous one if size is not evenly divisible.
  *
- * It is not easy to beat memcpy, in particular rep movsb seems
- * surprisingly slow.
+ * It is not easy to beat memcpy for large objects, in particular rep
+ * movsb seems surprisingly slow.
  */
 static void emit_memcpy(size_t bytes)
 {
-    int i;
-    size_t w;
-    struct address source, dest;
+    size_t i, w;
 
-    if (bytes <= 64 || !decl_memcpy) {
+    if (bytes > MEMCPY_INLINE_MAX && decl_memcpy) {
+        emit_ir(INSTR_MOV, constant(bytes, 8), reg(DX, 8));
+        emit_i_(INSTR_CALL, addr(decl_memcpy));
+    } else if (bytes < 16 || context.no_sse) {
+        w = chunk_width(bytes);
         for (i = 0; i < bytes; i += w) {
-            source = address(i, SI, 0, 0);
-            dest = address(i, DI, 0, 0);
-            switch (bytes - i) {
-            case 1:
-            case 2:
-            case 4:
-            case 8:
-                w = bytes - i;
-                break;
-            case 3:
-                w = 2;
-                break;
-            case 5:
-            case 6:
-            case 7:
-                w = 4;
-                break;
-            default:
-                w = 8;
-                break;
+            if (i + w > bytes) {
+                i = bytes - w;
+            }
+            emit_mr(INSTR_MOV, location(address(i, SI, 0, 0), w), reg(AX, w));
+            emit_rm(INSTR_MOV, reg(AX, w), location(address(i, DI, 0, 0), w));
+        }
+    } else {
+        for (i = 0; i < bytes; i += 16) {
+            if (i + 16 > bytes) {
+                i = bytes - 16;
+            }
+            emit_mr(INSTR_MOVDQU,
+                location(address(i, SI, 0, 0), 8), reg(XMM0, 8));
+            emit_rm(INSTR_MOVDQU,
+                reg(XMM0, 8), location(address(i, DI, 0, 0), 8));
+        }
+    }
+}
+
+/*
+ * Emit code for moving given number of bytes from %rsi to %rdi, where
+ * the regions can overlap. All chunks are loaded to registers before
+ * storing any of them.
+ */
+static void emit_memmove(size_t bytes)
+{
+    int n;
+    size_t i, w;
+    struct address offset[4];
+
+    assert(bytes <= MEMMOVE_INLINE_MAX);
+    if (bytes < 16) {
+        w = chunk_width(bytes);
+        for (i = 0, n = 0; i < bytes; i += w) {
+            if (i + w > bytes) {
+                i = bytes - w;
             }
+            assert(n < 2);
+            offset[n] = address(i, SI, 0, 0);
+            emit_mr(INSTR_MOV, location(offset[n], w), reg(n ? CX : AX, w));
+            n++;
+        }
 
-            emit_mr(INSTR_MOV, location(source, w), reg(AX, w));
-            emit_rm(INSTR_MOV, reg(AX, w), location(dest, w));
+        while (n--) {
+            offset[n].base = DI;
+            emit_rm(INSTR_MOV, reg(n ? CX : AX, w), location(offset[n], w));
         }
     } else {
-        emit_ir(INSTR_MOV, constant(bytes, 8), reg(DX, 8));
-        emit_i_(INSTR_CALL, addr(decl_memcpy));
+        for (i = 0, n = 0; i < bytes; i += 16) {
+            if (i + 16 > bytes) {
+                i = bytes - 16;
+            }
+            assert(n < 4);
+            offset[n] = address(i, SI, 0, 0);
+            emit_mr(INSTR_MOVDQU, location(offset[n], 8), reg(XMM0 + n, 8));
+            n++;
+        }
+
+        while (n--) {
+            offset[n].base = DI;
+            emit_rm(INSTR_MOVDQU, reg(XMM0 + n, 8), location(offset[n], 8));
+        }
+    }
+}
+
+/*
+ * Emit code for setting given number of bytes at %rdi to the value in
+ * %esi, or constant byte if value is immediate. The byte is broadcast
+ * to all bytes of %rax, and to %xmm0 for SSE stores. Large sizes use
+ * rep stosb.
+ */
+static void emit_memset(struct var value, size_t bytes)
+{
+    size_t i, w;
+    unsigned long pattern;
+
+    if (!bytes)
+        return;
+
+    if (bytes > MEMSET_INLINE_MAX) {
+        if (value.kind == IMMEDIATE) {
+            emit_ir(INSTR_MOV,
+                constant(value.value.imm.u & 0xFF, 4), reg(AX, 4));
+        } else {
+            emit_rr(INSTR_MOV, reg(SI, 4), reg(AX, 4));
+        }
+        emit_rr(INSTR_MOV, reg(DI, 8), reg(R8, 8));
+        emit_ir(INSTR_MOV, constant(bytes, 8), reg(CX, 8));
+        emit_rep_stos(1);
+        emit_rr(INSTR_MOV, reg(R8, 8), reg(DI, 8));
+        return;
+    }
+
+    pattern = 0x0101010101010101ul;
+    if (value.kind == IMMEDIATE) {
+        pattern *= value.value.imm.u & 0xFF;
+        if (!pattern) {
+            emit_rr(INSTR_XOR, reg(AX, 4), reg(AX, 4));
+        } else {
+            emit_ir(INSTR_MOV, constant(pattern, 8), reg(AX, 8));
+        }
+    } else {
+        emit_rr(INSTR_MOV, reg(SI, 4), reg(AX, 4));
+        emit_rr(INSTR_MOVZX, reg(AX, 1), reg(AX, 4));
+        emit_ir(INSTR_MOV, constant(pattern, 8), reg(CX, 8));
+        emit_r_(INSTR_IMUL, reg(CX, 8));
+    }
+
+    if (bytes < 16 || context.no_sse) {
+        w = chunk_width(bytes);
+        for (i = 0; i < bytes; i += w) {
+            if (i + w > bytes) {
+                i = bytes - w;
+            }
+            emit_rm(INSTR_MOV, reg(AX, w), location(address(i, DI, 0, 0), w));
+        }
+    } else {
+        if (value.kind == IMMEDIATE && !pattern) {
+            emit_rr(INSTR_PXOR, reg(XMM0, 8), reg(XMM0, 8));
+        } else {
+            emit_rr(INSTR_MOVQ, reg(AX, 8), reg(XMM0, 8));
+            emit_rr(INSTR_PUNPCKLQDQ, reg(XMM0, 8), reg(XMM0, 8));
+        }
+        for (i = 0; i < bytes; i += 16) {
+            if (i + 16 > bytes) {
+                i = bytes - 16;
+            }
+            emit_rm(INSTR_MOVDQU,
+                reg(XMM0, 8), location(address(i, DI, 0, 0), 8));
+        }
+    }
+}
+
+/*
+ * Emit code for comparing given number of bytes at %rdi and %rsi,
+ * with result in %eax. Chunks are loaded to integer registers, and
+ * byte swapped to compare as big endian unsigned integers. The result
+ * is -1 or 1 on the first difference found.
+ */
+static void emit_memcmp(size_t bytes)
+{
+    size_t i, w, r;
+    const struct symbol *diff, *done;
+
+    assert(bytes <= MEMCMP_INLINE_MAX);
+    if (!bytes) {
+        emit_rr(INSTR_XOR, reg(AX, 4), reg(AX, 4));
+        return;
+    }
+
+    if (bytes == 1) {
+        emit_mr(INSTR_MOVZX, location(address(0, DI, 0, 0), 1), reg(AX, 4));
+        emit_mr(INSTR_MOVZX, location(address(0, SI, 0, 0), 1), reg(CX, 4));
+        emit_rr(INSTR_SUB, reg(CX, 4), reg(AX, 4));
+        return;
+    }
+
+    diff = create_label(definition);
+    done = create_label(definition);
+    w = chunk_width(bytes);
+    for (i = 0; i < bytes; i += w) {
+        if (i + w > bytes) {
+            i = bytes - w;
+        }
+        if (w == 2) {
+            r = 4;
+            emit_mr(INSTR_MOVZX, location(address(i, DI, 0, 0), 2), reg(AX, r));
+            emit_mr(INSTR_MOVZX, location(address(i, SI, 0, 0), 2), reg(CX, r));
+        } else {
+            r = w;
+            emit_mr(INSTR_MOV, location(address(i, DI, 0, 0), w), reg(AX, r));
+            emit_mr(INSTR_MOV, location(address(i, SI, 0, 0), w), reg(CX, r));
+        }
+        emit_r_(INSTR_BSWAP, reg(AX, r));
+        emit_r_(INSTR_BSWAP, reg(CX, r));
+        emit_rr(INSTR_CMP, reg(CX, r), reg(AX, r));
+        emit_jcc(CC_NE, addr(diff));
     }
+
+    emit_rr(INSTR_XOR, reg(AX, 4), reg(AX, 4));
+    emit_i_(INSTR_JMP, addr(done));
+    enter_context(diff);
+    emit_setcc(CC_A, reg(AX, 1));
+    emit_rr(INSTR_MOVZX, reg(AX, 1), reg(AX, 4));
+    emit_mr(INSTR_LEA, location(address(-1, AX, AX, 1), 8), reg(AX, 4));
+    enter_context(done);
 }
 
 /* Push value to stack, rounded up to always be 8 byte aligned. */
@@ -1361,6 +1744,29 @@ static int alloc_register_params(
     return 0;
 }
 
+/*
+ * Store low bytes of register to the last eightbyte of an object, when
+ * the remaining width is not a standard register width. Register value
+ * is clobbered.
+ */
+static void store_partial(enum reg r, struct var var, size_t width)
+{
+    size_t w;
+
+    while (width) {
+        w = width >= 4 ? 4 : width >= 2 ? 2 : 1;
+        var.type = w == 4 ? basic_type__unsigned_int
+            : w == 2 ? basic_type__unsigned_short
+            : basic_type__unsigned_char;
+        store(r, var);
+        width -= w;
+        if (width) {
+            emit_ir(INSTR_SHR, constant(w * 8, 1), reg(r, 8));
+            var.offset += w;
+        }
+    }
+}
+
 static void move_to_from_registers(
     struct var var,
     struct param_class pc,
@@ -1382,6 +1788,21 @@ static void move_to_from_registers(
         type = var.type;
         n = EIGHTBYTES(type);
         for (i = 0; i < n; ++i) {
+            if (pc.eightbyte[i] == PC_SSE
+                && i + 1 < n
+                && pc.eightbyte[i + 1] == PC_SSEUP)
+            {
+                r = *sseregs++;
+                var.type = type;
+                if (toggle_load) {
+                    load_vector(var, r);
+                } else {
+                    store_vector(r, var);
+                }
+                var.offset += 16;
+                i += 1;
+                continue;
+            }
             if (pc.eightbyte[i] == PC_INTEGER) {
                 r = *intregs++;
             } else {
@@ -1390,6 +1811,8 @@ static void move_to_from_registers(
             var.type = slice_type(type, pc, i);
             if (toggle_load) {
                 load(var, r);
+            } else if (size_of(type) - i * 8 < size_of(var.type)) {
+                store_partial(r, var, size_of(type) - i * 8);
             } else {
                 store(r, var);
             }
@@ -1530,7 +1953,9 @@ static int push_function_arguments(Type type, struct param_class respc)
 /*
  * Assign stack location to locals, writing sym->stack_offset.
  *
- * Round up to nearest eightbyte, making all variables aligned.
+ * Round up to nearest eightbyte, making all variables aligned. Types
+ * requiring 16 byte alignment, like vectors, are placed accordingly
+ * relative to %rbp.
  */
 static int allocate_locals(
     struct definition *def,
@@ -1546,6 +1971,11 @@ static int allocate_locals(
         assert(sym->symtype == SYM_DEFINITION);
         if (sym->linkage == LINK_NONE && sym->slot == 0 && !is_vla(sym->type)) {
             stack_offset -= EIGHTBYTES(sym->type) * 8;
+            if (type_alignment(sym->type) >= 16
+                && (stack_offset - reg_offset) % 16)
+            {
+                stack_offset -= 8;
+            }
             sym->stack_offset = stack_offset - reg_offset;
         }
     }
@@ -1680,7 +2110,7 @@ static void allocate_registers(struct definition *def)
     } else {
         for (i = 0; i < array_len(&def->locals); ++i) {
             sym = array_get(&def->locals, i);
-            if (!is_temporary(sym) || sym->slot)
+            if (!is_temporary(sym) || sym->slot || sym->memory)
                 continue;
 
             assert(sym->linkage == LINK_NONE);
@@ -2130,27 +2560,90 @@ static void compile__builtin_va_arg(struct var res, struct var args)
     }
 }
 
-static void store_caller_saved_registers(void)
+enum memory_function {
+    MEM_NONE,
+    MEM_CPY,
+    MEM_MOVE,
+    MEM_SET,
+    MEM_CMP
+};
+
+/*
+ * Recognize call to standard library memcpy, memmove, memset or memcmp
+ * with constant size, which can be expanded inline. Arguments are in
+ * func_args.
+ */
+static enum memory_function inline_memory_function(struct var ptr)
 {
-    int i;
+    size_t n;
+    const char *name;
+    const struct symbol *sym;
+    struct var dst, src, size;
 
-    for (i = 0; i < sse_regs_alloc; ++i) {
-        emit_ir(INSTR_SUB, constant(16, 8), reg(SP, 8));
-        emit_rm(INSTR_MOVS,
-            reg(temp_sse_reg[i], 8),
-            location(address(0, SP, 0, 0), 8));
+    if (ptr.kind != ADDRESS || array_len(&func_args) != 3) {
+        return MEM_NONE;
+    }
+
+    sym = ptr.value.symbol;
+    if (sym->linkage != LINK_EXTERN || sym->symtype != SYM_DECLARATION) {
+        return MEM_NONE;
+    }
+
+    dst = array_get(&func_args, 0);
+    src = array_get(&func_args, 1);
+    size = array_get(&func_args, 2);
+    if (!is_pointer(dst.type)
+        || size.kind != IMMEDIATE
+        || !is_integer(size.type))
+    {
+        return MEM_NONE;
+    }
+
+    n = size.value.imm.u;
+    name = str_raw(sym->name);
+    if (!strcmp(name, "memset")) {
+        return is_integer(src.type) ? MEM_SET : MEM_NONE;
+    } else if (!is_pointer(src.type)) {
+        return MEM_NONE;
+    } else if (!strcmp(name, "memcpy")) {
+        return n <= MEMCPY_INLINE_MAX ? MEM_CPY : MEM_NONE;
+    } else if (!strcmp(name, "memmove")) {
+        return n <= (context.no_sse ? 15 : MEMMOVE_INLINE_MAX)
+            ? MEM_MOVE : MEM_NONE;
+    } else if (!strcmp(name, "memcmp")) {
+        return n <= MEMCMP_INLINE_MAX ? MEM_CMP : MEM_NONE;
     }
+
+    return MEM_NONE;
 }
 
-static void load_caller_saved_registers(void)
+/*
+ * Expand memory function inline, after arguments are placed in
+ * registers. Only caller saved registers are used, and the result is
+ * put in %rax like a normal call.
+ */
+static void compile_memory_function(
+    enum memory_function func,
+    struct var value,
+    size_t bytes)
 {
-    int i;
-
-    for (i = sse_regs_alloc - 1; i >= 0; --i) {
-        emit_mr(INSTR_MOVS,
-            location(address(0, SP, 0, 0), 8),
-            reg(temp_sse_reg[i], 8));
-        emit_ir(INSTR_ADD, constant(16, 8), reg(SP, 8));
+    switch (func) {
+    default: assert(0);
+    case MEM_CPY:
+        emit_memcpy(bytes);
+        emit_rr(INSTR_MOV, reg(DI, 8), reg(AX, 8));
+        break;
+    case MEM_MOVE:
+        emit_memmove(bytes);
+        emit_rr(INSTR_MOV, reg(DI, 8), reg(AX, 8));
+        break;
+    case MEM_SET:
+        emit_memset(value, bytes);
+        emit_rr(INSTR_MOV, reg(DI, 8), reg(AX, 8));
+        break;
+    case MEM_CMP:
+        emit_memcmp(bytes);
+        break;
     }
 }
 
@@ -2163,8 +2656,11 @@ static void load_caller_saved_registers(void)
 static enum reg compile_call(struct var target, struct var ptr)
 {
     int mem_used;
+    size_t bytes;
     Type func, ret;
+    struct var value;
     struct param_class pc;
+    enum memory_function mf;
     assert(is_pointer(ptr.type));
     assert(is_function(type_next(ptr.type)));
 
@@ -2172,26 +2668,36 @@ static enum reg compile_call(struct var target, struct var ptr)
     ret = type_next(func);
     pc = classify(ret);
 
-    store_caller_saved_registers();
-    mem_used = push_function_arguments(func, pc);
-    if (pc.eightbyte[0] == PC_MEMORY) {
-        assert(!is_void(target.type));
-        load_address(target, param_int_reg[0]);
-    }
-
-    if (ptr.kind == ADDRESS) {
-        assert(!ptr.offset);
-        emit_i_(INSTR_CALL, addr(ptr.value.symbol));
+    mf = inline_memory_function(ptr);
+    if (mf != MEM_NONE) {
+        value = array_get(&func_args, 1);
+        bytes = array_get(&func_args, 2).value.imm.u;
+        mem_used = push_function_arguments(func, pc);
+        assert(!mem_used);
+        compile_memory_function(mf, value, bytes);
     } else {
-        load(ptr, R11);
-        emit_r_(INSTR_CALL, reg(R11, 8));
-    }
+        store_caller_saved_registers();
+        mem_used = push_function_arguments(func, pc);
+        if (pc.eightbyte[0] == PC_MEMORY) {
+            assert(!is_void(target.type));
+            load_address(target, param_int_reg[0]);
+        }
+
+        if (ptr.kind == ADDRESS) {
+            assert(!ptr.offset);
+            emit_i_(INSTR_CALL, addr(ptr.value.symbol));
+        } else {
+            load(ptr, R11);
+            emit_r_(INSTR_CALL, reg(R11, 8));
+        }
+
+        if (mem_used) {
+            emit_ir(INSTR_ADD, constant(mem_used, 8), reg(SP, 8));
+        }
 
-    if (mem_used) {
-        emit_ir(INSTR_ADD, constant(mem_used, 8), reg(SP, 8));
+        load_caller_saved_registers();
     }
 
-    load_caller_saved_registers();
     switch (pc.eightbyte[0]) {
     case PC_X87:
         assert(x87_stack == 0);
@@ -2390,7 +2896,7 @@ static enum reg compile_add(
             if (operand_equal(target, r)) {
                 if (is_int_constant(l)) {
                     if ((cx = allocated_register(r)) != 0) {
-                        emit_rr(INSTR_ADD, reg(ax, w), reg(cx, w));
+                        emit_ir(INSTR_ADD, value_of(l, w), reg(cx, w));
                         ax = cx;
                     } else {
                         emit_im(INSTR_ADD,
@@ -2409,7 +2915,7 @@ static enum reg compile_add(
             } else if (operand_equal(target, l)) {
                 if (is_int_constant(r)) {
                     if ((cx = allocated_register(l)) != 0) {
-                        emit_rr(INSTR_ADD, reg(ax, w), reg(cx, w));
+                        emit_ir(INSTR_ADD, value_of(r, w), reg(cx, w));
                         ax = cx;
                     } else {
                         emit_im(INSTR_ADD,
@@ -2515,14 +3021,277 @@ static enum reg compile_not(
     return ax;
 }
 
-static enum reg compile_neg(
-    struct var target,
-    struct var l)
+/* Constant of width w with all bytes set to the same value. */
+static long repeat_byte(int byte, int w)
 {
-    static struct symbol *c32, *c64;
+    long n;
 
-    enum reg xmm0, xmm1;
-    struct var val;
+    for (n = 0; w > 0; --w) {
+        n = (n << 8) | byte;
+    }
+
+    return n;
+}
+
+/*
+ * Count number of set bits. Without POPCNT, add bits in parallel in
+ * increasingly wider fields, and sum the bytes using multiplication.
+ */
+static enum reg compile_popcount(
+    struct var target,
+    struct var l)
+{
+    int w;
+
+    w = size_of(l.type);
+    assert(w == 4 || w == 8);
+    load(l, AX);
+    if (context.cpu & CPU_POPCNT) {
+        emit_rr(INSTR_POPCNT, reg(AX, w), reg(AX, w));
+    } else {
+        emit_rr(INSTR_MOV, reg(AX, w), reg(CX, w));
+        emit_ir(INSTR_SHR, constant(1, 1), reg(CX, w));
+        emit_ir(INSTR_MOV, constant(repeat_byte(0x55, w), w), reg(R11, w));
+        emit_rr(INSTR_AND, reg(R11, w), reg(CX, w));
+        emit_rr(INSTR_SUB, reg(CX, w), reg(AX, w));
+        emit_ir(INSTR_MOV, constant(repeat_byte(0x33, w), w), reg(R11, w));
+        emit_rr(INSTR_MOV, reg(AX, w), reg(CX, w));
+        emit_ir(INSTR_SHR, constant(2, 1), reg(AX, w));
+        emit_rr(INSTR_AND, reg(R11, w), reg(CX, w));
+        emit_rr(INSTR_AND, reg(R11, w), reg(AX, w));
+        emit_rr(INSTR_ADD, reg(CX, w), reg(AX, w));
+        emit_rr(INSTR_MOV, reg(AX, w), reg(CX, w));
+        emit_ir(INSTR_SHR, constant(4, 1), reg(CX, w));
+        emit_rr(INSTR_ADD, reg(CX, w), reg(AX, w));
+        emit_ir(INSTR_MOV, constant(repeat_byte(0x0F, w), w), reg(R11, w));
+        emit_rr(INSTR_AND, reg(R11, w), reg(AX, w));
+        emit_ir(INSTR_MOV, constant(repeat_byte(0x01, w), w), reg(R11, w));
+        emit_r_(INSTR_MUL, reg(R11, w));
+        emit_ir(INSTR_SHR, constant(w * 8 - 8, 1), reg(AX, w));
+    }
+
+    if (!is_void(target.type)) {
+        store(AX, target);
+    }
+
+    return AX;
+}
+
+/*
+ * Count leading or trailing zero bits. Bit scan gives the index of the
+ * most significant bit, which is converted to number of leading zeros.
+ * Result is undefined for zero input.
+ */
+static enum reg compile_bit_scan(
+    struct var target,
+    enum optype op,
+    struct var l)
+{
+    int w;
+
+    w = size_of(l.type);
+    assert(w == 4 || w == 8);
+    load(l, AX);
+    if (op == IR_OP_CTZ) {
+        emit_rr((context.cpu & CPU_BMI) ? INSTR_TZCNT : INSTR_BSF, reg(AX, w), reg(AX, w));
+    } else if (context.cpu & CPU_LZCNT) {
+        emit_rr(INSTR_LZCNT, reg(AX, w), reg(AX, w));
+    } else {
+        emit_rr(INSTR_BSR, reg(AX, w), reg(AX, w));
+        emit_ir(INSTR_XOR, constant(w * 8 - 1, 4), reg(AX, 4));
+    }
+
+    if (!is_void(target.type)) {
+        store(AX, target);
+    }
+
+    return AX;
+}
+
+/*
+ * Find one plus the index of the least significant set bit, or zero
+ * if there are no bits set. Bit scan sets the zero flag in the latter
+ * case, which is used to mask the result.
+ */
+static enum reg compile_ffs(
+    struct var target,
+    struct var l)
+{
+    int w;
+
+    w = size_of(l.type);
+    assert(w == 4 || w == 8);
+    load(l, CX);
+    emit_rr(INSTR_BSF, reg(CX, w), reg(AX, w));
+    emit_setcc(CC_E, reg(CX, 1));
+    emit_rr(INSTR_MOVZX, reg(CX, 1), reg(CX, 4));
+    emit_ir(INSTR_SUB, constant(1, 4), reg(CX, 4));
+    emit_ir(INSTR_ADD, constant(1, 4), reg(AX, 4));
+    emit_rr(INSTR_AND, reg(CX, 4), reg(AX, 4));
+    if (!is_void(target.type)) {
+        store(AX, target);
+    }
+
+    return AX;
+}
+
+/* Reverse byte order, using rotate for 16 bit values. */
+static enum reg compile_bswap(
+    struct var target,
+    struct var l)
+{
+    int w;
+
+    w = size_of(l.type);
+    load(l, AX);
+    if (w == 2) {
+        emit_ir(INSTR_ROL, constant(8, 1), reg(AX, 2));
+    } else {
+        assert(w == 4 || w == 8);
+        emit_r_(INSTR_BSWAP, reg(AX, w));
+    }
+
+    if (!is_void(target.type)) {
+        store(AX, target);
+    }
+
+    return AX;
+}
+
+/*
+ * Memory operand of atomic operation, addressing the object pointed to
+ * by ptr. Pointer is loaded to %rsi unless it is a known address.
+ */
+static struct memory atomic_location(struct var ptr, int w)
+{
+    struct var target;
+
+    if (ptr.kind == ADDRESS
+        && !is_global_offset(ptr.value.symbol)
+        && !is_function(ptr.value.symbol->type))
+    {
+        target = ptr;
+        target.kind = DIRECT;
+        return location_of(target, w);
+    }
+
+    load(ptr, SI);
+    return location(address(0, SI, 0, 0), w);
+}
+
+/*
+ * Under the x86 memory model, aligned loads and stores are atomic, and
+ * only a later load can be reordered before an earlier store. Plain mov
+ * is then enough for loads and for stores not sequentially consistent.
+ * Read-modify-write operations use xchg or instructions with a lock
+ * prefix, which are also full barriers.
+ *
+ * Fetch and bitwise operation yields the old value, which there is no
+ * single instruction for. Use a compare and swap loop unless the result
+ * is not used.
+ */
+static enum reg compile_atomic(struct var target, struct expression expr)
+{
+    int w;
+    enum opcode op;
+    struct memory mem;
+    struct var expected;
+    const struct symbol *retry;
+
+    w = size_of(expr.type);
+    assert(w == 1 || w == 2 || w == 4 || w == 8);
+    switch (expr.op) {
+    default: assert(0);
+    case IR_OP_ATOMIC_LOAD:
+        mem = atomic_location(expr.l, w);
+        emit_mr(INSTR_MOV, mem, reg(AX, w));
+        break;
+    case IR_OP_ATOMIC_STORE:
+        load(expr.r, AX);
+        mem = atomic_location(expr.l, w);
+        emit_rm(INSTR_MOV, reg(AX, w), mem);
+        break;
+    case IR_OP_ATOMIC_XCHG:
+        load(expr.r, AX);
+        mem = atomic_location(expr.l, w);
+        emit_rm(INSTR_XCHG, reg(AX, w), mem);
+        break;
+    case IR_OP_ATOMIC_ADD:
+        load(expr.r, AX);
+        mem = atomic_location(expr.l, w);
+        if (is_void(target.type)) {
+            emit_lock_rm(INSTR_ADD, reg(AX, w), mem);
+        } else {
+            emit_lock_rm(INSTR_XADD, reg(AX, w), mem);
+        }
+        break;
+    case IR_OP_ATOMIC_CAS:
+        expected = array_pop_back(&func_args);
+        load(expected, AX);
+        load(expr.r, DX);
+        mem = atomic_location(expr.l, w);
+        emit_lock_rm(INSTR_CMPXCHG, reg(DX, w), mem);
+        break;
+    case IR_OP_ATOMIC_AND:
+    case IR_OP_ATOMIC_OR:
+    case IR_OP_ATOMIC_XOR:
+        op = expr.op == IR_OP_ATOMIC_AND ? INSTR_AND
+            : expr.op == IR_OP_ATOMIC_OR ? INSTR_OR : INSTR_XOR;
+        load(expr.r, CX);
+        mem = atomic_location(expr.l, w);
+        if (is_void(target.type)) {
+            emit_lock_rm(op, reg(CX, w), mem);
+        } else {
+            retry = create_label(definition);
+            emit_mr(INSTR_MOV, mem, reg(AX, w));
+            enter_context(retry);
+            emit_rr(INSTR_MOV, reg(AX, w), reg(DX, w));
+            emit_rr(op, reg(CX, w), reg(DX, w));
+            emit_lock_rm(INSTR_CMPXCHG, reg(DX, w), mem);
+            emit_jcc(CC_NE, addr(retry));
+        }
+        break;
+    }
+
+    if (!is_void(target.type)) {
+        store(AX, target);
+    }
+
+    return AX;
+}
+
+static enum reg compile_rotate(
+    struct var target,
+    enum opcode opcode,
+    struct var l,
+    struct var r)
+{
+    int w;
+
+    w = size_of(l.type);
+    load(l, AX);
+    if (r.kind == IMMEDIATE) {
+        emit_ir(opcode, constant(r.value.imm.u % (w * 8), 1), reg(AX, w));
+    } else {
+        load(r, CX);
+        emit_rr(opcode, reg(CX, 1), reg(AX, w));
+    }
+
+    if (!is_void(target.type)) {
+        store(AX, target);
+    }
+
+    return AX;
+}
+
+static enum reg compile_neg(
+    struct var target,
+    struct var l)
+{
+    static struct symbol *c32, *c64;
+
+    enum reg xmm0, xmm1;
+    struct var val;
     union value num = {0};
 
     if (is_float(l.type)) {
@@ -2551,6 +3320,83 @@ static enum reg compile_neg(
     return xmm0;
 }
 
+/* Return log2 of n if it is a power of two, or -1 otherwise. */
+static int power_of_two(unsigned long n)
+{
+    int k;
+
+    if (!n || (n & (n - 1)))
+        return -1;
+
+    for (k = 0; n > 1; ++k) {
+        n >>= 1;
+    }
+
+    return k;
+}
+
+/* Get value of integer immediate, truncated to operand width. */
+static unsigned long immediate_value(struct var v, int w)
+{
+    assert(v.kind == IMMEDIATE);
+    assert(is_integer(v.type));
+    return w == 8 ? v.value.imm.u : v.value.imm.u & 0xFFFFFFFFu;
+}
+
+/*
+ * Multiplication by a constant can be done with shifts, additions and
+ * lea, as long as the factor is on the form 2^k, 2^k +/- 1, or 3, 5
+ * and 9 multiplied by 2^k.
+ */
+static int is_mul_cheap(unsigned long c, int w)
+{
+    int k;
+
+    for (k = 0; c && !(c & 1); ++k) {
+        c >>= 1;
+    }
+
+    return k < w * 8
+        && (c <= 1
+            || c == 3 || c == 5 || c == 9
+            || (power_of_two(c - 1) > 0 && power_of_two(c - 1) < w * 8)
+            || (power_of_two(c + 1) > 0 && power_of_two(c + 1) < w * 8));
+}
+
+/* Multiply %rax by constant in place, using %rcx as scratch register. */
+static void emit_mul_cheap(unsigned long c, int w)
+{
+    int k, n;
+
+    for (k = 0; c && !(c & 1); ++k) {
+        c >>= 1;
+    }
+
+    if (!c) {
+        emit_rr(INSTR_XOR, reg(AX, 4), reg(AX, 4));
+        return;
+    } else if (c == 3 || c == 5 || c == 9) {
+        emit_mr(INSTR_LEA,
+            location(address(0, AX, AX, c - 1), 8),
+            reg(AX, w));
+    } else if (c > 1) {
+        n = power_of_two(c - 1);
+        emit_rr(INSTR_MOV, reg(AX, w), reg(CX, w));
+        if (n > 0) {
+            emit_ir(INSTR_SHL, constant(n, 1), reg(AX, w));
+            emit_rr(INSTR_ADD, reg(CX, w), reg(AX, w));
+        } else {
+            n = power_of_two(c + 1);
+            emit_ir(INSTR_SHL, constant(n, 1), reg(AX, w));
+            emit_rr(INSTR_SUB, reg(CX, w), reg(AX, w));
+        }
+    }
+
+    if (k) {
+        emit_ir(INSTR_SHL, constant(k, 1), reg(AX, w));
+    }
+}
+
 static enum reg compile_mul(
     struct var target,
     Type type,
@@ -2559,8 +3405,15 @@ static enum reg compile_mul(
 {
     size_t w;
     enum reg ax, cx;
+    struct var v;
 
     w = size_of(type);
+    if (l.kind == IMMEDIATE && r.kind != IMMEDIATE) {
+        v = l;
+        l = r;
+        r = v;
+    }
+
     if (is_real(type)) {
         ax = load_cast(l, type);
         cx = load_cast(r, type);
@@ -2577,6 +3430,16 @@ static enum reg compile_mul(
                 store(ax, target);
             }
         }
+    } else if (r.kind == IMMEDIATE
+        && (w == 4 || w == 8)
+        && is_mul_cheap(immediate_value(r, w), w))
+    {
+        ax = load_cast(l, type);
+        assert(ax == AX);
+        emit_mul_cheap(immediate_value(r, w), w);
+        if (!is_void(target.type)) {
+            store(ax, target);
+        }
     } else {
         ax = load_cast(r, r.type);
         assert(ax == AX);
@@ -2597,6 +3460,219 @@ static enum reg compile_mul(
     return ax;
 }
 
+/*
+ * Compute magic number and shift for signed division by constant d,
+ * where 2 <= |d| <= 2^(n-1), following Hacker's Delight. Return value
+ * is n bit pattern of the multiplier.
+ */
+static unsigned long signed_magic(long d, int n, int *shift)
+{
+    int p;
+    unsigned long ad, anc, delta, q1, r1, q2, r2, t, two, mask;
+
+    two = 1ul << (n - 1);
+    mask = (two - 1) | two;
+    ad = d < 0 ? -(unsigned long) d : (unsigned long) d;
+    t = two + (d < 0);
+    anc = t - 1 - t % ad;
+    p = n - 1;
+    q1 = two / anc;
+    r1 = two - q1 * anc;
+    q2 = two / ad;
+    r2 = two - q2 * ad;
+    do {
+        p++;
+        q1 = (2 * q1) & mask;
+        r1 = (2 * r1) & mask;
+        if (r1 >= anc) {
+            q1++;
+            r1 -= anc;
+        }
+        q2 = (2 * q2) & mask;
+        r2 = (2 * r2) & mask;
+        if (r2 >= ad) {
+            q2++;
+            r2 -= ad;
+        }
+        delta = ad - r2;
+    } while (q1 < delta || (q1 == delta && r1 == 0));
+
+    *shift = p - n;
+    t = (q2 + 1) & mask;
+    return d < 0 ? -t & mask : t;
+}
+
+/*
+ * Compute magic number and shift for unsigned division by constant d,
+ * where d > 0. If the multiplier does not fit in n bits, an extra add
+ * is needed to compensate, indicated by setting the add flag.
+ */
+static unsigned long unsigned_magic(
+    unsigned long d,
+    int n,
+    int *shift,
+    int *add)
+{
+    int p;
+    unsigned long nc, delta, q1, r1, q2, r2, two, mask;
+
+    two = 1ul << (n - 1);
+    mask = (two - 1) | two;
+    *add = 0;
+    nc = mask - ((mask - d + 1) & mask) % d;
+    p = n - 1;
+    q1 = two / nc;
+    r1 = two - q1 * nc;
+    q2 = (two - 1) / d;
+    r2 = (two - 1) - q2 * d;
+    do {
+        p++;
+        if (r1 >= nc - r1) {
+            q1 = (2 * q1 + 1) & mask;
+            r1 = (2 * r1 - nc) & mask;
+        } else {
+            q1 = (2 * q1) & mask;
+            r1 = (2 * r1) & mask;
+        }
+        if (r2 + 1 >= d - r2) {
+            if (q2 >= two - 1) *add = 1;
+            q2 = (2 * q2 + 1) & mask;
+            r2 = (2 * r2 + 1 - d) & mask;
+        } else {
+            if (q2 >= two) *add = 1;
+            q2 = (2 * q2) & mask;
+            r2 = (2 * r2 + 1) & mask;
+        }
+        delta = d - 1 - r2;
+    } while (p < 2 * n && (q1 < delta || (q1 == delta && r1 == 0)));
+
+    *shift = p - n;
+    return (q2 + 1) & mask;
+}
+
+/*
+ * Determine if division by constant can be done without div or idiv.
+ * Dividing by -1 is left to idiv, which traps on overflow like other
+ * compilers do.
+ */
+static int is_div_cheap(struct var r, int w, int is_signed)
+{
+    unsigned long d;
+
+    if (r.kind != IMMEDIATE || (w != 4 && w != 8))
+        return 0;
+
+    d = immediate_value(r, w);
+    return d > 1 && (!is_signed || d != (w == 8 ? ~0ul : 0xFFFFFFFFu));
+}
+
+/*
+ * Divide %rax by constant using shift or multiplication with magic
+ * number. Dividend is kept in %rcx, and the quotient is placed in %rax.
+ */
+static void emit_div_cheap(unsigned long d, int w, int is_signed)
+{
+    int k, n, s, add;
+    unsigned long m;
+
+    n = w * 8;
+    k = power_of_two(d);
+    emit_rr(INSTR_MOV, reg(AX, w), reg(CX, w));
+    if (!is_signed) {
+        if (k > 0) {
+            emit_ir(INSTR_SHR, constant(k, 1), reg(AX, w));
+        } else {
+            m = unsigned_magic(d, n, &s, &add);
+            emit_ir(INSTR_MOV, constant(m, w), reg(DX, w));
+            emit_r_(INSTR_MUL, reg(DX, w));
+            if (add) {
+                emit_rr(INSTR_MOV, reg(CX, w), reg(AX, w));
+                emit_rr(INSTR_SUB, reg(DX, w), reg(AX, w));
+                emit_ir(INSTR_SHR, constant(1, 1), reg(AX, w));
+                emit_rr(INSTR_ADD, reg(DX, w), reg(AX, w));
+                s -= 1;
+            } else {
+                emit_rr(INSTR_MOV, reg(DX, w), reg(AX, w));
+            }
+            if (s) {
+                emit_ir(INSTR_SHR, constant(s, 1), reg(AX, w));
+            }
+        }
+    } else if (k > 0 && k < n - 1) {
+        /* Round towards zero by adding 2^k - 1 to negative dividend. */
+        emit_rr(INSTR_MOV, reg(AX, w), reg(DX, w));
+        if (k > 1) {
+            emit_ir(INSTR_SAR, constant(n - 1, 1), reg(DX, w));
+        }
+        emit_ir(INSTR_SHR, constant(n - k, 1), reg(DX, w));
+        emit_rr(INSTR_ADD, reg(DX, w), reg(AX, w));
+        emit_ir(INSTR_SAR, constant(k, 1), reg(AX, w));
+    } else {
+        if (w == 4) {
+            m = signed_magic((int) d, n, &s);
+        } else {
+            m = signed_magic((long) d, n, &s);
+        }
+        emit_ir(INSTR_MOV, constant(m, w), reg(DX, w));
+        emit_r_(INSTR_IMUL, reg(DX, w));
+        if ((d >> (n - 1)) & 1) {
+            if (!((m >> (n - 1)) & 1)) {
+                emit_rr(INSTR_SUB, reg(CX, w), reg(DX, w));
+            }
+        } else if ((m >> (n - 1)) & 1) {
+            emit_rr(INSTR_ADD, reg(CX, w), reg(DX, w));
+        }
+        if (s) {
+            emit_ir(INSTR_SAR, constant(s, 1), reg(DX, w));
+        }
+        emit_rr(INSTR_MOV, reg(DX, w), reg(AX, w));
+        emit_ir(INSTR_SHR, constant(n - 1, 1), reg(AX, w));
+        emit_rr(INSTR_ADD, reg(DX, w), reg(AX, w));
+    }
+}
+
+/*
+ * Compute remainder of %rax divided by constant, placing the result in
+ * %rax. Powers of two are masked, adjusting for negative dividend if
+ * signed. Otherwise subtract quotient multiplied by divisor.
+ */
+static void emit_mod_cheap(unsigned long d, int w, int is_signed)
+{
+    int k, n;
+    struct immediate mask;
+
+    n = w * 8;
+    k = power_of_two(d);
+    if (k > 0 && k < n - 1) {
+        mask = constant(d - 1, w);
+        if (w == 8 && d - 1 > INT_MAX) {
+            emit_ir(INSTR_MOV, mask, reg(R11, w));
+        }
+        if (is_signed) {
+            emit_rr(INSTR_MOV, reg(AX, w), reg(DX, w));
+            if (k > 1) {
+                emit_ir(INSTR_SAR, constant(n - 1, 1), reg(DX, w));
+            }
+            emit_ir(INSTR_SHR, constant(n - k, 1), reg(DX, w));
+            emit_rr(INSTR_ADD, reg(DX, w), reg(AX, w));
+        }
+        if (w == 8 && d - 1 > INT_MAX) {
+            emit_rr(INSTR_AND, reg(R11, w), reg(AX, w));
+        } else {
+            emit_ir(INSTR_AND, mask, reg(AX, w));
+        }
+        if (is_signed) {
+            emit_rr(INSTR_SUB, reg(DX, w), reg(AX, w));
+        }
+    } else {
+        emit_div_cheap(d, w, is_signed);
+        emit_ir(INSTR_MOV, constant(d, w), reg(DX, w));
+        emit_r_(INSTR_MUL, reg(DX, w));
+        emit_rr(INSTR_SUB, reg(AX, w), reg(CX, w));
+        emit_rr(INSTR_MOV, reg(CX, w), reg(AX, w));
+    }
+}
+
 static enum reg compile_div(
     struct var target,
     Type type,
@@ -2627,6 +3703,15 @@ static enum reg compile_div(
     } else {
         ax = load_cast(l, l.type);
         assert(ax == AX);
+        w = size_of(type);
+        if (is_div_cheap(r, w, is_signed(type))) {
+            emit_div_cheap(immediate_value(r, w), w, is_signed(type));
+            if (!is_void(target.type)) {
+                store(ax, target);
+            }
+            return ax;
+        }
+
         if (is_signed(l.type)) {
             w = size_of(l.type);
             assert(w == 8 || w == 4);
@@ -2667,6 +3752,15 @@ static enum reg compile_mod(
 
     ax = load_cast(l, l.type);
     assert(ax == AX);
+    w = size_of(type);
+    if (is_div_cheap(r, w, is_signed(type))) {
+        emit_mod_cheap(immediate_value(r, w), w, is_signed(type));
+        if (!is_void(target.type)) {
+            store(ax, target);
+        }
+        return ax;
+    }
+
     if (is_signed(l.type)) {
         w = size_of(l.type);
         assert(w == 8 || w == 4);
@@ -2727,7 +3821,9 @@ static enum reg compile_bitwise(
 /*
  * Shift instruction encoding is either by immediate, or implicit %cl
  * register. Encode as if something other than %cl could be chosen.
- * 
+ * BMI2 has SHLX, SARX and SHRX taking count in any register, without
+ * updating flags.
+ *
  * Behavior is undefined if shift is greater than integer width, so
  * don't care about overflow or sign.
  */
@@ -2736,9 +3832,17 @@ static enum reg compile_shl(
     struct var l,
     struct var r)
 {
+    int w;
+
+    w = size_of(l.type);
     load(l, AX);
     load(r, CX);
-    emit_rr(INSTR_SHL, reg(CX, 1), reg(AX, size_of(l.type)));
+    if ((context.cpu & CPU_BMI2) && w >= 4) {
+        emit_rr(INSTR_SHLX, reg(CX, w), reg(AX, w));
+    } else {
+        emit_rr(INSTR_SHL, reg(CX, 1), reg(AX, w));
+    }
+
     if (!is_void(target.type)) {
         store(AX, target);
     }
@@ -2751,12 +3855,18 @@ static enum reg compile_shr(
     struct var l,
     struct var r)
 {
+    int w;
+
+    w = size_of(l.type);
     load(l, AX);
     load(r, CX);
-    if (is_unsigned(l.type)) {
-        emit_rr(INSTR_SHR, reg(CX, 1), reg(AX, size_of(l.type)));
+    if ((context.cpu & CPU_BMI2) && w >= 4) {
+        emit_rr(is_unsigned(l.type) ? INSTR_SHRX : INSTR_SARX,
+            reg(CX, w), reg(AX, w));
+    } else if (is_unsigned(l.type)) {
+        emit_rr(INSTR_SHR, reg(CX, 1), reg(AX, w));
     } else {
-        emit_rr(INSTR_SAR, reg(CX, 1), reg(AX, size_of(l.type)));
+        emit_rr(INSTR_SAR, reg(CX, 1), reg(AX, w));
     }
 
     if (!is_void(target.type)) {
@@ -2832,7 +3942,24 @@ static enum reg compile_cast(
     struct param_class pc;
 
     w = size_of(type);
+    if (is_vector(type) && !context.no_sse) {
+        if (!is_void(target.type)) {
+            load_vector(l, XMM0);
+            store_vector(XMM0, target);
+        }
+        return XMM0;
+    }
+
     if (!is_standard_register_width(w) && w < 8) {
+        /*
+         * Copy exact number of bytes on store, as the target can be
+         * followed by other members or array elements.
+         */
+        if (!is_void(target.type)) {
+            store_copy_object(l, target);
+            return AX;
+        }
+
         /* Do not bother masking adjacent bits read. */
         switch (w) {
         default: assert(0);
@@ -2847,11 +3974,6 @@ static enum reg compile_cast(
             ax = load_cast(l, l.type);
             break;
         }
-        if (!is_void(target.type)) {
-            /* All variables have at least 8 byte slots. */
-            target.type = l.type;
-            store(ax, target);
-        }
         return ax;
     }
 
@@ -2907,11 +4029,86 @@ static enum reg compile_cast(
     return ax;
 }
 
+/*
+ * Find packed SSE instruction for element-wise operation on vector
+ * with given element type, and operand width used for encoding. Return
+ * 0 if there is no such instruction.
+ */
+static int vector_opcode(enum optype op, Type elem, enum opcode *opc, int *w)
+{
+    static const enum opcode
+        padd[] = {INSTR_PADDB, INSTR_PADDW, INSTR_PADDD, INSTR_PADDQ},
+        psub[] = {INSTR_PSUBB, INSTR_PSUBW, INSTR_PSUBD, INSTR_PSUBQ};
+    int i;
+
+    if (is_real(elem)) {
+        *w = size_of(elem);
+        switch (op) {
+        case IR_OP_ADD: *opc = INSTR_ADDP; return 1;
+        case IR_OP_SUB: *opc = INSTR_SUBP; return 1;
+        case IR_OP_MUL: *opc = INSTR_MULP; return 1;
+        case IR_OP_DIV: *opc = INSTR_DIVP; return 1;
+        default: return 0;
+        }
+    }
+
+    *w = 8;
+    i = size_of(elem) == 1 ? 0 : size_of(elem) == 2 ? 1
+        : size_of(elem) == 4 ? 2 : 3;
+    switch (op) {
+    case IR_OP_ADD: *opc = padd[i]; return 1;
+    case IR_OP_SUB: *opc = psub[i]; return 1;
+    case IR_OP_AND: *opc = INSTR_PAND; return 1;
+    case IR_OP_OR: *opc = INSTR_POR; return 1;
+    case IR_OP_XOR: *opc = INSTR_PXOR; return 1;
+    case IR_OP_MUL:
+        if (size_of(elem) == 4 && (context.cpu & CPU_SSE4_1)) {
+            *opc = INSTR_PMULLD;
+            return 1;
+        }
+        *opc = INSTR_PMULLW;
+        return size_of(elem) == 2;
+    default: return 0;
+    }
+}
+
+/*
+ * Compile element-wise operation on GCC vector types. Operations that
+ * do not have a packed SSE2 instruction are already split into scalar
+ * operations on each element.
+ */
+static enum reg compile_vector(struct var target, struct expression expr)
+{
+    int w;
+    enum opcode opc;
+
+    assert(is_vector(expr.type));
+    assert(!context.no_sse);
+    if (!vector_opcode(expr.op, type_next(expr.type), &opc, &w)) {
+        assert(0);
+    }
+
+    if (!is_void(target.type)) {
+        load_vector(expr.l, XMM0);
+        load_vector(expr.r, XMM1);
+        emit_rr(opc, reg(XMM1, w), reg(XMM0, w));
+        store_vector(XMM0, target);
+    }
+
+    return XMM0;
+}
+
 static enum reg compile_assign(struct var target, struct expression expr)
 {
     enum reg ax;
     enum tttn cc;
 
+    if (is_vector(expr.type) && expr.op != IR_OP_CAST
+        && expr.op != IR_OP_CALL)
+    {
+        return compile_vector(target, expr);
+    }
+
     switch (expr.op) {
     default: assert(0);
     case IR_OP_CAST:
@@ -2930,6 +4127,29 @@ static enum reg compile_assign(struct var target, struct expression expr)
     case IR_OP_NEG:
         ax = compile_neg(target, expr.l);
         break;
+    case IR_OP_POPCOUNT:
+        ax = compile_popcount(target, expr.l);
+        break;
+    case IR_OP_CLZ:
+    case IR_OP_CTZ:
+        ax = compile_bit_scan(target, expr.op, expr.l);
+        break;
+    case IR_OP_FFS:
+        ax = compile_ffs(target, expr.l);
+        break;
+    case IR_OP_BSWAP:
+        ax = compile_bswap(target, expr.l);
+        break;
+    case IR_OP_ATOMIC_LOAD:
+    case IR_OP_ATOMIC_STORE:
+    case IR_OP_ATOMIC_XCHG:
+    case IR_OP_ATOMIC_CAS:
+    case IR_OP_ATOMIC_ADD:
+    case IR_OP_ATOMIC_AND:
+    case IR_OP_ATOMIC_OR:
+    case IR_OP_ATOMIC_XOR:
+        ax = compile_atomic(target, expr);
+        break;
     case IR_OP_ADD:
         ax = compile_add(target, expr.type, expr.l, expr.r);
         break;
@@ -2960,6 +4180,12 @@ static enum reg compile_assign(struct var target, struct expression expr)
     case IR_OP_SHR:
         ax = compile_shr(target, expr.l, expr.r);
         break;
+    case IR_OP_ROL:
+        ax = compile_rotate(target, INSTR_ROL, expr.l, expr.r);
+        break;
+    case IR_OP_ROR:
+        ax = compile_rotate(target, INSTR_ROR, expr.l, expr.r);
+        break;
     case IR_OP_EQ:
     case IR_OP_NE:
     case IR_OP_GE:
@@ -3033,6 +4259,47 @@ static void compile__asm(struct asm_statement st)
     }
 }
 
+/*
+ * Prefetch memory at address, choosing instruction from locality hint.
+ * Write prefetch is only used if supported by the target, otherwise
+ * falling back to prefetch for read.
+ */
+static void compile_prefetch(struct var ptr, int hint)
+{
+    enum reg ax;
+    enum opcode opcode;
+    struct var target;
+
+    if ((hint & 4) && (context.cpu & CPU_PRFCHW)) {
+        opcode = INSTR_PREFETCHW;
+    } else switch (hint & 3) {
+    case 0:
+        opcode = INSTR_PREFETCHNTA;
+        break;
+    case 1:
+        opcode = INSTR_PREFETCHT2;
+        break;
+    case 2:
+        opcode = INSTR_PREFETCHT1;
+        break;
+    default:
+        opcode = INSTR_PREFETCHT0;
+        break;
+    }
+
+    if (ptr.kind == ADDRESS
+        && !is_global_offset(ptr.value.symbol)
+        && !is_function(ptr.value.symbol->type))
+    {
+        target = ptr;
+        target.kind = DIRECT;
+        emit_m_(opcode, location_of(target, 1));
+    } else {
+        ax = load(ptr, AX);
+        emit_m_(opcode, location(address(0, ax, 0, 0), 1));
+    }
+}
+
 static void compile_statement(struct statement stmt)
 {
     switch (stmt.st) {
@@ -3054,6 +4321,14 @@ static void compile_statement(struct statement stmt)
         assert(stmt.t.is_symbol);
         compile_vla_alloc(stmt.t.value.symbol, stmt.expr);
         break;
+    case IR_PREFETCH:
+        assert(is_identity(stmt.expr));
+        assert(stmt.t.kind == IMMEDIATE);
+        compile_prefetch(stmt.expr.l, stmt.t.value.imm.i);
+        break;
+    case IR_FENCE:
+        emit_(INSTR_MFENCE);
+        break;
     case IR_ASM:
         compile__asm(array_get(&definition->asm_statements, stmt.asm_index));
         break;
@@ -3138,6 +4413,80 @@ static void compile_return(Type func, struct expression expr)
     assert(x87_stack == 0);
 }
 
+/*
+ * Restore temporaries allocated to callee saved registers, which are
+ * pushed after the frame pointer on function entry.
+ */
+static void load_callee_saved_registers(void)
+{
+    int i;
+
+    if (int_regs_alloc) {
+        emit_mr(INSTR_LEA,
+            location(address(-int_regs_alloc * 8, BP, 0, 0), 8),
+            reg(SP, 8));
+        for (i = int_regs_alloc; i > 0; --i) {
+            emit_r_(INSTR_POP, reg(temp_int_reg[i - 1], 8));
+        }
+    }
+}
+
+/*
+ * Compile call in tail position as a jump, after leaving the stack
+ * frame. The callee returns directly to our caller, with the result
+ * already in place.
+ *
+ * Only possible if all arguments are passed in registers, and the
+ * result is not written to memory provided by the caller. Calls that
+ * are expanded inline are also not done as tail calls. Return 0
+ * without emitting anything if this is not the case.
+ */
+static int compile_tail_call(struct var ptr)
+{
+    int i, next_integer_reg = 0, next_sse_reg = 0;
+    Type func;
+    struct var arg;
+    struct param_class pc;
+    assert(is_pointer(ptr.type));
+    assert(is_function(type_next(ptr.type)));
+
+    func = type_next(ptr.type);
+    pc = classify(type_next(func));
+    if (pc.eightbyte[0] == PC_MEMORY
+        || inline_memory_function(ptr) != MEM_NONE)
+    {
+        return 0;
+    }
+
+    for (i = 0; i < array_len(&func_args); ++i) {
+        arg = array_get(&func_args, i);
+        if (!alloc_register_params(
+                classify(arg.type), &next_integer_reg, &next_sse_reg))
+        {
+            return 0;
+        }
+    }
+
+    i = push_function_arguments(func, pc);
+    assert(!i);
+    if (ptr.kind != ADDRESS) {
+        load(ptr, R11);
+    }
+
+    load_callee_saved_registers();
+    emit_(INSTR_LEAVE);
+    if (ptr.kind == ADDRESS) {
+        assert(!ptr.offset);
+        emit_i_(INSTR_JMP, addr(ptr.value.symbol));
+    } else {
+        emit_r_(INSTR_JMP, reg(R11, 8));
+    }
+
+    relase_regs();
+    assert(x87_stack == 0);
+    return 1;
+}
+
 /*
  * Emit code for all statements in a block, jump to children based on
  * compare result, or return value in case of no children.
@@ -3146,9 +4495,50 @@ static void compile_return(Type func, struct expression expr)
  * object, branchhing to the correct next block. All scalar expressions
  * are allowed.
  */
+/*
+ * Emit conditional jump to branch targets, where cc is the condition
+ * for taking the true branch. No jump is needed to the block placed
+ * next, and the condition is inverted if the true branch falls
+ * through.
+ *
+ * Floating point comparisons for equality must also check the parity
+ * flag, which is set if either operand is NaN.
+ */
+static void emit_branch(
+    struct block *block,
+    struct block *next,
+    enum tttn cc,
+    int is_real)
+{
+    struct block *t, *f;
+
+    if (is_real && (cc == CC_E || cc == CC_NE)) {
+        t = block->jump[cc == CC_E];
+        f = block->jump[cc != CC_E];
+        if (next == f) {
+            emit_jcc(CC_P, addr(f->label));
+            emit_jcc(CC_E, addr(t->label));
+        } else {
+            emit_jcc(CC_NE, addr(f->label));
+            emit_jcc(CC_P, addr(f->label));
+            if (next != t) {
+                emit_i_(INSTR_JMP, addr(t->label));
+            }
+        }
+    } else if (next == block->jump[0]) {
+        emit_jcc(cc, addr(block->jump[1]->label));
+    } else {
+        emit_jcc((enum tttn) (cc ^ 1), addr(block->jump[0]->label));
+        if (next != block->jump[1]) {
+            emit_i_(INSTR_JMP, addr(block->jump[1]->label));
+        }
+    }
+}
+
 static void compile_block(
     struct definition *def,
     struct block *block,
+    struct block *next,
     Type type)
 {
     int i, w;
@@ -3156,20 +4546,35 @@ static void compile_block(
     enum reg xmm0, xmm1;
     enum tttn cc;
     struct statement st;
-    struct immediate br0, br1;
 
     assert(is_function(type));
-    if (block->color == BLACK)
-        return;
-
-    block->color = BLACK;
     enter_context(block->label);
     for (i = block->head; i < block->head + block->count; ++i) {
         st = array_get(&def->statements, i);
+        if (block->tail_call
+            && i == block->head + block->count - 1
+            && st.expr.op == IR_OP_CALL
+            && (!block->has_return_value || block->expr.op != IR_OP_CALL)
+            && compile_tail_call(st.expr.l))
+        {
+            return;
+        }
         compile_statement(st);
     }
 
-    if (!block->jump[0] && !block->jump[1]) {
+    if (block->unreachable) {
+        assert(!block->jump[0]);
+        if (block->trap) {
+            emit_(INSTR_UD2);
+        }
+    } else if (!block->jump[0] && !block->jump[1]) {
+        if (block->tail_call
+            && block->has_return_value
+            && block->expr.op == IR_OP_CALL
+            && compile_tail_call(block->expr.l))
+        {
+            return;
+        }
         if (block->has_return_value) {
             assert(is_object(block->expr.type));
             assert(type_equal_unqualified(block->expr.type, type_next(type)));
@@ -3177,75 +4582,20 @@ static void compile_block(
             relase_regs();
             assert(x87_stack == 0);
         }
-        if (int_regs_alloc) {
-            emit_mr(INSTR_LEA,
-                location(address(-int_regs_alloc * 8, BP, 0, 0), 8),
-                reg(SP, 8));
-            for (i = int_regs_alloc; i > 0; --i) {
-                emit_r_(INSTR_POP, reg(temp_int_reg[i - 1], 8));
-            }
-        }
+        load_callee_saved_registers();
         emit_(INSTR_LEAVE);
         emit_(INSTR_RET);
     } else if (!block->jump[1]) {
-        if (block->jump[0]->color == BLACK) {
+        if (block->jump[0] != next) {
             emit_i_(INSTR_JMP, addr(block->jump[0]->label));
-        } else {
-            compile_block(def, block->jump[0], type);
         }
     } else {
         assert(block->jump[0]);
         assert(block->jump[1]);
         assert(is_scalar(block->expr.type));
-        br0 = addr(block->jump[0]->label);
-        br1 = addr(block->jump[1]->label);
         if (is_comparison(block->expr)) {
             cc = compile_compare(block->expr.op, block->expr.l, block->expr.r);
-            switch (cc) {
-            default: assert(0);
-            case CC_E:
-                if (is_real(block->expr.l.type)) {
-                    emit_jcc(CC_NE, br0);
-                    emit_jcc(CC_P, br0);
-                    emit_i_(INSTR_JMP, br1);
-                } else {
-                    emit_jcc(CC_NE, br0);
-                }
-                break;
-            case CC_NE:
-                if (is_real(block->expr.l.type)) {
-                    emit_jcc(CC_NE, br1);
-                    emit_jcc(CC_P, br1);
-                    emit_i_(INSTR_JMP, br0);
-                } else {
-                    emit_jcc(CC_E, br0);
-                }
-                break;
-            case CC_G:
-                emit_jcc(CC_NG, br0);
-                break;
-            case CC_NG:
-                emit_jcc(CC_G, br0);
-                break;
-            case CC_A:
-                emit_jcc(CC_NA, br0);
-                break;
-            case CC_NA:
-                emit_jcc(CC_A, br0);
-                break;
-            case CC_GE:
-                emit_jcc(CC_NGE, br0);
-                break;
-            case CC_NGE:
-                emit_jcc(CC_GE, br0);
-                break;
-            case CC_AE:
-                emit_jcc(CC_NAE, br0);
-                break;
-            case CC_NAE:
-                emit_jcc(CC_AE, br0);
-                break;
-            }
+            emit_branch(block, next, cc, is_real(block->expr.l.type));
         } else {
             ax = compile_expression(block->expr);
             w = size_of(block->expr.type);
@@ -3264,25 +4614,15 @@ static void compile_block(
                     emit_rr(INSTR_PXOR, reg(xmm1, 8), reg(xmm1, 8));
                     emit_rr(INSTR_UCOMIS, reg(xmm0, w), reg(xmm1, w));
                 }
-
-                emit_jcc(CC_NE, br1);
-                emit_jcc(CC_P, br1);
-                emit_i_(INSTR_JMP, br0);
+                emit_branch(block, next, CC_NE, 1);
             } else {
                 assert(w == 1 || w == 2 || w == 4 || w == 8);
                 emit_ir(INSTR_CMP, constant(0, w), reg(ax, w));
-                emit_jcc(CC_E, br0);
+                emit_branch(block, next, CC_NE, 0);
             }
         }
 
         relase_regs();
-        if (block->jump[1]->color == BLACK) {
-            emit_i_(INSTR_JMP, br1);
-        } else {
-            compile_block(def, block->jump[1], type);
-        }
-
-        compile_block(def, block->jump[0], type);
     }
 }
 
@@ -3337,25 +4677,113 @@ static void compile_data_assign(struct var target, struct var val)
     emit_data(imm);
 }
 
-static void compile_data(struct definition *def)
+/*
+ * Objects of const qualified type, or arrays of such, can be placed in
+ * read only memory.
+ */
+static int is_read_only(Type type)
+{
+    while (is_array(type)) {
+        type = type_next(type);
+    }
+
+    return is_const(type) && !is_volatile(type);
+}
+
+static int has_relocations(struct definition *def)
 {
     int i;
     struct statement st;
 
-    enter_context(def->symbol);
     for (i = def->body->head; i < def->body->head + def->body->count; ++i) {
+        st = array_get(&def->statements, i);
+        if (st.expr.l.kind == ADDRESS) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Static initializers are sparse lists of non-zero assignments in order
+ * of increasing offset. Fill gaps with zero, and place objects without
+ * any assignments in .bss.
+ *
+ * Constant objects go in .rodata, or .data.rel.ro if position
+ * independent code needs relocations to be applied at load time.
+ */
+static void compile_data(struct definition *def)
+{
+    int i;
+    size_t offset, size;
+    struct statement st;
+    struct symbol *sym;
+    struct immediate imm = {0};
+
+    sym = (struct symbol *) def->symbol;
+    sym->read_only = !sym->tls && !sym->has_section
+        && is_read_only(sym->type);
+    sym->relro = sym->read_only && context.pic && has_relocations(def);
+    sym->zero_init = !def->body->count && !sym->has_section
+        && !sym->read_only;
+    enter_context(sym);
+    if (sym->zero_init) {
+        return;
+    }
+
+    imm.type = IMM_ZERO;
+    size = size_of(sym->type);
+    for (offset = 0, i = def->body->head;
+        i < def->body->head + def->body->count;
+        ++i)
+    {
         st = array_get(&def->statements, i);
         assert(st.st == IR_ASSIGN);
         assert(st.t.kind == DIRECT);
         assert(st.t.value.symbol == def->symbol);
         assert(is_identity(st.expr));
+        assert(st.t.offset >= offset);
+        if (st.t.offset > offset) {
+            imm.width = st.t.offset - offset;
+            emit_data(imm);
+        }
+
         compile_data_assign(st.t, st.expr.l);
+        offset = st.t.offset + (is_field(st.t)
+            ? st.t.field_width / 8
+            : size_of(st.t.type));
+    }
+
+    assert(offset <= size);
+    if (offset < size) {
+        imm.width = size - offset;
+        emit_data(imm);
     }
 }
 
+/*
+ * When optimizing, instructions are buffered and passed through the
+ * peephole optimizer before being written to output. Functions with
+ * inline assembly are written as is.
+ */
 static void compile_function(struct definition *def)
 {
+    int i, n, peephole;
+    int (*symbol)(const struct symbol *);
+    int (*text)(struct instruction);
+
     assert(is_function(def->symbol->type));
+    symbol = enter_context;
+    text = emit_instruction;
+    peephole = context.optimization_level
+        && !array_len(&def->asm_statements);
+    if (peephole) {
+        peephole_init(symbol, text);
+        enter_context = peephole_symbol;
+        emit_instruction = peephole_text;
+    }
+
     enter_context(def->symbol);
     emit_r_(INSTR_PUSH, reg(BP, 8));
     emit_rr(INSTR_MOV, reg(SP, 8), reg(BP, 8));
@@ -3363,8 +4791,21 @@ static void compile_function(struct definition *def)
     /* Make sure parameters and local variables are placed on stack. */
     enter(def);
 
-    /* Recursively assemble body. */
-    compile_block(def, def->body, def->symbol->type);
+    /* Assemble basic blocks in order, falling through when possible. */
+    n = block_layout(def, context.optimization_level);
+    for (i = 0; i < n; ++i) {
+        compile_block(
+            def,
+            get_layout_block(i),
+            i + 1 < n ? get_layout_block(i + 1) : NULL,
+            def->symbol->type);
+    }
+
+    if (peephole) {
+        enter_context = symbol;
+        emit_instruction = text;
+        peephole_flush();
+    }
 }
 
 INTERNAL void set_compile_target(FILE *stream, const char *file)
@@ -3380,7 +4821,8 @@ INTERNAL void set_compile_target(FILE *stream, const char *file)
         break;
     case TARGET_OBJ:
     case TARGET_EXE:
-        elf_init(stream, file);
+    case TARGET_RUN:
+        elf_init(context.target == TARGET_RUN ? NULL : stream, file);
         enter_context = elf_symbol;
         emit_instruction = elf_text;
         emit_data = elf_data;
@@ -3402,6 +4844,7 @@ INTERNAL int compile(struct definition *def)
     case TARGET_ASM:
     case TARGET_OBJ:
     case TARGET_EXE:
+    case TARGET_RUN:
         if (is_function(def->symbol->type)) {
             compile_function(def);
             if (context.target != TARGET_ASM) {
@@ -3423,6 +4866,7 @@ INTERNAL int declare(const struct symbol *sym)
     case TARGET_ASM:
     case TARGET_OBJ:
     case TARGET_EXE:
+    case TARGET_RUN:
         return enter_context(sym);
     default:
         return 0;
@@ -3442,6 +4886,8 @@ INTERNAL void flush(void)
 INTERNAL void finalize(void)
 {
     array_clear(&func_args);
+    peephole_finalize();
+    layout_finalize();
     if (finalize_backend) {
         finalize_backend();
     }
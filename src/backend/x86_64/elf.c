@@ -9,6 +9,7 @@
 #include <lacc/context.h>
 
 #include <assert.h>
+#include <string.h>
 
 static FILE *object_file_output;
 
@@ -38,25 +39,36 @@ static Elf64_Ehdr header = {
     0                   /* e_shstrndx, index of shstrtab. (TODO) */
 };
 
-#define SHNUM_MAX 13
-
-/* Section headers. */
-static Elf64_Shdr shdr[SHNUM_MAX];
-static int shnum;
+/*
+ * Section headers, growing as sections are added. Sections created with
+ * -ffunction-sections and -fdata-sections can be many, but indices must
+ * stay below the range of reserved values.
+ */
+static Elf64_Shdr *shdr;
+static int shnum, shcap;
 
 INTERNAL struct elf_sections section = {0};
 
-static struct symbol section_symbol[SHNUM_MAX];
+/*
+ * Symbols representing each section. These are allocated separately,
+ * as pointers are kept in pending relocations.
+ */
+static struct symbol **section_symbol;
 
 #define symtab_index_of(s) ((s)->stack_offset)
 #define symtab_lookup(s) (&sbuf[section.symtab].sym[(s)->stack_offset])
 
-/* Data associated with each section. */
+/*
+ * Data associated with each section, and capacity of buffer in bytes.
+ * Buffers are kept between object files, and reused.
+ */
 static union {
     unsigned char *data;
     Elf64_Sym *sym;
     Elf64_Rela *rela;
-} sbuf[SHNUM_MAX];
+} *sbuf;
+
+static size_t *scap;
 
 /*
  * Pending relocations, waiting for sym->stack_offset to be resolved to
@@ -71,8 +83,7 @@ struct pending_relocation {
 };
 
 /* Store list of relocations for sections of type rela. */
-static array_of(struct pending_relocation)
-    pending_relocations[SHNUM_MAX];
+static array_of(struct pending_relocation) *pending_relocations;
 
 /*
  * List of pending global symbols, not yet added to .symtab. All globals
@@ -99,15 +110,22 @@ struct pending_displacement {
 
 static array_of(struct pending_displacement) pending_displacement_list;
 
+/*
+ * Section receiving object data, and its relocation section. Either
+ * .data or .tdata, depending on the last symbol defined.
+ */
+static int data_section, rela_data_section;
+
+/*
+ * Default .text section and its relocations. Functions placed in other
+ * sections replace section.text and section.rela_text while they are
+ * being assembled.
+ */
+static int text_section, rela_text_section;
+
 /* Write bytes to section. If ptr is NULL, fill with zeros. */
 INTERNAL size_t elf_section_write(int shid, const void *data, size_t n)
 {
-    /*
-     * Section data buffer capacity, in bytes. Buffer is kept in sbuf,
-     * indexed by section id. 
-     */
-    static size_t scap[SHNUM_MAX];
-
     size_t offset;
     assert(0 < shid && shid < shnum);
     assert(
@@ -148,6 +166,17 @@ INTERNAL void *elf_section_buffer(int shid)
     return sbuf[shid].data;
 }
 
+INTERNAL int elf_section_count(void)
+{
+    return shnum;
+}
+
+INTERNAL const Elf64_Shdr *elf_section_header(int shid)
+{
+    assert(0 < shid && shid < shnum);
+    return &shdr[shid];
+}
+
 /*
  * Align data section to specified number of bytes. Following calls to
  * elf_section_write start at this alignment. Padding is filled with
@@ -163,9 +192,9 @@ static int elf_section_align(int shid, int align)
         || shdr[shid].sh_type == SHT_RELA
         || shdr[shid].sh_type == SHT_NOBITS);
 
+    assert(align > 0 && (align & (align - 1)) == 0);
     if (shdr[shid].sh_addralign < align) {
         shdr[shid].sh_addralign = align;
-        assert(align <= 16);
     }
 
     offset = shdr[shid].sh_size;
@@ -201,8 +230,9 @@ static void elf_chain_offsets(void)
         shdr[i].sh_offset = shdr[j].sh_offset + shdr[j].sh_size;
         if (shdr[i].sh_addralign > 1) {
             padding = shdr[i].sh_offset % shdr[i].sh_addralign;
-            shdr[i].sh_offset += padding;
-            assert(padding < 16);
+            if (padding) {
+                shdr[i].sh_offset += shdr[i].sh_addralign - padding;
+            }
         }
 
         j = i;
@@ -259,6 +289,41 @@ static int elf_symtab_add(Elf64_Sym entry)
     return i;
 }
 
+/*
+ * Make room for more sections, zero initializing the new entries. Data
+ * buffers are otherwise kept for reuse by the next object file.
+ */
+static void elf_expand_sections(void)
+{
+    int cap;
+
+    if (shcap == SHN_LORESERVE) {
+        error("Too many sections in object file, maximum is %d.",
+            SHN_LORESERVE);
+        exit(1);
+    }
+
+    cap = shcap ? shcap * 2 : 32;
+    if (cap > SHN_LORESERVE) {
+        cap = SHN_LORESERVE;
+    }
+
+    shdr = realloc(shdr, cap * sizeof(*shdr));
+    sbuf = realloc(sbuf, cap * sizeof(*sbuf));
+    scap = realloc(scap, cap * sizeof(*scap));
+    section_symbol = realloc(section_symbol, cap * sizeof(*section_symbol));
+    pending_relocations = realloc(pending_relocations,
+        cap * sizeof(*pending_relocations));
+
+    memset(sbuf + shcap, 0, (cap - shcap) * sizeof(*sbuf));
+    memset(scap + shcap, 0, (cap - shcap) * sizeof(*scap));
+    memset(section_symbol + shcap, 0,
+        (cap - shcap) * sizeof(*section_symbol));
+    memset(pending_relocations + shcap, 0,
+        (cap - shcap) * sizeof(*pending_relocations));
+    shcap = cap;
+}
+
 /*
  * Create ELF section, returning id of new section.
  *
@@ -276,13 +341,16 @@ INTERNAL int elf_section_init(
     Elf64_Sym sym = {0};
     int shid;
 
+    if (shnum == shcap) {
+        elf_expand_sections();
+    }
+
     if (!shnum) {
         shnum++;
         memset(shdr, 0, sizeof(Elf64_Shdr));
     }
 
     shid = shnum++;
-    assert(shid < SHNUM_MAX);
 
     memset(shdr + shid, 0, sizeof(Elf64_Shdr));
     shdr[shid].sh_type = type;
@@ -299,26 +367,138 @@ INTERNAL int elf_section_init(
         header.e_shstrndx = shid;
     }
 
+    if (!section_symbol[shid]) {
+        section_symbol[shid] = calloc(1, sizeof(struct symbol));
+    } else {
+        memset(section_symbol[shid], 0, sizeof(struct symbol));
+    }
+
     if (section.symtab) {
         sym.st_info = (STB_LOCAL << 4) | STT_SECTION;
         sym.st_shndx = shid;
-        section_symbol[shid].stack_offset = elf_symtab_add(sym);
+        section_symbol[shid]->stack_offset = elf_symtab_add(sym);
     }
 
     header.e_shnum = shnum;
     return shid;
 }
 
+/* Create relocation section for section with the given id. */
+static int elf_rela_section_init(int shid)
+{
+    int rela;
+    char *name;
+    const char *strtab;
+
+    strtab = (const char *) sbuf[section.shstrtab].data;
+    name = malloc(strlen(strtab + shdr[shid].sh_name) + sizeof(".rela"));
+    strcpy(name, ".rela");
+    strcat(name, strtab + shdr[shid].sh_name);
+    rela = elf_section_init(name, SHT_RELA, 0, section.symtab, shid, 8,
+        sizeof(Elf64_Rela));
+    free(name);
+    return rela;
+}
+
+/*
+ * Find section with the given name, or create a new one together with
+ * its relocation section. Used for placement by section attribute, and
+ * for hot and cold functions.
+ */
+static int elf_named_section(const char *name, int flags)
+{
+    int shid;
+    const char *strtab;
+
+    strtab = (const char *) sbuf[section.shstrtab].data;
+    for (shid = 1; shid < shnum; ++shid) {
+        if (!strcmp(strtab + shdr[shid].sh_name, name)) {
+            if (shdr[shid].sh_type != SHT_PROGBITS
+                || shdr[shid].sh_flags != flags)
+            {
+                error("Section '%s' conflicts with existing section.", name);
+                exit(1);
+            }
+            return shid;
+        }
+    }
+
+    shid = elf_section_init(name, SHT_PROGBITS, flags, SHN_UNDEF, 0, 1, 0);
+    elf_rela_section_init(shid);
+    return shid;
+}
+
+/*
+ * Create section named by prefix and symbol, used for placing each
+ * function or object in a separate section. Names are unique within
+ * the translation unit, so there is no need to look for existing ones.
+ */
+static int elf_symbol_section(
+    const char *prefix,
+    const struct symbol *sym,
+    int type,
+    int flags)
+{
+    int shid;
+    char *name;
+    const char *str;
+
+    str = sym_name(sym);
+    name = malloc(strlen(prefix) + strlen(str) + 2);
+    strcpy(name, prefix);
+    strcat(name, ".");
+    strcat(name, str);
+    shid = elf_section_init(name, type, flags, SHN_UNDEF, 0, 1, 0);
+    free(name);
+    return shid;
+}
+
+/*
+ * Relocation section is created immediately after the section it
+ * applies to.
+ */
+#define elf_rela_section(shid) ((shid) + 1)
+
+/*
+ * Set current text section for function definition, based on section,
+ * hot and cold attributes. With -ffunction-sections, each function gets
+ * its own section, keeping the hot and cold prefix.
+ */
+static void elf_set_text_section(const struct symbol *sym)
+{
+    int flags;
+    const char *name;
+
+    flags = SHF_EXECINSTR | SHF_ALLOC;
+    name = sym->cold ? ".text.unlikely" : sym->hot ? ".text.hot" : ".text";
+    if (sym->has_section) {
+        section.text = elf_named_section(str_raw(sym->section), flags);
+    } else if (context.function_sections) {
+        section.text = elf_symbol_section(name, sym, SHT_PROGBITS, flags);
+        elf_rela_section_init(section.text);
+    } else if (sym->cold || sym->hot) {
+        section.text = elf_named_section(name, flags);
+    } else {
+        section.text = text_section;
+        section.rela_text = rela_text_section;
+        return;
+    }
+
+    section.rela_text = elf_rela_section(section.text);
+    assert(shdr[section.rela_text].sh_info == section.text);
+    elf_section_align(section.text, 16);
+}
+
 /*
  * Retrieve index into symbol table for section as a proper symbol,
  * making it convenient to use like any other when creating relocations.
  */
-INTERNAL const struct symbol *elf_section_symbol(int shnum)
+INTERNAL const struct symbol *elf_section_symbol(int shid)
 {
-    assert(shnum > 0);
-    assert(shnum <= SHNUM_MAX);
+    assert(shid > 0);
+    assert(shid < shnum);
 
-    return &section_symbol[shnum];
+    return section_symbol[shid];
 }
 
 /*
@@ -441,7 +621,7 @@ static void flush_relocations(void)
     size_t offset;
     int i, j, len, index;
 
-    for (i = 0; i < SHNUM_MAX; ++i) {
+    for (i = 0; i < shnum; ++i) {
         len = array_len(&pending_relocations[i]);
         if (!len) {
             assert(!pending_relocations[i].data);
@@ -464,6 +644,8 @@ static void flush_relocations(void)
             case R_X86_64_PC32:
             case R_X86_64_PLT32:
             case R_X86_64_GOTPCREL:
+            case R_X86_64_TLSGD:
+            case R_X86_64_GOTTPOFF:
                 entry[j].r_addend -= 4;
                 break;
             default:
@@ -524,7 +706,6 @@ INTERNAL void elf_init(FILE *output, const char *file)
 
     shnum = 0;
     memset(&section, 0, sizeof(section));
-    memset(&section_symbol, 0, sizeof(section_symbol));
     memset(&current_function, 0, sizeof(current_function));
     object_file_output = output;
 
@@ -564,13 +745,163 @@ INTERNAL void elf_init(FILE *output, const char *file)
         ".rela.text", SHT_RELA, 0, section.symtab, section.text, 8,
         sizeof(Elf64_Rela));
 
+    text_section = section.text;
+    rela_text_section = section.rela_text;
+
     if (context.debug) {
         dwarf_init(file);
     }
 }
 
+/*
+ * Select section for object definitions, setting the current section
+ * for data and relocations. With -fdata-sections, each object is placed
+ * in its own section, getting a relocation section only when needed.
+ */
+#define TDATA_FLAGS (SHF_WRITE | SHF_ALLOC | SHF_TLS)
+
+static int elf_symbol_data_section(
+    const struct symbol *sym,
+    const char *prefix,
+    int flags)
+{
+    data_section = elf_symbol_section(prefix, sym, SHT_PROGBITS, flags);
+    rela_data_section = 0;
+    return data_section;
+}
+
+static int elf_data_section(const struct symbol *sym)
+{
+    if (context.data_sections) {
+        return elf_symbol_data_section(sym, ".data", SHF_WRITE | SHF_ALLOC);
+    }
+
+    data_section = section.data;
+    rela_data_section = section.rela_data;
+    return data_section;
+}
+
+static int elf_bss_section(const struct symbol *sym)
+{
+    if (context.data_sections) {
+        return elf_symbol_section(".bss", sym, SHT_NOBITS,
+            SHF_WRITE | SHF_ALLOC);
+    }
+
+    return section.bss;
+}
+
+/*
+ * Sections for thread local variables are only added to the object
+ * file when needed.
+ */
+static int elf_tdata_section(const struct symbol *sym)
+{
+    if (context.data_sections) {
+        return elf_symbol_data_section(sym, ".tdata", TDATA_FLAGS);
+    }
+
+    if (!section.tdata) {
+        section.tdata = elf_section_init(".tdata", SHT_PROGBITS,
+            TDATA_FLAGS, SHN_UNDEF, 0, 4, 0);
+        section.rela_tdata = elf_section_init(".rela.tdata", SHT_RELA, 0,
+            section.symtab, section.tdata, 8, sizeof(Elf64_Rela));
+    }
+
+    data_section = section.tdata;
+    rela_data_section = section.rela_tdata;
+    return data_section;
+}
+
+static int elf_tbss_section(const struct symbol *sym)
+{
+    if (context.data_sections) {
+        return elf_symbol_section(".tbss", sym, SHT_NOBITS, TDATA_FLAGS);
+    }
+
+    if (!section.tbss) {
+        section.tbss = elf_section_init(".tbss", SHT_NOBITS,
+            TDATA_FLAGS, SHN_UNDEF, 0, 4, 0);
+    }
+
+    return section.tbss;
+}
+
+/*
+ * Constant objects are normally placed in .rodata, where relocations
+ * are resolved at link time. Position independent code must instead
+ * use .data.rel.ro for objects containing addresses, which is made read
+ * only after relocations are applied by the dynamic loader.
+ */
+static int elf_read_only_section(const struct symbol *sym)
+{
+    assert(sym->read_only);
+    if (context.data_sections) {
+        return sym->relro
+            ? elf_symbol_data_section(sym, ".data.rel.ro",
+                SHF_WRITE | SHF_ALLOC)
+            : elf_symbol_data_section(sym, ".rodata", SHF_ALLOC);
+    }
+
+    if (sym->relro) {
+        data_section = elf_named_section(".data.rel.ro",
+            SHF_WRITE | SHF_ALLOC);
+        rela_data_section = elf_rela_section(data_section);
+    } else {
+        data_section = section.rodata;
+        rela_data_section = section.rela_rodata;
+    }
+
+    return data_section;
+}
+
+/*
+ * String literals and floating point constants are placed in mergeable
+ * sections, letting the linker remove duplicates across object files.
+ * Strings with embedded null characters cannot be split by the linker,
+ * and go in regular .rodata.
+ */
+static int elf_mergeable_section(int *shid, const char *name, int flags,
+    int entsize)
+{
+    if (!*shid) {
+        *shid = elf_section_init(name, SHT_PROGBITS,
+            SHF_ALLOC | SHF_MERGE | flags, SHN_UNDEF, 0, entsize, entsize);
+    }
+
+    return *shid;
+}
+
+static int elf_rodata_section(const struct symbol *sym)
+{
+    String str;
+
+    if (sym->symtype == SYM_LITERAL) {
+        str = sym->value.string;
+        if (strlen(str_raw(str)) != str_len(str)) {
+            return section.rodata;
+        }
+        return elf_mergeable_section(&section.rodata_str,
+            ".rodata.str1.1", SHF_STRINGS, 1);
+    }
+
+    switch (size_of(sym->type)) {
+    case 4:
+        return elf_mergeable_section(&section.rodata_cst4,
+            ".rodata.cst4", 0, 4);
+    case 8:
+        return elf_mergeable_section(&section.rodata_cst8,
+            ".rodata.cst8", 0, 8);
+    default:
+        assert(size_of(sym->type) == 16);
+        return elf_mergeable_section(&section.rodata_cst16,
+            ".rodata.cst16", 0, 16);
+    }
+}
+
 INTERNAL int elf_symbol(const struct symbol *sym)
 {
+    int shid;
     const void *data;
     Elf64_Sym entry = {0};
     union {
@@ -589,30 +920,76 @@ INTERNAL int elf_symbol(const struct symbol *sym)
     entry.st_name = elf_strtab_add(section.strtab, sym_name(sym));
     entry.st_info = (sym->linkage == LINK_INTERN)
         ? STB_LOCAL << 4 : STB_GLOBAL << 4;
+    entry.st_other = sym_visibility(sym);
 
     if (is_function(sym->type)) {
         entry.st_info |= STT_FUNC;
         if (sym->symtype == SYM_DEFINITION) {
+            elf_set_text_section(sym);
+            if (sym->alignment) {
+                elf_section_align(section.text, sym->alignment);
+            }
             entry.st_shndx = section.text;
             entry.st_value = shdr[section.text].sh_size;
         }
         /* st_size is updated while assembling instructions. */
-    } else if (sym->symtype == SYM_DEFINITION) {
-        elf_section_align(section.data, sym_alignment(sym));
-        entry.st_shndx = section.data;
+    } else if (sym->tls) {
+        entry.st_info |= STT_TLS;
+        if (sym->symtype == SYM_DEFINITION && !sym->zero_init) {
+            shid = elf_tdata_section(sym);
+        } else if (sym->symtype == SYM_TENTATIVE || sym->zero_init) {
+            shid = elf_tbss_section(sym);
+        } else {
+            assert(sym->symtype == SYM_DECLARATION);
+            shid = SHN_UNDEF;
+        }
+        if (shid != SHN_UNDEF) {
+            elf_section_align(shid, sym_alignment(sym));
+            entry.st_shndx = shid;
+            entry.st_size = size_of(sym->type);
+            entry.st_value = shdr[shid].sh_size;
+            if (sym->symtype == SYM_TENTATIVE || sym->zero_init) {
+                shdr[shid].sh_size += entry.st_size;
+            }
+        }
+    } else if (sym->has_section && sym->symtype != SYM_DECLARATION) {
+        shid = elf_named_section(str_raw(sym->section), SHF_WRITE | SHF_ALLOC);
+        elf_section_align(shid, sym_alignment(sym));
+        entry.st_shndx = shid;
         entry.st_size = size_of(sym->type);
-        entry.st_value = shdr[section.data].sh_size;
+        entry.st_value = shdr[shid].sh_size;
+        entry.st_info |= STT_OBJECT;
+        if (sym->symtype == SYM_TENTATIVE) {
+            elf_section_write(shid, NULL, entry.st_size);
+        } else {
+            data_section = shid;
+            rela_data_section = elf_rela_section(shid);
+        }
+    } else if (sym->symtype == SYM_DEFINITION && sym->read_only) {
+        shid = elf_read_only_section(sym);
+        elf_section_align(shid, sym_alignment(sym));
+        entry.st_shndx = shid;
+        entry.st_size = size_of(sym->type);
+        entry.st_value = shdr[shid].sh_size;
+        entry.st_info |= STT_OBJECT;
+    } else if (sym->symtype == SYM_DEFINITION && !sym->zero_init) {
+        shid = elf_data_section(sym);
+        elf_section_align(shid, sym_alignment(sym));
+        entry.st_shndx = shid;
+        entry.st_size = size_of(sym->type);
+        entry.st_value = shdr[shid].sh_size;
         entry.st_info |= STT_OBJECT;
     } else if (sym->symtype == SYM_LITERAL || sym->symtype == SYM_CONSTANT) {
-        elf_section_align(section.rodata, sym_alignment(sym));
-        entry.st_shndx = section.rodata;
+        shid = elf_rodata_section(sym);
+        elf_section_align(shid, sym_alignment(sym));
+        entry.st_shndx = shid;
         entry.st_size = size_of(sym->type);
-        entry.st_value = shdr[section.rodata].sh_size;
+        entry.st_value = shdr[shid].sh_size;
         entry.st_info |= STT_OBJECT;
 
         /*
          * Strings and constant symbols carry their actual string value;
-         * write to .rodata immediately.
+         * write to section immediately.
          */
         if (sym->symtype == SYM_LITERAL) {
             data = str_raw(sym->value.string);
@@ -624,16 +1001,18 @@ INTERNAL int elf_symbol(const struct symbol *sym)
             data = &sym->value.constant;
         }
 
-        elf_section_write(section.rodata, data, entry.st_size);
+        elf_section_write(shid, data, entry.st_size);
     } else if (sym->linkage == LINK_INTERN
+        || sym->zero_init
         || (sym->symtype == SYM_TENTATIVE && context.no_common))
     {
-        elf_section_align(section.bss, sym_alignment(sym));
-        entry.st_shndx = section.bss;
+        shid = elf_bss_section(sym);
+        elf_section_align(shid, sym_alignment(sym));
+        entry.st_shndx = shid;
         entry.st_size = size_of(sym->type);
-        entry.st_value = shdr[section.bss].sh_size;
+        entry.st_value = shdr[shid].sh_size;
         entry.st_info |= STT_OBJECT;
-        shdr[section.bss].sh_size += entry.st_size;
+        shdr[shid].sh_size += entry.st_size;
     } else if (sym->symtype == SYM_TENTATIVE) {
         assert(sym->linkage == LINK_EXTERN);
         assert(is_object(sym->type));
@@ -678,25 +1057,36 @@ INTERNAL int elf_data(struct immediate imm)
     case IMM_ADDR:
         assert(imm.d.addr.sym);
         assert(imm.width == 8);
-        elf_add_relocation(section.rela_data,
+        if (!rela_data_section) {
+            rela_data_section = elf_rela_section_init(data_section);
+            if (data_section == section.rodata) {
+                section.rela_rodata = rela_data_section;
+            }
+        }
+        elf_add_relocation(rela_data_section,
             imm.d.addr.sym, R_X86_64_64, 0, imm.d.addr.displacement);
         break;
     case IMM_STRING:
         assert(w == str_len(imm.d.string) + 1 || w == str_len(imm.d.string));
         ptr = str_raw(imm.d.string);
         break;
+    case IMM_ZERO:
+        break;
     }
 
-    return elf_section_write(section.data, ptr, w);
+    return elf_section_write(data_section, ptr, w);
 }
 
 static void write_data(const void *ptr, size_t size)
 {
-    char padding[16] = {0};
+    static const char padding[16] = {0};
     size_t b;
 
     if (!ptr) {
-        assert(size <= sizeof(padding));
+        while (size > sizeof(padding)) {
+            write_data(padding, sizeof(padding));
+            size -= sizeof(padding);
+        }
         ptr = padding;
     }
 
@@ -734,6 +1124,9 @@ static void write_sections(void)
 
 INTERNAL int elf_flush(void)
 {
+    section.text = text_section;
+    section.rela_text = rela_text_section;
+
     /* Finalize debug sections. */
     if (context.debug) {
         dwarf_flush();
@@ -744,11 +1137,15 @@ INTERNAL int elf_flush(void)
     flush_relocations();
     array_empty(&pending_displacement_list);
 
+    /* Sections are loaded directly from memory with -run. */
+    if (!object_file_output) {
+        return 0;
+    }
+
     /* Fill in missing offsets in section headers. */
     elf_chain_offsets();
 
     /* Write headers and section data to file. */
-    assert(object_file_output);
     write_data(&header, sizeof(header));
     write_data(shdr, shnum * sizeof(*shdr));
     write_sections();
@@ -761,9 +1158,16 @@ INTERNAL int elf_finalize(void)
 
     array_clear(&globals);
     array_clear(&pending_displacement_list);
-    for (i = 1; i < SHNUM_MAX; ++i) {
+    for (i = 0; i < shcap; ++i) {
         free(sbuf[i].data);
+        free(section_symbol[i]);
+        assert(!pending_relocations[i].data);
     }
 
+    free(shdr);
+    free(sbuf);
+    free(scap);
+    free(section_symbol);
+    free(pending_relocations);
     return 0;
 }
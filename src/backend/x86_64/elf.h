@@ -38,6 +38,9 @@ typedef struct {
 #define EV_CURRENT 1                /* Current ELF version. */
 #define ELFOSABI_SYSV 0             /* System V ABI. */
 #define ET_REL 1                    /* Relocatable file. */
+#define ET_EXEC 2                   /* Executable file. */
+#define ET_DYN 3                    /* Shared object file. */
+#define EM_X86_64 62                /* AMD x86-64 architecture. */
 
 typedef struct {
     Elf64_Word      sh_name;        /* Section name. */
@@ -53,6 +56,7 @@ typedef struct {
 } Elf64_Shdr;
 
 #define SHN_UNDEF 0
+#define SHN_LORESERVE 0xFF00        /* Start of reserved indices. */
 #define SHN_ABS 0xFFF1              /* Absolute value reference. */
 #define SHN_COMMON 0xFFF2           /* Tentative definitions. */
 
@@ -67,11 +71,28 @@ typedef struct {
 #define SHT_NOTE 7
 #define SHT_NOBITS 8                /* Uninitialized space. */
 #define SHT_DYNSYM 11
+#define SHT_INIT_ARRAY 14
+#define SHT_FINI_ARRAY 15
+#define SHT_PREINIT_ARRAY 16
+#define SHT_GROUP 17                /* Section group, like COMDAT. */
+#define SHT_SYMTAB_SHNDX 18
+#define SHT_GNU_verdef 0x6FFFFFFD   /* Symbol versions defined. */
+#define SHT_GNU_verneed 0x6FFFFFFE  /* Symbol versions required. */
+#define SHT_GNU_versym 0x6FFFFFFF   /* Symbol version index table. */
+#define SHT_X86_64_UNWIND 0x70000001
 
 /* Section attributes, sh_flags. */
 #define SHF_WRITE 0x1
 #define SHF_ALLOC 0x2
 #define SHF_EXECINSTR 0x4
+#define SHF_MERGE 0x10              /* Entries can be deduplicated. */
+#define SHF_STRINGS 0x20            /* Entries are null terminated. */
+#define SHF_GROUP 0x200             /* Member of section group. */
+#define SHF_TLS 0x400
+#define SHF_EXCLUDE 0x80000000      /* Not included in executable. */
+
+/* Section group flags. */
+#define GRP_COMDAT 0x1
 
 typedef struct {
     Elf64_Word      st_name;        /* Symbol name. */
@@ -84,12 +105,17 @@ typedef struct {
 
 #define STB_LOCAL 0
 #define STB_GLOBAL 1
+#define STB_WEAK 2
+#define STB_GNU_UNIQUE 10
 
 #define STT_NOTYPE 0
 #define STT_OBJECT 1
 #define STT_FUNC 2
 #define STT_SECTION 3
 #define STT_FILE 4
+#define STT_COMMON 5
+#define STT_TLS 6
+#define STT_GNU_IFUNC 10            /* Indirect function. */
 
 typedef struct {
     Elf64_Addr      r_offset;       /* Address of reference. */
@@ -115,10 +141,121 @@ enum rel_type {
     R_X86_64_64 = 1,                /* word64   S + A. */
     R_X86_64_PC32 = 2,              /* word32   S + A - P */
     R_X86_64_PLT32 = 4,             /* word32   L + A - P */
-    R_X86_64_GOTPCREL = 9           /* word32   G + GOT + A - P */
+    R_X86_64_COPY = 5,              /* Copy symbol at runtime. */
+    R_X86_64_GLOB_DAT = 6,          /* word64   S */
+    R_X86_64_JUMP_SLOT = 7,         /* word64   S */
+    R_X86_64_GOTPCREL = 9,          /* word32   G + GOT + A - P */
+    R_X86_64_32 = 10,               /* word32   S + A */
+    R_X86_64_32S = 11,              /* word32   S + A */
+    R_X86_64_DTPMOD64 = 16,         /* word64   Module ID */
+    R_X86_64_DTPOFF64 = 17,         /* word64   Offset in TLS block */
+    R_X86_64_TPOFF64 = 18,          /* word64   Offset in initial TLS */
+    R_X86_64_TLSGD = 19,            /* word32   tls_index in GOT - P */
+    R_X86_64_GOTTPOFF = 22,         /* word32   TP offset in GOT - P */
+    R_X86_64_TPOFF32 = 23,          /* word32   TP offset */
+    R_X86_64_PC64 = 24,             /* word64   S + A - P */
+    R_X86_64_IRELATIVE = 37,        /* word64   Indirect (B + A) */
+    R_X86_64_GOTPCRELX = 41,        /* word32   G + GOT + A - P */
+    R_X86_64_REX_GOTPCRELX = 42     /* word32   G + GOT + A - P */
 };
 
 #define ELF64_R_INFO(s, t) ((((long) s) << 32) + (((long) t) & 0xFFFFFFFFL))
+#define ELF64_R_SYM(i) ((i) >> 32)
+#define ELF64_R_TYPE(i) ((i) & 0xFFFFFFFFL)
+
+typedef struct {
+    Elf64_Word      p_type;         /* Type of segment. */
+    Elf64_Word      p_flags;        /* Segment attributes. */
+    Elf64_Off       p_offset;       /* Offset in file. */
+    Elf64_Addr      p_vaddr;        /* Virtual address in memory. */
+    Elf64_Addr      p_paddr;        /* Reserved. */
+    Elf64_Xword     p_filesz;       /* Size of segment in file. */
+    Elf64_Xword     p_memsz;        /* Size of segment in memory. */
+    Elf64_Xword     p_align;        /* Alignment of segment. */
+} Elf64_Phdr;
+
+/* Segment types, p_type. */
+#define PT_LOAD 1
+#define PT_DYNAMIC 2
+#define PT_INTERP 3
+#define PT_PHDR 6
+#define PT_TLS 7
+#define PT_GNU_STACK 0x6474E551
+
+/* Segment attributes, p_flags. */
+#define PF_X 0x1
+#define PF_W 0x2
+#define PF_R 0x4
+
+typedef struct {
+    Elf64_Sxword    d_tag;          /* Type of dynamic table entry. */
+    union {
+        Elf64_Xword d_val;          /* Integer value. */
+        Elf64_Addr  d_ptr;          /* Address value. */
+    } d_un;
+} Elf64_Dyn;
+
+/* Dynamic table entry types, d_tag. */
+#define DT_NULL 0
+#define DT_NEEDED 1
+#define DT_HASH 4
+#define DT_STRTAB 5
+#define DT_SYMTAB 6
+#define DT_RELA 7
+#define DT_RELASZ 8
+#define DT_RELAENT 9
+#define DT_STRSZ 10
+#define DT_SYMENT 11
+#define DT_INIT 12
+#define DT_FINI 13
+#define DT_SONAME 14
+#define DT_DEBUG 21
+#define DT_INIT_ARRAY 25
+#define DT_FINI_ARRAY 26
+#define DT_INIT_ARRAYSZ 27
+#define DT_FINI_ARRAYSZ 28
+#define DT_PREINIT_ARRAY 32
+#define DT_PREINIT_ARRAYSZ 33
+#define DT_VERSYM 0x6FFFFFF0
+#define DT_VERNEED 0x6FFFFFFE
+#define DT_VERNEEDNUM 0x6FFFFFFF
+
+/* Symbol version definition, in SHT_GNU_verdef. */
+typedef struct {
+    Elf64_Half      vd_version;     /* Version revision. */
+    Elf64_Half      vd_flags;       /* Version information. */
+    Elf64_Half      vd_ndx;         /* Version index. */
+    Elf64_Half      vd_cnt;         /* Number of associated aux entries. */
+    Elf64_Word      vd_hash;        /* Version name hash value. */
+    Elf64_Word      vd_aux;         /* Offset to verdaux array. */
+    Elf64_Word      vd_next;        /* Offset to next verdef entry. */
+} Elf64_Verdef;
+
+typedef struct {
+    Elf64_Word      vda_name;       /* Version name. */
+    Elf64_Word      vda_next;       /* Offset to next verdaux entry. */
+} Elf64_Verdaux;
+
+/* Symbol version requirement, in SHT_GNU_verneed. */
+typedef struct {
+    Elf64_Half      vn_version;     /* Version of structure. */
+    Elf64_Half      vn_cnt;         /* Number of associated aux entries. */
+    Elf64_Word      vn_file;        /* Offset of filename for dependency. */
+    Elf64_Word      vn_aux;         /* Offset to vernaux array. */
+    Elf64_Word      vn_next;        /* Offset to next verneed entry. */
+} Elf64_Verneed;
+
+typedef struct {
+    Elf64_Word      vna_hash;       /* Hash value of dependency name. */
+    Elf64_Half      vna_flags;      /* Dependency specific information. */
+    Elf64_Half      vna_other;      /* Version index used in versym. */
+    Elf64_Word      vna_name;       /* Dependency name string offset. */
+    Elf64_Word      vna_next;       /* Offset to next vernaux entry. */
+} Elf64_Vernaux;
+
+#define VER_FLG_BASE 0x1            /* Version of file itself. */
+#define VER_NDX_GLOBAL 1            /* Unversioned global symbol. */
+#define VER_NDX_HIDDEN 0x8000       /* Not default version. */
 
 EXTERNAL struct elf_sections {
     int shstrtab;
@@ -126,6 +263,7 @@ EXTERNAL struct elf_sections {
     int symtab;
     int bss;
     int rodata;
+    int rela_rodata;
     int data;
     int rela_data;
     int text;
@@ -133,8 +271,19 @@ EXTERNAL struct elf_sections {
     int debug_info;
     int rela_debug_info;
     int debug_abbrev;
+    int tdata;
+    int rela_tdata;
+    int tbss;
+    int rodata_str;
+    int rodata_cst4;
+    int rodata_cst8;
+    int rodata_cst16;
 } section;
 
+/*
+ * Start a new object file. Without output stream, sections are only
+ * kept in memory, to be loaded and run after flush.
+ */
 INTERNAL void elf_init(FILE *output, const char *file);
 
 INTERNAL int elf_symbol(const struct symbol *sym);
@@ -189,4 +338,10 @@ INTERNAL size_t elf_section_write(int shid, const void *data, size_t n);
 /* Get raw pointer to section buffer. */
 INTERNAL void *elf_section_buffer(int shid);
 
+/* Number of sections, including the initial null section. */
+INTERNAL int elf_section_count(void);
+
+/* Get header of section, with size and flags. */
+INTERNAL const Elf64_Shdr *elf_section_header(int shid);
+
 #endif
@@ -34,7 +34,8 @@
 /* Hack to enable REX.W on certain SSE instructions. */
 #define is_general(op) (op <= INSTR_XOR)
 #define enable_rex_w(op) \
-    (is_general(op) || op == INSTR_CVTTS2SI || op == INSTR_CVTSI2S)
+    (is_general(op) || op == INSTR_CVTTS2SI || op == INSTR_CVTSI2S \
+        || op == INSTR_MOVQ)
 
 /*
  * Some additional information can be encoded in the last opcode byte:
@@ -76,6 +77,24 @@ enum implicit {
     IMPL_AX = 2
 };
 
+/*
+ * Instructions that can be VEX encoded, which is done for SSE when the
+ * instruction has PREFIX_VEX. Legacy prefix and escape bytes are folded
+ * into the VEX prefix, replacing REX.
+ *
+ * VEX_RM:    Same operands as legacy encoding, VEX.vvvv is unused.
+ * VEX_NDS:   Destination register is also first source, encoded in
+ *            VEX.vvvv. Printed as vaddsd %xmm1, %xmm0, %xmm0.
+ * VEX_SHIFT: Always VEX encoded, with shift count register in VEX.vvvv.
+ *            Printed as shlx %rcx, %rax, %rax.
+ */
+enum vex {
+    VEX_NONE = 0,
+    VEX_RM = 1,
+    VEX_NDS = 2,
+    VEX_SHIFT = 3
+};
+
 static struct encoding {
     enum opcode opc;
 
@@ -124,6 +143,9 @@ static struct encoding {
      * in 32 bit, for instructions that implicitly extend to 64 bit.
      */
     unsigned int is_displacement_or_dword : 1;
+
+    /* Operands when using VEX encoding. */
+    unsigned int vex : 2;
 } encodings[] = {
     {INSTR_ADD, {"add", 1}, {0}, {0x00}, OPX_DW, 0x00, OPT_REG_REG | OPT_MEM_REG | OPT_REG_MEM},
     {INSTR_ADD, {"add", 1}, {0}, {0x80}, OPX_SW, 0x00, OPT_IMM_REG | OPT_IMM_MEM, {0}, 0, 1},
@@ -132,6 +154,12 @@ static struct encoding {
     {INSTR_AND, {"and"}, {0}, {0x24}, OPX_W, 0x00, OPT_IMM_REG, {{0}, {0, IMPL_AX}}, 0, 1},
     {INSTR_AND, {"and"}, {0}, {0x80}, OPX_SW, 0x20, OPT_IMM_REG | OPT_IMM_MEM, {0}, 0, 1},
 
+    {INSTR_BSF, {"bsf", 1}, {0}, {0x0F, 0xBC}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{2 | 4 | 8}, {2 | 4 | 8}}, 1},
+
+    {INSTR_BSR, {"bsr", 1}, {0}, {0x0F, 0xBD}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{2 | 4 | 8}, {2 | 4 | 8}}, 1},
+
+    {INSTR_BSWAP, {"bswap"}, {0}, {0x0F, 0xC8}, OPX_REG, 0x00, OPT_REG, {4 | 8}},
+
     {INSTR_CALL, {"call"}, {0}, {0xE8}, OPX_NONE, 0x00, OPT_IMM, {8}},
     {INSTR_CALL, {"call", 1}, {0}, {0xFF}, OPX_NONE, 0x10, OPT_REG | OPT_MEM, {8}},
 
@@ -139,6 +167,8 @@ static struct encoding {
     {INSTR_CMP, {"cmp"}, {0}, {0x3C}, OPX_W, 0x00, OPT_IMM_REG, {{1 | 2 | 4}, {1 | 2 | 4, IMPL_AX}}},
     {INSTR_CMP, {"cmp"}, {0}, {0x80}, OPX_SW, 0x38, OPT_IMM_REG | OPT_IMM_MEM},
 
+    {INSTR_CMPXCHG, {"cmpxchg"}, {0}, {0x0F, 0xB0}, OPX_W, 0x00, OPT_REG_MEM},
+
     {INSTR_Cxy, {"cdq"}, {0}, {0x99}, OPX_NONE, 0x00, OPT_NONE, {4}},
     {INSTR_Cxy, {"cqo"}, {0}, {0x99}, OPX_NONE, 0x00, OPT_NONE, {8}},
 
@@ -146,16 +176,23 @@ static struct encoding {
 
     {INSTR_IDIV, {"idiv"}, {0}, {0xF6}, OPX_W, 0x38, OPT_REG | OPT_MEM},
 
+    {INSTR_IMUL, {"imul"}, {0}, {0xF6}, OPX_W, 0x28, OPT_REG | OPT_MEM},
+
     {INSTR_Jcc, {"j"}, {0}, {0x0F, 0x80}, OPX_tttn, 0x00, OPT_IMM, {8}, 0, 1},
 
     {INSTR_JMP, {"jmp"}, {0}, {0xE9}, OPX_S, 0x00, OPT_IMM, {8}, 0, 1},
+    {INSTR_JMP, {"jmp"}, {0}, {0xFF}, OPX_NONE, 0x20, OPT_REG, {8}},
 
-    {INSTR_LEA, {"lea", 1}, {0}, {0x8D}, OPX_NONE, 0x00, OPT_MEM_REG, {{8}, {8}}},
+    {INSTR_LEA, {"lea", 1}, {0}, {0x8D}, OPX_NONE, 0x00, OPT_MEM_REG, {{8}, {4 | 8}}},
 
     {INSTR_LEAVE, {"leave"}, {0}, {0xC9}, OPX_NONE, 0x00, OPT_NONE},
 
+    {INSTR_LZCNT, {"lzcnt", 1}, {0xF3}, {0x0F, 0xBD}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{2 | 4 | 8}, {2 | 4 | 8}}, 1},
+
+    {INSTR_MFENCE, {"mfence"}, {0}, {0x0F, 0xAE, 0xF0}, OPX_NONE, 0x00, OPT_NONE},
+
     {INSTR_MOV, {"mov", 1}, {0}, {0x88}, OPX_DW, 0x00, OPT_REG_REG | OPT_MEM_REG | OPT_REG_MEM},
-    {INSTR_MOV, {"mov", 1}, {0}, {0xB8}, OPX_WREG, 0x00, OPT_IMM_REG, {{1 | 2 | 4}, {1 | 2 | 4}}},
+    {INSTR_MOV, {"mov", 1}, {0}, {0xB0}, OPX_WREG, 0x00, OPT_IMM_REG, {{1 | 2 | 4}, {1 | 2 | 4}}},
     {INSTR_MOV, {"mov", 1}, {0}, {0xC6}, OPX_W, 0x00, OPT_IMM_REG, {0}, 0, 1},
     {INSTR_MOV, {"movq"}, {0}, {0xB8}, OPX_WREG, 0x00, OPT_IMM_REG, {{8}, {8}}},
     {INSTR_MOV, {"mov", 1}, {0}, {0xC6}, OPX_W, 0x00, OPT_IMM_MEM, {0}, 0, 1},
@@ -177,36 +214,60 @@ static struct encoding {
 
     {INSTR_POP, {"pop"}, {0}, {0x58}, OPX_REG, 0x00, OPT_REG, {8}},
 
+    {INSTR_POPCNT, {"popcnt", 1}, {0xF3}, {0x0F, 0xB8}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{2 | 4 | 8}, {2 | 4 | 8}}, 1},
+
     {INSTR_PUSH, {"push"}, {0}, {0x50}, OPX_REG, 0x00, OPT_REG, {8}},
     {INSTR_PUSH, {"push"}, {0}, {0x68}, OPX_NONE, 0x00, OPT_IMM, {8}, 0, 1},
     {INSTR_PUSH, {"push"}, {0}, {0xFF}, OPX_NONE, 0x30, OPT_MEM, {8}},
 
     {INSTR_RET, {"ret"}, {0}, {0xC3}, OPX_NONE, 0x00, OPT_NONE},
 
+    {INSTR_ROL, {"rol"}, {0}, {0xC0}, OPX_W, 0xC0, OPT_IMM_REG, {1}},
+    {INSTR_ROL, {"rol"}, {0}, {0xD2}, OPX_W, 0xC0, OPT_REG_REG, {1, IMPL_CX}},
+
+    {INSTR_ROR, {"ror"}, {0}, {0xC0}, OPX_W, 0xC8, OPT_IMM_REG, {1}},
+    {INSTR_ROR, {"ror"}, {0}, {0xD2}, OPX_W, 0xC8, OPT_REG_REG, {1, IMPL_CX}},
+
     {INSTR_SAR, {"sar"}, {0}, {0xC0}, OPX_W, 0xF8, OPT_IMM_REG, {1}},
     {INSTR_SAR, {"sar"}, {0}, {0xD2}, OPX_W, 0xF8, OPT_REG_REG, {1, IMPL_CX}},
 
+    {INSTR_SARX, {"sarx"}, {0xF3}, {0x0F, 0x38, 0xF7}, OPX_NONE, 0x00, OPT_REG_REG, {{4 | 8}, {4 | 8}}, 0, 0, VEX_SHIFT},
+
     {INSTR_SETcc, {"set"}, {0}, {0x0F, 0x90}, OPX_tttn, 0xC0, OPT_REG, {1}},
 
     {INSTR_SHL, {"shl"}, {0}, {0xC0}, OPX_W, 0xE0, OPT_IMM_REG, {1}},
     {INSTR_SHL, {"shl"}, {0}, {0xD2}, OPX_W, 0xE0, OPT_REG_REG, {{1, IMPL_CX}}},
 
+    {INSTR_SHLX, {"shlx"}, {0x66}, {0x0F, 0x38, 0xF7}, OPX_NONE, 0x00, OPT_REG_REG, {{4 | 8}, {4 | 8}}, 0, 0, VEX_SHIFT},
+
     {INSTR_SHR, {"shr"}, {0}, {0xC0}, OPX_W, 0xE8, OPT_IMM_REG, {1}},
     {INSTR_SHR, {"shr"}, {0}, {0xD2}, OPX_W, 0xE8, OPT_REG_REG, {1, IMPL_CX}},
 
+    {INSTR_SHRX, {"shrx"}, {0xF2}, {0x0F, 0x38, 0xF7}, OPX_NONE, 0x00, OPT_REG_REG, {{4 | 8}, {4 | 8}}, 0, 0, VEX_SHIFT},
+
+    {INSTR_STOS, {"stos"}, {0}, {0xAA}, OPX_W},
+
     {INSTR_SUB, {"sub"}, {0}, {0x28}, OPX_SW, 0x00, OPT_REG_REG | OPT_MEM_REG | OPT_REG_MEM},
     {INSTR_SUB, {"sub"}, {0}, {0x80}, OPX_SW, 0x28, OPT_IMM_REG | OPT_IMM_MEM, {0}, 0, 1},
 
     {INSTR_TEST, {"test"}, {0}, {0x84}, OPX_W, 0x00, OPT_REG_REG | OPT_MEM_REG | OPT_REG_MEM},
     {INSTR_TEST, {"test"}, {0}, {0xF6}, OPX_W, 0xC0, OPT_IMM_REG},
 
+    {INSTR_TZCNT, {"tzcnt", 1}, {0xF3}, {0x0F, 0xBC}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{2 | 4 | 8}, {2 | 4 | 8}}, 1},
+
+    {INSTR_UD2, {"ud2"}, {0}, {0x0F, 0x0B}, OPX_NONE, 0x00, OPT_NONE},
+
+    {INSTR_XADD, {"xadd"}, {0}, {0x0F, 0xC0}, OPX_W, 0x00, OPT_REG_MEM},
+
+    {INSTR_XCHG, {"xchg"}, {0}, {0x86}, OPX_W, 0x00, OPT_REG_REG | OPT_REG_MEM},
+
     {INSTR_XOR, {"xor"}, {0}, {0x30}, OPX_DW, 0x00, OPT_REG_REG | OPT_MEM_REG | OPT_REG_MEM},
     {INSTR_XOR, {"xor"}, {0}, {0x80}, OPX_SW, 0xF0, OPT_IMM_REG | OPT_IMM_MEM, {0}, 0, 1},
 
     /* SSE */
 
-    {INSTR_ADDS, {"addss"}, {0xF3}, {0x0F, 0x58}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{4}, {4}}, 1},
-    {INSTR_ADDS, {"addsd"}, {0xF2}, {0x0F, 0x58}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{8}, {8}}, 1},
+    {INSTR_ADDS, {"addss"}, {0xF3}, {0x0F, 0x58}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{4}, {4}}, 1, 0, VEX_NDS},
+    {INSTR_ADDS, {"addsd"}, {0xF2}, {0x0F, 0x58}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{8}, {8}}, 1, 0, VEX_NDS},
 
     {0, {"andnps"}, {0}, {0x0F, 0x55}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{4}, {4}}, 1},
 
@@ -216,41 +277,81 @@ static struct encoding {
 
     {0, {"cvtdq2ps"}, {0}, {0x0F, 0x5B}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{4}, {4}}, 1},
 
-    {INSTR_CVTSI2S, {"cvtsi2ss"}, {0xF3}, {0x0F, 0x2A}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{4 | 8}, {4}}, 1},
-    {INSTR_CVTSI2S, {"cvtsi2sd"}, {0xF2}, {0x0F, 0x2A}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{4 | 8}, {8}}, 1},
+    {INSTR_CVTSI2S, {"cvtsi2ss"}, {0xF3}, {0x0F, 0x2A}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{4 | 8}, {4}}, 1, 0, VEX_NDS},
+    {INSTR_CVTSI2S, {"cvtsi2sd"}, {0xF2}, {0x0F, 0x2A}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{4 | 8}, {8}}, 1, 0, VEX_NDS},
 
-    {INSTR_CVTS2S, {"cvtss2sd"}, {0xF3}, {0x0F, 0x5A}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{4}, {8}}, 1},
-    {INSTR_CVTS2S, {"cvtsd2ss"}, {0xF2}, {0x0F, 0x5A}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{8}, {4}}, 1},
+    {INSTR_CVTS2S, {"cvtss2sd"}, {0xF3}, {0x0F, 0x5A}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{4}, {8}}, 1, 0, VEX_NDS},
+    {INSTR_CVTS2S, {"cvtsd2ss"}, {0xF2}, {0x0F, 0x5A}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{8}, {4}}, 1, 0, VEX_NDS},
 
-    {INSTR_CVTTS2SI, {"cvttss2si"}, {0xF3}, {0x0F, 0x2C}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{4}, {4 | 8}}, 1},
-    {INSTR_CVTTS2SI, {"cvttsd2si"}, {0xF2}, {0x0F, 0x2C}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{8}, {4 | 8}}, 1},
+    {INSTR_CVTTS2SI, {"cvttss2si"}, {0xF3}, {0x0F, 0x2C}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{4}, {4 | 8}}, 1, 0, VEX_RM},
+    {INSTR_CVTTS2SI, {"cvttsd2si"}, {0xF2}, {0x0F, 0x2C}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{8}, {4 | 8}}, 1, 0, VEX_RM},
 
-    {INSTR_DIVS, {"divss"}, {0xF3}, {0x0F, 0x5E}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{4}, {4}}, 1},
-    {INSTR_DIVS, {"divsd"}, {0xF2}, {0x0F, 0x5E}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{8}, {8}}, 1},
+    {INSTR_DIVS, {"divss"}, {0xF3}, {0x0F, 0x5E}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{4}, {4}}, 1, 0, VEX_NDS},
+    {INSTR_DIVS, {"divsd"}, {0xF2}, {0x0F, 0x5E}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{8}, {8}}, 1, 0, VEX_NDS},
 
-    {INSTR_MULS, {"mulss"}, {0xF3}, {0x0F, 0x59}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{4}, {4}}, 1},
-    {INSTR_MULS, {"mulsd"}, {0xF2}, {0x0F, 0x59}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{8}, {8}}, 1},
+    {INSTR_MULS, {"mulss"}, {0xF3}, {0x0F, 0x59}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{4}, {4}}, 1, 0, VEX_NDS},
+    {INSTR_MULS, {"mulsd"}, {0xF2}, {0x0F, 0x59}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{8}, {8}}, 1, 0, VEX_NDS},
 
     {0, {"orps"}, {0}, {0x0F, 0x56}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{4}, {4}}, 1},
 
-    {INSTR_SUBS, {"subss"}, {0xF3}, {0x0F, 0x5C}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{4}, {4}}, 1},
-    {INSTR_SUBS, {"subsd"}, {0xF2}, {0x0F, 0x5C}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{8}, {8}}, 1},
+    {INSTR_SUBS, {"subss"}, {0xF3}, {0x0F, 0x5C}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{4}, {4}}, 1, 0, VEX_NDS},
+    {INSTR_SUBS, {"subsd"}, {0xF2}, {0x0F, 0x5C}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{8}, {8}}, 1, 0, VEX_NDS},
+
+    {INSTR_MOVAP, {"movaps"}, {0}, {0x0F, 0x28}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{4}, {4}}, 1, 0, VEX_RM},
+    {INSTR_MOVAP, {"movaps"}, {0}, {0x0F, 0x29}, OPX_NONE, 0x00, OPT_REG_MEM, {{4}, {4}}, 0, 0, VEX_RM},
+
+    {INSTR_MOVS, {"movss"}, {0xF3}, {0x0F, 0x10}, OPX_NONE, 0x00, OPT_REG_REG, {{4}, {4}}, 1, 0, VEX_NDS},
+    {INSTR_MOVS, {"movss"}, {0xF3}, {0x0F, 0x10}, OPX_NONE, 0x00, OPT_MEM_REG, {{4}, {4}}, 1, 0, VEX_RM},
+    {INSTR_MOVS, {"movss"}, {0xF3}, {0x0F, 0x11}, OPX_NONE, 0x00, OPT_REG_MEM, {{4}, {4}}, 0, 0, VEX_RM},
+    {INSTR_MOVS, {"movsd"}, {0xF2}, {0x0F, 0x10}, OPX_NONE, 0x00, OPT_REG_REG, {{8}, {8}}, 1, 0, VEX_NDS},
+    {INSTR_MOVS, {"movsd"}, {0xF2}, {0x0F, 0x10}, OPX_NONE, 0x00, OPT_MEM_REG, {{8}, {8}}, 1, 0, VEX_RM},
+    {INSTR_MOVS, {"movsd"}, {0xF2}, {0x0F, 0x11}, OPX_NONE, 0x00, OPT_REG_MEM, {{8}, {8}}, 0, 0, VEX_RM},
+
+    {INSTR_MOVUP, {"movups"}, {0}, {0x0F, 0x10}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{4}, {4}}, 1, 0, VEX_RM},
+    {INSTR_MOVUP, {"movups"}, {0}, {0x0F, 0x11}, OPX_NONE, 0x00, OPT_REG_MEM, {{4}, {4}}, 0, 0, VEX_RM},
 
-    {INSTR_MOVAP, {"movaps"}, {0}, {0x0F, 0x28}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{4}, {4}}, 1},
-    {INSTR_MOVAP, {"movaps"}, {0}, {0x0F, 0x29}, OPX_NONE, 0x00, OPT_REG_MEM, {{4}, {4}}},
+    {INSTR_UCOMIS, {"ucomiss"}, {0}, {0x0F, 0x2E}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{4}, {4}}, 1, 0, VEX_RM},
+    {INSTR_UCOMIS, {"ucomisd"}, {0x66}, {0x0F, 0x2E}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{8}, {8}}, 1, 0, VEX_RM},
 
-    {INSTR_MOVS, {"movss"}, {0xF3}, {0x0F, 0x10}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{4}, {4}}, 1},
-    {INSTR_MOVS, {"movss"}, {0xF3}, {0x0F, 0x11}, OPX_NONE, 0x00, OPT_REG_MEM, {{4}, {4}}},
-    {INSTR_MOVS, {"movsd"}, {0xF2}, {0x0F, 0x10}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{8}, {8}}, 1},
-    {INSTR_MOVS, {"movsd"}, {0xF2}, {0x0F, 0x11}, OPX_NONE, 0x00, OPT_REG_MEM, {{8}, {8}}},
+    {INSTR_PXOR, {"pxor"}, {0x66}, {0x0F, 0xEF}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{8}, {8}}, 1, 0, VEX_NDS},
 
-    {0, {"movups"}, {0}, {0x0F, 0x10}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{4}, {4}}, 1},
-    {0, {"movups"}, {0}, {0x0F, 0x11}, OPX_NONE, 0x00, OPT_REG_MEM, {{4}, {4}}},
+    {INSTR_MOVDQU, {"movdqu"}, {0xF3}, {0x0F, 0x6F}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{8}, {8}}, 1, 0, VEX_RM},
+    {INSTR_MOVDQU, {"movdqu"}, {0xF3}, {0x0F, 0x7F}, OPX_NONE, 0x00, OPT_REG_MEM, {{8}, {8}}, 0, 0, VEX_RM},
 
-    {INSTR_UCOMIS, {"ucomiss"}, {0}, {0x0F, 0x2E}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{4}, {4}}, 1},
-    {INSTR_UCOMIS, {"ucomisd"}, {0x66}, {0x0F, 0x2E}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{8}, {8}}, 1},
+    {INSTR_MOVQ, {"movq"}, {0x66}, {0x0F, 0x6E}, OPX_NONE, 0x00, OPT_REG_REG, {{8}, {8}}, 1, 0, VEX_RM},
 
-    {INSTR_PXOR, {"pxor"}, {0x66}, {0x0F, 0xEF}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{8}, {8}}, 1},
+    {INSTR_PUNPCKLQDQ, {"punpcklqdq"}, {0x66}, {0x0F, 0x6C}, OPX_NONE, 0x00, OPT_REG_REG, {{8}, {8}}, 1, 0, VEX_NDS},
+
+    {INSTR_ADDP, {"addps"}, {0}, {0x0F, 0x58}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{4}, {4}}, 1, 0, VEX_NDS},
+    {INSTR_ADDP, {"addpd"}, {0x66}, {0x0F, 0x58}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{8}, {8}}, 1, 0, VEX_NDS},
+
+    {INSTR_SUBP, {"subps"}, {0}, {0x0F, 0x5C}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{4}, {4}}, 1, 0, VEX_NDS},
+    {INSTR_SUBP, {"subpd"}, {0x66}, {0x0F, 0x5C}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{8}, {8}}, 1, 0, VEX_NDS},
+
+    {INSTR_MULP, {"mulps"}, {0}, {0x0F, 0x59}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{4}, {4}}, 1, 0, VEX_NDS},
+    {INSTR_MULP, {"mulpd"}, {0x66}, {0x0F, 0x59}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{8}, {8}}, 1, 0, VEX_NDS},
+
+    {INSTR_DIVP, {"divps"}, {0}, {0x0F, 0x5E}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{4}, {4}}, 1, 0, VEX_NDS},
+    {INSTR_DIVP, {"divpd"}, {0x66}, {0x0F, 0x5E}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{8}, {8}}, 1, 0, VEX_NDS},
+
+    {INSTR_PADDB, {"paddb"}, {0x66}, {0x0F, 0xFC}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{8}, {8}}, 1, 0, VEX_NDS},
+    {INSTR_PADDW, {"paddw"}, {0x66}, {0x0F, 0xFD}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{8}, {8}}, 1, 0, VEX_NDS},
+    {INSTR_PADDD, {"paddd"}, {0x66}, {0x0F, 0xFE}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{8}, {8}}, 1, 0, VEX_NDS},
+    {INSTR_PADDQ, {"paddq"}, {0x66}, {0x0F, 0xD4}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{8}, {8}}, 1, 0, VEX_NDS},
+    {INSTR_PSUBB, {"psubb"}, {0x66}, {0x0F, 0xF8}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{8}, {8}}, 1, 0, VEX_NDS},
+    {INSTR_PSUBW, {"psubw"}, {0x66}, {0x0F, 0xF9}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{8}, {8}}, 1, 0, VEX_NDS},
+    {INSTR_PSUBD, {"psubd"}, {0x66}, {0x0F, 0xFA}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{8}, {8}}, 1, 0, VEX_NDS},
+    {INSTR_PSUBQ, {"psubq"}, {0x66}, {0x0F, 0xFB}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{8}, {8}}, 1, 0, VEX_NDS},
+    {INSTR_PMULLW, {"pmullw"}, {0x66}, {0x0F, 0xD5}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{8}, {8}}, 1, 0, VEX_NDS},
+    {INSTR_PMULLD, {"pmulld"}, {0x66}, {0x0F, 0x38, 0x40}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{8}, {8}}, 1, 0, VEX_NDS},
+    {INSTR_PAND, {"pand"}, {0x66}, {0x0F, 0xDB}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{8}, {8}}, 1, 0, VEX_NDS},
+    {INSTR_POR, {"por"}, {0x66}, {0x0F, 0xEB}, OPX_NONE, 0x00, OPT_REG_REG | OPT_MEM_REG, {{8}, {8}}, 1, 0, VEX_NDS},
+
+    {INSTR_PREFETCHNTA, {"prefetchnta"}, {0}, {0x0F, 0x18}, OPX_NONE, 0x00, OPT_MEM, {{1}}},
+    {INSTR_PREFETCHT0, {"prefetcht0"}, {0}, {0x0F, 0x18}, OPX_NONE, 0x08, OPT_MEM, {{1}}},
+    {INSTR_PREFETCHT1, {"prefetcht1"}, {0}, {0x0F, 0x18}, OPX_NONE, 0x10, OPT_MEM, {{1}}},
+    {INSTR_PREFETCHT2, {"prefetcht2"}, {0}, {0x0F, 0x18}, OPX_NONE, 0x18, OPT_MEM, {{1}}},
+    {INSTR_PREFETCHW, {"prefetchw"}, {0}, {0x0F, 0x0D}, OPX_NONE, 0x08, OPT_MEM, {{1}}},
 
     /* x87 */ 
 
@@ -289,6 +390,12 @@ static struct encoding {
     {INSTR_FUCOMIP, {"fucomip"}, {0}, {0xD8 | 7}, OPX_NONE, 0x28, OPT_REG},
 
     {INSTR_FXCH, {"fxch"}, {0}, {0xD8 | 1}, OPX_NONE, 0x08, OPT_REG},
+
+    /* Processor identification, only used in inline assembly. */
+
+    {0, {"cpuid"}, {0}, {0x0F, 0xA2}, OPX_NONE, 0x00, OPT_NONE},
+
+    {0, {"xgetbv"}, {0}, {0x0F, 0x01, 0xD0}, OPX_NONE, 0x00, OPT_NONE},
     {0},
 };
 
@@ -367,11 +474,20 @@ static int encode_address(
 
     if (addr.sym) {
         c->val[c->len++] = ((reg & 0x7) << 3) | 0x5;
-        if (addr.type == ADDR_GLOBAL_OFFSET) {
-            reloc = R_X86_64_GOTPCREL;
-        } else {
-            assert(addr.type == ADDR_NORMAL);
+        switch (addr.type) {
+        default: assert(0);
+        case ADDR_NORMAL:
             reloc = R_X86_64_PC32;
+            break;
+        case ADDR_GLOBAL_OFFSET:
+            reloc = R_X86_64_GOTPCREL;
+            break;
+        case ADDR_GOTTPOFF:
+            reloc = R_X86_64_GOTTPOFF;
+            break;
+        case ADDR_TLSGD:
+            reloc = R_X86_64_TLSGD;
+            break;
         }
 
         elf_add_relocation(section.rela_text,
@@ -408,7 +524,7 @@ static void encode_opcode(struct code *c, struct encoding enc)
     int i;
 
     c->val[c->len++] = enc.opcode[0];
-    for (i = 1; enc.opcode[i] && i < 2; ++i) {
+    for (i = 1; i < 3 && enc.opcode[i]; ++i) {
         c->val[c->len++] = enc.opcode[i];
     }
 }
@@ -522,19 +638,23 @@ static int encode_immediate(
     case IMM_ADDR:
         addr = imm.d.addr;
         assert(addr.sym);
-        if (is_displacement_or_dword) {
+        if (is_displacement_or_dword && addr.sym->symtype == SYM_LABEL) {
             assert(addr.type == ADDR_NORMAL);
             disp = elf_text_displacement(addr.sym, c->len) + addr.displacement - 4;
             memcpy(c->val + c->len, &disp, 4);
         } else {
-            assert(addr.type == ADDR_NORMAL || addr.type == ADDR_PLT);
-            reloc = addr.type == ADDR_NORMAL ? R_X86_64_PC32 : R_X86_64_PLT32;
+            assert(addr.type == ADDR_NORMAL
+                || addr.type == ADDR_PLT
+                || addr.type == ADDR_TPOFF);
+            reloc = addr.type == ADDR_NORMAL ? R_X86_64_PC32
+                : addr.type == ADDR_PLT ? R_X86_64_PLT32 : R_X86_64_TPOFF32;
             elf_add_relocation(section.rela_text,
                 addr.sym, reloc, c->len, addr.displacement);
         }
         c->len += 4;
         break;
     case IMM_STRING:
+    case IMM_ZERO:
         assert(0);
         break;
     }
@@ -770,6 +890,87 @@ static void encode_imm(
     encode_immediate(c, imm, 1, enc.is_displacement_or_dword);
 }
 
+/*
+ * Emit VEX prefix and opcode byte. Two byte form is used if possible,
+ * with implied 0F escape, and no need for REX.W, REX.X or REX.B.
+ */
+static void encode_vex_opcode(
+    struct code *c,
+    struct encoding enc,
+    int w,
+    enum reg r,
+    enum reg v,
+    enum reg x,
+    enum reg b)
+{
+    int map, pp, wide;
+    unsigned char vvvv;
+
+    map = enc.opcode[1] == 0x38 ? 2 : enc.opcode[1] == 0x3A ? 3 : 1;
+    pp = enc.prefix[0] == 0x66 ? 1
+        : enc.prefix[0] == 0xF3 ? 2
+        : enc.prefix[0] == 0xF2 ? 3 : 0;
+    wide = enable_rex_w(enc.opc) && w == 8;
+    vvvv = v ? ~((is_64_bit_reg(v) << 3) | reg3(v)) & 0xF : 0xF;
+    if (map == 1 && !wide && !is_64_bit_reg(x) && !is_64_bit_reg(b)) {
+        c->val[c->len++] = 0xC5;
+        c->val[c->len++] = (!is_64_bit_reg(r) << 7) | (vvvv << 3) | pp;
+    } else {
+        c->val[c->len++] = 0xC4;
+        c->val[c->len++] = (!is_64_bit_reg(r) << 7)
+            | (!is_64_bit_reg(x) << 6) | (!is_64_bit_reg(b) << 5) | map;
+        c->val[c->len++] = (wide << 7) | (vvvv << 3) | pp;
+    }
+
+    c->val[c->len++] = enc.opcode[map == 1 ? 1 : 2];
+}
+
+static void encode_vex(
+    struct code *c,
+    struct encoding enc,
+    int w,
+    struct instruction instr)
+{
+    enum reg r, v, b;
+    struct address addr;
+
+    v = 0;
+    switch (instr.optype) {
+    default: assert(0);
+    case OPT_REG_REG:
+        if (enc.vex == VEX_SHIFT) {
+            r = instr.dest.reg.r;
+            v = instr.source.reg.r;
+            b = r;
+        } else {
+            r = enc.reverse ? instr.dest.reg.r : instr.source.reg.r;
+            b = enc.reverse ? instr.source.reg.r : instr.dest.reg.r;
+            if (enc.vex == VEX_NDS) {
+                v = instr.dest.reg.r;
+            }
+        }
+        encode_vex_opcode(c, enc, w, r, v, 0, b);
+        c->val[c->len++] = 0xC0 | (reg3(r) << 3) | reg3(b);
+        break;
+    case OPT_MEM_REG:
+        r = instr.dest.reg.r;
+        addr = instr.source.mem.addr;
+        if (enc.vex == VEX_NDS) {
+            v = r;
+        }
+        encode_vex_opcode(c, enc, w, r, v, addr.index, addr.base);
+        encode_address(c, reg3(r), addr, 0);
+        break;
+    case OPT_REG_MEM:
+        assert(enc.vex == VEX_RM);
+        r = instr.source.reg.r;
+        addr = instr.dest.mem.addr;
+        encode_vex_opcode(c, enc, w, r, 0, addr.index, addr.base);
+        encode_address(c, reg3(r), addr, 0);
+        break;
+    }
+}
+
 static int operand_size(struct instruction instr)
 {
     switch (instr.optype) {
@@ -783,7 +984,7 @@ static int operand_size(struct instruction instr)
     case OPT_REG_REG:
     case OPT_IMM_REG:
     case OPT_IMM_MEM:
-        if (instr.opcode == INSTR_CVTSI2S) {
+        if (instr.opcode == INSTR_CVTSI2S || instr.opcode == INSTR_MOVQ) {
             return instr.source.width;
         }
         return instr.dest.width;
@@ -871,6 +1072,21 @@ static struct encoding find_encoding(struct instruction instr)
     exit(1);
 }
 
+static int is_vex_encoded(struct instruction instr, struct encoding enc)
+{
+    return enc.vex == VEX_SHIFT
+        || (enc.vex != VEX_NONE && instr.prefix == PREFIX_VEX);
+}
+
+INTERNAL int is_three_operand(struct instruction instr)
+{
+    struct encoding enc;
+
+    enc = find_encoding(instr);
+    return is_vex_encoded(instr, enc)
+        && (enc.vex == VEX_NDS || enc.vex == VEX_SHIFT);
+}
+
 static int is_single_width(unsigned int w)
 {
     return w == 1 || w == 2 || w == 4 || w == 8 || w == 16;
@@ -1013,6 +1229,9 @@ INTERNAL void get_mnemonic(struct instruction instr, char *buf)
 
     enc = find_encoding(instr);
     ptr = enc.mnemonic.str;
+    if (is_vex_encoded(instr, enc) && enc.vex != VEX_SHIFT) {
+        *buf++ = 'v';
+    }
 
     while (*ptr) {
         *buf++ = *ptr++;
@@ -1069,17 +1288,32 @@ INTERNAL struct code encode(struct instruction instr)
     int i, ws, w;
 
     enc = find_encoding(instr);
-    for (i = 0; i < 4 && enc.prefix[i]; ++i) {
-        c.val[c.len++] = enc.prefix[i];
+    w = operand_size(instr);
+    if (is_vex_encoded(instr, enc)) {
+        encode_vex(&c, enc, w, instr);
+        return c;
+    }
+
+    if (w == 2) {
+        c.val[c.len++] = PREFIX_OPERAND_SIZE;
     }
 
     if (instr.prefix) {
         c.val[c.len++] = instr.prefix;
     }
 
-    w = operand_size(instr);
-    if (w == 2) {
-        c.val[c.len++] = PREFIX_OPERAND_SIZE;
+    /*
+     * Call to __tls_get_addr in general dynamic TLS sequence is padded
+     * with a second data16 prefix and rex64, making room for the linker
+     * to rewrite it to a local or initial exec sequence.
+     */
+    if (instr.opcode == INSTR_CALL && instr.prefix == PREFIX_DATA16) {
+        c.val[c.len++] = PREFIX_DATA16;
+        c.val[c.len++] = REX | W(8);
+    }
+
+    for (i = 0; i < 4 && enc.prefix[i]; ++i) {
+        c.val[c.len++] = enc.prefix[i];
     }
 
     switch (instr.optype) {
@@ -73,12 +73,25 @@ struct registr {
  * foo@PLT
  *     Function address through trampoline in procedure linkage table.
  *
+ * $tls@tpoff
+ *     Offset of thread local variable from the thread pointer, which
+ *     is found at %fs:0. Used as immediate.
+ *
+ * tls@gottpoff(%rip)
+ *     Address of thread pointer offset, found in global offset table.
+ *
+ * tls@tlsgd(%rip)
+ *     Address of GOT entry passed to __tls_get_addr.
+ *
  */
 struct address {
     enum {
         ADDR_NORMAL,
         ADDR_GLOBAL_OFFSET,
-        ADDR_PLT
+        ADDR_PLT,
+        ADDR_TPOFF,
+        ADDR_GOTTPOFF,
+        ADDR_TLSGD
     } type;
 
     const struct symbol *sym;
@@ -105,7 +118,8 @@ struct immediate {
     enum {
         IMM_INT,    /* 1, 2, 4 or 8 byte signed number. */
         IMM_ADDR,   /* Symbol-relative address, label etc. */
-        IMM_STRING  /* string value, only used for initialization. */
+        IMM_STRING, /* string value, only used for initialization. */
+        IMM_ZERO    /* width bytes of zero, only used for initialization. */
     } type;
     union {
         char byte;
@@ -123,16 +137,23 @@ struct immediate {
 enum opcode {
     INSTR_ADD = 0,
     INSTR_AND = INSTR_ADD + 2,
-    INSTR_CALL = INSTR_AND + 3,
+    INSTR_BSF = INSTR_AND + 3,          /* Bit scan forward. */
+    INSTR_BSR = INSTR_BSF + 1,          /* Bit scan reverse. */
+    INSTR_BSWAP = INSTR_BSR + 1,        /* Reverse byte order. */
+    INSTR_CALL = INSTR_BSWAP + 1,
     INSTR_CMP = INSTR_CALL + 2,
-    INSTR_Cxy = INSTR_CMP + 3,          /* Sign extend %[e/r]ax to %[e|r]dx:%[e|r]ax. */
+    INSTR_CMPXCHG = INSTR_CMP + 3,      /* Compare and exchange, with LOCK prefix. */
+    INSTR_Cxy = INSTR_CMPXCHG + 1,      /* Sign extend %[e/r]ax to %[e|r]dx:%[e|r]ax. */
     INSTR_DIV = INSTR_Cxy + 2,
     INSTR_IDIV = INSTR_DIV + 1,         /* Signed division. */
-    INSTR_Jcc = INSTR_IDIV + 1,         /* Jump on condition (combined with tttn) */
+    INSTR_IMUL = INSTR_IDIV + 1,        /* Signed multiplication. */
+    INSTR_Jcc = INSTR_IMUL + 1,         /* Jump on condition (combined with tttn) */
     INSTR_JMP = INSTR_Jcc + 1,
-    INSTR_LEA = INSTR_JMP + 1,
+    INSTR_LEA = INSTR_JMP + 2,
     INSTR_LEAVE = INSTR_LEA + 1,
-    INSTR_MOV = INSTR_LEAVE + 1,
+    INSTR_LZCNT = INSTR_LEAVE + 1,      /* Count leading zero bits. */
+    INSTR_MFENCE = INSTR_LZCNT + 1,     /* Serialize loads and stores. */
+    INSTR_MOV = INSTR_MFENCE + 1,
     INSTR_MOV_STR = INSTR_MOV + 5,      /* Move string, optionally with REP prefix. */
     INSTR_MOVSX = INSTR_MOV_STR + 1,
     INSTR_MOVZX = INSTR_MOVSX + 2,
@@ -140,15 +161,26 @@ enum opcode {
     INSTR_NOT = INSTR_MUL + 1,
     INSTR_OR = INSTR_NOT + 1,
     INSTR_POP = INSTR_OR + 2,
-    INSTR_PUSH = INSTR_POP + 1,
+    INSTR_POPCNT = INSTR_POP + 1,       /* Count number of set bits. */
+    INSTR_PUSH = INSTR_POPCNT + 1,
     INSTR_RET = INSTR_PUSH + 3,
-    INSTR_SAR = INSTR_RET + 1,
-    INSTR_SETcc = INSTR_SAR + 2,        /* Set flag (combined with tttn). */
+    INSTR_ROL = INSTR_RET + 1,          /* Rotate left. */
+    INSTR_ROR = INSTR_ROL + 2,          /* Rotate right. */
+    INSTR_SAR = INSTR_ROR + 2,
+    INSTR_SARX = INSTR_SAR + 2,         /* Shift arithmetic without flags (BMI2). */
+    INSTR_SETcc = INSTR_SARX + 1,       /* Set flag (combined with tttn). */
     INSTR_SHL = INSTR_SETcc + 1,
-    INSTR_SHR = INSTR_SHL + 2,
-    INSTR_SUB = INSTR_SHR + 2,
+    INSTR_SHLX = INSTR_SHL + 2,         /* Shift left without flags (BMI2). */
+    INSTR_SHR = INSTR_SHLX + 1,
+    INSTR_SHRX = INSTR_SHR + 2,         /* Shift right without flags (BMI2). */
+    INSTR_STOS = INSTR_SHRX + 1,         /* Store string, optionally with REP prefix. */
+    INSTR_SUB = INSTR_STOS + 1,
     INSTR_TEST = INSTR_SUB + 2,
-    INSTR_XOR = INSTR_TEST + 2,
+    INSTR_TZCNT = INSTR_TEST + 2,       /* Count trailing zero bits. */
+    INSTR_UD2 = INSTR_TZCNT + 1,        /* Undefined instruction. */
+    INSTR_XADD = INSTR_UD2 + 1,         /* Exchange and add, with LOCK prefix. */
+    INSTR_XCHG = INSTR_XADD + 1,        /* Exchange, implicitly locked. */
+    INSTR_XOR = INSTR_XCHG + 1,
 
     INSTR_ADDS = INSTR_XOR + 2,         /* Add floating point. */
     INSTR_CVTSI2S = INSTR_ADDS + 6,     /* Convert int to floating point. */
@@ -159,10 +191,35 @@ enum opcode {
     INSTR_SUBS = INSTR_MULS + 3,        /* Subtract floating point. */
     INSTR_MOVAP = INSTR_SUBS + 2,       /* Move aligned packed floating point. */
     INSTR_MOVS = INSTR_MOVAP + 2,       /* Move floating point. */
-    INSTR_UCOMIS = INSTR_MOVS + 6,      /* Compare floating point and set EFLAGS. */
+    INSTR_MOVUP = INSTR_MOVS + 6,       /* Move unaligned packed floating point. */
+    INSTR_UCOMIS = INSTR_MOVUP + 2,     /* Compare floating point and set EFLAGS. */
     INSTR_PXOR = INSTR_UCOMIS + 2,      /* Bitwise xor with xmm register. */
+    INSTR_MOVDQU = INSTR_PXOR + 1,      /* Move unaligned 16 bytes. */
+    INSTR_MOVQ = INSTR_MOVDQU + 2,      /* Move quadword from general register. */
+    INSTR_PUNPCKLQDQ = INSTR_MOVQ + 1,  /* Interleave low quadwords. */
+    INSTR_ADDP = INSTR_PUNPCKLQDQ + 1,  /* Add packed floating point. */
+    INSTR_SUBP = INSTR_ADDP + 2,        /* Subtract packed floating point. */
+    INSTR_MULP = INSTR_SUBP + 2,        /* Multiply packed floating point. */
+    INSTR_DIVP = INSTR_MULP + 2,        /* Divide packed floating point. */
+    INSTR_PADDB = INSTR_DIVP + 2,       /* Add packed integers. */
+    INSTR_PADDW = INSTR_PADDB + 1,
+    INSTR_PADDD = INSTR_PADDW + 1,
+    INSTR_PADDQ = INSTR_PADDD + 1,
+    INSTR_PSUBB = INSTR_PADDQ + 1,      /* Subtract packed integers. */
+    INSTR_PSUBW = INSTR_PSUBB + 1,
+    INSTR_PSUBD = INSTR_PSUBW + 1,
+    INSTR_PSUBQ = INSTR_PSUBD + 1,
+    INSTR_PMULLW = INSTR_PSUBQ + 1,     /* Multiply packed words, keep low. */
+    INSTR_PMULLD = INSTR_PMULLW + 1,    /* Multiply packed dwords, keep low (SSE4.1). */
+    INSTR_PAND = INSTR_PMULLD + 1,      /* Bitwise and with xmm register. */
+    INSTR_POR = INSTR_PAND + 1,         /* Bitwise or with xmm register. */
+    INSTR_PREFETCHNTA = INSTR_POR + 1,  /* Prefetch data into caches. */
+    INSTR_PREFETCHT0 = INSTR_PREFETCHNTA + 1,
+    INSTR_PREFETCHT1 = INSTR_PREFETCHT0 + 1,
+    INSTR_PREFETCHT2 = INSTR_PREFETCHT1 + 1,
+    INSTR_PREFETCHW = INSTR_PREFETCHT2 + 1,
 
-    INSTR_FADDP = INSTR_PXOR + 1,       /* Add x87 ST(0) to ST(i) and pop. */
+    INSTR_FADDP = INSTR_PREFETCHW + 1,       /* Add x87 ST(0) to ST(i) and pop. */
     INSTR_FDIVRP = INSTR_FADDP + 1,     /* Divide and pop. */
     INSTR_FILD = INSTR_FDIVRP + 1,      /* Load integer to ST(0). */
     INSTR_FISTP = INSTR_FILD + 3,       /* Store integer and pop. */
@@ -181,7 +238,11 @@ enum prefix {
     PREFIX_NONE = 0x0,
     PREFIX_REP = 0xF3,
     PREFIX_REPE = 0xF3,
-    PREFIX_REPNE = 0xF2
+    PREFIX_REPNE = 0xF2,
+    PREFIX_LOCK = 0xF0,
+    PREFIX_FS = 0x64,                   /* Segment override. */
+    PREFIX_DATA16 = 0x66,               /* Padding for TLS sequences. */
+    PREFIX_VEX = 0xC4                   /* Use VEX encoding of SSE instruction. */
 };
 
 /*
@@ -252,6 +313,14 @@ INTERNAL struct code encode(struct instruction instr);
 /* Lookup instruction mnemonic for textual assembly. */
 INTERNAL void get_mnemonic(struct instruction instr, char *buf);
 
+/*
+ * Determine if VEX encoded instruction takes an additional register
+ * source operand, which in textual assembly is written between source
+ * and destination. The extra operand is always the destination for
+ * SSE, or the source for BMI2 shifts.
+ */
+INTERNAL int is_three_operand(struct instruction instr);
+
 /*
  * Lookup best matching instruction from textual assembly mnemonic and
  * operands.
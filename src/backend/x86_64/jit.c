@@ -0,0 +1,494 @@
+#if !AMALGAMATION
+# define INTERNAL
+# define EXTERNAL extern
+#endif
+#include "jit.h"
+#include "elf.h"
+#include <lacc/context.h>
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <assert.h>
+#include <dlfcn.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Not visible in strict C89 mode, but always the same on Linux. */
+#ifndef MAP_ANONYMOUS
+# define MAP_ANONYMOUS 0x20
+#endif
+
+#define JIT_PAGE_SIZE 0x1000UL
+#define JIT_PLT_ENTRY_SIZE 8
+
+#define JIT_ALIGN(n, a) (((n) + (a) - 1) & ~((a) - 1))
+
+/*
+ * Sections are loaded in executable, read only and writable segments,
+ * each starting on a new page. Stubs for calling functions in shared
+ * libraries are placed after the text, and the table of addresses they
+ * jump through after read only data. Everything is mapped together,
+ * keeping references between sections within reach of 32 bit offsets.
+ */
+enum jit_segment {
+    JIT_TEXT,
+    JIT_RODATA,
+    JIT_DATA
+};
+
+struct jit_symbol {
+    Elf64_Addr address;
+    int got;                        /* GOT entry holding address. */
+    int plt;                        /* Stub jumping to address. */
+    unsigned int is_used : 1;       /* Referenced by relocation. */
+};
+
+static char *jit_memory;
+static size_t jit_segments[JIT_DATA + 2];
+static size_t jit_got, jit_plt;
+static int jit_got_count, jit_plt_count;
+
+static const Elf64_Sym *jit_symbols;
+static const char *jit_strtab;
+static struct jit_symbol *jit_symtab;
+static int jit_symbol_count;
+
+/* Address of each section, 0 if not loaded. */
+static Elf64_Addr *jit_sections;
+
+/*
+ * The C library does not export every function, some are linked in
+ * statically from libc_nonshared.a. Forward those to the copy in the
+ * compiler itself.
+ */
+static int jit_atexit(void (*func)(void))
+{
+    return atexit(func);
+}
+
+static Elf64_Addr jit_lookup(void *handle, const char *name)
+{
+    void *addr;
+
+    if (!strcmp("atexit", name)) {
+        return (Elf64_Addr) &jit_atexit;
+    }
+
+    addr = handle ? dlsym(handle, name) : NULL;
+    return (Elf64_Addr) addr;
+}
+
+static const char *jit_symbol_name(int i)
+{
+    return jit_strtab + jit_symbols[i].st_name;
+}
+
+static int jit_is_undefined(int i)
+{
+    return i > 0 && jit_symbols[i].st_shndx == SHN_UNDEF;
+}
+
+static int jit_is_loaded(const Elf64_Shdr *sh)
+{
+    return (sh->sh_flags & SHF_ALLOC) != 0;
+}
+
+static enum jit_segment jit_segment_of(const Elf64_Shdr *sh)
+{
+    if (sh->sh_flags & SHF_EXECINSTR) {
+        return JIT_TEXT;
+    }
+
+    return (sh->sh_flags & SHF_WRITE) ? JIT_DATA : JIT_RODATA;
+}
+
+static void jit_read_symbols(void)
+{
+    int i;
+
+    jit_symbols = elf_section_buffer(section.symtab);
+    jit_strtab = elf_section_buffer(section.strtab);
+    jit_symbol_count =
+        elf_section_header(section.symtab)->sh_size / sizeof(Elf64_Sym);
+    jit_symtab = calloc(jit_symbol_count, sizeof(*jit_symtab));
+    for (i = 0; i < jit_symbol_count; ++i) {
+        jit_symtab[i].got = -1;
+        jit_symtab[i].plt = -1;
+    }
+}
+
+/*
+ * Count entries needed in GOT and for stubs. Calls to undefined
+ * functions go through a stub, as the definition is likely too far
+ * away to be reached directly.
+ */
+static void jit_scan_relocations(void)
+{
+    int i, j, k, n;
+    const Elf64_Shdr *sh;
+    const Elf64_Rela *rel;
+    struct jit_symbol *sym;
+
+    for (i = 1; i < elf_section_count(); ++i) {
+        sh = elf_section_header(i);
+        if (sh->sh_type != SHT_RELA
+            || !jit_is_loaded(elf_section_header(sh->sh_info)))
+        {
+            continue;
+        }
+
+        rel = elf_section_buffer(i);
+        n = sh->sh_size / sizeof(Elf64_Rela);
+        for (j = 0; j < n; ++j) {
+            k = ELF64_R_SYM(rel[j].r_info);
+            sym = &jit_symtab[k];
+            sym->is_used = 1;
+            switch (ELF64_R_TYPE(rel[j].r_info)) {
+            case R_X86_64_PLT32:
+                if (jit_is_undefined(k) && sym->plt == -1) {
+                    sym->plt = jit_plt_count++;
+                    if (sym->got == -1) {
+                        sym->got = jit_got_count++;
+                    }
+                }
+                break;
+            case R_X86_64_GOTPCREL:
+                if (sym->got == -1) {
+                    sym->got = jit_got_count++;
+                }
+                break;
+            case R_X86_64_TLSGD:
+            case R_X86_64_GOTTPOFF:
+            case R_X86_64_TPOFF32:
+                error("Thread-local storage is not supported with -run.");
+                exit(1);
+            default:
+                break;
+            }
+        }
+    }
+}
+
+/*
+ * Assign offsets from start of mapping to each loaded section, stubs,
+ * GOT and common symbols.
+ */
+static void jit_layout(void)
+{
+    int i;
+    size_t size, align;
+    const Elf64_Shdr *sh;
+    const Elf64_Sym *sym;
+    enum jit_segment seg;
+
+    jit_sections = calloc(elf_section_count(), sizeof(*jit_sections));
+    for (seg = JIT_TEXT, size = 0; seg <= JIT_DATA; ++seg) {
+        size = JIT_ALIGN(size, JIT_PAGE_SIZE);
+        jit_segments[seg] = size;
+        for (i = 1; i < elf_section_count(); ++i) {
+            sh = elf_section_header(i);
+            if (!jit_is_loaded(sh) || jit_segment_of(sh) != seg)
+                continue;
+
+            if (sh->sh_flags & SHF_TLS) {
+                error("Thread-local storage is not supported with -run.");
+                exit(1);
+            }
+
+            align = sh->sh_addralign ? sh->sh_addralign : 1;
+            size = JIT_ALIGN(size, align);
+            jit_sections[i] = size;
+            size += sh->sh_size;
+        }
+
+        switch (seg) {
+        case JIT_TEXT:
+            size = JIT_ALIGN(size, JIT_PLT_ENTRY_SIZE);
+            jit_plt = size;
+            size += jit_plt_count * JIT_PLT_ENTRY_SIZE;
+            break;
+        case JIT_RODATA:
+            size = JIT_ALIGN(size, 8);
+            jit_got = size;
+            size += jit_got_count * 8;
+            break;
+        case JIT_DATA:
+            for (i = 1; i < jit_symbol_count; ++i) {
+                sym = &jit_symbols[i];
+                if (sym->st_shndx == SHN_COMMON) {
+                    size = JIT_ALIGN(size, sym->st_value);
+                    jit_symtab[i].address = size;
+                    size += sym->st_size;
+                }
+            }
+            break;
+        }
+    }
+
+    jit_segments[JIT_DATA + 1] = JIT_ALIGN(size, JIT_PAGE_SIZE);
+}
+
+/* Map memory and copy section contents, rebasing addresses. */
+static void jit_map(void)
+{
+    int i;
+    void *ptr;
+    const Elf64_Shdr *sh;
+
+    ptr = mmap(NULL, jit_segments[JIT_DATA + 1], PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) {
+        error("Unable to map memory for running program.");
+        exit(1);
+    }
+
+    jit_memory = ptr;
+    for (i = 1; i < elf_section_count(); ++i) {
+        sh = elf_section_header(i);
+        if (!jit_is_loaded(sh))
+            continue;
+
+        if (sh->sh_type != SHT_NOBITS) {
+            memcpy(jit_memory + jit_sections[i], elf_section_buffer(i),
+                sh->sh_size);
+        }
+
+        jit_sections[i] += (Elf64_Addr) jit_memory;
+    }
+}
+
+/*
+ * Resolve symbol addresses. Undefined symbols are looked up in the
+ * compiler process itself, which has the C library loaded.
+ */
+static void jit_resolve_symbols(void)
+{
+    int i, undefined;
+    void *handle;
+    const char *name;
+    const Elf64_Sym *sym;
+
+    handle = dlopen(NULL, RTLD_LAZY);
+    for (i = 1, undefined = 0; i < jit_symbol_count; ++i) {
+        sym = &jit_symbols[i];
+        switch (sym->st_shndx) {
+        case SHN_UNDEF:
+            if (!jit_symtab[i].is_used)
+                break;
+
+            name = jit_symbol_name(i);
+            if (!strcmp("_GLOBAL_OFFSET_TABLE_", name)) {
+                jit_symtab[i].address = (Elf64_Addr) jit_memory + jit_got;
+                break;
+            }
+
+            jit_symtab[i].address = jit_lookup(handle, name);
+            if (!jit_symtab[i].address && (sym->st_info >> 4) != STB_WEAK) {
+                error("Undefined reference to '%s'.", name);
+                undefined++;
+            }
+            break;
+        case SHN_ABS:
+            jit_symtab[i].address = sym->st_value;
+            break;
+        case SHN_COMMON:
+            jit_symtab[i].address += (Elf64_Addr) jit_memory;
+            break;
+        default:
+            jit_symtab[i].address = jit_sections[sym->st_shndx]
+                + sym->st_value;
+            break;
+        }
+    }
+
+    if (handle) {
+        dlclose(handle);
+    }
+
+    if (undefined) {
+        exit(1);
+    }
+}
+
+static int jit_write32(char *ptr, Elf64_Addr value, int is_signed)
+{
+    Elf64_Word word;
+
+    if (is_signed
+        ? ((long) value < -2147483647L - 1 || (long) value > 2147483647L)
+        : value > 0xFFFFFFFFUL)
+    {
+        return 1;
+    }
+
+    word = (Elf64_Word) value;
+    memcpy(ptr, &word, sizeof(word));
+    return 0;
+}
+
+static Elf64_Addr jit_got_address(int index)
+{
+    return (Elf64_Addr) jit_memory + jit_got + index * 8;
+}
+
+static Elf64_Addr jit_plt_address(int index)
+{
+    return (Elf64_Addr) jit_memory + jit_plt + index * JIT_PLT_ENTRY_SIZE;
+}
+
+/* Fill GOT entries, and stubs doing jmp *GOT(%rip). */
+static void jit_fill_tables(void)
+{
+    int i;
+    char *ptr;
+    Elf64_Addr addr;
+    const struct jit_symbol *sym;
+
+    for (i = 1; i < jit_symbol_count; ++i) {
+        sym = &jit_symtab[i];
+        if (sym->got != -1) {
+            addr = sym->address;
+            memcpy(jit_memory + jit_got + sym->got * 8, &addr, sizeof(addr));
+        }
+
+        if (sym->plt != -1) {
+            addr = jit_plt_address(sym->plt);
+            ptr = (char *) addr;
+            ptr[0] = '\xFF';
+            ptr[1] = '\x25';
+            jit_write32(ptr + 2, jit_got_address(sym->got) - (addr + 6), 1);
+            ptr[6] = '\x66';
+            ptr[7] = '\x90';
+        }
+    }
+}
+
+static void jit_apply_relocations(int shid)
+{
+    int i, n, k, type, overflow;
+    char *ptr;
+    const Elf64_Shdr *sh;
+    const Elf64_Rela *rel;
+    const struct jit_symbol *sym;
+    Elf64_Addr P, S, A, base;
+
+    sh = elf_section_header(shid);
+    base = jit_sections[sh->sh_info];
+    rel = elf_section_buffer(shid);
+    n = sh->sh_size / sizeof(Elf64_Rela);
+    for (i = 0; i < n; ++i) {
+        type = ELF64_R_TYPE(rel[i].r_info);
+        k = ELF64_R_SYM(rel[i].r_info);
+        sym = &jit_symtab[k];
+        P = base + rel[i].r_offset;
+        S = sym->address;
+        A = rel[i].r_addend;
+        ptr = (char *) P;
+        overflow = 0;
+        switch (type) {
+        case R_X86_64_64:
+            S += A;
+            memcpy(ptr, &S, sizeof(S));
+            break;
+        case R_X86_64_PLT32:
+            if (sym->plt != -1) {
+                S = jit_plt_address(sym->plt);
+            }
+        case R_X86_64_PC32:
+            overflow = jit_write32(ptr, S + A - P, 1);
+            break;
+        case R_X86_64_GOTPCREL:
+            overflow = jit_write32(ptr, jit_got_address(sym->got) + A - P, 1);
+            break;
+        default:
+            error("Unsupported relocation type %d.", type);
+            exit(1);
+        }
+
+        if (overflow) {
+            error("Relocation overflow against '%s'.", jit_symbol_name(k));
+            exit(1);
+        }
+    }
+}
+
+static void jit_relocate(void)
+{
+    int i;
+    const Elf64_Shdr *sh;
+
+    for (i = 1; i < elf_section_count(); ++i) {
+        sh = elf_section_header(i);
+        if (sh->sh_type == SHT_RELA
+            && jit_is_loaded(elf_section_header(sh->sh_info)))
+        {
+            jit_apply_relocations(i);
+        }
+    }
+}
+
+/* Make text executable and read only data, including GOT, read only. */
+static void jit_protect(void)
+{
+    if (mprotect(jit_memory + jit_segments[JIT_TEXT],
+            jit_segments[JIT_RODATA] - jit_segments[JIT_TEXT],
+            PROT_READ | PROT_EXEC)
+        || mprotect(jit_memory + jit_segments[JIT_RODATA],
+            jit_segments[JIT_DATA] - jit_segments[JIT_RODATA],
+            PROT_READ))
+    {
+        error("Unable to set protection of memory for running program.");
+        exit(1);
+    }
+}
+
+static Elf64_Addr jit_find_main(void)
+{
+    int i;
+    const Elf64_Sym *sym;
+
+    for (i = 1; i < jit_symbol_count; ++i) {
+        sym = &jit_symbols[i];
+        if ((sym->st_info >> 4) != STB_LOCAL
+            && sym->st_shndx != SHN_UNDEF
+            && !strcmp("main", jit_symbol_name(i)))
+        {
+            return jit_symtab[i].address;
+        }
+    }
+
+    error("Undefined reference to 'main'.");
+    exit(1);
+}
+
+/*
+ * Memory is kept mapped, as the program can leave pointers to its code
+ * and data in the C library, for example with atexit.
+ */
+static void jit_cleanup(void)
+{
+    free(jit_symtab);
+    free(jit_sections);
+    jit_symtab = NULL;
+    jit_sections = NULL;
+    jit_memory = NULL;
+    jit_got_count = 0;
+    jit_plt_count = 0;
+}
+
+INTERNAL int jit_run(int argc, char **argv)
+{
+    int (*entry)(int, char **);
+
+    jit_read_symbols();
+    jit_scan_relocations();
+    jit_layout();
+    jit_map();
+    jit_resolve_symbols();
+    jit_fill_tables();
+    jit_relocate();
+    jit_protect();
+    entry = (int (*)(int, char **)) jit_find_main();
+    jit_cleanup();
+    return entry(argc, argv);
+}
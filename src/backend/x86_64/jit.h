@@ -0,0 +1,14 @@
+#ifndef JIT_H
+#define JIT_H
+
+/*
+ * Load the translation unit kept in section buffers after elf_flush
+ * into executable memory, and call main with the given arguments.
+ * Undefined symbols are looked up in the running process, which means
+ * the C library and anything else already loaded.
+ *
+ * Return value of main, or exit on errors in loading the program.
+ */
+INTERNAL int jit_run(int argc, char **argv);
+
+#endif
@@ -0,0 +1,422 @@
+#if !AMALGAMATION
+# define INTERNAL
+# define EXTERNAL extern
+#endif
+#include "layout.h"
+#include <lacc/array.h>
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Estimated number of iterations of each loop, used to scale frequency
+ * of blocks inside the loop.
+ */
+#define LOOP_ITERATIONS 8.0
+
+/*
+ * Probability of branch heuristics, as described by Ball and Larus in
+ * "Branch Prediction For Free".
+ */
+#define PROB_COLD 0.01
+#define PROB_LOOP 0.88
+#define PROB_RETURN 0.28
+
+/*
+ * Information about each reachable block, indexed by position in depth
+ * first order. Strongly connected components are used to approximate
+ * loops.
+ */
+struct node {
+    struct block *block;
+    int lowlink;
+    int scc;
+    int postorder;
+    int next, prev;
+    int first, last;
+    unsigned int on_stack : 1;
+    unsigned int is_header : 1;
+    unsigned int is_cold : 1;
+    unsigned int is_top : 1;
+    double frequency;
+};
+
+/* Control flow edge considered for fall-through. */
+struct edge {
+    int from, to;
+    double weight;
+};
+
+static array_of(struct node) nodes;
+static array_of(struct edge) edges;
+static array_of(int) stack;
+static array_of(int) rpo;
+static array_of(struct block *) layout;
+
+#define node(b) (&array_get(&nodes, (b)->order))
+
+/*
+ * Functions known to not return, or declared with the cold attribute,
+ * making any block calling them part of an error path.
+ */
+static int is_cold_call(struct expression expr)
+{
+    int i, n;
+    const char *name;
+    const struct symbol *sym;
+    static const char *functions[] = {
+        "abort",
+        "exit",
+        "_Exit",
+        "quick_exit",
+        "longjmp",
+        "siglongjmp",
+        "__assert_fail",
+        "__stack_chk_fail"
+    };
+
+    if (expr.op != IR_OP_CALL || expr.l.kind != ADDRESS) {
+        return 0;
+    }
+
+    sym = expr.l.value.symbol;
+    if (sym->cold) {
+        return 1;
+    }
+
+    if (sym->linkage != LINK_EXTERN) {
+        return 0;
+    }
+
+    name = str_raw(sym->name);
+    n = sizeof(functions) / sizeof(functions[0]);
+    for (i = 0; i < n; ++i) {
+        if (!strcmp(name, functions[i])) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static int is_cold_block(struct definition *def, struct block *block)
+{
+    int i;
+    struct statement *st;
+
+    for (i = block->head; i < block->head + block->count; ++i) {
+        st = &array_get(&def->statements, i);
+        if (is_cold_call(st->expr)) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Number reachable blocks in depth first order, visiting the true
+ * branch first unless the false branch has higher weight, and find
+ * strongly connected components using Tarjan's algorithm.
+ */
+static void visit(struct definition *def, struct block *block)
+{
+    int i, j, k, low;
+    struct node n = {0};
+    struct block *next;
+
+    i = array_len(&nodes);
+    n.block = block;
+    n.lowlink = i;
+    n.on_stack = 1;
+    n.next = n.prev = -1;
+    n.first = n.last = i;
+    n.is_cold = block->unreachable || is_cold_block(def, block);
+    block->order = i;
+    block->color = BLACK;
+    array_push_back(&nodes, n);
+    array_push_back(&stack, i);
+    array_push_back(&layout, block);
+
+    for (k = 0; k < 2; ++k) {
+        j = (block->weight[0] > block->weight[1]) ? k : !k;
+        next = block->jump[j];
+        if (!next)
+            continue;
+
+        if (next->color == WHITE) {
+            visit(def, next);
+            low = node(next)->lowlink;
+        } else if (node(next)->on_stack) {
+            low = next->order;
+        } else continue;
+
+        if (low < array_get(&nodes, i).lowlink) {
+            array_get(&nodes, i).lowlink = low;
+        }
+    }
+
+    if (array_get(&nodes, i).lowlink == i) {
+        do {
+            j = array_pop_back(&stack);
+            array_get(&nodes, j).on_stack = 0;
+            array_get(&nodes, j).scc = i;
+        } while (j != i);
+    }
+
+    array_get(&nodes, i).postorder = array_len(&rpo);
+    array_push_back(&rpo, i);
+}
+
+/* Edge to a block earlier in postorder goes back to a loop header. */
+static int is_forward_edge(struct block *from, struct block *to)
+{
+    return node(from)->postorder > node(to)->postorder;
+}
+
+/* Edge within a strongly connected component continues a loop. */
+static int is_loop_edge(struct block *from, struct block *to)
+{
+    return node(from)->scc == node(to)->scc;
+}
+
+static int is_return_block(struct block *block)
+{
+    return !block->jump[0];
+}
+
+/*
+ * Estimate probability of taking the true branch of a conditional
+ * jump. Branch weights from __builtin_expect are used if present.
+ * Otherwise, error paths are cold, loops are likely to continue, and
+ * early returns are less likely to be taken.
+ */
+static double branch_probability(struct block *block)
+{
+    double w;
+    struct block *b0, *b1;
+
+    assert(block->jump[0]);
+    assert(block->jump[1]);
+    w = (double) block->weight[0] + block->weight[1];
+    if (w > 0.0) {
+        return block->weight[1] / w;
+    }
+
+    b0 = block->jump[0];
+    b1 = block->jump[1];
+    if (node(b0)->is_cold != node(b1)->is_cold) {
+        return node(b1)->is_cold ? PROB_COLD : 1.0 - PROB_COLD;
+    }
+
+    if (is_loop_edge(block, b0) != is_loop_edge(block, b1)) {
+        return is_loop_edge(block, b1) ? PROB_LOOP : 1.0 - PROB_LOOP;
+    }
+
+    if (is_return_block(b0) != is_return_block(b1)) {
+        return is_return_block(b1) ? PROB_RETURN : 1.0 - PROB_RETURN;
+    }
+
+    return 0.5;
+}
+
+/*
+ * Propagate frequency from the entry block in reverse postorder,
+ * ignoring back edges. Blocks targeted by a back edge are loop headers,
+ * executed a number of times for each time the loop is entered.
+ */
+static void estimate_frequency(void)
+{
+    int i;
+    double p;
+    struct node *n;
+    struct block *block;
+
+    for (i = 0; i < array_len(&nodes); ++i) {
+        block = array_get(&nodes, i).block;
+        if (block->jump[0] && !is_forward_edge(block, block->jump[0])) {
+            node(block->jump[0])->is_header = 1;
+        }
+        if (block->jump[1] && !is_forward_edge(block, block->jump[1])) {
+            node(block->jump[1])->is_header = 1;
+        }
+    }
+
+    array_get(&nodes, 0).frequency = 1.0;
+    for (i = array_len(&rpo) - 1; i >= 0; --i) {
+        n = &array_get(&nodes, array_get(&rpo, i));
+        if (n->is_header) {
+            n->frequency *= LOOP_ITERATIONS;
+        }
+
+        block = n->block;
+        if (!block->jump[0])
+            continue;
+
+        p = block->jump[1] ? branch_probability(block) : 0.0;
+        if (is_forward_edge(block, block->jump[0])) {
+            node(block->jump[0])->frequency += n->frequency * (1.0 - p);
+        }
+        if (block->jump[1] && is_forward_edge(block, block->jump[1])) {
+            node(block->jump[1])->frequency += n->frequency * p;
+        }
+    }
+}
+
+static void add_edge(int from, int to, double weight)
+{
+    struct edge e;
+
+    e.from = from;
+    e.to = to;
+    e.weight = weight;
+    array_push_back(&edges, e);
+}
+
+/*
+ * Order edges by decreasing weight. Ties are broken by depth first
+ * order, which is the same order blocks are placed without
+ * optimization.
+ */
+static int compare_edge(const void *a, const void *b)
+{
+    const struct edge *l, *r;
+
+    l = (const struct edge *) a;
+    r = (const struct edge *) b;
+    if (l->weight != r->weight) {
+        return l->weight > r->weight ? -1 : 1;
+    }
+
+    if (l->from != r->from) {
+        return l->from - r->from;
+    }
+
+    return l->to - r->to;
+}
+
+/*
+ * Go through edges from most to least frequent, joining chains of
+ * blocks where the source is the last block of one chain and the
+ * target is the first block of another. If the most frequent edge to a
+ * block would close a loop, the block is kept at the top of its chain,
+ * not letting less frequent edges into the loop fall through to it.
+ */
+static void build_chains(void)
+{
+    int i, head, tail;
+    double p;
+    struct edge *e;
+    struct node *n;
+    struct block *block;
+
+    array_empty(&edges);
+    for (i = 0; i < array_len(&nodes); ++i) {
+        n = &array_get(&nodes, i);
+        block = n->block;
+        if (!block->jump[0] || block->tail_call)
+            continue;
+
+        p = block->jump[1] ? branch_probability(block) : 0.0;
+        if (block->jump[1]) {
+            add_edge(i, block->jump[1]->order, n->frequency * p);
+        }
+        add_edge(i, block->jump[0]->order, n->frequency * (1.0 - p));
+    }
+
+    qsort(edges.data, array_len(&edges), sizeof(struct edge), compare_edge);
+    for (i = 0; i < array_len(&edges); ++i) {
+        e = &array_get(&edges, i);
+        if (e->to == 0
+            || array_get(&nodes, e->from).next != -1
+            || array_get(&nodes, e->to).prev != -1
+            || array_get(&nodes, e->to).is_top)
+        {
+            continue;
+        }
+
+        if (array_get(&nodes, e->from).first == e->to) {
+            array_get(&nodes, e->to).is_top = 1;
+            continue;
+        }
+
+        head = array_get(&nodes, e->from).first;
+        tail = array_get(&nodes, e->to).last;
+        array_get(&nodes, e->from).next = e->to;
+        array_get(&nodes, e->to).prev = e->from;
+        array_get(&nodes, head).last = tail;
+        array_get(&nodes, tail).first = head;
+    }
+}
+
+static void place_chain(int i)
+{
+    assert(array_get(&nodes, i).prev == -1);
+    while (i != -1) {
+        array_push_back(&layout, array_get(&nodes, i).block);
+        i = array_get(&nodes, i).next;
+    }
+}
+
+/*
+ * Place the chain starting with the entry block first, then remaining
+ * chains in depth first order. Chains starting with a cold block are
+ * moved to the end.
+ */
+static void place_chains(void)
+{
+    int i;
+    struct node *n;
+
+    array_empty(&layout);
+    place_chain(0);
+    for (i = 1; i < array_len(&nodes); ++i) {
+        n = &array_get(&nodes, i);
+        if (n->prev == -1 && !n->is_cold) {
+            place_chain(i);
+        }
+    }
+
+    for (i = 1; i < array_len(&nodes); ++i) {
+        n = &array_get(&nodes, i);
+        if (n->prev == -1 && n->is_cold) {
+            place_chain(i);
+        }
+    }
+
+    assert(array_len(&layout) == array_len(&nodes));
+}
+
+INTERNAL int block_layout(struct definition *def, int optimize)
+{
+    array_empty(&nodes);
+    array_empty(&stack);
+    array_empty(&rpo);
+    array_empty(&layout);
+    visit(def, def->body);
+    assert(!array_len(&stack));
+    if (optimize) {
+        estimate_frequency();
+        build_chains();
+        place_chains();
+    }
+
+    return array_len(&layout);
+}
+
+INTERNAL struct block *get_layout_block(int i)
+{
+    assert(i >= 0);
+    assert(i < array_len(&layout));
+    return array_get(&layout, i);
+}
+
+INTERNAL void layout_finalize(void)
+{
+    array_clear(&nodes);
+    array_clear(&edges);
+    array_clear(&stack);
+    array_clear(&rpo);
+    array_clear(&layout);
+}
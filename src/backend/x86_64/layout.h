@@ -0,0 +1,27 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <lacc/ir.h>
+
+/*
+ * Compute the order in which to emit basic blocks of a function. The
+ * first block is always the function entry.
+ *
+ * Without optimization, blocks are placed in depth first order,
+ * visiting the true branch first unless the false branch has higher
+ * weight. Otherwise blocks are chained along the most frequently taken
+ * edges, such that they can fall through to the next block without a
+ * jump, in the style of Pettis and Hansen. Edge frequencies are
+ * estimated from branch weights if available, or static heuristics.
+ *
+ * Return number of reachable blocks.
+ */
+INTERNAL int block_layout(struct definition *def, int optimize);
+
+/* Get block at position in the last computed layout. */
+INTERNAL struct block *get_layout_block(int i);
+
+/* Free memory used for block layout. */
+INTERNAL void layout_finalize(void);
+
+#endif
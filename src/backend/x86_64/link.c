@@ -0,0 +1,2987 @@
+#if !AMALGAMATION
+# define INTERNAL
+# define EXTERNAL extern
+#endif
+#include "link.h"
+#include "elf.h"
+#include "../../preprocessor/strtab.h"
+#include <lacc/array.h>
+#include <lacc/context.h>
+#include <lacc/hash.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <assert.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * Executables are loaded at a fixed address. Each segment starts on a
+ * new page in the file, and is mapped at the same offset from the base
+ * address.
+ */
+#define LINK_BASE_ADDRESS 0x400000UL
+#define LINK_PAGE_SIZE 0x1000UL
+#define LINK_PLT_ENTRY_SIZE 16
+
+#define LINK_ALIGN(n, a) (((n) + (a) - 1) & ~((a) - 1))
+
+/*
+ * Order of output sections in the executable, grouped in read only,
+ * executable, and writable segments.
+ */
+enum link_rank {
+    RANK_INTERP,
+    RANK_HASH,
+    RANK_DYNSYM,
+    RANK_DYNSTR,
+    RANK_VERSYM,
+    RANK_VERNEED,
+    RANK_RELA,
+    RANK_RODATA,
+    RANK_RODATA_OTHER,
+    RANK_EH_FRAME,
+    RANK_EXCEPT_TABLE,
+    RANK_INIT,
+    RANK_PLT,
+    RANK_TEXT,
+    RANK_TEXT_OTHER,
+    RANK_FINI,
+    RANK_TDATA,
+    RANK_TBSS,
+    RANK_PREINIT_ARRAY,
+    RANK_INIT_ARRAY,
+    RANK_FINI_ARRAY,
+    RANK_DATA_REL_RO,
+    RANK_DYNAMIC,
+    RANK_GOT,
+    RANK_DATA,
+    RANK_DATA_OTHER,
+    RANK_BSS,
+    RANK_BSS_OTHER,
+    RANK_NONALLOC
+};
+
+#define RANK_SEGMENT(r) ((r) < RANK_INIT ? 0 : (r) < RANK_TDATA ? 1 : 2)
+
+struct link_object;
+struct output_section;
+struct shared_object;
+
+/* Section from relocatable object file, or generated by the linker. */
+struct link_section {
+    const char *name;
+    struct link_object *object;
+    const char *data;               /* NULL for SHT_NOBITS. */
+    Elf64_Word type;
+    Elf64_Xword flags;
+    Elf64_Xword size;
+    Elf64_Xword align;
+    const Elf64_Rela *rela;
+    size_t relocations;
+    struct output_section *output;
+    Elf64_Off offset;               /* Offset into output section. */
+};
+
+/*
+ * Symbols are either local to an object file, or global and shared by
+ * all objects. Global symbols not defined by any object can be imported
+ * from a shared library.
+ */
+struct link_symbol {
+    const char *name;
+    String key;                     /* Interned name of global symbol. */
+    struct link_section *section;   /* NULL for absolute symbols. */
+    struct shared_object *shared;   /* Library defining the symbol. */
+    const Elf64_Sym *dynamic;       /* Definition in shared library. */
+    Elf64_Addr value;
+    Elf64_Xword size;
+    Elf64_Xword align;              /* Alignment of common symbol. */
+    int type;
+    unsigned int is_global : 1;
+    unsigned int is_defined : 1;    /* Defined by object or linker. */
+    unsigned int is_weak : 1;       /* Weak definition. */
+    unsigned int is_strong_ref : 1; /* Non-weak undefined reference. */
+    unsigned int is_common : 1;
+    unsigned int is_hidden : 1;
+    unsigned int is_exported : 1;
+    unsigned int is_canonical : 1;  /* Imported function address is PLT. */
+    unsigned int is_copied : 1;     /* Imported data copied to .bss. */
+    int got;                        /* GOT entry holding address. */
+    int gottp;                      /* GOT entry holding TP offset. */
+    int tlsgd;                      /* GOT entry pair for TLSGD. */
+    int plt;                        /* PLT entry. */
+    int pltgot;                     /* GOT entry used by PLT entry. */
+    int dynsym;                     /* Index in .dynsym. */
+    Elf64_Word dynname;             /* Offset of name in .dynstr. */
+    Elf64_Half version;             /* Version index in .gnu.version. */
+};
+
+struct link_object {
+    const char *name;
+    const char *buffer;
+    int shnum;
+    struct link_section *storage;
+    struct link_section **sections; /* NULL for discarded sections. */
+    const Elf64_Sym *symtab;
+    const char *strtab;
+    int symnum;
+    struct link_symbol *locals;
+    struct link_symbol **symbols;
+};
+
+struct archive_symbol {
+    String name;
+    size_t offset;                  /* Offset of member header. */
+};
+
+struct link_archive {
+    const char *path;
+    const char *buffer;
+    size_t size;
+    array_of(struct archive_symbol) symbols;
+    array_of(size_t) members;       /* Members already loaded. */
+};
+
+struct shared_object {
+    const char *path;
+    const char *soname;
+    const char *dynstr;
+    const Elf64_Sym *dynsym;
+    const Elf64_Half *versym;
+    int symnum;
+    array_of(const char *) versions;
+    struct hash_table symbols;
+    Elf64_Word dynname;
+    unsigned int is_as_needed : 1;
+    unsigned int is_needed : 1;
+};
+
+/* Symbol version required from a shared library. */
+struct link_version {
+    struct shared_object *shared;
+    const char *name;
+    Elf64_Word dynname;
+    Elf64_Half index;
+};
+
+struct output_section {
+    const char *name;
+    Elf64_Word type;
+    Elf64_Xword flags;
+    Elf64_Xword align;
+    Elf64_Xword size;
+    Elf64_Xword entsize;
+    Elf64_Addr addr;
+    Elf64_Off offset;
+    enum link_rank rank;
+    int index;
+    Elf64_Word shname;
+    Elf64_Word info;
+    struct output_section *link;
+    char *data;
+    array_of(struct link_section *) inputs;
+};
+
+enum got_kind {
+    GOT_ADDRESS,
+    GOT_PLT,
+    GOT_TPOFF,
+    GOT_TLS_MODULE,
+    GOT_TLS_OFFSET
+};
+
+struct got_entry {
+    struct link_symbol *sym;
+    enum got_kind kind;
+};
+
+/* Symbols defined by the linker, with value computed after layout. */
+enum provide_kind {
+    PROVIDE_ZERO,
+    PROVIDE_BASE,
+    PROVIDE_START,
+    PROVIDE_END,
+    PROVIDE_ETEXT,
+    PROVIDE_EDATA,
+    PROVIDE_END_OF_IMAGE
+};
+
+struct link_provide {
+    struct link_symbol *sym;
+    struct output_section *output;
+    enum provide_kind kind;
+};
+
+static struct {
+    const char *output;
+    const char *entry;
+    const char *interp;
+    int is_static;
+    int is_as_needed;
+    int export_dynamic;
+} link_opt;
+
+/*
+ * Model __tls_get_addr in static executables, where there is only the
+ * initial TLS block. Add offset from tls_index to thread pointer.
+ *
+ *     mov %fs:0, %rax
+ *     add 8(%rdi), %rax
+ *     ret
+ */
+static const char link_tls_get_addr[] = {
+    '\x64', '\x48', '\x8B', '\x04', '\x25', '\x00', '\x00', '\x00', '\x00',
+    '\x48', '\x03', '\x47', '\x08',
+    '\xC3'
+};
+
+static array_of(char *) link_buffers;
+static array_of(const char *) link_paths;
+static array_of(struct link_object *) link_objects;
+static array_of(struct link_archive *) link_archives;
+static array_of(struct shared_object *) link_libraries;
+static array_of(struct link_symbol *) link_globals;
+static array_of(struct output_section *) link_outputs;
+static array_of(struct got_entry) link_got;
+static array_of(struct link_symbol *) link_plt, link_copies, link_dynsyms;
+static array_of(struct link_provide) link_provides;
+static array_of(struct link_version) link_versions;
+static array_of(Elf64_Rela) link_relocations;
+static array_of(char) link_dynstr, link_strtab;
+static array_of(Elf64_Sym) link_symbols;
+static struct hash_table link_symtab, link_groups;
+static struct link_section link_common, link_tls_stub;
+
+static struct {
+    struct output_section *interp;
+    struct output_section *hash;
+    struct output_section *dynsym;
+    struct output_section *dynstr;
+    struct output_section *versym;
+    struct output_section *verneed;
+    struct output_section *rela;
+    struct output_section *plt;
+    struct output_section *got;
+    struct output_section *dynamic;
+} link_synthetic;
+
+static Elf64_Phdr link_segments[3], link_tls;
+static int link_phnum, link_relocation_count;
+
+static char *link_read_file(const char *path, size_t *size)
+{
+    FILE *f;
+    long len;
+    char *buffer;
+
+    f = fopen(path, "rb");
+    if (!f) {
+        return NULL;
+    }
+
+    if (fseek(f, 0, SEEK_END) || (len = ftell(f)) < 0
+        || fseek(f, 0, SEEK_SET))
+    {
+        fclose(f);
+        return NULL;
+    }
+
+    buffer = malloc(len + 1);
+    if (fread(buffer, 1, len, f) != (size_t) len) {
+        free(buffer);
+        fclose(f);
+        return NULL;
+    }
+
+    buffer[len] = '\0';
+    fclose(f);
+    array_push_back(&link_buffers, buffer);
+    *size = len;
+    return buffer;
+}
+
+/* Hash function used for DT_HASH and symbol versions. */
+static Elf64_Word link_elf_hash(const char *name)
+{
+    Elf64_Word h, g;
+
+    h = 0;
+    while (*name) {
+        h = (h << 4) + (unsigned char) *name++;
+        g = h & 0xF0000000;
+        if (g) {
+            h ^= g >> 24;
+        }
+
+        h &= ~g;
+    }
+
+    return h;
+}
+
+static struct link_symbol *link_lookup(const char *name)
+{
+    return hash_lookup(&link_symtab, str_intern(name, strlen(name)));
+}
+
+static struct link_symbol *link_global(const char *name)
+{
+    String key;
+    struct link_symbol *sym;
+
+    key = str_intern(name, strlen(name));
+    sym = hash_lookup(&link_symtab, key);
+    if (!sym) {
+        sym = calloc(1, sizeof(*sym));
+        sym->name = name;
+        sym->key = key;
+        sym->is_global = 1;
+        sym->got = sym->gottp = sym->tlsgd = sym->plt = sym->pltgot = -1;
+        hash_insert(&link_symtab, key, sym, NULL);
+        array_push_back(&link_globals, sym);
+    }
+
+    return sym;
+}
+
+/*
+ * Find default version of symbol defined by shared library loaded so
+ * far, searching in command line order.
+ */
+static const Elf64_Sym *link_find_shared(
+    String key,
+    struct shared_object **shared)
+{
+    int i;
+    const Elf64_Sym *es;
+    struct shared_object *so;
+
+    for (i = 0; i < array_len(&link_libraries); ++i) {
+        so = array_get(&link_libraries, i);
+        es = hash_lookup(&so->symbols, key);
+        if (es) {
+            *shared = so;
+            return es;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Archive members are loaded to define symbols that are referenced,
+ * but not already defined by an object or a shared library.
+ */
+static int link_is_unresolved(const struct link_symbol *sym)
+{
+    struct shared_object *so;
+
+    return !sym->is_defined
+        && !sym->is_common
+        && sym->is_strong_ref
+        && !link_find_shared(sym->key, &so);
+}
+
+static int link_add_symbol(struct link_object *obj, int i)
+{
+    int bind, type;
+    const char *name;
+    const Elf64_Sym *es;
+    struct link_section *sec;
+    struct link_symbol *sym;
+
+    es = &obj->symtab[i];
+    bind = es->st_info >> 4;
+    type = es->st_info & 0xF;
+    name = obj->strtab + es->st_name;
+    sec = NULL;
+    if (es->st_shndx != SHN_UNDEF && es->st_shndx < SHN_LORESERVE) {
+        if (es->st_shndx >= obj->shnum) {
+            goto unsupported;
+        }
+
+        sec = obj->sections[es->st_shndx];
+    } else if (es->st_shndx >= SHN_LORESERVE
+        && es->st_shndx != SHN_ABS
+        && es->st_shndx != SHN_COMMON)
+    {
+        goto unsupported;
+    }
+
+    if (bind == STB_LOCAL) {
+        sym = &obj->locals[i];
+        sym->name = name;
+        sym->type = type;
+        sym->size = es->st_size;
+        sym->section = sec;
+        sym->is_defined = es->st_shndx != SHN_UNDEF;
+        sym->value = (sec || es->st_shndx == SHN_ABS) ? es->st_value : 0;
+        sym->got = sym->gottp = sym->tlsgd = sym->plt = sym->pltgot = -1;
+        obj->symbols[i] = sym;
+        return 0;
+    }
+
+    if (bind != STB_GLOBAL && bind != STB_WEAK) {
+        goto unsupported;
+    }
+
+    sym = link_global(name);
+    obj->symbols[i] = sym;
+    if (es->st_other & 0x3) {
+        sym->is_hidden = 1;
+    }
+
+    /*
+     * Definitions in discarded sections, like duplicate COMDAT groups,
+     * are treated as references.
+     */
+    if (es->st_shndx == SHN_UNDEF
+        || (es->st_shndx < SHN_LORESERVE && !sec))
+    {
+        if (bind == STB_GLOBAL) {
+            sym->is_strong_ref = 1;
+        }
+
+        if (!sym->is_defined && !sym->is_common && type != STT_NOTYPE) {
+            sym->type = type;
+        }
+
+        return 0;
+    }
+
+    if (es->st_shndx == SHN_COMMON) {
+        if (!sym->is_defined) {
+            sym->is_common = 1;
+            sym->type = STT_OBJECT;
+            if (es->st_size > sym->size) {
+                sym->size = es->st_size;
+            }
+
+            if (es->st_value > sym->align) {
+                sym->align = es->st_value;
+            }
+        }
+
+        return 0;
+    }
+
+    if (sym->is_defined) {
+        if (!sym->is_weak && bind != STB_WEAK) {
+            verbose("Multiple definitions of %s.", name);
+            return 1;
+        }
+
+        if (!sym->is_weak || bind == STB_WEAK) {
+            return 0;
+        }
+    }
+
+    sym->is_defined = 1;
+    sym->is_common = 0;
+    sym->is_weak = bind == STB_WEAK;
+    sym->section = sec;
+    sym->value = es->st_value;
+    sym->size = es->st_size;
+    sym->type = type;
+    return 0;
+
+unsupported:
+    verbose("Unsupported symbol %s in %s.", name, obj->name);
+    return 1;
+}
+
+/*
+ * Keep only the first instance of each COMDAT group, marking sections
+ * of later duplicates as discarded.
+ */
+static int link_add_group(
+    struct link_object *obj,
+    const Elf64_Shdr *shdr,
+    int i,
+    char *discard)
+{
+    int j, n;
+    String key;
+    const char *name;
+    const Elf64_Word *words;
+    const Elf64_Shdr *sh, *symtab;
+    const Elf64_Sym *es;
+
+    sh = &shdr[i];
+    words = (const Elf64_Word *) (obj->buffer + sh->sh_offset);
+    n = sh->sh_size / sizeof(Elf64_Word);
+    if (!n || !(words[0] & GRP_COMDAT)) {
+        return 0;
+    }
+
+    if (sh->sh_link >= obj->shnum) {
+        return 1;
+    }
+
+    symtab = &shdr[sh->sh_link];
+    if (sh->sh_info >= symtab->sh_size / sizeof(Elf64_Sym)
+        || symtab->sh_link >= obj->shnum)
+    {
+        return 1;
+    }
+
+    es = (const Elf64_Sym *) (obj->buffer + symtab->sh_offset) + sh->sh_info;
+    name = obj->buffer + shdr[symtab->sh_link].sh_offset + es->st_name;
+    key = str_intern(name, strlen(name));
+    if (!hash_lookup(&link_groups, key)) {
+        hash_insert(&link_groups, key, obj, NULL);
+        return 0;
+    }
+
+    discard[i] = 1;
+    for (j = 1; j < n; ++j) {
+        if (words[j] >= (Elf64_Word) obj->shnum) {
+            return 1;
+        }
+
+        discard[words[j]] = 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Include allocated sections, and debug information. Notes and other
+ * metadata are not carried over to the executable.
+ */
+static int link_keep_section(const char *name, const Elf64_Shdr *sh)
+{
+    switch (sh->sh_type) {
+    case SHT_PROGBITS:
+    case SHT_NOBITS:
+    case SHT_INIT_ARRAY:
+    case SHT_FINI_ARRAY:
+    case SHT_PREINIT_ARRAY:
+    case SHT_X86_64_UNWIND:
+        if (sh->sh_flags & SHF_EXCLUDE) {
+            return 0;
+        }
+
+        if (sh->sh_flags & SHF_ALLOC) {
+            return 1;
+        }
+
+        return !strncmp(name, ".debug_", 7);
+    default:
+        return 0;
+    }
+}
+
+static int link_add_object(const char *name, char *buffer, size_t size)
+{
+    int i, symtab;
+    char *discard;
+    const char *shstrtab;
+    const Elf64_Ehdr *ehdr;
+    const Elf64_Shdr *shdr, *sh;
+    struct link_section *sec;
+    struct link_object *obj;
+
+    ehdr = (const Elf64_Ehdr *) buffer;
+    if (size < sizeof(*ehdr)
+        || ehdr->e_ident[4] != ELFCLASS64
+        || ehdr->e_ident[5] != ELFDATA2LSB
+        || ehdr->e_type != ET_REL
+        || ehdr->e_machine != EM_X86_64
+        || ehdr->e_shentsize != sizeof(Elf64_Shdr)
+        || ehdr->e_shnum == 0
+        || ehdr->e_shoff + ehdr->e_shnum * sizeof(Elf64_Shdr) > size
+        || ehdr->e_shstrndx >= ehdr->e_shnum)
+    {
+        goto unsupported;
+    }
+
+    shdr = (const Elf64_Shdr *) (buffer + ehdr->e_shoff);
+    for (i = 0; i < ehdr->e_shnum; ++i) {
+        if (shdr[i].sh_type != SHT_NOBITS
+            && shdr[i].sh_offset + shdr[i].sh_size > size)
+        {
+            goto unsupported;
+        }
+    }
+
+    obj = calloc(1, sizeof(*obj));
+    obj->name = name;
+    obj->buffer = buffer;
+    obj->shnum = ehdr->e_shnum;
+    obj->storage = calloc(obj->shnum, sizeof(*obj->storage));
+    obj->sections = calloc(obj->shnum, sizeof(*obj->sections));
+    array_push_back(&link_objects, obj);
+    shstrtab = buffer + shdr[ehdr->e_shstrndx].sh_offset;
+    discard = calloc(obj->shnum, sizeof(*discard));
+
+    for (i = 1, symtab = 0; i < obj->shnum; ++i) {
+        sh = &shdr[i];
+        switch (sh->sh_type) {
+        case SHT_SYMTAB:
+            if (symtab) {
+                goto invalid;
+            }
+            symtab = i;
+            break;
+        case SHT_GROUP:
+            if (link_add_group(obj, shdr, i, discard)) {
+                goto invalid;
+            }
+            break;
+        case SHT_SYMTAB_SHNDX:
+            goto invalid;
+        }
+    }
+
+    for (i = 1; i < obj->shnum; ++i) {
+        sh = &shdr[i];
+        if (discard[i] || !link_keep_section(shstrtab + sh->sh_name, sh)) {
+            continue;
+        }
+
+        sec = &obj->storage[i];
+        sec->name = shstrtab + sh->sh_name;
+        sec->object = obj;
+        sec->type = sh->sh_type;
+        sec->flags = sh->sh_flags;
+        sec->size = sh->sh_size;
+        sec->align = sh->sh_addralign ? sh->sh_addralign : 1;
+        if (sh->sh_type != SHT_NOBITS) {
+            sec->data = buffer + sh->sh_offset;
+        }
+
+        obj->sections[i] = sec;
+    }
+
+    for (i = 1; i < obj->shnum; ++i) {
+        sh = &shdr[i];
+        if (sh->sh_type != SHT_RELA) {
+            continue;
+        }
+
+        if (sh->sh_info >= (Elf64_Word) obj->shnum
+            || sh->sh_link != (Elf64_Word) symtab)
+        {
+            goto invalid;
+        }
+
+        sec = obj->sections[sh->sh_info];
+        if (sec) {
+            sec->rela = (const Elf64_Rela *) (buffer + sh->sh_offset);
+            sec->relocations = sh->sh_size / sizeof(Elf64_Rela);
+        }
+    }
+
+    if (symtab) {
+        sh = &shdr[symtab];
+        if (sh->sh_link >= (Elf64_Word) obj->shnum) {
+            goto invalid;
+        }
+
+        obj->symtab = (const Elf64_Sym *) (buffer + sh->sh_offset);
+        obj->strtab = buffer + shdr[sh->sh_link].sh_offset;
+        obj->symnum = sh->sh_size / sizeof(Elf64_Sym);
+        obj->locals = calloc(obj->symnum, sizeof(*obj->locals));
+        obj->symbols = calloc(obj->symnum, sizeof(*obj->symbols));
+        for (i = 0; i < obj->symnum; ++i) {
+            if (link_add_symbol(obj, i)) {
+                free(discard);
+                return 1;
+            }
+        }
+    }
+
+    free(discard);
+    return 0;
+
+invalid:
+    free(discard);
+unsupported:
+    verbose("Unsupported object file %s.", name);
+    return 1;
+}
+
+static size_t link_read_index(const char *data, int word)
+{
+    int i;
+    size_t n;
+
+    for (i = 0, n = 0; i < word; ++i) {
+        n = (n << 8) | (unsigned char) data[i];
+    }
+
+    return n;
+}
+
+static int link_add_archive(const char *path, char *buffer, size_t size)
+{
+    int word;
+    size_t pos, len, count, i;
+    const char *hdr, *data, *name, *end;
+    struct archive_symbol as;
+    struct link_archive *ar;
+
+    ar = calloc(1, sizeof(*ar));
+    ar->path = path;
+    ar->buffer = buffer;
+    ar->size = size;
+    array_push_back(&link_archives, ar);
+    for (pos = 8; pos + 60 <= size; pos += 60 + len + (len & 1)) {
+        hdr = buffer + pos;
+        data = hdr + 60;
+        len = strtoul(hdr + 48, NULL, 10);
+        if (len > size - pos - 60) {
+            goto unsupported;
+        }
+
+        if (!strncmp(hdr, "/               ", 16)) {
+            word = 4;
+        } else if (!strncmp(hdr, "/SYM64/         ", 16)) {
+            word = 8;
+        } else if (!strncmp(hdr, "//              ", 16)) {
+            continue;
+        } else {
+            break;
+        }
+
+        count = len < (size_t) word ? 0 : link_read_index(data, word);
+        if (count > len / word - 1) {
+            goto unsupported;
+        }
+
+        name = data + word * (count + 1);
+        end = data + len;
+        for (i = 0; i < count; ++i) {
+            as.offset = link_read_index(data + word * (i + 1), word);
+            as.name = str_intern(name, strlen(name));
+            array_push_back(&ar->symbols, as);
+            name += strlen(name) + 1;
+            if (name > end) {
+                goto unsupported;
+            }
+        }
+    }
+
+    if (!array_len(&ar->symbols)) {
+        goto unsupported;
+    }
+
+    return 0;
+
+unsupported:
+    verbose("Unsupported archive %s.", path);
+    return 1;
+}
+
+static int link_load_member(struct link_archive *ar, size_t offset)
+{
+    int i;
+    size_t len;
+    char *buffer;
+    const char *hdr;
+
+    for (i = 0; i < array_len(&ar->members); ++i) {
+        if (array_get(&ar->members, i) == offset) {
+            return 0;
+        }
+    }
+
+    array_push_back(&ar->members, offset);
+    if (offset + 60 > ar->size) {
+        goto unsupported;
+    }
+
+    hdr = ar->buffer + offset;
+    len = strtoul(hdr + 48, NULL, 10);
+    if (len > ar->size - offset - 60) {
+        goto unsupported;
+    }
+
+    buffer = malloc(len + 1);
+    memcpy(buffer, hdr + 60, len);
+    array_push_back(&link_buffers, buffer);
+    return link_add_object(ar->path, buffer, len);
+
+unsupported:
+    verbose("Unsupported archive %s.", ar->path);
+    return 1;
+}
+
+/*
+ * Load archive members defining symbols that are referenced, but not
+ * yet defined. Loading a member can introduce new references, so scan
+ * until nothing more is loaded.
+ */
+static int link_scan_archive(struct link_archive *ar, int *loaded)
+{
+    int i, n;
+    struct archive_symbol as;
+    struct link_symbol *sym;
+
+    do {
+        n = array_len(&ar->members);
+        for (i = 0; i < array_len(&ar->symbols); ++i) {
+            as = array_get(&ar->symbols, i);
+            sym = hash_lookup(&link_symtab, as.name);
+            if (sym && link_is_unresolved(sym)
+                && link_load_member(ar, as.offset))
+            {
+                return 1;
+            }
+        }
+
+        n = array_len(&ar->members) - n;
+        *loaded += n;
+    } while (n);
+
+    return 0;
+}
+
+/* Scan archives in group repeatedly, until no more members are loaded. */
+static int link_scan_group(int first)
+{
+    int i, loaded;
+
+    do {
+        loaded = 0;
+        for (i = first; i < array_len(&link_archives); ++i) {
+            if (link_scan_archive(array_get(&link_archives, i), &loaded)) {
+                return 1;
+            }
+        }
+    } while (loaded && array_len(&link_archives) - first > 1);
+
+    return 0;
+}
+
+static int link_add_versions(
+    struct shared_object *so,
+    const char *buffer,
+    size_t size,
+    const Elf64_Shdr *shdr,
+    int shnum,
+    const Elf64_Shdr *sh)
+{
+    int i;
+    size_t pos;
+    const char *strtab;
+    const Elf64_Verdef *vd;
+    const Elf64_Verdaux *vda;
+
+    if (sh->sh_link >= (Elf64_Word) shnum) {
+        return 1;
+    }
+
+    strtab = buffer + shdr[sh->sh_link].sh_offset;
+    for (i = 0, pos = sh->sh_offset; i < (int) sh->sh_info; ++i) {
+        if (pos + sizeof(*vd) > size) {
+            return 1;
+        }
+
+        vd = (const Elf64_Verdef *) (buffer + pos);
+        if (pos + vd->vd_aux + sizeof(*vda) > size) {
+            return 1;
+        }
+
+        vda = (const Elf64_Verdaux *) (buffer + pos + vd->vd_aux);
+        while (array_len(&so->versions) <= (vd->vd_ndx & 0x7FFF)) {
+            array_push_back(&so->versions, (const char *) NULL);
+        }
+
+        if (!(vd->vd_flags & VER_FLG_BASE)) {
+            array_get(&so->versions, vd->vd_ndx & 0x7FFF) =
+                strtab + vda->vda_name;
+        }
+
+        pos += vd->vd_next;
+    }
+
+    return 0;
+}
+
+static int link_add_shared(
+    const char *path,
+    char *buffer,
+    size_t size,
+    int as_needed)
+{
+    int i, bind;
+    const char *name;
+    const Elf64_Ehdr *ehdr;
+    const Elf64_Shdr *shdr, *sh;
+    const Elf64_Dyn *dyn;
+    const Elf64_Sym *es;
+    struct shared_object *so;
+
+    ehdr = (const Elf64_Ehdr *) buffer;
+    if (size < sizeof(*ehdr)
+        || ehdr->e_ident[4] != ELFCLASS64
+        || ehdr->e_machine != EM_X86_64
+        || ehdr->e_shentsize != sizeof(Elf64_Shdr)
+        || ehdr->e_shoff + ehdr->e_shnum * sizeof(Elf64_Shdr) > size)
+    {
+        goto unsupported;
+    }
+
+    so = calloc(1, sizeof(*so));
+    so->path = path;
+    so->soname = path;
+    so->is_as_needed = as_needed;
+    array_push_back(&link_libraries, so);
+    shdr = (const Elf64_Shdr *) (buffer + ehdr->e_shoff);
+    for (i = 0; i < ehdr->e_shnum; ++i) {
+        sh = &shdr[i];
+        if (sh->sh_type != SHT_NOBITS && sh->sh_offset + sh->sh_size > size) {
+            goto unsupported;
+        }
+
+        switch (sh->sh_type) {
+        case SHT_DYNSYM:
+            if (sh->sh_link >= ehdr->e_shnum) {
+                goto unsupported;
+            }
+            so->dynsym = (const Elf64_Sym *) (buffer + sh->sh_offset);
+            so->symnum = sh->sh_size / sizeof(Elf64_Sym);
+            so->dynstr = buffer + shdr[sh->sh_link].sh_offset;
+            break;
+        case SHT_GNU_versym:
+            so->versym = (const Elf64_Half *) (buffer + sh->sh_offset);
+            break;
+        case SHT_GNU_verdef:
+            if (link_add_versions(so, buffer, size, shdr, ehdr->e_shnum, sh)) {
+                goto unsupported;
+            }
+            break;
+        }
+    }
+
+    if (!so->dynsym) {
+        goto unsupported;
+    }
+
+    for (i = 0; i < ehdr->e_shnum; ++i) {
+        sh = &shdr[i];
+        if (sh->sh_type != SHT_DYNAMIC || sh->sh_link >= ehdr->e_shnum) {
+            continue;
+        }
+
+        dyn = (const Elf64_Dyn *) (buffer + sh->sh_offset);
+        for (; (const char *) (dyn + 1) <= buffer + sh->sh_offset + sh->sh_size
+            && dyn->d_tag != DT_NULL; dyn++)
+        {
+            if (dyn->d_tag == DT_SONAME) {
+                so->soname =
+                    buffer + shdr[sh->sh_link].sh_offset + dyn->d_un.d_val;
+            }
+        }
+    }
+
+    for (i = 1; i < so->symnum; ++i) {
+        es = &so->dynsym[i];
+        bind = es->st_info >> 4;
+        if (es->st_shndx == SHN_UNDEF
+            || (bind != STB_GLOBAL && bind != STB_WEAK && bind != STB_GNU_UNIQUE)
+            || (so->versym && (so->versym[i] & VER_NDX_HIDDEN))
+            || (so->versym && so->versym[i] == 0))
+        {
+            continue;
+        }
+
+        name = so->dynstr + es->st_name;
+        hash_insert(&so->symbols, str_intern(name, strlen(name)), (void *) es, NULL);
+    }
+
+    return 0;
+
+unsupported:
+    verbose("Unsupported shared library %s.", path);
+    return 1;
+}
+
+static int link_add_file(const char *path, int as_needed);
+
+static int link_add_library(const char *name, int as_needed)
+{
+    int i, n;
+    char *path;
+    const char *dir;
+
+    for (i = 0; i < array_len(&link_paths); ++i) {
+        dir = array_get(&link_paths, i);
+        path = malloc(strlen(dir) + strlen(name) + 8);
+        array_push_back(&link_buffers, path);
+        for (n = link_opt.is_static; n < 2; ++n) {
+            if (name[0] == ':') {
+                sprintf(path, "%s/%s", dir, name + 1);
+            } else {
+                sprintf(path, "%s/lib%s.%s", dir, name, n ? "a" : "so");
+            }
+
+            if (!access(path, R_OK)) {
+                return link_add_file(path, as_needed);
+            }
+        }
+    }
+
+    verbose("Cannot find library %s.", name);
+    return 1;
+}
+
+/* Read next token from linker script, skipping comments. */
+static const char *link_script_token(char **pos)
+{
+    char *p, *tok;
+    size_t len;
+
+    p = *pos;
+    while (1) {
+        while (isspace((unsigned char) *p)) {
+            p++;
+        }
+
+        if (p[0] != '/' || p[1] != '*') {
+            break;
+        }
+
+        p = strstr(p + 2, "*/");
+        if (!p) {
+            return NULL;
+        }
+
+        p += 2;
+    }
+
+    switch (*p) {
+    case '\0':
+        *pos = p;
+        return NULL;
+    case '(':
+        *pos = p + 1;
+        return "(";
+    case ')':
+        *pos = p + 1;
+        return ")";
+    case ',':
+        *pos = p + 1;
+        return ",";
+    }
+
+    for (len = 0; p[len] && !isspace((unsigned char) p[len])
+        && !strchr("(),", p[len]); ++len)
+        ;
+
+    tok = malloc(len + 1);
+    memcpy(tok, p, len);
+    tok[len] = '\0';
+    array_push_back(&link_buffers, tok);
+    *pos = p + len;
+    return tok;
+}
+
+/*
+ * Linker scripts are supported only for the simple case of listing
+ * input files, like libc.so being a text file with GROUP(...).
+ */
+static int link_add_script(const char *path, char *text)
+{
+    int group, as_needed;
+    const char *tok, *cmd;
+
+    while ((cmd = link_script_token(&text)) != NULL) {
+        tok = link_script_token(&text);
+        if (!tok || strcmp(tok, "(")) {
+            goto unsupported;
+        }
+
+        if (!strcmp(cmd, "OUTPUT_FORMAT") || !strcmp(cmd, "OUTPUT_ARCH")) {
+            while ((tok = link_script_token(&text)) != NULL
+                && strcmp(tok, ")"))
+                ;
+            if (!tok) {
+                goto unsupported;
+            }
+            continue;
+        }
+
+        if (strcmp(cmd, "GROUP") && strcmp(cmd, "INPUT")) {
+            goto unsupported;
+        }
+
+        group = array_len(&link_archives);
+        as_needed = 0;
+        while ((tok = link_script_token(&text)) != NULL) {
+            if (!strcmp(tok, ")")) {
+                if (!as_needed) {
+                    break;
+                }
+                as_needed = 0;
+            } else if (!strcmp(tok, "AS_NEEDED")) {
+                tok = link_script_token(&text);
+                if (!tok || strcmp(tok, "(")) {
+                    goto unsupported;
+                }
+                as_needed = 1;
+            } else if (!strcmp(tok, ",")) {
+                continue;
+            } else if (!strncmp(tok, "-l", 2)) {
+                if (link_add_library(tok + 2, as_needed || link_opt.is_as_needed)) {
+                    return 1;
+                }
+            } else if (link_add_file(tok, as_needed || link_opt.is_as_needed)) {
+                return 1;
+            }
+        }
+
+        if (!tok) {
+            goto unsupported;
+        }
+
+        if (!strcmp(cmd, "GROUP") && link_scan_group(group)) {
+            return 1;
+        }
+    }
+
+    return 0;
+
+unsupported:
+    verbose("Unsupported linker script %s.", path);
+    return 1;
+}
+
+/*
+ * Determine type of input file by looking at the contents; object,
+ * shared library, archive, or linker script.
+ */
+static int link_add_file(const char *path, int as_needed)
+{
+    int loaded;
+    size_t size;
+    char *buffer;
+
+    buffer = link_read_file(path, &size);
+    if (!buffer) {
+        verbose("Cannot read %s.", path);
+        return 1;
+    }
+
+    if (size >= sizeof(Elf64_Ehdr) && !memcmp(buffer, "\177ELF", 4)) {
+        if (((const Elf64_Ehdr *) buffer)->e_type == ET_DYN) {
+            if (link_opt.is_static) {
+                verbose("Cannot link %s statically.", path);
+                return 1;
+            }
+
+            return link_add_shared(path, buffer, size, as_needed);
+        }
+
+        return link_add_object(path, buffer, size);
+    }
+
+    if (size >= 8 && !memcmp(buffer, "!<arch>\n", 8)) {
+        loaded = 0;
+        return link_add_archive(path, buffer, size)
+            || link_scan_archive(array_back(&link_archives), &loaded);
+    }
+
+    return link_add_script(path, buffer);
+}
+
+static int link_parse_arguments(int argc, char **argv)
+{
+    int i, group;
+    const char *arg;
+
+    link_opt.output = "a.out";
+    link_opt.entry = "_start";
+    for (i = 1; i < argc; ++i) {
+        arg = argv[i];
+        if (!strcmp(arg, "-static")) {
+            link_opt.is_static = 1;
+        } else if (!strcmp(arg, "-L") && i + 1 < argc) {
+            array_push_back(&link_paths, argv[++i]);
+        } else if (!strncmp(arg, "-L", 2)) {
+            array_push_back(&link_paths, arg + 2);
+        }
+    }
+
+    for (i = 1, group = -1; i < argc; ++i) {
+        arg = argv[i];
+        if (arg[0] != '-') {
+            if (link_add_file(arg, link_opt.is_as_needed)) {
+                return 1;
+            }
+        } else if (!strcmp(arg, "-L")) {
+            i++;
+        } else if (!strncmp(arg, "-L", 2)
+            || !strcmp(arg, "-static")
+            || !strcmp(arg, "-no-pie")
+            || !strcmp(arg, "-fno-PIE"))
+        {
+            continue;
+        } else if (!strcmp(arg, "-o") && i + 1 < argc) {
+            link_opt.output = argv[++i];
+        } else if (!strcmp(arg, "-e") && i + 1 < argc) {
+            link_opt.entry = argv[++i];
+        } else if (!strcmp(arg, "-dynamic-linker") && i + 1 < argc) {
+            link_opt.interp = argv[++i];
+        } else if (!strcmp(arg, "-l") && i + 1 < argc) {
+            if (link_add_library(argv[++i], link_opt.is_as_needed)) {
+                return 1;
+            }
+        } else if (!strncmp(arg, "-l", 2)) {
+            if (link_add_library(arg + 2, link_opt.is_as_needed)) {
+                return 1;
+            }
+        } else if (!strcmp(arg, "-export-dynamic")
+            || !strcmp(arg, "--export-dynamic")
+            || !strcmp(arg, "-E"))
+        {
+            link_opt.export_dynamic = 1;
+        } else if (!strcmp(arg, "--as-needed")) {
+            link_opt.is_as_needed = 1;
+        } else if (!strcmp(arg, "--no-as-needed")) {
+            link_opt.is_as_needed = 0;
+        } else if (!strcmp(arg, "--start-group") && group < 0) {
+            group = array_len(&link_archives);
+        } else if (!strcmp(arg, "--end-group") && group >= 0) {
+            if (link_scan_group(group)) {
+                return 1;
+            }
+            group = -1;
+        } else {
+            verbose("Unsupported linker option %s.", arg);
+            return 1;
+        }
+    }
+
+    if (!link_opt.is_static && !link_opt.interp) {
+        verbose("Missing dynamic linker.");
+        return 1;
+    }
+
+    return 0;
+}
+
+static struct output_section *link_find_output(const char *name)
+{
+    int i;
+    struct output_section *out;
+
+    for (i = 0; i < array_len(&link_outputs); ++i) {
+        out = array_get(&link_outputs, i);
+        if (!strcmp(out->name, name)) {
+            return out;
+        }
+    }
+
+    return NULL;
+}
+
+static struct output_section *link_output(
+    const char *name,
+    Elf64_Word type,
+    Elf64_Xword flags,
+    enum link_rank rank)
+{
+    struct output_section *out;
+
+    out = link_find_output(name);
+    if (!out) {
+        out = calloc(1, sizeof(*out));
+        out->name = name;
+        out->type = type;
+        out->flags = flags;
+        out->rank = rank;
+        out->align = 1;
+        array_push_back(&link_outputs, out);
+    } else if (out->type == SHT_NOBITS && type != SHT_NOBITS) {
+        out->type = type;
+        if (out->rank == RANK_BSS_OTHER) {
+            out->rank = RANK_DATA_OTHER;
+        }
+    }
+
+    out->flags |= flags;
+    return out;
+}
+
+static int link_has_prefix(const char *name, const char *prefix)
+{
+    size_t len;
+
+    len = strlen(prefix);
+    return !strncmp(name, prefix, len)
+        && (name[len] == '\0' || name[len] == '.');
+}
+
+/*
+ * Map input section to output section. Sections of the same kind are
+ * merged, for example .text.foo becomes part of .text, and otherwise
+ * keep their name.
+ */
+static void link_map_section(struct link_section *sec)
+{
+    const char *name;
+    Elf64_Word type;
+    Elf64_Xword flags;
+    enum link_rank rank;
+    struct output_section *out;
+
+    name = sec->name;
+    type = sec->type == SHT_X86_64_UNWIND ? SHT_PROGBITS : sec->type;
+    flags = sec->flags & (SHF_WRITE | SHF_ALLOC | SHF_EXECINSTR | SHF_TLS);
+    if (!(flags & SHF_ALLOC)) {
+        rank = RANK_NONALLOC;
+    } else if (flags & SHF_TLS) {
+        if (type == SHT_NOBITS) {
+            name = ".tbss";
+            rank = RANK_TBSS;
+        } else {
+            name = ".tdata";
+            rank = RANK_TDATA;
+        }
+    } else if (type == SHT_PREINIT_ARRAY
+        || link_has_prefix(name, ".preinit_array"))
+    {
+        name = ".preinit_array";
+        rank = RANK_PREINIT_ARRAY;
+        type = SHT_PREINIT_ARRAY;
+    } else if (type == SHT_INIT_ARRAY || link_has_prefix(name, ".init_array")) {
+        name = ".init_array";
+        rank = RANK_INIT_ARRAY;
+        type = SHT_INIT_ARRAY;
+    } else if (type == SHT_FINI_ARRAY || link_has_prefix(name, ".fini_array")) {
+        name = ".fini_array";
+        rank = RANK_FINI_ARRAY;
+        type = SHT_FINI_ARRAY;
+    } else if (type == SHT_NOBITS) {
+        if (link_has_prefix(name, ".bss")) {
+            name = ".bss";
+            rank = RANK_BSS;
+        } else {
+            rank = RANK_BSS_OTHER;
+        }
+    } else if (flags & SHF_EXECINSTR) {
+        if (!strcmp(name, ".init")) {
+            rank = RANK_INIT;
+        } else if (!strcmp(name, ".fini")) {
+            rank = RANK_FINI;
+        } else if (link_has_prefix(name, ".text")) {
+            name = ".text";
+            rank = RANK_TEXT;
+        } else {
+            rank = RANK_TEXT_OTHER;
+        }
+    } else if (flags & SHF_WRITE) {
+        if (link_has_prefix(name, ".data.rel.ro")) {
+            name = ".data.rel.ro";
+            rank = RANK_DATA_REL_RO;
+        } else if (link_has_prefix(name, ".data")) {
+            name = ".data";
+            rank = RANK_DATA;
+        } else {
+            rank = RANK_DATA_OTHER;
+        }
+    } else if (link_has_prefix(name, ".rodata")) {
+        name = ".rodata";
+        rank = RANK_RODATA;
+    } else if (!strcmp(name, ".eh_frame")) {
+        rank = RANK_EH_FRAME;
+    } else if (link_has_prefix(name, ".gcc_except_table")) {
+        name = ".gcc_except_table";
+        rank = RANK_EXCEPT_TABLE;
+    } else {
+        rank = RANK_RODATA_OTHER;
+    }
+
+    out = link_output(name, type, flags, rank);
+    if (sec->align > out->align) {
+        out->align = sec->align;
+    }
+
+    sec->output = out;
+    array_push_back(&out->inputs, sec);
+}
+
+static void link_create_outputs(void)
+{
+    int i, j;
+    struct link_object *obj;
+    struct link_section *sec;
+
+    for (i = 0; i < array_len(&link_objects); ++i) {
+        obj = array_get(&link_objects, i);
+        for (j = 1; j < obj->shnum; ++j) {
+            sec = obj->sections[j];
+            if (sec) {
+                link_map_section(sec);
+            }
+        }
+    }
+
+    link_synthetic.got = link_output(".got",
+        SHT_PROGBITS, SHF_ALLOC | SHF_WRITE, RANK_GOT);
+    link_synthetic.plt = link_output(".plt",
+        SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, RANK_PLT);
+    link_synthetic.got->align = 8;
+    link_synthetic.got->entsize = 8;
+    link_synthetic.plt->align = 16;
+    link_synthetic.plt->entsize = LINK_PLT_ENTRY_SIZE;
+    if (link_opt.is_static) {
+        link_synthetic.rela = link_output(".rela.iplt",
+            SHT_RELA, SHF_ALLOC, RANK_RELA);
+    } else {
+        link_synthetic.interp = link_output(".interp",
+            SHT_PROGBITS, SHF_ALLOC, RANK_INTERP);
+        link_synthetic.hash = link_output(".hash",
+            SHT_HASH, SHF_ALLOC, RANK_HASH);
+        link_synthetic.dynsym = link_output(".dynsym",
+            SHT_DYNSYM, SHF_ALLOC, RANK_DYNSYM);
+        link_synthetic.dynstr = link_output(".dynstr",
+            SHT_STRTAB, SHF_ALLOC, RANK_DYNSTR);
+        link_synthetic.versym = link_output(".gnu.version",
+            SHT_GNU_versym, SHF_ALLOC, RANK_VERSYM);
+        link_synthetic.verneed = link_output(".gnu.version_r",
+            SHT_GNU_verneed, SHF_ALLOC, RANK_VERNEED);
+        link_synthetic.rela = link_output(".rela.dyn",
+            SHT_RELA, SHF_ALLOC, RANK_RELA);
+        link_synthetic.dynamic = link_output(".dynamic",
+            SHT_DYNAMIC, SHF_ALLOC | SHF_WRITE, RANK_DYNAMIC);
+        link_synthetic.hash->align = 8;
+        link_synthetic.hash->entsize = 4;
+        link_synthetic.hash->link = link_synthetic.dynsym;
+        link_synthetic.dynsym->align = 8;
+        link_synthetic.dynsym->entsize = sizeof(Elf64_Sym);
+        link_synthetic.dynsym->link = link_synthetic.dynstr;
+        link_synthetic.dynsym->info = 1;
+        link_synthetic.versym->align = 2;
+        link_synthetic.versym->entsize = 2;
+        link_synthetic.versym->link = link_synthetic.dynsym;
+        link_synthetic.verneed->align = 8;
+        link_synthetic.verneed->link = link_synthetic.dynstr;
+        link_synthetic.rela->link = link_synthetic.dynsym;
+        link_synthetic.dynamic->align = 8;
+        link_synthetic.dynamic->entsize = sizeof(Elf64_Dyn);
+        link_synthetic.dynamic->link = link_synthetic.dynstr;
+    }
+
+    link_synthetic.rela->align = 8;
+    link_synthetic.rela->entsize = sizeof(Elf64_Rela);
+}
+
+/*
+ * Define symbol if it is referenced, but not defined by any object.
+ * The value is computed after layout.
+ */
+static struct link_symbol *link_provide(
+    const char *name,
+    struct output_section *out,
+    enum provide_kind kind)
+{
+    struct link_symbol *sym;
+    struct link_provide provide;
+
+    sym = link_lookup(name);
+    if (!sym || sym->is_defined || sym->is_common) {
+        return NULL;
+    }
+
+    sym->is_defined = 1;
+    sym->is_hidden = 1;
+    provide.sym = sym;
+    provide.output = out;
+    provide.kind = kind;
+    array_push_back(&link_provides, provide);
+    return sym;
+}
+
+static void link_provide_array(
+    const char *section,
+    Elf64_Word type,
+    enum link_rank rank,
+    const char *start,
+    const char *end)
+{
+    struct output_section *out;
+
+    if (link_lookup(start) || link_lookup(end)) {
+        out = link_output(section, type, SHF_ALLOC | SHF_WRITE, rank);
+        if (out->align < 8) {
+            out->align = 8;
+        }
+        link_provide(start, out, PROVIDE_START);
+        link_provide(end, out, PROVIDE_END);
+    }
+}
+
+static int link_is_identifier(const char *name)
+{
+    if (isdigit((unsigned char) *name)) {
+        return 0;
+    }
+
+    while (*name) {
+        if (!isalnum((unsigned char) *name) && *name != '_') {
+            return 0;
+        }
+        name++;
+    }
+
+    return 1;
+}
+
+/*
+ * Define symbols normally provided by the default linker script, and
+ * __start_ and __stop_ symbols for sections named like identifiers.
+ */
+static void link_define_symbols(void)
+{
+    int i;
+    char name[128];
+    struct link_symbol *sym;
+    struct output_section *out;
+
+    link_provide("__ehdr_start", NULL, PROVIDE_BASE);
+    link_provide("__executable_start", NULL, PROVIDE_BASE);
+    link_provide("etext", NULL, PROVIDE_ETEXT);
+    link_provide("_etext", NULL, PROVIDE_ETEXT);
+    link_provide("__etext", NULL, PROVIDE_ETEXT);
+    link_provide("edata", NULL, PROVIDE_EDATA);
+    link_provide("_edata", NULL, PROVIDE_EDATA);
+    link_provide("__bss_start", NULL, PROVIDE_EDATA);
+    link_provide("end", NULL, PROVIDE_END_OF_IMAGE);
+    link_provide("_end", NULL, PROVIDE_END_OF_IMAGE);
+    link_provide("_GLOBAL_OFFSET_TABLE_", link_synthetic.got, PROVIDE_START);
+    link_provide_array(".preinit_array", SHT_PREINIT_ARRAY, RANK_PREINIT_ARRAY,
+        "__preinit_array_start", "__preinit_array_end");
+    link_provide_array(".init_array", SHT_INIT_ARRAY, RANK_INIT_ARRAY,
+        "__init_array_start", "__init_array_end");
+    link_provide_array(".fini_array", SHT_FINI_ARRAY, RANK_FINI_ARRAY,
+        "__fini_array_start", "__fini_array_end");
+    if (link_opt.is_static) {
+        link_provide("__rela_iplt_start", link_synthetic.rela, PROVIDE_START);
+        link_provide("__rela_iplt_end", link_synthetic.rela, PROVIDE_END);
+        sym = link_lookup("__tls_get_addr");
+        if (sym && !sym->is_defined) {
+            link_tls_stub.name = ".text";
+            link_tls_stub.data = link_tls_get_addr;
+            link_tls_stub.type = SHT_PROGBITS;
+            link_tls_stub.flags = SHF_ALLOC | SHF_EXECINSTR;
+            link_tls_stub.size = sizeof(link_tls_get_addr);
+            link_tls_stub.align = 16;
+            link_map_section(&link_tls_stub);
+            sym->is_defined = 1;
+            sym->section = &link_tls_stub;
+            sym->type = STT_FUNC;
+        }
+    } else {
+        link_provide("_DYNAMIC", link_synthetic.dynamic, PROVIDE_START);
+        link_provide("__rela_iplt_start", NULL, PROVIDE_ZERO);
+        link_provide("__rela_iplt_end", NULL, PROVIDE_ZERO);
+    }
+
+    sym = link_lookup("__dso_handle");
+    if (sym && !sym->is_defined && !sym->is_common) {
+        sym->is_common = 1;
+        sym->is_hidden = 1;
+        sym->type = STT_OBJECT;
+        sym->size = 8;
+        sym->align = 8;
+    }
+
+    for (i = 0; i < array_len(&link_outputs); ++i) {
+        out = array_get(&link_outputs, i);
+        if (link_is_identifier(out->name) && strlen(out->name) < 100) {
+            sprintf(name, "__start_%s", out->name);
+            link_provide(name, out, PROVIDE_START);
+            sprintf(name, "__stop_%s", out->name);
+            link_provide(name, out, PROVIDE_END);
+        }
+    }
+}
+
+/* Bind remaining undefined symbols to shared library definitions. */
+static void link_resolve_shared(void)
+{
+    int i;
+    const Elf64_Sym *es;
+    struct link_symbol *sym;
+    struct shared_object *so;
+
+    for (i = 0; i < array_len(&link_globals); ++i) {
+        sym = array_get(&link_globals, i);
+        if (sym->is_defined || sym->is_common) {
+            continue;
+        }
+
+        es = link_find_shared(sym->key, &so);
+        if (es) {
+            sym->shared = so;
+            sym->dynamic = es;
+            sym->type = es->st_info & 0xF;
+            sym->size = es->st_size;
+            so->is_needed = 1;
+        }
+    }
+}
+
+static int link_is_imported(const struct link_symbol *sym)
+{
+    return sym->shared && !sym->section;
+}
+
+static Elf64_Addr link_definition_address(const struct link_symbol *sym)
+{
+    if (sym->section) {
+        return sym->section->output->addr + sym->section->offset + sym->value;
+    }
+
+    return sym->value;
+}
+
+static Elf64_Addr link_symbol_address(const struct link_symbol *sym)
+{
+    if (sym->plt >= 0
+        && (sym->type == STT_GNU_IFUNC || link_is_imported(sym)))
+    {
+        return link_synthetic.plt->addr + sym->plt * LINK_PLT_ENTRY_SIZE;
+    }
+
+    return link_definition_address(sym);
+}
+
+/* Offset from thread pointer, for the initial TLS block. */
+static Elf64_Addr link_tpoff(const struct link_symbol *sym)
+{
+    return link_definition_address(sym) - link_tls.p_vaddr - link_tls.p_memsz;
+}
+
+/* Value written to symbol tables, relative to TLS segment for TLS. */
+static Elf64_Addr link_symbol_value(const struct link_symbol *sym)
+{
+    if (sym->type == STT_TLS) {
+        return link_definition_address(sym) - link_tls.p_vaddr;
+    }
+
+    return link_symbol_address(sym);
+}
+
+static void link_add_got(struct link_symbol *sym, int *slot, enum got_kind kind)
+{
+    struct got_entry entry;
+
+    if (*slot < 0) {
+        *slot = array_len(&link_got);
+        entry.sym = sym;
+        entry.kind = kind;
+        array_push_back(&link_got, entry);
+        if (kind == GOT_TLS_MODULE) {
+            entry.kind = GOT_TLS_OFFSET;
+            array_push_back(&link_got, entry);
+        }
+    }
+}
+
+static void link_add_plt(struct link_symbol *sym)
+{
+    if (sym->plt < 0) {
+        sym->plt = array_len(&link_plt);
+        array_push_back(&link_plt, sym);
+        link_add_got(sym, &sym->pltgot, GOT_PLT);
+    }
+}
+
+/*
+ * Absolute references to imported functions resolve to the PLT entry,
+ * which becomes the canonical address of the function. Imported data
+ * is copied into the executable.
+ */
+static int link_direct_reference(struct link_symbol *sym)
+{
+    if (sym->type == STT_GNU_IFUNC) {
+        link_add_plt(sym);
+        sym->is_canonical = 1;
+    } else if (sym->shared) {
+        if (sym->type == STT_FUNC) {
+            link_add_plt(sym);
+            sym->is_canonical = 1;
+        } else if (sym->type == STT_TLS) {
+            verbose("Invalid reference to thread local %s.", sym->name);
+            return 1;
+        } else if (!sym->is_copied) {
+            sym->is_copied = 1;
+            array_push_back(&link_copies, sym);
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Go through all relocations, determining which symbols need GOT and
+ * PLT entries.
+ */
+static int link_scan_relocations(void)
+{
+    int i, j, type;
+    size_t k;
+    const Elf64_Rela *rel;
+    struct link_object *obj;
+    struct link_section *sec;
+    struct link_symbol *sym;
+
+    for (i = 0; i < array_len(&link_objects); ++i) {
+        obj = array_get(&link_objects, i);
+        for (j = 1; j < obj->shnum; ++j) {
+            sec = obj->sections[j];
+            if (!sec || !sec->relocations) {
+                continue;
+            }
+
+            if (sec->type == SHT_NOBITS) {
+                goto unsupported;
+            }
+
+            for (k = 0; k < sec->relocations; ++k) {
+                rel = &sec->rela[k];
+                type = ELF64_R_TYPE(rel->r_info);
+                if (ELF64_R_SYM(rel->r_info) >= (Elf64_Xword) obj->symnum) {
+                    goto unsupported;
+                }
+
+                sym = obj->symbols[ELF64_R_SYM(rel->r_info)];
+                if (!(sec->flags & SHF_ALLOC)) {
+                    if (type != R_X86_64_NONE
+                        && type != R_X86_64_64
+                        && type != R_X86_64_32)
+                    {
+                        goto unsupported;
+                    }
+                    continue;
+                }
+
+                if (sym->is_global && !sym->is_defined && !sym->is_common
+                    && !sym->shared && sym->is_strong_ref)
+                {
+                    verbose("Undefined reference to %s.", sym->name);
+                    return 1;
+                }
+
+                switch (type) {
+                case R_X86_64_NONE:
+                    break;
+                case R_X86_64_64:
+                case R_X86_64_PC64:
+                case R_X86_64_PC32:
+                case R_X86_64_32:
+                case R_X86_64_32S:
+                    if (link_direct_reference(sym)) {
+                        return 1;
+                    }
+                    break;
+                case R_X86_64_PLT32:
+                    if (sym->shared || sym->type == STT_GNU_IFUNC) {
+                        link_add_plt(sym);
+                    }
+                    break;
+                case R_X86_64_GOTPCREL:
+                case R_X86_64_GOTPCRELX:
+                case R_X86_64_REX_GOTPCRELX:
+                    link_add_got(sym, &sym->got, GOT_ADDRESS);
+                    break;
+                case R_X86_64_GOTTPOFF:
+                    link_add_got(sym, &sym->gottp, GOT_TPOFF);
+                    break;
+                case R_X86_64_TLSGD:
+                    link_add_got(sym, &sym->tlsgd, GOT_TLS_MODULE);
+                    break;
+                case R_X86_64_TPOFF32:
+                    if (sym->shared) {
+                        goto unsupported;
+                    }
+                    break;
+                default:
+                    goto unsupported;
+                }
+            }
+        }
+    }
+
+    return 0;
+
+unsupported:
+    verbose("Unsupported relocation in %s.", obj->name);
+    return 1;
+}
+
+static void link_allocate_common(struct link_symbol *sym, Elf64_Xword align)
+{
+    link_common.size = LINK_ALIGN(link_common.size, align);
+    if (align > link_common.align) {
+        link_common.align = align;
+    }
+
+    sym->section = &link_common;
+    sym->value = link_common.size;
+    link_common.size += sym->size;
+}
+
+/*
+ * Allocate space in .bss for common symbols, and for imported data
+ * referenced directly. Other names for the same imported object are
+ * defined at the copy, and exported.
+ */
+static void link_allocate_commons(void)
+{
+    int i, j;
+    const char *name;
+    const Elf64_Sym *es;
+    Elf64_Xword align;
+    struct link_symbol *sym, *alias;
+    struct shared_object *so;
+
+    link_common.name = ".bss";
+    link_common.type = SHT_NOBITS;
+    link_common.flags = SHF_ALLOC | SHF_WRITE;
+    link_common.align = 1;
+    for (i = 0; i < array_len(&link_globals); ++i) {
+        sym = array_get(&link_globals, i);
+        if (sym->is_common && !sym->is_defined) {
+            link_allocate_common(sym, sym->align ? sym->align : 1);
+            sym->is_defined = 1;
+        }
+    }
+
+    for (i = 0; i < array_len(&link_copies); ++i) {
+        sym = array_get(&link_copies, i);
+        for (align = 1; align < 32 && !(sym->dynamic->st_value & align);)
+            align <<= 1;
+
+        link_allocate_common(sym, align);
+        so = sym->shared;
+        for (j = 1; j < so->symnum; ++j) {
+            es = &so->dynsym[j];
+            if (es == sym->dynamic
+                || es->st_value != sym->dynamic->st_value
+                || es->st_shndx == SHN_UNDEF
+                || (es->st_info & 0xF) != STT_OBJECT)
+            {
+                continue;
+            }
+
+            name = so->dynstr + es->st_name;
+            if (hash_lookup(&so->symbols, str_intern(name, strlen(name))) != es) {
+                continue;
+            }
+
+            alias = link_global(name);
+            if (!alias->is_defined && !alias->is_common && !alias->section) {
+                alias->shared = NULL;
+                alias->is_defined = 1;
+                alias->is_exported = 1;
+                alias->section = &link_common;
+                alias->value = sym->value;
+                alias->size = sym->size;
+                alias->type = STT_OBJECT;
+            }
+        }
+    }
+
+    if (link_common.size) {
+        link_map_section(&link_common);
+    }
+}
+
+static int link_needs_relocation(const struct got_entry *entry)
+{
+    if (link_is_imported(entry->sym)) {
+        return 1;
+    }
+
+    return (entry->kind == GOT_ADDRESS || entry->kind == GOT_PLT)
+        && entry->sym->type == STT_GNU_IFUNC;
+}
+
+static Elf64_Word link_add_dynstr(const char *str)
+{
+    Elf64_Word offset;
+
+    offset = array_len(&link_dynstr);
+    do {
+        array_push_back(&link_dynstr, *str);
+    } while (*str++);
+
+    return offset;
+}
+
+static int link_is_needed(const struct shared_object *so)
+{
+    return so->is_needed || !so->is_as_needed;
+}
+
+static Elf64_Half link_add_version(struct link_symbol *sym)
+{
+    int i;
+    Elf64_Half ndx;
+    struct link_version ver;
+
+    ndx = 0;
+    if (sym->shared->versym) {
+        ndx = sym->shared->versym[sym->dynamic - sym->shared->dynsym] & 0x7FFF;
+    }
+
+    if (ndx < 2
+        || ndx >= array_len(&sym->shared->versions)
+        || !array_get(&sym->shared->versions, ndx))
+    {
+        return VER_NDX_GLOBAL;
+    }
+
+    ver.shared = sym->shared;
+    ver.name = array_get(&sym->shared->versions, ndx);
+    for (i = 0; i < array_len(&link_versions); ++i) {
+        if (array_get(&link_versions, i).shared == ver.shared
+            && !strcmp(array_get(&link_versions, i).name, ver.name))
+        {
+            return array_get(&link_versions, i).index;
+        }
+    }
+
+    ver.index = array_len(&link_versions) + 2;
+    ver.dynname = link_add_dynstr(ver.name);
+    array_push_back(&link_versions, ver);
+    return ver.index;
+}
+
+static int link_dynamic_entry(
+    Elf64_Dyn *dyn,
+    int i,
+    Elf64_Sxword tag,
+    Elf64_Xword val)
+{
+    if (dyn) {
+        dyn[i].d_tag = tag;
+        dyn[i].d_un.d_val = val;
+    }
+
+    return i + 1;
+}
+
+/*
+ * Write entries in .dynamic section, or only count them if the buffer
+ * is NULL.
+ */
+static int link_dynamic_entries(Elf64_Dyn *dyn)
+{
+    int i, n;
+    struct link_symbol *sym;
+    struct shared_object *so;
+    struct output_section *out;
+    static const struct {
+        const char *name;
+        Elf64_Sxword tag, size;
+    } arrays[] = {
+        {".preinit_array", DT_PREINIT_ARRAY, DT_PREINIT_ARRAYSZ},
+        {".init_array", DT_INIT_ARRAY, DT_INIT_ARRAYSZ},
+        {".fini_array", DT_FINI_ARRAY, DT_FINI_ARRAYSZ}
+    };
+
+    for (i = 0, n = 0; i < array_len(&link_libraries); ++i) {
+        so = array_get(&link_libraries, i);
+        if (link_is_needed(so)) {
+            n = link_dynamic_entry(dyn, n, DT_NEEDED, so->dynname);
+        }
+    }
+
+    sym = link_lookup("_init");
+    if (sym && sym->is_defined) {
+        n = link_dynamic_entry(dyn, n, DT_INIT, link_symbol_address(sym));
+    }
+
+    sym = link_lookup("_fini");
+    if (sym && sym->is_defined) {
+        n = link_dynamic_entry(dyn, n, DT_FINI, link_symbol_address(sym));
+    }
+
+    for (i = 0; i < (int) (sizeof(arrays) / sizeof(arrays[0])); ++i) {
+        out = link_find_output(arrays[i].name);
+        if (out) {
+            n = link_dynamic_entry(dyn, n, arrays[i].tag, out->addr);
+            n = link_dynamic_entry(dyn, n, arrays[i].size, out->size);
+        }
+    }
+
+    n = link_dynamic_entry(dyn, n, DT_HASH, link_synthetic.hash->addr);
+    n = link_dynamic_entry(dyn, n, DT_STRTAB, link_synthetic.dynstr->addr);
+    n = link_dynamic_entry(dyn, n, DT_SYMTAB, link_synthetic.dynsym->addr);
+    n = link_dynamic_entry(dyn, n, DT_STRSZ, link_synthetic.dynstr->size);
+    n = link_dynamic_entry(dyn, n, DT_SYMENT, sizeof(Elf64_Sym));
+    if (link_relocation_count) {
+        n = link_dynamic_entry(dyn, n, DT_RELA, link_synthetic.rela->addr);
+        n = link_dynamic_entry(dyn, n, DT_RELASZ, link_synthetic.rela->size);
+        n = link_dynamic_entry(dyn, n, DT_RELAENT, sizeof(Elf64_Rela));
+    }
+
+    if (array_len(&link_versions)) {
+        n = link_dynamic_entry(dyn, n, DT_VERSYM, link_synthetic.versym->addr);
+        n = link_dynamic_entry(dyn, n, DT_VERNEED, link_synthetic.verneed->addr);
+        n = link_dynamic_entry(dyn, n, DT_VERNEEDNUM, link_synthetic.verneed->info);
+    }
+
+    n = link_dynamic_entry(dyn, n, DT_DEBUG, 0);
+    n = link_dynamic_entry(dyn, n, DT_NULL, 0);
+    return n;
+}
+
+/*
+ * Build dynamic symbol table with imported symbols, and symbols that
+ * are referenced or interposed by shared libraries.
+ */
+static void link_allocate_dynamic(void)
+{
+    int i, j, libs;
+    const char *name;
+    const Elf64_Sym *es;
+    struct link_symbol *sym;
+    struct shared_object *so;
+    struct link_version *ver;
+
+    link_add_dynstr("");
+    for (i = 0; i < array_len(&link_libraries); ++i) {
+        so = array_get(&link_libraries, i);
+        if (!link_is_needed(so)) {
+            continue;
+        }
+
+        so->dynname = link_add_dynstr(so->soname);
+        for (j = 1; j < so->symnum; ++j) {
+            es = &so->dynsym[j];
+            name = so->dynstr + es->st_name;
+            sym = hash_lookup(&link_symtab, str_intern(name, strlen(name)));
+            if (sym && sym->is_defined && !sym->is_hidden) {
+                sym->is_exported = 1;
+            }
+        }
+    }
+
+    array_push_back(&link_dynsyms, (struct link_symbol *) NULL);
+    for (i = 0; i < array_len(&link_globals); ++i) {
+        sym = array_get(&link_globals, i);
+        if (link_opt.export_dynamic && sym->is_defined && !sym->is_hidden) {
+            sym->is_exported = 1;
+        }
+
+        if (sym->is_exported
+            || sym->is_copied
+            || (link_is_imported(sym) && (sym->plt >= 0 || sym->got >= 0
+                || sym->gottp >= 0 || sym->tlsgd >= 0)))
+        {
+            sym->dynsym = array_len(&link_dynsyms);
+            sym->dynname = link_add_dynstr(sym->name);
+            sym->version = sym->shared
+                ? link_add_version(sym)
+                : VER_NDX_GLOBAL;
+            array_push_back(&link_dynsyms, sym);
+        }
+    }
+
+    for (i = 0; i < array_len(&link_got); ++i) {
+        link_relocation_count += link_needs_relocation(&array_get(&link_got, i));
+    }
+
+    link_relocation_count += array_len(&link_copies);
+    libs = 0;
+    for (i = 0; i < array_len(&link_versions); ++i) {
+        ver = &array_get(&link_versions, i);
+        for (j = 0; j < i; ++j) {
+            if (array_get(&link_versions, j).shared == ver->shared)
+                break;
+        }
+
+        libs += j == i;
+    }
+
+    link_synthetic.interp->size = strlen(link_opt.interp) + 1;
+    link_synthetic.dynsym->size = array_len(&link_dynsyms) * sizeof(Elf64_Sym);
+    link_synthetic.hash->size =
+        (2 + array_len(&link_dynsyms) / 2 + 1 + array_len(&link_dynsyms)) * 4;
+    link_synthetic.dynstr->size = array_len(&link_dynstr);
+    if (array_len(&link_versions)) {
+        link_synthetic.versym->size = array_len(&link_dynsyms) * 2;
+        link_synthetic.verneed->info = libs;
+        link_synthetic.verneed->size = libs * sizeof(Elf64_Verneed)
+            + array_len(&link_versions) * sizeof(Elf64_Vernaux);
+    }
+
+    link_synthetic.dynamic->size =
+        link_dynamic_entries(NULL) * sizeof(Elf64_Dyn);
+}
+
+static void link_allocate(void)
+{
+    int i;
+
+    link_allocate_commons();
+    if (link_opt.is_static) {
+        for (i = 0; i < array_len(&link_got); ++i) {
+            link_relocation_count +=
+                link_needs_relocation(&array_get(&link_got, i));
+        }
+    } else {
+        link_allocate_dynamic();
+    }
+
+    link_synthetic.got->size = array_len(&link_got) * 8;
+    link_synthetic.plt->size = array_len(&link_plt) * LINK_PLT_ENTRY_SIZE;
+    link_synthetic.rela->size = link_relocation_count * sizeof(Elf64_Rela);
+}
+
+static void link_sort_outputs(void)
+{
+    int i, j;
+    struct output_section *out;
+
+    for (i = 1; i < array_len(&link_outputs); ++i) {
+        out = array_get(&link_outputs, i);
+        for (j = i; j > 0 && array_get(&link_outputs, j - 1)->rank > out->rank; --j) {
+            array_get(&link_outputs, j) = array_get(&link_outputs, j - 1);
+        }
+
+        array_get(&link_outputs, j) = out;
+    }
+}
+
+/*
+ * Assign addresses to output sections, and offsets to all input
+ * sections. Segments are read only, executable, and writable, in that
+ * order.
+ */
+static int link_layout(void)
+{
+    int i, j, seg;
+    Elf64_Off offset;
+    Elf64_Addr addr;
+    Elf64_Phdr *ph;
+    struct link_provide *p;
+    struct link_section *sec;
+    struct output_section *out, *tls;
+
+    tls = NULL;
+    link_tls.p_align = 1;
+    for (i = 0; i < array_len(&link_outputs); ++i) {
+        out = array_get(&link_outputs, i);
+        for (j = 0; j < array_len(&out->inputs); ++j) {
+            sec = array_get(&out->inputs, j);
+            out->size = LINK_ALIGN(out->size, sec->align);
+            sec->offset = out->size;
+            out->size += sec->size;
+        }
+
+        if (out->align > LINK_PAGE_SIZE || (out->align & (out->align - 1))) {
+            verbose("Unsupported alignment of section %s.", out->name);
+            return 1;
+        }
+
+        if ((out->flags & SHF_TLS) && out->align > link_tls.p_align) {
+            link_tls.p_align = out->align;
+        }
+    }
+
+    link_sort_outputs();
+    link_phnum = 5;
+    for (i = 0; i < array_len(&link_outputs); ++i) {
+        out = array_get(&link_outputs, i);
+        out->index = i + 1;
+        if ((out->flags & SHF_TLS) && !tls) {
+            tls = out;
+            tls->align = link_tls.p_align;
+            link_phnum++;
+        }
+    }
+
+    if (!link_opt.is_static) {
+        link_phnum += 2;
+    }
+
+    offset = sizeof(Elf64_Ehdr) + link_phnum * sizeof(Elf64_Phdr);
+    addr = LINK_BASE_ADDRESS + offset;
+    for (seg = 0, i = 0; seg < 3; ++seg) {
+        ph = &link_segments[seg];
+        if (seg) {
+            offset = LINK_ALIGN(offset, LINK_PAGE_SIZE);
+            addr = LINK_BASE_ADDRESS + offset;
+        }
+
+        ph->p_type = PT_LOAD;
+        ph->p_flags = PF_R | (seg == 1 ? PF_X : 0) | (seg == 2 ? PF_W : 0);
+        ph->p_offset = seg ? offset : 0;
+        ph->p_vaddr = ph->p_paddr = seg ? addr : LINK_BASE_ADDRESS;
+        ph->p_align = LINK_PAGE_SIZE;
+        for (; i < array_len(&link_outputs); ++i) {
+            out = array_get(&link_outputs, i);
+            if (out->rank == RANK_NONALLOC || RANK_SEGMENT(out->rank) != seg) {
+                break;
+            }
+
+            if (out->type == SHT_NOBITS) {
+                out->addr = LINK_ALIGN(addr, out->align);
+                out->offset = offset;
+                if (!(out->flags & SHF_TLS)) {
+                    addr = out->addr + out->size;
+                }
+            } else {
+                assert(addr == LINK_BASE_ADDRESS + offset);
+                offset = LINK_ALIGN(offset, out->align);
+                addr = LINK_BASE_ADDRESS + offset;
+                out->addr = addr;
+                out->offset = offset;
+                offset += out->size;
+                addr += out->size;
+            }
+        }
+
+        ph->p_filesz = offset - ph->p_offset;
+        ph->p_memsz = addr - ph->p_vaddr;
+    }
+
+    if (tls) {
+        link_tls.p_type = PT_TLS;
+        link_tls.p_flags = PF_R;
+        link_tls.p_offset = tls->offset;
+        link_tls.p_vaddr = link_tls.p_paddr = tls->addr;
+        for (i = tls->index - 1; i < array_len(&link_outputs); ++i) {
+            out = array_get(&link_outputs, i);
+            if (!(out->flags & SHF_TLS)) {
+                break;
+            }
+
+            link_tls.p_memsz = out->addr + out->size - tls->addr;
+            if (out->type != SHT_NOBITS) {
+                link_tls.p_filesz = link_tls.p_memsz;
+            }
+        }
+
+        link_tls.p_memsz = LINK_ALIGN(link_tls.p_memsz, link_tls.p_align);
+    }
+
+    for (i = 0; i < array_len(&link_provides); ++i) {
+        p = &array_get(&link_provides, i);
+        switch (p->kind) {
+        case PROVIDE_ZERO:
+            p->sym->value = 0;
+            break;
+        case PROVIDE_BASE:
+            p->sym->value = LINK_BASE_ADDRESS;
+            break;
+        case PROVIDE_START:
+            p->sym->value = p->output->addr;
+            break;
+        case PROVIDE_END:
+            p->sym->value = p->output->addr + p->output->size;
+            break;
+        case PROVIDE_ETEXT:
+            p->sym->value = link_segments[1].p_vaddr + link_segments[1].p_memsz;
+            break;
+        case PROVIDE_EDATA:
+            p->sym->value = link_segments[2].p_vaddr + link_segments[2].p_filesz;
+            break;
+        case PROVIDE_END_OF_IMAGE:
+            p->sym->value = link_segments[2].p_vaddr + link_segments[2].p_memsz;
+            break;
+        }
+    }
+
+    return 0;
+}
+
+static int link_write32(char *ptr, Elf64_Addr value, int is_signed)
+{
+    Elf64_Word word;
+
+    if (is_signed
+        ? ((long) value < -2147483647L - 1 || (long) value > 2147483647L)
+        : value > 0xFFFFFFFFUL)
+    {
+        return 1;
+    }
+
+    word = (Elf64_Word) value;
+    memcpy(ptr, &word, sizeof(word));
+    return 0;
+}
+
+static void link_write64(char *ptr, Elf64_Addr value)
+{
+    memcpy(ptr, &value, sizeof(value));
+}
+
+static Elf64_Addr link_got_address(int index)
+{
+    return link_synthetic.got->addr + index * 8;
+}
+
+static int link_apply_relocations(struct link_section *sec)
+{
+    int type, overflow;
+    size_t i, width;
+    char *ptr;
+    const Elf64_Rela *rel;
+    struct link_symbol *sym;
+    Elf64_Addr P, S, A;
+
+    for (i = 0; i < sec->relocations; ++i) {
+        rel = &sec->rela[i];
+        type = ELF64_R_TYPE(rel->r_info);
+        sym = sec->object->symbols[ELF64_R_SYM(rel->r_info)];
+        width = (type == R_X86_64_64 || type == R_X86_64_PC64) ? 8 : 4;
+        if (rel->r_offset + width > sec->size) {
+            verbose("Relocation out of bounds in %s.", sec->object->name);
+            return 1;
+        }
+
+        ptr = sec->output->data + sec->offset + rel->r_offset;
+        P = sec->output->addr + sec->offset + rel->r_offset;
+        S = link_symbol_address(sym);
+        A = rel->r_addend;
+        overflow = 0;
+        switch (type) {
+        case R_X86_64_NONE:
+            break;
+        case R_X86_64_64:
+            link_write64(ptr, S + A);
+            break;
+        case R_X86_64_PC64:
+            link_write64(ptr, S + A - P);
+            break;
+        case R_X86_64_PC32:
+        case R_X86_64_PLT32:
+            overflow = link_write32(ptr, S + A - P, 1);
+            break;
+        case R_X86_64_32:
+            overflow = link_write32(ptr, S + A, 0);
+            break;
+        case R_X86_64_32S:
+            overflow = link_write32(ptr, S + A, 1);
+            break;
+        case R_X86_64_GOTPCREL:
+        case R_X86_64_GOTPCRELX:
+        case R_X86_64_REX_GOTPCRELX:
+            overflow = link_write32(ptr, link_got_address(sym->got) + A - P, 1);
+            break;
+        case R_X86_64_GOTTPOFF:
+            overflow = link_write32(ptr, link_got_address(sym->gottp) + A - P, 1);
+            break;
+        case R_X86_64_TLSGD:
+            overflow = link_write32(ptr, link_got_address(sym->tlsgd) + A - P, 1);
+            break;
+        case R_X86_64_TPOFF32:
+            overflow = link_write32(ptr, link_tpoff(sym) + A, 1);
+            break;
+        }
+
+        if (overflow) {
+            verbose("Relocation overflow in %s.", sec->object->name);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void link_add_relocation(
+    Elf64_Addr offset,
+    int type,
+    const struct link_symbol *sym,
+    Elf64_Addr addend)
+{
+    int index;
+    Elf64_Rela rel;
+
+    index = sym ? sym->dynsym : 0;
+    rel.r_offset = offset;
+    rel.r_info = ELF64_R_INFO(index, type);
+    rel.r_addend = addend;
+    array_push_back(&link_relocations, rel);
+}
+
+/*
+ * Fill in GOT entries, which are either known at link time, or need a
+ * dynamic relocation.
+ */
+static void link_fill_got(void)
+{
+    int i;
+    Elf64_Addr value, place;
+    struct got_entry *entry;
+    struct link_symbol *sym;
+
+    for (i = 0; i < array_len(&link_got); ++i) {
+        entry = &array_get(&link_got, i);
+        sym = entry->sym;
+        place = link_got_address(i);
+        value = 0;
+        switch (entry->kind) {
+        case GOT_ADDRESS:
+        case GOT_PLT:
+            if (link_is_imported(sym)) {
+                link_add_relocation(place,
+                    entry->kind == GOT_PLT
+                        ? R_X86_64_JUMP_SLOT
+                        : R_X86_64_GLOB_DAT,
+                    sym, 0);
+            } else if (sym->type == STT_GNU_IFUNC) {
+                link_add_relocation(place, R_X86_64_IRELATIVE, NULL,
+                    link_definition_address(sym));
+            } else {
+                value = link_symbol_address(sym);
+            }
+            break;
+        case GOT_TPOFF:
+            if (link_is_imported(sym)) {
+                link_add_relocation(place, R_X86_64_TPOFF64, sym, 0);
+            } else {
+                value = link_tpoff(sym);
+            }
+            break;
+        case GOT_TLS_MODULE:
+            if (link_is_imported(sym)) {
+                link_add_relocation(place, R_X86_64_DTPMOD64, sym, 0);
+            } else {
+                value = 1;
+            }
+            break;
+        case GOT_TLS_OFFSET:
+            if (link_is_imported(sym)) {
+                link_add_relocation(place, R_X86_64_DTPOFF64, sym, 0);
+            } else if (link_opt.is_static) {
+                value = link_tpoff(sym);
+            } else {
+                value = link_definition_address(sym) - link_tls.p_vaddr;
+            }
+            break;
+        }
+
+        link_write64(link_synthetic.got->data + i * 8, value);
+    }
+
+    for (i = 0; i < array_len(&link_copies); ++i) {
+        sym = array_get(&link_copies, i);
+        link_add_relocation(link_definition_address(sym), R_X86_64_COPY, sym, 0);
+    }
+
+    assert(array_len(&link_relocations) == link_relocation_count);
+    if (link_relocation_count) {
+        memcpy(link_synthetic.rela->data,
+            &array_get(&link_relocations, 0),
+            link_relocation_count * sizeof(Elf64_Rela));
+    }
+}
+
+/* Each PLT entry is an indirect jump through the GOT. */
+static void link_fill_plt(void)
+{
+    int i;
+    char *ptr;
+    Elf64_Addr addr;
+    struct link_symbol *sym;
+    static const char nop[] = {
+        '\x0F', '\x1F', '\x84', '\x00', '\x00', '\x00', '\x00', '\x00',
+        '\x66', '\x90'
+    };
+
+    for (i = 0; i < array_len(&link_plt); ++i) {
+        sym = array_get(&link_plt, i);
+        ptr = link_synthetic.plt->data + i * LINK_PLT_ENTRY_SIZE;
+        addr = link_synthetic.plt->addr + i * LINK_PLT_ENTRY_SIZE;
+        ptr[0] = '\xFF';
+        ptr[1] = '\x25';
+        link_write32(ptr + 2, link_got_address(sym->pltgot) - (addr + 6), 1);
+        memcpy(ptr + 6, nop, sizeof(nop));
+    }
+}
+
+static void link_fill_dynamic(void)
+{
+    int i, j, n;
+    Elf64_Word *hash, nbucket, b;
+    Elf64_Half *versym;
+    Elf64_Sym *es;
+    Elf64_Verneed *vn, *last;
+    Elf64_Vernaux *vna;
+    struct link_symbol *sym;
+    struct link_version *ver;
+    struct shared_object *so;
+
+    memcpy(link_synthetic.interp->data, link_opt.interp,
+        link_synthetic.interp->size);
+    memcpy(link_synthetic.dynstr->data, &array_get(&link_dynstr, 0),
+        link_synthetic.dynstr->size);
+
+    n = array_len(&link_dynsyms);
+    nbucket = n / 2 + 1;
+    hash = (Elf64_Word *) link_synthetic.hash->data;
+    hash[0] = nbucket;
+    hash[1] = n;
+    versym = NULL;
+    if (array_len(&link_versions)) {
+        versym = (Elf64_Half *) link_synthetic.versym->data;
+    }
+
+    for (i = 1; i < n; ++i) {
+        sym = array_get(&link_dynsyms, i);
+        es = (Elf64_Sym *) link_synthetic.dynsym->data + i;
+        es->st_name = sym->dynname;
+        if (link_is_imported(sym)) {
+            es->st_info = (sym->is_strong_ref ? STB_GLOBAL : STB_WEAK) << 4;
+            es->st_shndx = SHN_UNDEF;
+            if (sym->is_canonical) {
+                es->st_value = link_symbol_address(sym);
+            }
+        } else {
+            es->st_info = (sym->is_weak ? STB_WEAK : STB_GLOBAL) << 4;
+            es->st_shndx = sym->section ? sym->section->output->index : SHN_ABS;
+            es->st_value = link_symbol_value(sym);
+            es->st_size = sym->size;
+        }
+
+        es->st_info |= sym->type == STT_GNU_IFUNC ? STT_FUNC : sym->type;
+        if (versym) {
+            versym[i] = sym->version;
+        }
+
+        b = link_elf_hash(sym->name) % nbucket;
+        hash[2 + nbucket + i] = hash[2 + b];
+        hash[2 + b] = i;
+    }
+
+    vn = (Elf64_Verneed *) link_synthetic.verneed->data;
+    last = NULL;
+    for (i = 0; i < array_len(&link_libraries); ++i) {
+        so = array_get(&link_libraries, i);
+        vna = (Elf64_Vernaux *) (vn + 1);
+        vn->vn_cnt = 0;
+        for (j = 0; j < array_len(&link_versions); ++j) {
+            ver = &array_get(&link_versions, j);
+            if (ver->shared != so) {
+                continue;
+            }
+
+            vna->vna_hash = link_elf_hash(ver->name);
+            vna->vna_flags = 0;
+            vna->vna_other = ver->index;
+            vna->vna_name = ver->dynname;
+            vna->vna_next = sizeof(*vna);
+            vn->vn_cnt++;
+            vna++;
+        }
+
+        if (vn->vn_cnt) {
+            vna[-1].vna_next = 0;
+            vn->vn_version = 1;
+            vn->vn_file = so->dynname;
+            vn->vn_aux = sizeof(*vn);
+            vn->vn_next = (char *) vna - (char *) vn;
+            last = vn;
+            vn = (Elf64_Verneed *) vna;
+        }
+    }
+
+    if (last) {
+        last->vn_next = 0;
+    }
+
+    link_dynamic_entries((Elf64_Dyn *) link_synthetic.dynamic->data);
+}
+
+/* Copy section contents to output, and resolve relocations. */
+static int link_relocate(void)
+{
+    int i, j;
+    struct link_section *sec;
+    struct output_section *out;
+
+    for (i = 0; i < array_len(&link_outputs); ++i) {
+        out = array_get(&link_outputs, i);
+        if (out->type == SHT_NOBITS) {
+            continue;
+        }
+
+        out->data = calloc(1, out->size + 1);
+        for (j = 0; j < array_len(&out->inputs); ++j) {
+            sec = array_get(&out->inputs, j);
+            if (sec->data) {
+                memcpy(out->data + sec->offset, sec->data, sec->size);
+            }
+        }
+    }
+
+    link_fill_plt();
+    link_fill_got();
+    if (!link_opt.is_static) {
+        link_fill_dynamic();
+    }
+
+    for (i = 0; i < array_len(&link_outputs); ++i) {
+        out = array_get(&link_outputs, i);
+        for (j = 0; j < array_len(&out->inputs); ++j) {
+            sec = array_get(&out->inputs, j);
+            if (sec->relocations && link_apply_relocations(sec)) {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static struct output_section *link_output_data(
+    const char *name,
+    Elf64_Word type,
+    const void *data,
+    size_t size)
+{
+    struct output_section *out;
+
+    out = calloc(1, sizeof(*out));
+    out->name = name;
+    out->type = type;
+    out->rank = RANK_NONALLOC;
+    out->align = 1;
+    out->data = malloc(size + 1);
+    out->size = size;
+    if (size) {
+        memcpy(out->data, data, size);
+    }
+
+    array_push_back(&link_outputs, out);
+    out->index = array_len(&link_outputs);
+    return out;
+}
+
+static void link_add_symtab_entry(const struct link_symbol *sym, int bind)
+{
+    const char *name;
+    Elf64_Sym es = {0};
+
+    es.st_name = array_len(&link_strtab);
+    for (name = sym->name; *name; ++name) {
+        array_push_back(&link_strtab, *name);
+    }
+
+    array_push_back(&link_strtab, '\0');
+    es.st_info = (bind << 4) | (sym->type & 0xF);
+    es.st_other = sym->is_hidden ? 2 : 0;
+    if (link_is_imported(sym) || (!sym->is_defined && !sym->section)) {
+        es.st_shndx = SHN_UNDEF;
+    } else {
+        es.st_shndx = sym->section ? sym->section->output->index : SHN_ABS;
+        es.st_value = link_symbol_value(sym);
+        es.st_size = sym->size;
+    }
+
+    array_push_back(&link_symbols, es);
+}
+
+/* Write symbol table, keeping named local and global symbols. */
+static void link_create_symtab(void)
+{
+    int i, j, bind;
+    Elf64_Sym null = {0};
+    struct link_object *obj;
+    struct link_symbol *sym;
+    struct output_section *out;
+
+    array_push_back(&link_symbols, null);
+    array_push_back(&link_strtab, '\0');
+    for (i = 0; i < array_len(&link_objects); ++i) {
+        obj = array_get(&link_objects, i);
+        for (j = 1; j < obj->symnum; ++j) {
+            sym = obj->symbols[j];
+            if (sym->is_global
+                || !sym->section
+                || !*sym->name
+                || !strncmp(sym->name, ".L", 2)
+                || sym->type == STT_SECTION
+                || sym->type == STT_FILE)
+            {
+                continue;
+            }
+
+            link_add_symtab_entry(sym, STB_LOCAL);
+        }
+    }
+
+    j = array_len(&link_symbols);
+    for (i = 0; i < array_len(&link_globals); ++i) {
+        sym = array_get(&link_globals, i);
+        if (link_is_imported(sym) || (!sym->is_defined && !sym->section)) {
+            bind = sym->is_strong_ref ? STB_GLOBAL : STB_WEAK;
+        } else {
+            bind = sym->is_weak ? STB_WEAK : STB_GLOBAL;
+        }
+
+        link_add_symtab_entry(sym, bind);
+    }
+
+    out = link_output_data(".symtab", SHT_SYMTAB, link_symbols.data,
+        array_len(&link_symbols) * sizeof(Elf64_Sym));
+    out->align = 8;
+    out->entsize = sizeof(Elf64_Sym);
+    out->info = j;
+    out->link = link_output_data(".strtab", SHT_STRTAB, link_strtab.data,
+        array_len(&link_strtab));
+}
+
+static int link_write(void)
+{
+    int i;
+    FILE *f;
+    mode_t mask;
+    size_t size;
+    char *image;
+    Elf64_Off offset;
+    Elf64_Ehdr *ehdr;
+    Elf64_Phdr *ph;
+    Elf64_Shdr *sh;
+    const char *name;
+    struct link_symbol *entry;
+    struct output_section *out, *shstrtab;
+
+    entry = link_lookup(link_opt.entry);
+    if (!entry || !entry->is_defined) {
+        verbose("Entry symbol %s not defined.", link_opt.entry);
+        return 1;
+    }
+
+    link_create_symtab();
+    shstrtab = link_output_data(".shstrtab", SHT_STRTAB, NULL, 0);
+    array_empty(&link_strtab);
+    array_push_back(&link_strtab, '\0');
+    for (i = 0; i < array_len(&link_outputs); ++i) {
+        out = array_get(&link_outputs, i);
+        out->shname = array_len(&link_strtab);
+        for (name = out->name; *name; ++name) {
+            array_push_back(&link_strtab, *name);
+        }
+
+        array_push_back(&link_strtab, '\0');
+    }
+
+    free(shstrtab->data);
+    shstrtab->data = malloc(array_len(&link_strtab));
+    shstrtab->size = array_len(&link_strtab);
+    memcpy(shstrtab->data, link_strtab.data, shstrtab->size);
+    offset = link_segments[2].p_offset + link_segments[2].p_filesz;
+    for (i = 0; i < array_len(&link_outputs); ++i) {
+        out = array_get(&link_outputs, i);
+        if (out->rank == RANK_NONALLOC) {
+            offset = LINK_ALIGN(offset, out->align);
+            out->offset = offset;
+            offset += out->size;
+        }
+    }
+
+    offset = LINK_ALIGN(offset, 8);
+    size = offset + (array_len(&link_outputs) + 1) * sizeof(Elf64_Shdr);
+    image = calloc(1, size);
+    ehdr = (Elf64_Ehdr *) image;
+    memcpy(ehdr->e_ident, "\177ELF", 4);
+    ehdr->e_ident[4] = ELFCLASS64;
+    ehdr->e_ident[5] = ELFDATA2LSB;
+    ehdr->e_ident[6] = EV_CURRENT;
+    ehdr->e_ident[7] = ELFOSABI_SYSV;
+    ehdr->e_type = ET_EXEC;
+    ehdr->e_machine = EM_X86_64;
+    ehdr->e_version = EV_CURRENT;
+    ehdr->e_entry = link_symbol_address(entry);
+    ehdr->e_phoff = sizeof(Elf64_Ehdr);
+    ehdr->e_shoff = offset;
+    ehdr->e_ehsize = sizeof(Elf64_Ehdr);
+    ehdr->e_phentsize = sizeof(Elf64_Phdr);
+    ehdr->e_phnum = link_phnum;
+    ehdr->e_shentsize = sizeof(Elf64_Shdr);
+    ehdr->e_shnum = array_len(&link_outputs) + 1;
+    ehdr->e_shstrndx = shstrtab->index;
+
+    ph = (Elf64_Phdr *) (image + sizeof(Elf64_Ehdr));
+    ph->p_type = PT_PHDR;
+    ph->p_flags = PF_R;
+    ph->p_offset = sizeof(Elf64_Ehdr);
+    ph->p_vaddr = ph->p_paddr = LINK_BASE_ADDRESS + ph->p_offset;
+    ph->p_filesz = ph->p_memsz = link_phnum * sizeof(Elf64_Phdr);
+    ph->p_align = 8;
+    ph++;
+    if (!link_opt.is_static) {
+        out = link_synthetic.interp;
+        ph->p_type = PT_INTERP;
+        ph->p_flags = PF_R;
+        ph->p_offset = out->offset;
+        ph->p_vaddr = ph->p_paddr = out->addr;
+        ph->p_filesz = ph->p_memsz = out->size;
+        ph->p_align = 1;
+        ph++;
+    }
+
+    memcpy(ph, link_segments, sizeof(link_segments));
+    ph += 3;
+    if (!link_opt.is_static) {
+        out = link_synthetic.dynamic;
+        ph->p_type = PT_DYNAMIC;
+        ph->p_flags = PF_R | PF_W;
+        ph->p_offset = out->offset;
+        ph->p_vaddr = ph->p_paddr = out->addr;
+        ph->p_filesz = ph->p_memsz = out->size;
+        ph->p_align = 8;
+        ph++;
+    }
+
+    if (link_tls.p_type) {
+        *ph++ = link_tls;
+    }
+
+    ph->p_type = PT_GNU_STACK;
+    ph->p_flags = PF_R | PF_W;
+    ph->p_align = 16;
+
+    sh = (Elf64_Shdr *) (image + offset);
+    for (i = 0; i < array_len(&link_outputs); ++i) {
+        out = array_get(&link_outputs, i);
+        if (out->type != SHT_NOBITS && out->size) {
+            memcpy(image + out->offset, out->data, out->size);
+        }
+
+        sh++;
+        sh->sh_name = out->shname;
+        sh->sh_type = out->type;
+        sh->sh_flags = out->flags;
+        sh->sh_addr = out->addr;
+        sh->sh_offset = out->offset;
+        sh->sh_size = out->size;
+        sh->sh_link = out->link ? out->link->index : 0;
+        sh->sh_info = out->info;
+        sh->sh_addralign = out->align;
+        sh->sh_entsize = out->entsize;
+    }
+
+    remove(link_opt.output);
+    f = fopen(link_opt.output, "wb");
+    if (!f) {
+        free(image);
+        verbose("Cannot open %s.", link_opt.output);
+        return 1;
+    }
+
+    i = fwrite(image, 1, size, f) != size;
+    i |= fclose(f) != 0;
+    free(image);
+    if (i) {
+        remove(link_opt.output);
+        verbose("Failed writing %s.", link_opt.output);
+        return 1;
+    }
+
+    mask = umask(0);
+    umask(mask);
+    chmod(link_opt.output, 0777 & ~mask);
+    return 0;
+}
+
+static void link_cleanup(void)
+{
+    int i;
+    struct link_object *obj;
+    struct link_archive *ar;
+    struct shared_object *so;
+    struct output_section *out;
+
+    for (i = 0; i < array_len(&link_objects); ++i) {
+        obj = array_get(&link_objects, i);
+        free(obj->storage);
+        free(obj->sections);
+        free(obj->locals);
+        free(obj->symbols);
+        free(obj);
+    }
+
+    for (i = 0; i < array_len(&link_archives); ++i) {
+        ar = array_get(&link_archives, i);
+        array_clear(&ar->symbols);
+        array_clear(&ar->members);
+        free(ar);
+    }
+
+    for (i = 0; i < array_len(&link_libraries); ++i) {
+        so = array_get(&link_libraries, i);
+        array_clear(&so->versions);
+        hash_destroy(&so->symbols);
+        free(so);
+    }
+
+    for (i = 0; i < array_len(&link_globals); ++i) {
+        free(array_get(&link_globals, i));
+    }
+
+    for (i = 0; i < array_len(&link_outputs); ++i) {
+        out = array_get(&link_outputs, i);
+        array_clear(&out->inputs);
+        free(out->data);
+        free(out);
+    }
+
+    for (i = 0; i < array_len(&link_buffers); ++i) {
+        free(array_get(&link_buffers, i));
+    }
+
+    array_clear(&link_objects);
+    array_clear(&link_archives);
+    array_clear(&link_libraries);
+    array_clear(&link_globals);
+    array_clear(&link_outputs);
+    array_clear(&link_buffers);
+    array_clear(&link_paths);
+    array_clear(&link_got);
+    array_clear(&link_plt);
+    array_clear(&link_copies);
+    array_clear(&link_dynsyms);
+    array_clear(&link_provides);
+    array_clear(&link_versions);
+    array_clear(&link_relocations);
+    array_clear(&link_dynstr);
+    array_clear(&link_strtab);
+    array_clear(&link_symbols);
+    hash_destroy(&link_symtab);
+    hash_destroy(&link_groups);
+    memset(&link_opt, 0, sizeof(link_opt));
+    memset(&link_synthetic, 0, sizeof(link_synthetic));
+    memset(&link_common, 0, sizeof(link_common));
+    memset(&link_tls_stub, 0, sizeof(link_tls_stub));
+    memset(&link_tls, 0, sizeof(link_tls));
+    memset(link_segments, 0, sizeof(link_segments));
+    link_relocation_count = 0;
+}
+
+INTERNAL int link_executable(int argc, char **argv)
+{
+    int ret;
+
+    ret = link_parse_arguments(argc, argv);
+    if (!ret) {
+        link_create_outputs();
+        link_define_symbols();
+        link_resolve_shared();
+        ret = link_scan_relocations();
+    }
+
+    if (!ret) {
+        link_allocate();
+        ret = link_layout() || link_relocate() || link_write();
+    }
+
+    link_cleanup();
+    return ret;
+}
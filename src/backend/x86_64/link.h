@@ -0,0 +1,16 @@
+#ifndef LINK_H
+#define LINK_H
+
+/*
+ * Link executable in process, taking the same arguments as would be
+ * passed to ld. Only a subset of the options are understood, enough to
+ * combine object files with crt files and the C library, either static
+ * or against shared libraries.
+ *
+ * Return 0 on success. Non-zero means the input is not supported, and
+ * the system linker should be invoked instead. No output is written in
+ * that case, and the reason is printed with verbose.
+ */
+INTERNAL int link_executable(int argc, char **argv);
+
+#endif
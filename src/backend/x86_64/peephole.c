@@ -0,0 +1,528 @@
+#if !AMALGAMATION
+# define INTERNAL
+# define EXTERNAL extern
+#endif
+#include "peephole.h"
+#include <lacc/array.h>
+
+#include <assert.h>
+
+/*
+ * Instruction list entry, either a label or an instruction. Lines are
+ * marked as removed, and compacted after each pass.
+ */
+struct line {
+    enum {
+        LINE_LABEL,
+        LINE_INSTRUCTION,
+        LINE_REMOVED
+    } type;
+    const struct symbol *label;
+    struct instruction instr;
+};
+
+static array_of(struct line) lines;
+
+static int (*emit_symbol)(const struct symbol *);
+static int (*emit_text)(struct instruction);
+
+static int next_line(int i)
+{
+    do {
+        i++;
+    } while (i < array_len(&lines)
+        && array_get(&lines, i).type == LINE_REMOVED);
+
+    return i;
+}
+
+/*
+ * Return index of next instruction, only skipping over labels if
+ * specified. Return -1 if there are no more instructions, or a label is
+ * reached.
+ */
+static int next_instruction(int i, int skip_labels)
+{
+    struct line *line;
+
+    for (i = next_line(i); i < array_len(&lines); i = next_line(i)) {
+        line = &array_get(&lines, i);
+        if (line->type == LINE_INSTRUCTION) {
+            return i;
+        }
+
+        assert(line->type == LINE_LABEL);
+        if (!skip_labels)
+            break;
+    }
+
+    return -1;
+}
+
+/*
+ * Return index of previous instruction, or -1 if there is a label in
+ * between.
+ */
+static int prev_instruction(int i)
+{
+    struct line *line;
+
+    while (--i >= 0) {
+        line = &array_get(&lines, i);
+        if (line->type == LINE_INSTRUCTION) {
+            return i;
+        } else if (line->type == LINE_LABEL) {
+            break;
+        }
+    }
+
+    return -1;
+}
+
+static struct instruction *get_instruction(int i)
+{
+    assert(array_get(&lines, i).type == LINE_INSTRUCTION);
+    return &array_get(&lines, i).instr;
+}
+
+static void remove_line(int i)
+{
+    array_get(&lines, i).type = LINE_REMOVED;
+}
+
+static int reg_equal(struct registr a, struct registr b)
+{
+    return a.r == b.r && a.width == b.width;
+}
+
+static int address_equal(struct address a, struct address b)
+{
+    return a.type == b.type
+        && a.sym == b.sym
+        && a.displacement == b.displacement
+        && a.base == b.base
+        && a.index == b.index
+        && a.scale == b.scale;
+}
+
+static int mem_equal(struct memory a, struct memory b)
+{
+    return a.width == b.width && address_equal(a.addr, b.addr);
+}
+
+/* Stack slots are never volatile, and cannot alias registers. */
+static int is_stack_memory(struct memory mem)
+{
+    return !mem.addr.sym
+        && !mem.addr.index
+        && (mem.addr.base == BP || mem.addr.base == SP);
+}
+
+static int is_int_reg(struct registr reg)
+{
+    return reg.r >= AX && reg.r <= R15;
+}
+
+static int is_imm_zero(struct immediate imm)
+{
+    return imm.type == IMM_INT && imm.d.qword == 0;
+}
+
+static int is_flag_reader(const struct instruction *instr)
+{
+    return instr->opcode == INSTR_Jcc || instr->opcode == INSTR_SETcc;
+}
+
+/*
+ * Determine if flags can be read by the instruction following line i,
+ * also looking past labels.
+ */
+static int reads_flags(int i)
+{
+    i = next_instruction(i, 1);
+    return i != -1 && is_flag_reader(get_instruction(i));
+}
+
+/*
+ * Determine if instruction writes a 32 bit register, in which case the
+ * upper half of the 64 bit register is already cleared.
+ */
+static int writes_dword(const struct instruction *instr, struct registr reg)
+{
+    assert(reg.width == 4);
+    switch (instr->opcode) {
+    case INSTR_MOV:
+    case INSTR_ADD:
+    case INSTR_SUB:
+    case INSTR_AND:
+    case INSTR_OR:
+    case INSTR_XOR:
+        switch (instr->optype) {
+        case OPT_REG_REG:
+        case OPT_MEM_REG:
+        case OPT_IMM_REG:
+            return reg_equal(instr->dest.reg, reg);
+        default:
+            break;
+        }
+    default:
+        return 0;
+    }
+}
+
+/*
+ * Move between identical registers. Moving a 32 bit register to itself
+ * clears the upper half, and can only be removed if that has already
+ * happened.
+ *
+ *      movq    %rax, %rax
+ */
+static int remove_self_move(int i)
+{
+    int j;
+    struct instruction *instr;
+
+    instr = get_instruction(i);
+    if ((instr->opcode == INSTR_MOV
+            || instr->opcode == INSTR_MOVS
+            || instr->opcode == INSTR_MOVAP)
+        && instr->optype == OPT_REG_REG
+        && reg_equal(instr->source.reg, instr->dest.reg))
+    {
+        if (instr->opcode == INSTR_MOV && instr->dest.reg.width == 4) {
+            j = prev_instruction(i);
+            if (j == -1 || !writes_dword(get_instruction(j), instr->dest.reg))
+                return 0;
+        }
+
+        remove_line(i);
+        return 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Load from stack slot just written. The load is removed, or replaced
+ * by a register move.
+ *
+ *      movl    %eax, -8(%rbp)
+ *      movl    -8(%rbp), %eax
+ */
+static int remove_reload(int i)
+{
+    int j;
+    struct instruction *instr, *prev;
+
+    instr = get_instruction(i);
+    if ((instr->opcode != INSTR_MOV && instr->opcode != INSTR_MOVS)
+        || instr->optype != OPT_MEM_REG
+        || !is_stack_memory(instr->source.mem))
+    {
+        return 0;
+    }
+
+    j = prev_instruction(i);
+    if (j == -1) {
+        return 0;
+    }
+
+    prev = get_instruction(j);
+    if (prev->opcode != instr->opcode
+        || prev->optype != OPT_REG_MEM
+        || !mem_equal(prev->dest.mem, instr->source.mem)
+        || prev->source.reg.width != instr->dest.reg.width)
+    {
+        return 0;
+    }
+
+    if (prev->source.reg.r == instr->dest.reg.r) {
+        remove_line(i);
+        return 1;
+    }
+
+    if (instr->opcode == INSTR_MOV
+        && is_int_reg(prev->source.reg)
+        && is_int_reg(instr->dest.reg))
+    {
+        instr->optype = OPT_REG_REG;
+        instr->source.reg = prev->source.reg;
+        return 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Add or subtract zero, where the flags are not used. A 32 bit register
+ * operand must already have the upper half cleared.
+ *
+ *      addl    $0, %eax
+ */
+static int remove_add_zero(int i)
+{
+    int j;
+    struct instruction *instr;
+
+    instr = get_instruction(i);
+    if ((instr->opcode != INSTR_ADD && instr->opcode != INSTR_SUB)
+        || (instr->optype != OPT_IMM_REG && instr->optype != OPT_IMM_MEM)
+        || !is_imm_zero(instr->source.imm)
+        || reads_flags(i))
+    {
+        return 0;
+    }
+
+    if (instr->optype == OPT_IMM_REG && instr->dest.reg.width == 4) {
+        j = prev_instruction(i);
+        if (j == -1 || !writes_dword(get_instruction(j), instr->dest.reg))
+            return 0;
+    }
+
+    remove_line(i);
+    return 1;
+}
+
+/*
+ * Compare with zero after arithmetic or logical operation on the same
+ * operand, which already set the flags. Logical operations clear CF and
+ * OF like the compare does, while for addition and subtraction only
+ * the zero and sign flags can be used.
+ *
+ *      subl    %ecx, %eax
+ *      cmpl    $0, %eax
+ *      je      .L4
+ *
+ * Stores to memory and register copies in between do not change the
+ * flags, but the operand is followed through copies.
+ */
+static int remove_compare_zero(int i)
+{
+    int j, logical;
+    enum tttn cc;
+    struct registr reg;
+    struct instruction *instr, *prev;
+
+    instr = get_instruction(i);
+    if (instr->opcode != INSTR_CMP
+        || instr->optype != OPT_IMM_REG
+        || !is_imm_zero(instr->source.imm))
+    {
+        return 0;
+    }
+
+    j = i;
+    reg = instr->dest.reg;
+    while (1) {
+        j = prev_instruction(j);
+        if (j == -1) {
+            return 0;
+        }
+        prev = get_instruction(j);
+        if (prev->opcode != INSTR_MOV)
+            break;
+        if (prev->optype == OPT_REG_REG && reg_equal(prev->dest.reg, reg)) {
+            reg = prev->source.reg;
+        } else if (prev->optype != OPT_REG_MEM) {
+            return 0;
+        }
+    }
+
+    switch (prev->opcode) {
+    case INSTR_AND:
+    case INSTR_OR:
+    case INSTR_XOR:
+        logical = 1;
+        break;
+    case INSTR_ADD:
+    case INSTR_SUB:
+        logical = 0;
+        break;
+    default:
+        return 0;
+    }
+
+    switch (prev->optype) {
+    case OPT_REG_REG:
+    case OPT_MEM_REG:
+    case OPT_IMM_REG:
+        if (!reg_equal(prev->dest.reg, reg))
+            return 0;
+        break;
+    default:
+        return 0;
+    }
+
+    j = next_instruction(i, 0);
+    if (j == -1 || !is_flag_reader(get_instruction(j))) {
+        return 0;
+    }
+
+    do {
+        cc = get_instruction(j)->cc;
+        if (!logical && cc != CC_E && cc != CC_NE && cc != CC_S && cc != CC_NS)
+            return 0;
+        j = next_instruction(j, 0);
+    } while (j != -1 && is_flag_reader(get_instruction(j)));
+
+    remove_line(i);
+    return 1;
+}
+
+/*
+ * Jump to label immediately following, possibly after other labels.
+ *
+ *      jmp     .L3
+ *  .L3:
+ */
+static int remove_jump_next(int i)
+{
+    int j;
+    struct instruction *instr;
+    const struct symbol *label;
+
+    instr = get_instruction(i);
+    if ((instr->opcode != INSTR_JMP && instr->opcode != INSTR_Jcc)
+        || instr->optype != OPT_IMM
+        || instr->source.imm.type != IMM_ADDR)
+    {
+        return 0;
+    }
+
+    label = instr->source.imm.d.addr.sym;
+    for (j = next_line(i); j < array_len(&lines); j = next_line(j)) {
+        if (array_get(&lines, j).type != LINE_LABEL) {
+            break;
+        }
+
+        if (array_get(&lines, j).label == label) {
+            remove_line(i);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Patterns are tried in order on each instruction, and return non-zero
+ * if the instruction list was changed.
+ */
+static int (*const rules[])(int) = {
+    remove_self_move,
+    remove_reload,
+    remove_add_zero,
+    remove_compare_zero,
+    remove_jump_next
+};
+
+static int peephole_pass(void)
+{
+    int i, j, n;
+    struct line *line;
+
+    for (i = 0, n = 0; i < array_len(&lines); ++i) {
+        line = &array_get(&lines, i);
+        if (line->type != LINE_INSTRUCTION)
+            continue;
+
+        for (j = 0; j < sizeof(rules) / sizeof(rules[0]); ++j) {
+            if (rules[j](i)) {
+                n += 1;
+                break;
+            }
+        }
+    }
+
+    for (i = 0, j = 0; i < array_len(&lines); ++i) {
+        line = &array_get(&lines, i);
+        if (line->type != LINE_REMOVED) {
+            array_get(&lines, j++) = *line;
+        }
+    }
+
+    lines.length = j;
+    return n;
+}
+
+INTERNAL void peephole_init(
+    int (*symbol)(const struct symbol *),
+    int (*text)(struct instruction))
+{
+    assert(!array_len(&lines));
+    emit_symbol = symbol;
+    emit_text = text;
+}
+
+INTERNAL int peephole_symbol(const struct symbol *sym)
+{
+    struct line line = {LINE_LABEL};
+
+    line.label = sym;
+    array_push_back(&lines, line);
+    return 0;
+}
+
+/*
+ * Names of x87 registers depend on the stack depth at the time the
+ * instruction is written, which is only known while compiling.
+ */
+static int has_x87_operand(struct instruction instr)
+{
+    switch (instr.optype) {
+    case OPT_REG_REG:
+        if (instr.dest.reg.r >= ST0)
+            return 1;
+    case OPT_REG:
+    case OPT_REG_MEM:
+        return instr.source.reg.r >= ST0;
+    case OPT_MEM_REG:
+    case OPT_IMM_REG:
+        return instr.dest.reg.r >= ST0;
+    default:
+        return 0;
+    }
+}
+
+INTERNAL int peephole_text(struct instruction instr)
+{
+    struct line line = {LINE_INSTRUCTION};
+
+    if (has_x87_operand(instr)) {
+        peephole_flush();
+        return emit_text(instr);
+    }
+
+    line.instr = instr;
+    array_push_back(&lines, line);
+    return 0;
+}
+
+INTERNAL int peephole_flush(void)
+{
+    int i, n, c;
+    struct line line;
+
+    n = 0;
+    do {
+        c = peephole_pass();
+        n += c;
+    } while (c);
+
+    for (i = 0; i < array_len(&lines); ++i) {
+        line = array_get(&lines, i);
+        if (line.type == LINE_LABEL) {
+            emit_symbol(line.label);
+        } else {
+            emit_text(line.instr);
+        }
+    }
+
+    array_empty(&lines);
+    return n;
+}
+
+INTERNAL void peephole_finalize(void)
+{
+    array_clear(&lines);
+}
@@ -0,0 +1,38 @@
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include "encoding.h"
+
+/*
+ * Start buffering instructions of a function, which are written to the
+ * given output functions on peephole_flush.
+ */
+INTERNAL void peephole_init(
+    int (*symbol)(const struct symbol *),
+    int (*text)(struct instruction));
+
+/* Add label or function symbol to instruction list. */
+INTERNAL int peephole_symbol(const struct symbol *sym);
+
+/*
+ * Add instruction to instruction list. Instructions referencing x87
+ * registers are written directly, after flushing the list.
+ */
+INTERNAL int peephole_text(struct instruction instr);
+
+/*
+ * Remove redundant instructions from the buffered function, matching a
+ * table of patterns over a small window of adjacent instructions, and
+ * write the result to output.
+ *
+ *      movl    %eax, -8(%rbp)
+ *      movl    -8(%rbp), %eax
+ *
+ * Return number of instructions removed or simplified.
+ */
+INTERNAL int peephole_flush(void);
+
+/* Free memory used for instruction list. */
+INTERNAL void peephole_finalize(void);
+
+#endif
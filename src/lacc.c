@@ -12,7 +12,11 @@
 #  include "backend/x86_64/abi.c"
 #  include "backend/x86_64/assemble.c"
 #  include "backend/x86_64/assembler.c"
+#  include "backend/x86_64/peephole.c"
+#  include "backend/x86_64/layout.c"
 #  include "backend/x86_64/compile.c"
+#  include "backend/x86_64/link.c"
+#  include "backend/x86_64/jit.c"
 # endif
 # ifdef ARM64
 #  include "backend/arm64/compile.c"
@@ -21,6 +25,10 @@
 # include "backend/linker.c"
 # include "optimizer/transform.c"
 # include "optimizer/liveness.c"
+# include "optimizer/loop.c"
+# include "optimizer/induction.c"
+# include "optimizer/vectorize.c"
+# include "optimizer/inline.c"
 # include "optimizer/optimize.c"
 # include "preprocessor/tokenize.c"
 # include "preprocessor/strtab.c"
@@ -81,9 +89,12 @@ struct input_file {
 };
 
 static const char *program, *output_name;
-static int optimization_level;
 static int dump_symbols, dump_types;
 
+/* Arguments passed to main with -run, starting with the file name. */
+static int run_argc;
+static char **run_argv;
+
 static array_of(struct input_file) input_files;
 static array_of(char *) predefined_macros;
 static array_of(const char *) system_include_paths;
@@ -92,8 +103,9 @@ static int help(const char *arg)
 {
     fprintf(
         stderr,
-        "Usage: %s [-(S|E|c)] [-I <path>] [-o <file>] <file ...>\n",
-        program);
+        "Usage: %s [-(S|E|c)] [-I <path>] [-o <file>] <file ...>\n"
+        "       %s [-I <path>] -run <file> [args ...]\n",
+        program, program);
     return 1;
 }
 
@@ -138,6 +150,185 @@ static int flag(const char *arg)
     return 0;
 }
 
+#define CPU_SSE_EXTENSIONS (CPU_SSE3 | CPU_SSSE3 | CPU_SSE4_1 \
+    | CPU_SSE4_2 | CPU_AVX | CPU_AVX2)
+
+#define CPU_X86_64_V2 (CPU_SSE3 | CPU_SSSE3 | CPU_SSE4_1 | CPU_SSE4_2 \
+    | CPU_POPCNT)
+
+#define CPU_X86_64_V3 (CPU_X86_64_V2 | CPU_AVX | CPU_AVX2 | CPU_BMI \
+    | CPU_BMI2 | CPU_LZCNT)
+
+/*
+ * Features enabled by -m<name>, also enabling the features they
+ * require. Disabling a feature also disables everything requiring it.
+ */
+static const struct {
+    const char *name;
+    unsigned int feature;
+    unsigned int requires;
+} cpu_features[] = {
+    {"sse3", CPU_SSE3, 0},
+    {"ssse3", CPU_SSSE3, CPU_SSE3},
+    {"sse4.1", CPU_SSE4_1, CPU_SSE3 | CPU_SSSE3},
+    {"sse4.2", CPU_SSE4_2, CPU_SSE3 | CPU_SSSE3 | CPU_SSE4_1},
+    {"sse4", CPU_SSE4_1 | CPU_SSE4_2, CPU_SSE3 | CPU_SSSE3},
+    {"avx", CPU_AVX, CPU_SSE3 | CPU_SSSE3 | CPU_SSE4_1 | CPU_SSE4_2},
+    {"avx2", CPU_AVX2, CPU_SSE_EXTENSIONS & ~CPU_AVX2},
+    {"popcnt", CPU_POPCNT, 0},
+    {"lzcnt", CPU_LZCNT, 0},
+    {"bmi", CPU_BMI, 0},
+    {"bmi2", CPU_BMI2, 0},
+    {"prfchw", CPU_PRFCHW, 0}
+};
+
+/*
+ * Known -march values. Anything else is accepted and compiles for
+ * baseline x86-64.
+ */
+static const struct {
+    const char *name;
+    unsigned int features;
+} cpu_models[] = {
+    {"x86-64", 0},
+    {"x86-64-v2", CPU_X86_64_V2},
+    {"x86-64-v3", CPU_X86_64_V3},
+    {"x86-64-v4", CPU_X86_64_V3},
+    {"nehalem", CPU_X86_64_V2},
+    {"westmere", CPU_X86_64_V2},
+    {"sandybridge", CPU_X86_64_V2 | CPU_AVX},
+    {"ivybridge", CPU_X86_64_V2 | CPU_AVX},
+    {"haswell", CPU_X86_64_V3},
+    {"broadwell", CPU_X86_64_V3 | CPU_PRFCHW},
+    {"skylake", CPU_X86_64_V3 | CPU_PRFCHW},
+    {"znver1", CPU_X86_64_V3 | CPU_PRFCHW},
+    {"znver2", CPU_X86_64_V3 | CPU_PRFCHW},
+    {"znver3", CPU_X86_64_V3 | CPU_PRFCHW},
+    {"znver4", CPU_X86_64_V3 | CPU_PRFCHW}
+};
+
+#define CPU_FEATURES (sizeof(cpu_features) / sizeof(cpu_features[0]))
+
+static void set_cpu_feature(const char *name, int enable)
+{
+    int i;
+    unsigned int f;
+
+    for (i = 0; i < CPU_FEATURES; ++i) {
+        if (!strcmp(cpu_features[i].name, name)) {
+            break;
+        }
+    }
+
+    assert(i < CPU_FEATURES);
+    f = cpu_features[i].feature;
+    if (enable) {
+        context.no_sse = 0;
+        context.cpu |= f | cpu_features[i].requires;
+    } else {
+        context.cpu &= ~f;
+        for (i = 0; i < CPU_FEATURES; ++i) {
+            if (cpu_features[i].requires & f) {
+                context.cpu &= ~cpu_features[i].feature;
+            }
+        }
+    }
+}
+
+#ifdef x86_64
+static void cpuid(
+    unsigned int leaf,
+    unsigned int subleaf,
+    unsigned int *a,
+    unsigned int *b,
+    unsigned int *c,
+    unsigned int *d)
+{
+    unsigned int eax, ebx, ecx, edx;
+
+    __asm__ volatile (
+        "cpuid"
+        : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx)
+        : "a" (leaf), "c" (subleaf));
+
+    *a = eax;
+    *b = ebx;
+    *c = ecx;
+    *d = edx;
+}
+
+/* Read extended control register, XCR0 tells which state the OS saves. */
+static unsigned int xgetbv(unsigned int xcr)
+{
+    unsigned int eax, edx;
+
+    __asm__ volatile ("xgetbv" : "=a" (eax), "=d" (edx) : "c" (xcr));
+    return eax;
+}
+#endif
+
+/* Detect features of the host processor for -march=native. */
+static unsigned int native_cpu_features(void)
+{
+    unsigned int f = 0;
+#ifdef x86_64
+    unsigned int a, b, c, d, max;
+
+    cpuid(0, 0, &max, &b, &c, &d);
+    if (max >= 1) {
+        cpuid(1, 0, &a, &b, &c, &d);
+        if (c & (1u << 0)) f |= CPU_SSE3;
+        if (c & (1u << 9)) f |= CPU_SSSE3;
+        if (c & (1u << 19)) f |= CPU_SSE4_1;
+        if (c & (1u << 20)) f |= CPU_SSE4_2;
+        if (c & (1u << 23)) f |= CPU_POPCNT;
+        if ((c & (1u << 27)) && (c & (1u << 28))
+            && (xgetbv(0) & 6) == 6)
+        {
+            f |= CPU_AVX;
+        }
+    }
+
+    if (max >= 7) {
+        cpuid(7, 0, &a, &b, &c, &d);
+        if (b & (1u << 3)) f |= CPU_BMI;
+        if ((b & (1u << 5)) && (f & CPU_AVX)) f |= CPU_AVX2;
+        if (b & (1u << 8)) f |= CPU_BMI2;
+    }
+
+    cpuid(0x80000000u, 0, &max, &b, &c, &d);
+    if (max >= 0x80000001u) {
+        cpuid(0x80000001u, 0, &a, &b, &c, &d);
+        if (c & (1u << 5)) f |= CPU_LZCNT;
+        if (c & (1u << 8)) f |= CPU_PRFCHW;
+    }
+#endif
+    return f;
+}
+
+/*
+ * Select instruction set extensions from -march, or -mcpu. Unknown
+ * processors are accepted, and compile for baseline x86-64.
+ */
+static int set_cpu(const char *arg)
+{
+    int i;
+
+    context.cpu = 0;
+    if (!strcmp("native", arg)) {
+        context.cpu = native_cpu_features();
+    } else {
+        for (i = 0; i < sizeof(cpu_models) / sizeof(cpu_models[0]); ++i) {
+            if (!strcmp(cpu_models[i].name, arg)) {
+                context.cpu = cpu_models[i].features;
+                break;
+            }
+        }
+    }
+
+    return 0;
+}
+
 static int option(const char *arg)
 {
     int disable;
@@ -153,6 +344,10 @@ static int option(const char *arg)
             context.pic = !disable;
         } else if (!strcmp("common", arg)) {
             context.no_common = disable;
+        } else if (!strcmp("function-sections", arg)) {
+            context.function_sections = !disable;
+        } else if (!strcmp("data-sections", arg)) {
+            context.data_sections = !disable;
         } else if (!strcmp("fast-math", arg)) {
             /* Always slow... */
         } else if (!strcmp("strict-aliasing", arg)) {
@@ -164,14 +359,28 @@ static int option(const char *arg)
         if (disable) {
             arg = arg + 3;
         }
-        if (!strcmp("sse", arg) || !strcmp("sse2", arg)
-            || !strcmp("mmx", arg)
-            || !strcmp("3dnow", arg))
-        {
-            context.no_sse = 1;
-        } else assert(0);
+        if (!strcmp("sse", arg) || !strcmp("sse2", arg)) {
+            context.no_sse = disable;
+            if (disable) {
+                context.cpu &= ~CPU_SSE_EXTENSIONS;
+            }
+        } else if (!strcmp("mmx", arg) || !strcmp("3dnow", arg)) {
+            if (disable) {
+                context.no_sse = 1;
+                context.cpu &= ~CPU_SSE_EXTENSIONS;
+            }
+        } else {
+            set_cpu_feature(arg, !disable);
+        }
     } else if (!strcmp("-dot", arg)) {
         context.target = TARGET_IR_DOT;
+    } else if (!strcmp("-run", arg)) {
+#if x86_64 && LINUX
+        context.target = TARGET_RUN;
+#else
+        fprintf(stderr, "Option -run is not supported on this target.\n");
+        return 1;
+#endif
     } else if (!strcmp("-nostdinc", arg)) {
         context.nostdinc = 1;
     } else if (!strcmp("-pedantic", arg)) {
@@ -204,14 +413,28 @@ static int language(const char *arg)
     return 0;
 }
 
-/* Support -fvisibility, with no effect. */
+/* Default visibility of symbols defined in this translation unit. */
 static int set_visibility(const char *arg)
 {
+    assert(arg);
+    if (!strcmp("default", arg)) {
+        context.visibility = VISIBILITY_DEFAULT;
+    } else if (!strcmp("hidden", arg)) {
+        context.visibility = VISIBILITY_HIDDEN;
+    } else if (!strcmp("protected", arg)) {
+        context.visibility = VISIBILITY_PROTECTED;
+    } else if (!strcmp("internal", arg)) {
+        context.visibility = VISIBILITY_INTERNAL;
+    } else {
+        fprintf(stderr, "Unrecognized visibility %s.\n", arg);
+        return 1;
+    }
+
     return 0;
 }
 
-/* Accept anything for -march. */
-static int set_cpu(const char *arg)
+/* Accept anything for -mtune. */
+static int set_tune(const char *arg)
 {
     return 0;
 }
@@ -253,6 +476,7 @@ static char *change_file_suffix(const char *file, enum target target)
     switch (target) {
     default: assert(0);
     case TARGET_PREPROCESS:
+    case TARGET_RUN:
         return NULL;
     case TARGET_IR_DOT:
         suffix = ".dot";
@@ -349,7 +573,7 @@ static int set_c_std(const char *std)
 static int set_optimization_level(const char *level)
 {
     assert(isdigit(level[2]));
-    optimization_level = level[2] - '0';
+    context.optimization_level = level[2] - '0';
     return 0;
 }
 
@@ -488,15 +712,33 @@ static int parse_program_arguments(int argc, char *argv[])
         {"-f[no-]fast-math", &option},
         {"-f[no-]strict-aliasing", &option},
         {"-f[no-]common", &option},
+        {"-f[no-]function-sections", &option},
+        {"-f[no-]data-sections", &option},
         {"-fvisibility=", &set_visibility},
+        {"-fuse-ld=", &set_linker},
         {"-m[no-]sse", &option},
         {"-m[no-]sse2", &option},
         {"-m[no-]3dnow", &option},
         {"-m[no-]mmx", &option},
+        {"-m[no-]sse3", &option},
+        {"-m[no-]ssse3", &option},
+        {"-m[no-]sse4.1", &option},
+        {"-m[no-]sse4.2", &option},
+        {"-m[no-]sse4", &option},
+        {"-m[no-]avx", &option},
+        {"-m[no-]avx2", &option},
+        {"-m[no-]popcnt", &option},
+        {"-m[no-]lzcnt", &option},
+        {"-m[no-]bmi", &option},
+        {"-m[no-]bmi2", &option},
+        {"-m[no-]prfchw", &option},
         {"-dot", &option},
+        {"-run", &option},
         {"--help", &help},
         {"--version", &version},
         {"-march=", &set_cpu},
+        {"-mcpu=", &set_cpu},
+        {"-mtune=", &set_tune},
         {"-o:", &set_output_name},
         {"-I:", &add_include_search_path},
         {"-O{0|1|2|3}", &set_optimization_level},
@@ -528,6 +770,19 @@ static int parse_program_arguments(int argc, char *argv[])
     context.target = TARGET_EXE;
     context.pic = 1;
 
+    /*
+     * Arguments after the input file of -run are passed to the program,
+     * and not parsed as options.
+     */
+    for (i = 1; i < argc - 1; ++i) {
+        if (!strcmp("-run", argv[i])) {
+            run_argc = argc - i - 1;
+            run_argv = argv + i + 1;
+            argc = i + 2;
+            break;
+        }
+    }
+
     if ((i = parse_args(optv, argc, argv)) != 0) {
         return i;
     }
@@ -557,6 +812,24 @@ static int parse_program_arguments(int argc, char *argv[])
         return 1;
     }
 
+    if (context.target == TARGET_RUN) {
+        if (n > 1) {
+            fprintf(stderr, "%s\n", "Option -run takes a single input file.");
+            return 1;
+        }
+
+        if (output_name) {
+            fprintf(stderr, "%s\n", "Cannot set -o with -run.");
+            return 1;
+        }
+
+        /*
+         * Code is loaded anywhere in the address space, and must reach
+         * data in shared libraries through the GOT.
+         */
+        context.pic = 1;
+    }
+
     if (output_name && context.target != TARGET_EXE) {
         if (n > 1) {
             fprintf(stderr, "%s\n", "Cannot set -o with multiple inputs.");
@@ -637,7 +910,7 @@ static int process_file(struct input_file file)
     } else {
         set_compile_target(output, file.name);
         register_builtins();
-        push_optimization(optimization_level);
+        push_optimization(context.optimization_level);
 
         while ((def = parse()) != NULL) {
             if (context.errors) {
@@ -694,6 +967,9 @@ int main(int argc, char *argv[])
 
     if (context.target == TARGET_EXE) {
         ret = invoke_linker();
+    } else if (context.target == TARGET_RUN) {
+        /* Keep the low byte, as exit would for negative values. */
+        ret = run_program(run_argc, run_argv) & 0xFF;
     }
 
 end:
@@ -0,0 +1,719 @@
+#if !AMALGAMATION
+# define INTERNAL
+# define EXTERNAL extern
+#endif
+#include "induction.h"
+#include "liveness.h"
+#include "transform.h"
+#include "../parser/symtab.h"
+
+#include <lacc/type.h>
+
+#include <assert.h>
+
+/*
+ * Pointer maintained as base + iv * scale, replacing the address
+ * computation in expr. Position is the operand of expr holding the
+ * scaled induction variable, where the other operand is the base.
+ */
+struct induction {
+    const struct symbol *iv;
+    struct symbol *ptr;
+    struct expression expr;
+    int position;
+    long scale;
+};
+
+/* Addresses replaced in the last loop processed. */
+static array_of(struct induction) inductions;
+
+/* Loop from last call to strength_reduction. */
+static const struct loop *current;
+
+/* Temporary used to compute initial pointer values in the preheader. */
+static struct symbol *offset;
+
+/*
+ * Create temporary placed first among the local variables, giving it
+ * priority in register allocation.
+ */
+static struct symbol *create_temporary(struct definition *def, Type type)
+{
+    int i;
+    struct symbol *sym;
+
+    sym = sym_create_temporary(type);
+    array_push_back(&def->locals, sym);
+    for (i = array_len(&def->locals) - 1; i > 0; --i) {
+        array_get(&def->locals, i) = array_get(&def->locals, i - 1);
+    }
+
+    array_get(&def->locals, 0) = sym;
+    return sym;
+}
+
+static struct var var_long(struct var var)
+{
+    var.type = basic_type__long;
+    return var;
+}
+
+static struct var imm_long(long n)
+{
+    union value val = {0};
+
+    val.i = n;
+    return var_numeric(basic_type__long, val);
+}
+
+static struct expression create_binary(
+    enum optype op,
+    Type type,
+    struct var l,
+    struct var r)
+{
+    struct expression expr = {0};
+
+    expr.op = op;
+    expr.type = type;
+    expr.l = l;
+    expr.r = r;
+    return expr;
+}
+
+static struct statement create_assignment(
+    const struct symbol *sym,
+    struct expression expr)
+{
+    struct statement st = {IR_ASSIGN};
+
+    st.t = var_direct(sym);
+    st.expr = expr;
+    return st;
+}
+
+static int is_symbol_var(struct var var, const struct symbol *sym)
+{
+    return var.kind == DIRECT
+        && var.value.symbol == sym
+        && !var.offset
+        && !is_field(var);
+}
+
+static int is_binary(const struct expression *expr)
+{
+    switch (expr->op) {
+    case IR_OP_CAST:
+    case IR_OP_NOT:
+    case IR_OP_NEG:
+    case IR_OP_POPCOUNT:
+    case IR_OP_CLZ:
+    case IR_OP_CTZ:
+    case IR_OP_FFS:
+    case IR_OP_BSWAP:
+    case IR_OP_ATOMIC_LOAD:
+    case IR_OP_CALL:
+    case IR_OP_VA_ARG:
+        return 0;
+    default:
+        return 1;
+    }
+}
+
+/* Find position of the only assignment to symbol in loop. */
+static struct statement *find_assignment(
+    struct definition *def,
+    const struct loop *loop,
+    const struct symbol *sym,
+    struct block **block,
+    int *position)
+{
+    int i, j;
+    struct statement *st;
+
+    for (i = 0; i < array_len(&loop->blocks); ++i) {
+        *block = array_get(&loop->blocks, i);
+        for (j = 0; j < (*block)->count; ++j) {
+            st = &array_get(&def->statements, (*block)->head + j);
+            if (st->st == IR_ASSIGN
+                && st->t.kind == DIRECT
+                && st->t.value.symbol == sym)
+            {
+                *position = j;
+                return st;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/* Find closest assignment to symbol before position in block. */
+static int find_previous_assignment(
+    struct definition *def,
+    struct block *block,
+    int position,
+    const struct symbol *sym)
+{
+    struct statement *st;
+
+    while (--position >= 0) {
+        st = &array_get(&def->statements, block->head + position);
+        if (st->st == IR_ASSIGN
+            && st->t.kind == DIRECT
+            && st->t.value.symbol == sym)
+        {
+            break;
+        }
+    }
+
+    return position;
+}
+
+/*
+ * Return step c if symbol is a basic induction variable, with a single
+ * assignment i = i + c or i = i - c in the loop, or zero otherwise.
+ *
+ * Only signed int and long are considered, where overflow is undefined
+ * and the value after conversion to long is linear in the step.
+ */
+static long induction_step(
+    struct definition *def,
+    const struct loop *loop,
+    const struct symbol *sym,
+    struct block **block,
+    int *position)
+{
+    struct statement *st;
+    struct expression expr;
+
+    if (!sym->index
+        || sym->linkage != LINK_NONE
+        || is_address_taken(sym)
+        || !is_signed(sym->type)
+        || (type_of(sym->type) != T_INT && type_of(sym->type) != T_LONG)
+        || assignment_count(sym) != 1)
+    {
+        return 0;
+    }
+
+    st = find_assignment(def, loop, sym, block, position);
+    assert(st);
+    if (!is_symbol_var(st->t, sym) || !type_equal(st->expr.type, sym->type))
+        return 0;
+
+    expr = st->expr;
+    switch (expr.op) {
+    case IR_OP_ADD:
+        if (is_symbol_var(expr.l, sym) && expr.r.kind == IMMEDIATE)
+            return expr.r.value.imm.i;
+        if (is_symbol_var(expr.r, sym) && expr.l.kind == IMMEDIATE)
+            return expr.l.value.imm.i;
+        break;
+    case IR_OP_SUB:
+        if (is_symbol_var(expr.l, sym) && expr.r.kind == IMMEDIATE)
+            return -expr.r.value.imm.i;
+        break;
+    default:
+        break;
+    }
+
+    return 0;
+}
+
+/*
+ * Determine if value of y, read at position in block, is computed as
+ * (long) i * scale from a basic induction variable i. The induction
+ * variable cannot be updated between where it is read, and position.
+ */
+static const struct symbol *scaled_induction_variable(
+    struct definition *def,
+    const struct loop *loop,
+    struct block *block,
+    int position,
+    struct var y,
+    long *scale)
+{
+    int i, read;
+    struct block *update;
+    struct statement *st;
+    const struct symbol *iv;
+
+    *scale = 1;
+    read = position;
+    while (1) {
+        if (y.kind != DIRECT || y.offset || is_field(y))
+            return NULL;
+
+        iv = y.value.symbol;
+        if (type_of(y.type) == T_LONG
+            && induction_step(def, loop, iv, &update, &i))
+        {
+            break;
+        }
+
+        read = find_previous_assignment(def, block, read, iv);
+        if (read < 0)
+            return NULL;
+
+        st = &array_get(&def->statements, block->head + read);
+        if (type_of(st->expr.type) != T_LONG || !is_signed(st->expr.type))
+            return NULL;
+
+        if (st->expr.op == IR_OP_MUL && *scale == 1) {
+            if (st->expr.l.kind == IMMEDIATE) {
+                *scale = st->expr.l.value.imm.i;
+                y = st->expr.r;
+            } else if (st->expr.r.kind == IMMEDIATE) {
+                *scale = st->expr.r.value.imm.i;
+                y = st->expr.l;
+            } else {
+                return NULL;
+            }
+
+            if (*scale <= 1)
+                return NULL;
+        } else if (st->expr.op == IR_OP_CAST
+            && type_of(st->expr.l.type) == T_INT
+            && is_signed(st->expr.l.type)
+            && st->expr.l.kind == DIRECT)
+        {
+            iv = st->expr.l.value.symbol;
+            if (!is_symbol_var(st->expr.l, iv)
+                || !induction_step(def, loop, iv, &update, &i))
+            {
+                return NULL;
+            }
+            break;
+        } else {
+            return NULL;
+        }
+    }
+
+    if (update == block && i >= read && i < position)
+        return NULL;
+
+    return iv;
+}
+
+/*
+ * Match pointer arithmetic base + y, where base is loop invariant, and
+ * y is derived from induction variable.
+ */
+static const struct symbol *match_address(
+    struct definition *def,
+    const struct loop *loop,
+    struct block *block,
+    int position,
+    int *operand,
+    long *scale)
+{
+    struct statement *st;
+    const struct symbol *iv;
+
+    st = &array_get(&def->statements, block->head + position);
+    if (st->st != IR_ASSIGN
+        || st->expr.op != IR_OP_ADD
+        || !is_pointer(st->expr.type))
+    {
+        return NULL;
+    }
+
+    iv = scaled_induction_variable(def, loop, block, position,
+        st->expr.r, scale);
+    if (iv && is_invariant_operand(st->expr.l)) {
+        *operand = 1;
+        return iv;
+    }
+
+    iv = scaled_induction_variable(def, loop, block, position,
+        st->expr.l, scale);
+    if (iv && is_invariant_operand(st->expr.r)) {
+        *operand = 0;
+        return iv;
+    }
+
+    return NULL;
+}
+
+static int same_operand(struct var a, struct var b)
+{
+    if (a.kind != b.kind
+        || a.is_symbol != b.is_symbol
+        || a.offset != b.offset
+        || !type_equal(a.type, b.type))
+    {
+        return 0;
+    }
+
+    return a.is_symbol
+        ? a.value.symbol == b.value.symbol
+        : a.value.imm.u == b.value.imm.u;
+}
+
+static struct var *base_operand(struct induction *ind)
+{
+    return ind->position ? &ind->expr.l : &ind->expr.r;
+}
+
+static struct induction *find_induction(
+    const struct symbol *iv,
+    struct expression expr,
+    int position,
+    long scale)
+{
+    int i;
+    struct var base;
+    struct induction *ind;
+
+    base = position ? expr.l : expr.r;
+    for (i = 0; i < array_len(&inductions); ++i) {
+        ind = &array_get(&inductions, i);
+        if (ind->iv == iv
+            && ind->scale == scale
+            && ind->position == position
+            && type_equal(ind->expr.type, expr.type)
+            && same_operand(*base_operand(ind), base))
+        {
+            return ind;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Compute base + (long) value * scale in preheader, using expression
+ * from induction as template.
+ */
+static void initialize_pointer(
+    struct definition *def,
+    struct block *pre,
+    struct induction *ind,
+    struct symbol *ptr,
+    struct var value)
+{
+    struct expression expr;
+
+    if (value.kind == IMMEDIATE) {
+        expr = as_expr(imm_long(value.value.imm.i * ind->scale));
+        statement_array_insert(def, pre, pre->count,
+            create_assignment(offset, expr));
+    } else {
+        expr = as_expr(value);
+        expr.type = basic_type__long;
+        if (size_of(value.type) == 8) {
+            expr.l.type = basic_type__long;
+        }
+
+        statement_array_insert(def, pre, pre->count,
+            create_assignment(offset, expr));
+        if (ind->scale != 1) {
+            expr = create_binary(IR_OP_MUL, basic_type__long,
+                imm_long(ind->scale), var_direct(offset));
+            statement_array_insert(def, pre, pre->count,
+                create_assignment(offset, expr));
+        }
+    }
+
+    expr = ind->expr;
+    if (ind->position) {
+        expr.r = var_direct(offset);
+    } else {
+        expr.l = var_direct(offset);
+    }
+
+    statement_array_insert(def, pre, pre->count, create_assignment(ptr, expr));
+}
+
+/*
+ * Create pointer for new induction, initialized in preheader and
+ * updated after each assignment to the induction variable.
+ */
+static struct induction *add_induction(
+    struct definition *def,
+    struct loop *loop,
+    const struct symbol *iv,
+    struct expression expr,
+    int position,
+    long scale)
+{
+    int i;
+    long step;
+    struct block *pre, *update;
+    struct induction ind = {0};
+
+    ind.iv = iv;
+    ind.expr = expr;
+    ind.position = position;
+    ind.scale = scale;
+    ind.ptr = create_temporary(def, expr.type);
+    if (!offset) {
+        offset = create_temporary(def, basic_type__long);
+    }
+
+    pre = loop_preheader(def, loop);
+    initialize_pointer(def, pre, &ind, ind.ptr, var_direct(iv));
+
+    step = induction_step(def, loop, iv, &update, &i);
+    assert(step);
+    expr = create_binary(IR_OP_ADD, expr.type,
+        var_long(var_direct(ind.ptr)), imm_long(step * scale));
+    statement_array_insert(def, update, i + 1,
+        create_assignment(ind.ptr, expr));
+
+    array_push_back(&inductions, ind);
+    return &array_back(&inductions);
+}
+
+static void substitute(
+    struct var *var,
+    const struct symbol *from,
+    const struct symbol *to)
+{
+    if (var->is_symbol
+        && var->value.symbol == from
+        && (var->kind == DEREF || is_symbol_var(*var, from)))
+    {
+        var->value.symbol = to;
+    }
+}
+
+/*
+ * Read pointer directly instead of copy assigned at position, until
+ * the end of block or the pointer is updated.
+ */
+static void propagate_copy(
+    struct definition *def,
+    struct block *block,
+    int position,
+    int end,
+    const struct symbol *from,
+    const struct symbol *to)
+{
+    struct statement *st;
+
+    while (++position < end) {
+        st = &array_get(&def->statements, block->head + position);
+        substitute(&st->expr.l, from, to);
+        if (is_binary(&st->expr)) {
+            substitute(&st->expr.r, from, to);
+        }
+
+        if (st->st == IR_ASSIGN) {
+            if (st->t.kind == DEREF) {
+                substitute(&st->t, from, to);
+            } else if (st->t.kind == DIRECT && st->t.value.symbol == from) {
+                return;
+            }
+        }
+    }
+
+    if (end == block->count && (block->jump[1] || block->has_return_value)) {
+        substitute(&block->expr.l, from, to);
+        if (is_binary(&block->expr)) {
+            substitute(&block->expr.r, from, to);
+        }
+    }
+}
+
+INTERNAL int strength_reduction(
+    struct definition *def,
+    struct loop *loop,
+    int temporaries)
+{
+    int i, j, n, end, update, operand;
+    long scale;
+    struct block *block, *assign;
+    struct statement *st;
+    struct induction *ind;
+    const struct symbol *iv;
+
+    array_empty(&inductions);
+    current = loop;
+    offset = NULL;
+    if (count_assignments(def, loop))
+        return 0;
+
+    for (i = 0, n = 0; i < array_len(&loop->blocks); ++i) {
+        block = array_get(&loop->blocks, i);
+        for (j = 0; j < block->count; ++j) {
+            iv = match_address(def, loop, block, j, &operand, &scale);
+            if (!iv)
+                continue;
+
+            induction_step(def, loop, iv, &assign, &update);
+            st = &array_get(&def->statements, block->head + j);
+            ind = find_induction(iv, st->expr, operand, scale);
+            if (!ind) {
+                if (temporaries < (offset ? 1 : 2))
+                    continue;
+
+                temporaries -= offset ? 1 : 2;
+                ind = add_induction(def, loop, iv, st->expr, operand, scale);
+                if (assign == block && update < j) {
+                    j++;
+                }
+                st = &array_get(&def->statements, block->head + j);
+            }
+
+            st->expr = as_expr(var_direct(ind->ptr));
+            end = (assign == block && update > j) ? update + 1 : block->count;
+            if (st->t.kind == DIRECT && !st->t.offset) {
+                propagate_copy(def, block, j, end,
+                    st->t.value.symbol, ind->ptr);
+            }
+
+            n++;
+        }
+    }
+
+    return n;
+}
+
+/* Determine if statement reads symbol. */
+static int is_used(const struct statement *st, const struct symbol *sym)
+{
+    if ((st->expr.l.is_symbol && st->expr.l.value.symbol == sym)
+        || (is_binary(&st->expr)
+            && st->expr.r.is_symbol && st->expr.r.value.symbol == sym))
+    {
+        return 1;
+    }
+
+    return st->st == IR_ASSIGN
+        && st->t.kind == DEREF
+        && st->t.value.symbol == sym;
+}
+
+/*
+ * Exit test comparing induction variable to a loop invariant value of
+ * the same type.
+ */
+static int is_exit_test(struct expression expr, const struct symbol *iv)
+{
+    switch (expr.op) {
+    case IR_OP_EQ:
+    case IR_OP_NE:
+    case IR_OP_GE:
+    case IR_OP_GT:
+        break;
+    default:
+        return 0;
+    }
+
+    if (!type_equal(expr.l.type, expr.r.type))
+        return 0;
+
+    return (is_symbol_var(expr.l, iv) && is_invariant_operand(expr.r))
+        || (is_symbol_var(expr.r, iv) && is_invariant_operand(expr.l));
+}
+
+/*
+ * Find the single branch testing induction variable. The variable can
+ * not be used for anything else in the loop, and must be dead on exit.
+ */
+static struct block *find_exit_test(
+    struct definition *def,
+    const struct loop *loop,
+    const struct symbol *iv,
+    const struct block *assign,
+    int update)
+{
+    int i, j;
+    unsigned long bit;
+    struct block *block, *next, *test;
+    struct statement *st;
+
+    test = NULL;
+    bit = 1ul << (iv->index - 1);
+    for (i = 0; i < array_len(&loop->blocks); ++i) {
+        block = array_get(&loop->blocks, i);
+        for (j = 0; j < block->count; ++j) {
+            st = &array_get(&def->statements, block->head + j);
+            if ((block != assign || j != update) && is_used(st, iv))
+                return NULL;
+        }
+
+        if (block->jump[1] || block->has_return_value) {
+            if ((block->expr.l.is_symbol && block->expr.l.value.symbol == iv)
+                || (is_binary(&block->expr) && block->expr.r.is_symbol
+                    && block->expr.r.value.symbol == iv))
+            {
+                if (test || !block->jump[1] || !is_exit_test(block->expr, iv))
+                    return NULL;
+                test = block;
+            }
+        }
+
+        for (j = 0; j < 2; ++j) {
+            next = block->jump[j];
+            if (next && !is_loop_block(loop, next) && (next->in & bit))
+                return NULL;
+        }
+    }
+
+    return test;
+}
+
+/*
+ * Comparing pointers as signed long gives the same result as comparing
+ * the induction variable, as long as the offsets cannot overflow. This
+ * holds for canonical x86_64 addresses, with 32 bit signed int scaled by
+ * a small factor.
+ */
+INTERNAL int replace_exit_test(
+    struct definition *def,
+    struct loop *loop,
+    int temporaries)
+{
+    int i, update;
+    struct block *assign, *test;
+    struct induction *ind;
+    struct symbol *end;
+    struct var *l, *r;
+
+    if (loop != current
+        || !array_len(&inductions)
+        || temporaries < 1
+        || count_assignments(def, loop))
+    {
+        return 0;
+    }
+
+    for (i = 0; i < array_len(&inductions); ++i) {
+        ind = &array_get(&inductions, i);
+        if (type_of(ind->iv->type) != T_INT || ind->scale > 0x7FFF)
+            continue;
+
+        if (!induction_step(def, loop, ind->iv, &assign, &update))
+            continue;
+
+        test = find_exit_test(def, loop, ind->iv, assign, update);
+        if (!test)
+            continue;
+
+        if (is_symbol_var(test->expr.l, ind->iv)) {
+            l = &test->expr.l;
+            r = &test->expr.r;
+        } else {
+            l = &test->expr.r;
+            r = &test->expr.l;
+        }
+
+        assert(loop->preheader);
+        end = create_temporary(def, ind->expr.type);
+        initialize_pointer(def, loop->preheader, ind, end, *r);
+        *l = var_long(var_direct(ind->ptr));
+        *r = var_long(var_direct(end));
+        statement_array_erase(def, assign->head + update);
+        return 1;
+    }
+
+    return 0;
+}
+
+INTERNAL void induction_finalize(void)
+{
+    array_clear(&inductions);
+}
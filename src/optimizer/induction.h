@@ -0,0 +1,52 @@
+#ifndef INDUCTION_H
+#define INDUCTION_H
+
+#include "loop.h"
+
+#include <lacc/ir.h>
+
+/*
+ * Replace address computations on the form base + i * size in a loop
+ * with a pointer that is incremented together with i. Here i is a basic
+ * induction variable, with a single assignment i = i + c in the loop.
+ *
+ *   .L1:
+ *      .t1 = (long) i
+ *      .t2 = 4 * .t1
+ *      .t3 = a + .t2
+ *      s = s + *.t3
+ *      i = i + 1
+ *
+ * The pointer is initialized in the loop preheader, and the address is
+ * read directly from it:
+ *
+ *   .L1:
+ *      s = s + *.p
+ *      i = i + 1
+ *      .p = .p + 4
+ *
+ * At most the given number of temporaries are created. Return number
+ * of addresses replaced.
+ */
+INTERNAL int strength_reduction(
+    struct definition *def,
+    struct loop *loop,
+    int temporaries);
+
+/*
+ * Rewrite exit tests comparing an induction variable to a loop invariant
+ * value, to instead compare the derived pointer. Only done if the
+ * induction variable is not used for anything else, in which case its
+ * update is removed. Liveness must be up to date.
+ *
+ * Return non-zero if the exit test was replaced.
+ */
+INTERNAL int replace_exit_test(
+    struct definition *def,
+    struct loop *loop,
+    int temporaries);
+
+/* Free memory used for induction variable analysis. */
+INTERNAL void induction_finalize(void);
+
+#endif
@@ -0,0 +1,735 @@
+#if !AMALGAMATION
+# define INTERNAL
+# define EXTERNAL extern
+#endif
+#include "inline.h"
+#include "loop.h"
+#include "transform.h"
+#include "../parser/parse.h"
+#include "../parser/symtab.h"
+
+#include <lacc/context.h>
+#include <lacc/type.h>
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Size limit for candidates to be inlined, counting statements and
+ * blocks. Functions declared inline are allowed to be larger, and the
+ * limit is doubled for calls inside loops. Functions with attribute
+ * always_inline are not limited by size or growth.
+ */
+#define INLINE_SIZE 16
+#define INLINE_SIZE_DECLARED 48
+
+/* Maximum number of statements added to a function by inlining. */
+#define INLINE_GROWTH 256
+
+/* Calls in inlined code are inlined as well, up to this depth. */
+#define INLINE_DEPTH 3
+
+/*
+ * Block in copy of function body, with jump targets stored as index
+ * into the list of blocks. Return blocks have no jump targets, marked
+ * by -1.
+ */
+struct inline_block {
+    int head, count;
+    int jump[2];
+    unsigned short weight[2];
+    unsigned int has_return_value : 1;
+    unsigned int unreachable : 1;
+    unsigned int trap : 1;
+    struct expression expr;
+};
+
+/*
+ * Parameter or local variable to be replaced by a new temporary. Type
+ * is stored separately, as temporaries are recycled after the original
+ * definition is compiled.
+ */
+struct inline_symbol {
+    const struct symbol *sym;
+    Type type;
+    int memory;
+};
+
+/*
+ * Copy of function definition, made after optimization. Parameters are
+ * the first symbols in the list. Functions which cannot be inlined are
+ * kept with negative size.
+ */
+struct inline_function {
+    const struct symbol *symbol;
+    int size;
+    int params;
+    array_of(struct inline_symbol) symbols;
+    array_of(struct inline_block) blocks;
+    array_of(struct statement) statements;
+};
+
+/* Call site to be considered for inlining. */
+struct call_site {
+    struct block *block;
+    int depth;
+    int hot;
+};
+
+static array_of(struct inline_function *) candidates;
+
+static array_of(struct call_site) call_sites;
+
+/* Blocks reachable in definition being copied. */
+static array_of(struct block *) visited;
+
+/* Blocks and temporaries created for the current call site. */
+static array_of(struct block *) copies;
+static array_of(struct symbol *) renamed;
+
+static int block_index(const struct block *block)
+{
+    int i;
+
+    for (i = 0; i < array_len(&visited); ++i) {
+        if (array_get(&visited, i) == block) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static void visit_blocks(struct block *block)
+{
+    if (block_index(block) != -1)
+        return;
+
+    array_push_back(&visited, block);
+    if (block->jump[0]) {
+        visit_blocks(block->jump[0]);
+        if (block->jump[1]) {
+            visit_blocks(block->jump[1]);
+        }
+    }
+}
+
+static int symbol_index(
+    const struct inline_function *func,
+    const struct symbol *sym)
+{
+    int i;
+
+    for (i = 0; i < array_len(&func->symbols); ++i) {
+        if (array_get(&func->symbols, i).sym == sym) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static void add_symbol(struct inline_function *func, const struct symbol *sym)
+{
+    struct inline_symbol local = {0};
+
+    local.sym = sym;
+    local.type = sym->type;
+    array_push_back(&func->symbols, local);
+}
+
+static int is_local(const struct definition *def, const struct symbol *sym)
+{
+    int i;
+
+    for (i = 0; i < array_len(&def->locals); ++i) {
+        if (array_get(&def->locals, i) == sym) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Verify that operand only refers to symbols with static storage, or
+ * variables owned by the function. Local variables are added to the
+ * list of symbols to rename when first referenced. Variables with
+ * address taken must not be placed in registers when inlined.
+ */
+static int check_operand(
+    struct inline_function *func,
+    const struct definition *def,
+    struct var var)
+{
+    int i;
+    const struct symbol *sym;
+
+    if (!var.is_symbol || var.value.symbol->linkage != LINK_NONE)
+        return 1;
+
+    sym = var.value.symbol;
+    i = symbol_index(func, sym);
+    if (i == -1) {
+        if (!is_local(def, sym) || is_vla(sym->type))
+            return 0;
+
+        add_symbol(func, sym);
+        i = array_len(&func->symbols) - 1;
+    }
+
+    if (var.kind == ADDRESS) {
+        array_get(&func->symbols, i).memory = 1;
+    }
+
+    return 1;
+}
+
+/*
+ * Functions using va_arg, or calling themselves recursively, are not
+ * inlined.
+ */
+static int check_expression(
+    struct inline_function *func,
+    const struct definition *def,
+    struct expression expr)
+{
+    switch (expr.op) {
+    default:
+        if (!check_operand(func, def, expr.r))
+            return 0;
+    case IR_OP_CAST:
+    case IR_OP_NOT:
+    case IR_OP_NEG:
+    case IR_OP_POPCOUNT:
+    case IR_OP_CLZ:
+    case IR_OP_CTZ:
+    case IR_OP_FFS:
+    case IR_OP_BSWAP:
+    case IR_OP_ATOMIC_LOAD:
+        return check_operand(func, def, expr.l);
+    case IR_OP_CALL:
+        if (expr.l.kind == ADDRESS && expr.l.value.symbol == def->symbol)
+            return 0;
+        return check_operand(func, def, expr.l);
+    case IR_OP_VA_ARG:
+        return 0;
+    }
+}
+
+static int check_statement(
+    struct inline_function *func,
+    const struct definition *def,
+    struct statement st)
+{
+    switch (st.st) {
+    case IR_ASSIGN:
+        if (!check_operand(func, def, st.t))
+            return 0;
+    case IR_EXPR:
+    case IR_PARAM:
+    case IR_PREFETCH:
+    case IR_FENCE:
+        return check_expression(func, def, st.expr);
+    default:
+        return 0;
+    }
+}
+
+/*
+ * Copy reachable blocks and statements of definition. Return size of
+ * the function, or -1 if it cannot be inlined.
+ */
+static int copy_definition(
+    struct inline_function *func,
+    const struct definition *def)
+{
+    int i, j, size;
+    struct block *block;
+    struct statement st;
+    struct inline_block ib;
+    const struct symbol *sym;
+
+    if (is_vararg(def->symbol->type) || array_len(&def->asm_statements))
+        return -1;
+
+    for (i = 0; i < array_len(&def->params); ++i) {
+        sym = array_get(&def->params, i);
+        add_symbol(func, sym);
+    }
+
+    func->params = array_len(&def->params);
+    array_empty(&visited);
+    visit_blocks(def->body);
+    for (i = 0, size = 0; i < array_len(&visited); ++i) {
+        block = array_get(&visited, i);
+        ib.head = array_len(&func->statements);
+        ib.count = block->count;
+        ib.jump[0] = block->jump[0] ? block_index(block->jump[0]) : -1;
+        ib.jump[1] = block->jump[1] ? block_index(block->jump[1]) : -1;
+        ib.weight[0] = block->weight[0];
+        ib.weight[1] = block->weight[1];
+        ib.has_return_value = block->has_return_value;
+        ib.unreachable = block->unreachable;
+        ib.trap = block->trap;
+        memset(&ib.expr, 0, sizeof(ib.expr));
+        for (j = 0; j < block->count; ++j) {
+            st = array_get(&def->statements, block->head + j);
+            if (!check_statement(func, def, st))
+                return -1;
+
+            array_push_back(&func->statements, st);
+        }
+
+        if (block->has_return_value || block->jump[1]) {
+            if (!check_expression(func, def, block->expr))
+                return -1;
+
+            ib.expr = block->expr;
+        }
+
+        array_push_back(&func->blocks, ib);
+        size += block->count + 1;
+    }
+
+    return size;
+}
+
+static void free_function(struct inline_function *func)
+{
+    array_clear(&func->symbols);
+    array_clear(&func->blocks);
+    array_clear(&func->statements);
+    free(func);
+}
+
+static struct inline_function *find_function(const struct symbol *sym)
+{
+    int i;
+    struct inline_function *func;
+
+    for (i = 0; i < array_len(&candidates); ++i) {
+        func = array_get(&candidates, i);
+        if (func->symbol == sym) {
+            return func;
+        }
+    }
+
+    return NULL;
+}
+
+static struct inline_function *add_function(const struct definition *def)
+{
+    struct inline_function *func;
+
+    func = calloc(1, sizeof(*func));
+    func->symbol = def->symbol;
+    func->size = copy_definition(func, def);
+    array_push_back(&candidates, func);
+    return func;
+}
+
+/*
+ * Get function to inline. Definitions of inline candidates are not
+ * compiled until the end of the translation unit, and are copied from
+ * the parser as they are.
+ */
+static struct inline_function *lookup_function(const struct symbol *sym)
+{
+    struct inline_function *func;
+    const struct definition *def;
+
+    func = find_function(sym);
+    if (!func && sym->inlined) {
+        def = get_inline_definition(sym);
+        if (def) {
+            func = add_function(def);
+        }
+    }
+
+    return func;
+}
+
+/*
+ * Determine if call expression can be inlined, with parameters given by
+ * the statements immediately before the end index.
+ */
+static struct inline_function *inline_target(
+    struct definition *def,
+    struct block *block,
+    struct expression expr,
+    int end,
+    int hot,
+    int growth,
+    int temporaries)
+{
+    int i, limit;
+    const struct symbol *sym;
+    struct statement *st;
+    struct inline_function *func;
+
+    if (expr.op != IR_OP_CALL
+        || expr.l.kind != ADDRESS
+        || expr.l.offset
+        || !is_function(expr.l.value.symbol->type))
+    {
+        return NULL;
+    }
+
+    sym = expr.l.value.symbol;
+    if (sym == def->symbol || sym->noinline)
+        return NULL;
+
+    func = lookup_function(sym);
+    if (!func || func->size < 0)
+        return NULL;
+
+    limit = sym->inlined ? INLINE_SIZE_DECLARED : INLINE_SIZE;
+    if (hot) {
+        limit *= 2;
+    }
+
+    if ((!sym->always_inline && (func->size > limit || func->size > growth))
+        || array_len(&func->symbols) + 1 > temporaries
+        || end - block->head < func->params)
+    {
+        return NULL;
+    }
+
+    for (i = 0; i < func->params; ++i) {
+        st = &array_get(&def->statements, end - func->params + i);
+        if (st->st != IR_PARAM
+            || !type_equal_unqualified(
+                st->expr.type, array_get(&func->symbols, i).type))
+        {
+            return NULL;
+        }
+    }
+
+    return func;
+}
+
+static struct var rename_operand(
+    const struct inline_function *func,
+    struct var var)
+{
+    int i;
+
+    if (var.is_symbol) {
+        i = symbol_index(func, var.value.symbol);
+        if (i != -1) {
+            var.value.symbol = array_get(&renamed, i);
+        }
+    }
+
+    return var;
+}
+
+static struct expression rename_expression(
+    const struct inline_function *func,
+    struct expression expr)
+{
+    switch (expr.op) {
+    default:
+        expr.r = rename_operand(func, expr.r);
+    case IR_OP_CAST:
+    case IR_OP_NOT:
+    case IR_OP_NEG:
+    case IR_OP_POPCOUNT:
+    case IR_OP_CLZ:
+    case IR_OP_CTZ:
+    case IR_OP_FFS:
+    case IR_OP_BSWAP:
+    case IR_OP_ATOMIC_LOAD:
+    case IR_OP_CALL:
+    case IR_OP_VA_ARG:
+        expr.l = rename_operand(func, expr.l);
+        break;
+    }
+
+    return expr;
+}
+
+/*
+ * Replace call statement at index with body of function. Parameters
+ * before the call are turned into assignments to the renamed parameter
+ * variables. Return the block containing statements after the call.
+ */
+static struct block *inline_call(
+    struct definition *def,
+    struct block *block,
+    int index,
+    const struct inline_function *func)
+{
+    int i, j;
+    struct symbol *sym;
+    struct statement call, st, *param;
+    struct block *next, *copy;
+    const struct inline_block *ib;
+    const struct inline_symbol *local;
+
+    array_empty(&renamed);
+    for (i = 0; i < array_len(&func->symbols); ++i) {
+        local = &array_get(&func->symbols, i);
+        sym = sym_create_temporary(local->type);
+        sym->memory = local->memory;
+        array_push_back(&def->locals, sym);
+        array_push_back(&renamed, sym);
+    }
+
+    for (i = 0; i < func->params; ++i) {
+        param = &array_get(&def->statements, index - func->params + i);
+        assert(param->st == IR_PARAM);
+        param->st = IR_ASSIGN;
+        param->t = var_direct(array_get(&renamed, i));
+    }
+
+    call = array_get(&def->statements, index);
+    next = cfg_block_init(def);
+    next->head = index + 1;
+    next->count = block->head + block->count - index - 1;
+    next->expr = block->expr;
+    next->jump[0] = block->jump[0];
+    next->jump[1] = block->jump[1];
+    next->weight[0] = block->weight[0];
+    next->weight[1] = block->weight[1];
+    next->has_return_value = block->has_return_value;
+    next->unreachable = block->unreachable;
+    next->trap = block->trap;
+    block->count = index - block->head;
+    block->weight[0] = block->weight[1] = 0;
+    block->has_return_value = 0;
+    block->unreachable = 0;
+    block->trap = 0;
+    memset(&block->expr, 0, sizeof(block->expr));
+    statement_array_erase(def, index);
+
+    array_empty(&copies);
+    for (i = 0; i < array_len(&func->blocks); ++i) {
+        copy = cfg_block_init(def);
+        array_push_back(&copies, copy);
+    }
+
+    for (i = 0; i < array_len(&func->blocks); ++i) {
+        ib = &array_get(&func->blocks, i);
+        copy = array_get(&copies, i);
+        for (j = 0; j < ib->count; ++j) {
+            st = array_get(&func->statements, ib->head + j);
+            if (st.st == IR_ASSIGN) {
+                st.t = rename_operand(func, st.t);
+            }
+
+            st.expr = rename_expression(func, st.expr);
+            statement_array_insert(def, copy, copy->count, st);
+        }
+
+        if (ib->unreachable) {
+            copy->unreachable = 1;
+            copy->trap = ib->trap;
+        } else if (ib->jump[0] == -1) {
+            if (ib->has_return_value) {
+                st = call;
+                st.expr = rename_expression(func, ib->expr);
+                if (st.st == IR_ASSIGN || has_side_effects(st.expr)) {
+                    statement_array_insert(def, copy, copy->count, st);
+                }
+            }
+            copy->jump[0] = next;
+        } else {
+            copy->jump[0] = array_get(&copies, ib->jump[0]);
+            if (ib->jump[1] != -1) {
+                copy->jump[1] = array_get(&copies, ib->jump[1]);
+                copy->weight[0] = ib->weight[0];
+                copy->weight[1] = ib->weight[1];
+                copy->expr = rename_expression(func, ib->expr);
+            }
+        }
+    }
+
+    block->jump[0] = array_get(&copies, 0);
+    block->jump[1] = NULL;
+    return next;
+}
+
+/*
+ * Move call in return value or branch condition to a separate
+ * statement, assigning the result to a new temporary.
+ */
+static void evaluate_call(struct definition *def, struct block *block)
+{
+    struct symbol *sym;
+    struct statement st = {IR_ASSIGN};
+
+    sym = sym_create_temporary(block->expr.type);
+    array_push_back(&def->locals, sym);
+    st.t = var_direct(sym);
+    st.expr = block->expr;
+    statement_array_insert(def, block, block->count, st);
+    block->expr = as_expr(st.t);
+}
+
+static int is_hot(const struct block *block, int loops)
+{
+    int i;
+
+    for (i = 0; i < loops; ++i) {
+        if (is_loop_block(get_loop(i), block)) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Find next call in block which can be inlined, returning the index of
+ * the call statement.
+ */
+static struct inline_function *next_call(
+    struct definition *def,
+    struct block *block,
+    int hot,
+    int growth,
+    int temporaries,
+    int *index)
+{
+    int i;
+    struct statement *st;
+    struct inline_function *func;
+
+    for (i = 0; i < block->count; ++i) {
+        st = &array_get(&def->statements, block->head + i);
+        if (st->st == IR_ASSIGN || st->st == IR_EXPR) {
+            *index = block->head + i;
+            func = inline_target(def, block, st->expr, *index, hot,
+                growth, temporaries);
+            if (func) {
+                return func;
+            }
+        }
+    }
+
+    if (block->has_return_value || block->jump[1]) {
+        *index = block->head + block->count;
+        func = inline_target(def, block, block->expr, *index, hot,
+            growth, temporaries - 1);
+        if (func) {
+            evaluate_call(def, block);
+            *index = block->head + block->count - 1;
+            return func;
+        }
+    }
+
+    return NULL;
+}
+
+static void add_call_sites(struct definition *def, int loops, int hot)
+{
+    int i;
+    struct block *block;
+    struct call_site site;
+
+    for (i = 0; i < array_len(&def->nodes); ++i) {
+        block = array_get(&def->nodes, i);
+        if (block->order != -1 && is_hot(block, loops) == hot) {
+            site.block = block;
+            site.depth = 0;
+            site.hot = hot;
+            array_push_back(&call_sites, site);
+        }
+    }
+}
+
+static void add_inlined_blocks(int depth, int hot)
+{
+    int i;
+    struct call_site site;
+
+    for (i = 0; i < array_len(&copies); ++i) {
+        site.block = array_get(&copies, i);
+        site.depth = depth;
+        site.hot = hot;
+        array_push_back(&call_sites, site);
+    }
+}
+
+INTERNAL int inline_calls(struct definition *def, int temporaries)
+{
+    int i, index, loops, growth, inlined;
+    struct block *block;
+    struct call_site site;
+    struct inline_function *func;
+
+    /*
+     * Visit blocks inside loops first, as the budget is limited. Blocks
+     * created by inlining are added to the end of the list.
+     */
+    loops = loop_analysis(def);
+    array_empty(&call_sites);
+    add_call_sites(def, loops, 1);
+    add_call_sites(def, loops, 0);
+
+    growth = INLINE_GROWTH;
+    inlined = 0;
+    for (i = 0; i < array_len(&call_sites); ++i) {
+        site = array_get(&call_sites, i);
+        block = site.block;
+        while ((func = next_call(def, block, site.hot, growth, temporaries,
+            &index)) != NULL)
+        {
+            verbose("%s: inlined call to %s",
+                sym_name(def->symbol), sym_name(func->symbol));
+
+            temporaries -= array_len(&func->symbols);
+            growth -= func->size;
+            inlined += 1;
+            block = inline_call(def, block, index, func);
+            if (site.depth + 1 < INLINE_DEPTH) {
+                add_inlined_blocks(site.depth + 1, site.hot);
+            }
+        }
+    }
+
+    return inlined;
+}
+
+INTERNAL void inline_candidate(const struct definition *def)
+{
+    int i;
+    struct inline_function *func;
+
+    assert(is_function(def->symbol->type));
+    if (def->symbol->linkage != LINK_INTERN
+        && !def->symbol->inlined
+        && !def->symbol->always_inline)
+        return;
+
+    for (i = 0; i < array_len(&candidates); ++i) {
+        func = array_get(&candidates, i);
+        if (func->symbol == def->symbol) {
+            array_erase(&candidates, i);
+            free_function(func);
+            break;
+        }
+    }
+
+    add_function(def);
+}
+
+INTERNAL void inline_finalize(void)
+{
+    int i;
+    struct inline_function *func;
+
+    for (i = 0; i < array_len(&candidates); ++i) {
+        func = array_get(&candidates, i);
+        free_function(func);
+    }
+
+    array_clear(&candidates);
+    array_clear(&call_sites);
+    array_clear(&visited);
+    array_clear(&copies);
+    array_clear(&renamed);
+}
@@ -0,0 +1,32 @@
+#ifndef INLINE_H
+#define INLINE_H
+
+#include <lacc/ir.h>
+
+/*
+ * Replace calls to small static and inline functions defined earlier in
+ * the translation unit with a copy of the function body. Parameters and
+ * local variables of the callee are renamed to new temporaries.
+ *
+ *      .t1 = call square
+ *
+ * The block containing the call is split, and the callee body inserted
+ * in between. Each return block assigns the result and continues after
+ * the call site.
+ *
+ * At most the given number of temporaries are created, keeping the
+ * function small enough for data flow analysis. Return number of calls
+ * inlined.
+ */
+INTERNAL int inline_calls(struct definition *def, int temporaries);
+
+/*
+ * Keep a copy of function definition to be inlined in later calls, if
+ * it is small enough.
+ */
+INTERNAL void inline_candidate(const struct definition *def);
+
+/* Free memory used for inlining. */
+INTERNAL void inline_finalize(void);
+
+#endif
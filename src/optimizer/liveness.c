@@ -7,22 +7,121 @@
 
 #include <assert.h>
 
+/*
+ * Set of symbols which can be accessed indirectly, either through a
+ * pointer or by other functions. Reading through a pointer, or calling
+ * a function, can only touch these, and not every variable in scope.
+ */
+static unsigned long address_taken;
+
+static unsigned long symbol_bit(const struct symbol *sym)
+{
+    return sym->index ? 1ul << (sym->index - 1) : 0ul;
+}
+
+/*
+ * Symbols escape if their address is taken, including arrays decaying
+ * to pointers, or if they are visible outside the function.
+ */
+static unsigned long set_escape_bit(struct var var)
+{
+    const struct symbol *sym;
+
+    if (!var.is_symbol || !is_object(var.value.symbol->type)) {
+        return 0;
+    }
+
+    sym = var.value.symbol;
+    if (var.kind == ADDRESS
+        || sym->linkage != LINK_NONE
+        || sym->memory)
+    {
+        return symbol_bit(sym);
+    }
+
+    return 0;
+}
+
+static unsigned long escaped(const struct expression *expr)
+{
+    unsigned long r = 0ul;
+
+    switch (expr->op) {
+    default:
+        r |= set_escape_bit(expr->r);
+    case IR_OP_CAST:
+    case IR_OP_NOT:
+    case IR_OP_NEG:
+    case IR_OP_POPCOUNT:
+    case IR_OP_CLZ:
+    case IR_OP_CTZ:
+    case IR_OP_FFS:
+    case IR_OP_BSWAP:
+    case IR_OP_ATOMIC_LOAD:
+    case IR_OP_CALL:
+    case IR_OP_VA_ARG:
+        r |= set_escape_bit(expr->l);
+        break;
+    }
+
+    return r;
+}
+
+INTERNAL int address_taken_analysis(
+    struct definition *def,
+    struct block *block)
+{
+    int i;
+    struct statement *s;
+
+    for (i = block->head; i < block->head + block->count; ++i) {
+        s = &array_get(&def->statements, i);
+        address_taken |= escaped(&s->expr);
+        if (s->st == IR_ASSIGN) {
+            address_taken |= set_escape_bit(s->t);
+        }
+    }
+
+    if (block->has_return_value || block->jump[1]) {
+        address_taken |= escaped(&block->expr);
+    }
+
+    return 0;
+}
+
+INTERNAL int is_address_taken(const struct symbol *sym)
+{
+    return (address_taken & symbol_bit(sym)) != 0;
+}
+
+INTERNAL void clear_address_taken(void)
+{
+    address_taken = 0;
+}
+
 /*
  * Set bit for symbol definitely written through operation. Unless used
  * in right hand side expression, this can be removed from in-liveness.
  *
  * Only safe to say object is written when the whole object is actually
- * overwritten. Consider only basic integral types.
+ * overwritten. Consider only basic integral types, and vectors assigned
+ * as a whole.
  *
  * Pointers can point to anything, so we cannot say for sure what is
  * written.
  */
 static unsigned long set_def_bit(struct var var)
 {
+    const struct symbol *sym;
+
     switch (var.kind) {
     case DIRECT:
-        if (is_scalar(var.value.symbol->type) && var.value.symbol->index) {
-            return 1ul << (var.value.symbol->index - 1);
+        sym = var.value.symbol;
+        if (sym->index
+            && (is_scalar(sym->type)
+                || (is_vector(sym->type) && is_vector(var.type))))
+        {
+            return 1ul << (sym->index - 1);
         }
     default:
         return 0;
@@ -33,13 +132,17 @@ static unsigned long set_def_bit(struct var var)
  * Set bit for symbol possibly read through operation. This set must be
  * part of in-liveness.
  *
- * Pointers can point to anything, so assume everything is touched.
+ * Pointers can only point to symbols that have their address taken,
+ * in addition to the pointer itself being read.
  */
 static unsigned long set_use_bit(struct var var)
 {
     switch (var.kind) {
     case DEREF:
-        return 0xFFFFFFFFFFFFFFFFul;
+        if (var.is_symbol) {
+            return address_taken | symbol_bit(var.value.symbol);
+        }
+        return address_taken;
     case DIRECT:
     case ADDRESS:
         if (is_object(var.value.symbol->type)) {
@@ -70,10 +173,26 @@ static unsigned long use(const struct expression *expr)
     case IR_OP_CAST:
     case IR_OP_NOT:
     case IR_OP_NEG:
-    case IR_OP_CALL:
+    case IR_OP_POPCOUNT:
+    case IR_OP_CLZ:
+    case IR_OP_CTZ:
+    case IR_OP_FFS:
+    case IR_OP_BSWAP:
     case IR_OP_VA_ARG:
         r |= set_use_bit(expr->l);
         break;
+    case IR_OP_ATOMIC_STORE:
+    case IR_OP_ATOMIC_XCHG:
+    case IR_OP_ATOMIC_CAS:
+    case IR_OP_ATOMIC_ADD:
+    case IR_OP_ATOMIC_AND:
+    case IR_OP_ATOMIC_OR:
+    case IR_OP_ATOMIC_XOR:
+        r |= set_use_bit(expr->r);
+    case IR_OP_ATOMIC_LOAD:
+    case IR_OP_CALL:
+        r |= set_use_bit(expr->l) | address_taken;
+        break;
     }
 
     return r;
@@ -102,7 +221,7 @@ static int is_or_has_pointer(Type type)
 
 /*
  * Consider special case of sending a pointer into a function. Assume
- * then that anything can be used.
+ * then that anything with its address taken can be used.
  */
 static unsigned long uses(const struct statement *s)
 {
@@ -121,7 +240,7 @@ static unsigned long uses(const struct statement *s)
         break;
     case IR_PARAM:
         if (is_or_has_pointer(s->expr.type)) {
-            r |= 0xFFFFFFFFFFFFFFFFul;
+            r |= address_taken;
         }
     default:
         break;
@@ -3,6 +3,20 @@
 
 #include <lacc/ir.h>
 
+/*
+ * Find variables that can be accessed indirectly, through pointers or
+ * from other functions. Must be done for all blocks before computing
+ * liveness, and cleared after each function.
+ */
+INTERNAL int address_taken_analysis(
+    struct definition *def,
+    struct block *block);
+
+INTERNAL void clear_address_taken(void);
+
+/* Whether symbol can be accessed indirectly. */
+INTERNAL int is_address_taken(const struct symbol *sym);
+
 /*
  * Compute liveness of each variable on every edge, before and after
  * every ir operation.
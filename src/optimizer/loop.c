@@ -0,0 +1,528 @@
+#if !AMALGAMATION
+# define INTERNAL
+# define EXTERNAL extern
+#endif
+#include "loop.h"
+#include "liveness.h"
+#include "transform.h"
+#include "../parser/parse.h"
+
+#include <lacc/type.h>
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Reachable blocks in reverse postorder. Position in this list is also
+ * stored in each block, and used as index in the other lists.
+ */
+static array_of(struct block *) order;
+
+/* Index of immediate dominator of each block. */
+static array_of(int) idom;
+
+/*
+ * Predecessors of each block, stored contiguously. Predecessors of the
+ * block at index i are found at preds[pred_index[i] .. pred_index[i+1]].
+ */
+static array_of(int) pred_index;
+static array_of(int) preds;
+
+/* Used to mark blocks added to the loop currently discovered. */
+static array_of(int) mark;
+
+static array_of(struct loop) loops;
+
+/* Number of assignments to each symbol within the current loop. */
+static int assignments[64];
+
+static void postorder(struct block *block)
+{
+    if (block->order != -1)
+        return;
+
+    block->order = 0;
+    if (block->jump[0]) {
+        postorder(block->jump[0]);
+        if (block->jump[1]) {
+            postorder(block->jump[1]);
+        }
+    }
+
+    array_push_back(&order, block);
+}
+
+static void compute_order(struct definition *def)
+{
+    int i, n;
+    struct block *block;
+
+    array_empty(&order);
+    for (i = 0; i < array_len(&def->nodes); ++i) {
+        block = array_get(&def->nodes, i);
+        block->order = -1;
+    }
+
+    postorder(def->body);
+    n = array_len(&order);
+    for (i = 0; i < n / 2; ++i) {
+        block = array_get(&order, i);
+        array_get(&order, i) = array_get(&order, n - i - 1);
+        array_get(&order, n - i - 1) = block;
+    }
+
+    for (i = 0; i < n; ++i) {
+        block = array_get(&order, i);
+        block->order = i;
+    }
+}
+
+static void compute_predecessors(void)
+{
+    int i, j, n;
+    struct block *block, *next;
+
+    n = array_len(&order);
+    array_empty(&pred_index);
+    array_empty(&preds);
+    for (i = 0; i <= n; ++i) {
+        array_push_back(&pred_index, 0);
+    }
+
+    for (i = 0; i < n; ++i) {
+        block = array_get(&order, i);
+        for (j = 0; j < 2 && block->jump[j]; ++j) {
+            next = block->jump[j];
+            array_get(&pred_index, next->order)++;
+            array_push_back(&preds, 0);
+        }
+    }
+
+    for (i = 1; i < n; ++i) {
+        array_get(&pred_index, i) += array_get(&pred_index, i - 1);
+    }
+
+    array_get(&pred_index, n) = array_len(&preds);
+    for (i = 0; i < n; ++i) {
+        block = array_get(&order, i);
+        for (j = 0; j < 2 && block->jump[j]; ++j) {
+            next = block->jump[j];
+            array_get(&preds, --array_get(&pred_index, next->order)) = i;
+        }
+    }
+}
+
+static int intersect(int a, int b)
+{
+    while (a != b) {
+        while (a > b) {
+            a = array_get(&idom, a);
+        }
+        while (b > a) {
+            b = array_get(&idom, b);
+        }
+    }
+
+    return a;
+}
+
+/*
+ * Compute immediate dominators, following "A Simple, Fast Dominance
+ * Algorithm" by Cooper, Harvey and Kennedy. Iterate over blocks in
+ * reverse postorder, where the dominator always has a lower index.
+ */
+static void compute_dominators(void)
+{
+    int i, j, p, n, dom, changed;
+
+    n = array_len(&order);
+    array_empty(&idom);
+    for (i = 0; i < n; ++i) {
+        array_push_back(&idom, -1);
+    }
+
+    array_get(&idom, 0) = 0;
+    do {
+        changed = 0;
+        for (i = 1; i < n; ++i) {
+            dom = -1;
+            for (j = array_get(&pred_index, i);
+                j < array_get(&pred_index, i + 1); ++j)
+            {
+                p = array_get(&preds, j);
+                if (array_get(&idom, p) == -1)
+                    continue;
+                dom = (dom == -1) ? p : intersect(p, dom);
+            }
+
+            if (dom != array_get(&idom, i)) {
+                array_get(&idom, i) = dom;
+                changed = 1;
+            }
+        }
+    } while (changed);
+}
+
+static int dominates(int a, int b)
+{
+    while (b > a) {
+        b = array_get(&idom, b);
+    }
+
+    return a == b;
+}
+
+static void add_loop_block(struct loop *loop, int i, int stamp)
+{
+    if (array_get(&mark, i) != stamp) {
+        array_get(&mark, i) = stamp;
+        array_push_back(&loop->blocks, array_get(&order, i));
+    }
+}
+
+/*
+ * Build loop with the given header, including all blocks that can reach
+ * a back edge without going through the header.
+ */
+static void find_natural_loop(int header)
+{
+    int i, j, p, stamp;
+    struct loop loop = {0};
+
+    stamp = array_len(&loops) + 1;
+    for (j = array_get(&pred_index, header);
+        j < array_get(&pred_index, header + 1); ++j)
+    {
+        p = array_get(&preds, j);
+        if (!dominates(header, p))
+            continue;
+
+        if (!loop.header) {
+            loop.header = array_get(&order, header);
+            add_loop_block(&loop, header, stamp);
+        }
+
+        add_loop_block(&loop, p, stamp);
+    }
+
+    if (!loop.header)
+        return;
+
+    for (i = 1; i < array_len(&loop.blocks); ++i) {
+        p = array_get(&loop.blocks, i)->order;
+        for (j = array_get(&pred_index, p);
+            j < array_get(&pred_index, p + 1); ++j)
+        {
+            add_loop_block(&loop, array_get(&preds, j), stamp);
+        }
+    }
+
+    array_push_back(&loops, loop);
+}
+
+static int compare_loop_size(const void *a, const void *b)
+{
+    const struct loop *l1, *l2;
+
+    l1 = (const struct loop *) a;
+    l2 = (const struct loop *) b;
+    return array_len(&l1->blocks) - array_len(&l2->blocks);
+}
+
+static void clear_loops(void)
+{
+    int i;
+    struct loop *loop;
+
+    for (i = 0; i < array_len(&loops); ++i) {
+        loop = &array_get(&loops, i);
+        array_clear(&loop->blocks);
+    }
+
+    array_empty(&loops);
+}
+
+INTERNAL int loop_analysis(struct definition *def)
+{
+    int i, n;
+
+    clear_loops();
+    compute_order(def);
+    compute_predecessors();
+    compute_dominators();
+
+    n = array_len(&order);
+    array_empty(&mark);
+    for (i = 0; i < n; ++i) {
+        array_push_back(&mark, 0);
+    }
+
+    for (i = 0; i < n; ++i) {
+        find_natural_loop(i);
+    }
+
+    n = array_len(&loops);
+    if (n > 1) {
+        qsort(&array_get(&loops, 0), n, sizeof(struct loop),
+            &compare_loop_size);
+    }
+
+    return n;
+}
+
+INTERNAL struct loop *get_loop(int i)
+{
+    assert(i >= 0);
+    assert(i < array_len(&loops));
+    return &array_get(&loops, i);
+}
+
+INTERNAL int is_loop_block(const struct loop *loop, const struct block *block)
+{
+    int i;
+
+    for (i = 0; i < array_len(&loop->blocks); ++i) {
+        if (array_get(&loop->blocks, i) == block) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+INTERNAL struct block *loop_create_block(
+    struct definition *def,
+    const struct loop *loop)
+{
+    int i;
+    struct block *block;
+    struct loop *other;
+
+    block = cfg_block_init(def);
+    block->order = -1;
+    for (i = 0; i < array_len(&loops); ++i) {
+        other = &array_get(&loops, i);
+        if (other != loop && is_loop_block(other, loop->header)) {
+            array_push_back(&other->blocks, block);
+        }
+    }
+
+    return block;
+}
+
+/*
+ * Reuse single predecessor from outside the loop if it unconditionally
+ * jumps to the header, otherwise insert a new block redirecting all
+ * edges from outside the loop.
+ */
+INTERNAL struct block *loop_preheader(
+    struct definition *def,
+    struct loop *loop)
+{
+    int i, j, n;
+    struct block *pre, *pred, *outside;
+
+    if (loop->preheader)
+        return loop->preheader;
+
+    n = 0;
+    outside = NULL;
+    i = loop->header->order;
+    for (j = array_get(&pred_index, i); j < array_get(&pred_index, i + 1); ++j) {
+        pred = array_get(&order, array_get(&preds, j));
+        if (!is_loop_block(loop, pred)) {
+            outside = pred;
+            n++;
+        }
+    }
+
+    if (n == 1 && !outside->jump[1] && def->body != loop->header) {
+        loop->preheader = outside;
+        return outside;
+    }
+
+    pre = loop_create_block(def, loop);
+    pre->jump[0] = loop->header;
+    for (j = array_get(&pred_index, i); j < array_get(&pred_index, i + 1); ++j) {
+        pred = array_get(&order, array_get(&preds, j));
+        if (!is_loop_block(loop, pred)) {
+            if (pred->jump[0] == loop->header) {
+                pred->jump[0] = pre;
+            }
+            if (pred->jump[1] == loop->header) {
+                pred->jump[1] = pre;
+            }
+        }
+    }
+
+    if (def->body == loop->header) {
+        def->body = pre;
+    }
+
+    loop->preheader = pre;
+    return pre;
+}
+
+INTERNAL int is_invariant_operand(struct var var)
+{
+    const struct symbol *sym;
+
+    switch (var.kind) {
+    case IMMEDIATE:
+    case ADDRESS:
+        return 1;
+    case DIRECT:
+        sym = var.value.symbol;
+        return sym->index
+            && sym->linkage == LINK_NONE
+            && !is_vla(sym->type)
+            && !is_address_taken(sym)
+            && !assignments[sym->index - 1];
+    default:
+        return 0;
+    }
+}
+
+/*
+ * Integer division traps on zero, and on overflow for signed division
+ * of the smallest negative number by -1.
+ */
+static int is_trapping(struct expression expr)
+{
+    switch (expr.op) {
+    case IR_OP_CALL:
+    case IR_OP_VA_ARG:
+        return 1;
+    case IR_OP_DIV:
+    case IR_OP_MOD:
+        if (!is_integer(expr.type))
+            return 0;
+        if (expr.r.kind != IMMEDIATE || !expr.r.value.imm.u)
+            return 1;
+        return is_signed(expr.type) && expr.r.value.imm.i == -1;
+    default:
+        return is_atomic_operation(expr);
+    }
+}
+
+static int is_loop_invariant(
+    const struct loop *loop,
+    const struct statement *st)
+{
+    const struct symbol *sym;
+
+    if (st->st != IR_ASSIGN
+        || st->t.kind != DIRECT
+        || st->t.offset
+        || is_field(st->t)
+        || is_trapping(st->expr))
+    {
+        return 0;
+    }
+
+    sym = st->t.value.symbol;
+    if (!is_scalar(sym->type)
+        || sym->linkage != LINK_NONE
+        || is_address_taken(sym)
+        || assignments[sym->index - 1] != 1
+        || (loop->header->in & (1ul << (sym->index - 1))))
+    {
+        return 0;
+    }
+
+    switch (st->expr.op) {
+    default:
+        if (!is_invariant_operand(st->expr.r))
+            return 0;
+    case IR_OP_CAST:
+    case IR_OP_NOT:
+    case IR_OP_NEG:
+    case IR_OP_POPCOUNT:
+    case IR_OP_CLZ:
+    case IR_OP_CTZ:
+    case IR_OP_FFS:
+    case IR_OP_BSWAP:
+    case IR_OP_ATOMIC_LOAD:
+        return is_invariant_operand(st->expr.l);
+    }
+}
+
+INTERNAL int count_assignments(struct definition *def, struct loop *loop)
+{
+    int i, j;
+    struct block *block;
+    struct statement *st;
+
+    memset(assignments, 0, sizeof(assignments));
+    for (i = 0; i < array_len(&loop->blocks); ++i) {
+        block = array_get(&loop->blocks, i);
+        for (j = 0; j < block->count; ++j) {
+            st = &array_get(&def->statements, block->head + j);
+            switch (st->st) {
+            case IR_VLA_ALLOC:
+                return 1;
+            case IR_ASSIGN:
+                if (st->t.kind == DIRECT && st->t.value.symbol->index) {
+                    assignments[st->t.value.symbol->index - 1]++;
+                }
+            default:
+                break;
+            }
+        }
+    }
+
+    return 0;
+}
+
+INTERNAL int assignment_count(const struct symbol *sym)
+{
+    assert(sym->index);
+    return assignments[sym->index - 1];
+}
+
+INTERNAL int loop_invariant_code_motion(
+    struct definition *def,
+    struct loop *loop)
+{
+    int i, j, n, changes;
+    struct block *block, *pre;
+    struct statement st;
+
+    if (count_assignments(def, loop))
+        return 0;
+
+    n = 0;
+    do {
+        changes = 0;
+        for (i = 0; i < array_len(&loop->blocks); ++i) {
+            block = array_get(&loop->blocks, i);
+            for (j = 0; j < block->count; ++j) {
+                st = array_get(&def->statements, block->head + j);
+                if (is_loop_invariant(loop, &st)) {
+                    pre = loop_preheader(def, loop);
+                    statement_array_erase(def, block->head + j);
+                    statement_array_insert(def, pre, pre->count, st);
+                    assignments[st.t.value.symbol->index - 1]--;
+                    changes++;
+                    j--;
+                }
+            }
+        }
+
+        n += changes;
+    } while (changes);
+
+    return n;
+}
+
+INTERNAL void loop_finalize(void)
+{
+    clear_loops();
+    array_clear(&loops);
+    array_clear(&order);
+    array_clear(&idom);
+    array_clear(&pred_index);
+    array_clear(&preds);
+    array_clear(&mark);
+}
@@ -0,0 +1,87 @@
+#ifndef LOOP_H
+#define LOOP_H
+
+#include <lacc/ir.h>
+
+/*
+ * Natural loop, consisting of a header block dominating all blocks in
+ * the loop, and at least one back edge to the header.
+ *
+ * The preheader is the only block outside the loop with an edge to the
+ * header, and is created on demand.
+ */
+struct loop {
+    struct block *header;
+    struct block *preheader;
+    array_of(struct block *) blocks;
+};
+
+/*
+ * Find natural loops in control flow graph, identified by back edges
+ * to a block dominating the source. Loops are ordered innermost first.
+ *
+ * Return number of loops found.
+ */
+INTERNAL int loop_analysis(struct definition *def);
+
+/* Get loop found in previous analysis. */
+INTERNAL struct loop *get_loop(int i);
+
+/* Determine whether block is part of loop. */
+INTERNAL int is_loop_block(const struct loop *loop, const struct block *block);
+
+/*
+ * Create an empty block outside the loop. The block is added to any
+ * enclosing loops.
+ */
+INTERNAL struct block *loop_create_block(
+    struct definition *def,
+    const struct loop *loop);
+
+/*
+ * Get or create preheader block for loop. New blocks are also added to
+ * any enclosing loops.
+ */
+INTERNAL struct block *loop_preheader(
+    struct definition *def,
+    struct loop *loop);
+
+/*
+ * Count assignments to each variable in the loop. Return non-zero if
+ * the loop cannot be analyzed, for example if it allocates variable
+ * length arrays.
+ */
+INTERNAL int count_assignments(struct definition *def, struct loop *loop);
+
+/* Number of assignments to symbol in the last counted loop. */
+INTERNAL int assignment_count(const struct symbol *sym);
+
+/*
+ * Determine if operand has the same value in all iterations of the last
+ * counted loop. This is true for constants, and local variables which
+ * are not assigned in the loop, and cannot be accessed indirectly.
+ */
+INTERNAL int is_invariant_operand(struct var var);
+
+/*
+ * Move computations that produce the same value in every iteration out
+ * to the loop preheader. Liveness must be up to date. Return number of
+ * statements moved.
+ *
+ *   .L1:
+ *      .t1 = (long) n
+ *      .t2 = .t1 * 4
+ *      ...
+ *
+ * Statements are only moved if they cannot trap, the target is assigned
+ * once in the loop, and its value is not live when entering the loop
+ * header.
+ */
+INTERNAL int loop_invariant_code_motion(
+    struct definition *def,
+    struct loop *loop);
+
+/* Free memory used for loop analysis. */
+INTERNAL void loop_finalize(void);
+
+#endif
@@ -3,12 +3,17 @@
 # define EXTERNAL extern
 #endif
 #include "optimize.h"
+#include "induction.h"
+#include "inline.h"
 #include "liveness.h"
+#include "loop.h"
 #include "transform.h"
+#include "vectorize.h"
 
 #include <lacc/array.h>
 #include <lacc/context.h>
 #include <assert.h>
+#include <limits.h>
 
 static int optimization_level;
 
@@ -119,6 +124,12 @@ static int enumerate_used_symbols(
         case IR_OP_CAST:
         case IR_OP_NOT:
         case IR_OP_NEG:
+        case IR_OP_POPCOUNT:
+        case IR_OP_CLZ:
+        case IR_OP_CTZ:
+        case IR_OP_FFS:
+        case IR_OP_BSWAP:
+        case IR_OP_ATOMIC_LOAD:
         case IR_OP_CALL:
         case IR_OP_VA_ARG:
             n += count_symbol(s->expr.l);
@@ -137,6 +148,12 @@ static int enumerate_used_symbols(
         case IR_OP_CAST:
         case IR_OP_NOT:
         case IR_OP_NEG:
+        case IR_OP_POPCOUNT:
+        case IR_OP_CLZ:
+        case IR_OP_CTZ:
+        case IR_OP_FFS:
+        case IR_OP_BSWAP:
+        case IR_OP_ATOMIC_LOAD:
         case IR_OP_CALL:
         case IR_OP_VA_ARG:
             n += count_symbol(block->expr.l);
@@ -153,7 +170,11 @@ static int color_white(struct definition *def, struct block *block)
     return 0;
 }
 
-/* Forward jumps through blocks with no instructions. */
+/*
+ * Forward jumps through blocks with no instructions. Branches to an
+ * empty block marked unreachable are never taken, and can be replaced
+ * by an unconditional jump to the other target.
+ */
 static int skip_empty_blocks(struct definition *def, struct block *block)
 {
     int i;
@@ -168,6 +189,18 @@ static int skip_empty_blocks(struct definition *def, struct block *block)
         } while (1);
     }
 
+    if (block->jump[1] && !has_side_effects(block->expr)) {
+        for (i = 0; i < 2; ++i) {
+            next = block->jump[i];
+            if (!next->count && next->unreachable && !next->trap) {
+                block->jump[0] = block->jump[!i];
+                block->jump[1] = NULL;
+                block->weight[0] = block->weight[1] = 0;
+                break;
+            }
+        }
+    }
+
     return 0;
 }
 
@@ -245,6 +278,94 @@ int print_liveness(struct definition *def, struct block *block)
 }
 #endif
 
+/*
+ * Remove dead stores and redundant assignments, updating liveness until
+ * there are no more changes.
+ */
+static void simplify(struct definition *def)
+{
+    int n;
+
+    do {
+        n = 0;
+        execute_iterative_dataflow(def, &live_variable_analysis);
+
+        /*traverse(&print_liveness);*/
+        n += traverse(def, &dead_store_elimination);
+        n += traverse(def, &merge_chained_assignment);
+        /*if (n) printf("Did %d changes!\n", n);*/
+    } while (n);
+}
+
+/*
+ * Serialize blocks again after changing the control flow graph, and
+ * recompute liveness. New temporaries are assigned a symbol index.
+ */
+static void update_liveness(struct definition *def)
+{
+    traverse(def, &color_white);
+    array_empty(&blocklist);
+    serialize_basic_blocks(def->body);
+    traverse(def, &enumerate_used_symbols);
+    assert(array_len(&symbols) < 64);
+    initialize_dataflow(def);
+    execute_iterative_dataflow(def, &live_variable_analysis);
+}
+
+/*
+ * Find loops in the function, move invariant computations out to
+ * preheader blocks, and strength reduce address computations using
+ * induction variables. Loops are vectorized at optimization level 3.
+ * Innermost loops are processed first, and liveness is updated after
+ * each change.
+ */
+static int optimize_loops(struct definition *def)
+{
+    int i, n, c, r, e, v, count;
+    struct loop *loop;
+
+    count = loop_analysis(def);
+    for (i = 0, n = 0; i < count; ++i) {
+        loop = get_loop(i);
+        c = loop_invariant_code_motion(def, loop);
+        if (c) {
+            update_liveness(def);
+        }
+
+        e = 0;
+        r = strength_reduction(def, loop, 63 - array_len(&symbols));
+        if (r) {
+            update_liveness(def);
+            simplify(def);
+            e = replace_exit_test(def, loop, 63 - array_len(&symbols));
+            if (e) {
+                update_liveness(def);
+                simplify(def);
+            }
+        }
+
+        v = 0;
+        if (optimization_level > 2) {
+            v = vectorize_loop(def, loop, 63 - array_len(&symbols));
+            if (v) {
+                update_liveness(def);
+                simplify(def);
+            }
+        }
+
+        verbose("%s: loop at %s with %d blocks, %d invariant statements "
+            "moved, %d addresses strength reduced%s%s",
+            sym_name(def->symbol),
+            sym_name(loop->header->label),
+            array_len(&loop->blocks),
+            c, r, e ? ", exit test replaced" : "",
+            v ? ", vectorized" : "");
+        n += c + r + v;
+    }
+
+    return n;
+}
+
 INTERNAL int is_live_after(const struct symbol *sym, const struct statement *st)
 {
     if (optimization_level && is_object(sym->type)) {
@@ -262,7 +383,7 @@ INTERNAL void push_optimization(int level)
 
 INTERNAL void optimize(struct definition *def)
 {
-    int syms, n;
+    int syms;
 
     if (!optimization_level
         || !is_function(def->symbol->type)
@@ -277,25 +398,41 @@ INTERNAL void optimize(struct definition *def)
     traverse(def, &skip_empty_blocks);
     syms = traverse(def, &enumerate_used_symbols);
 
+    if (optimization_level > 1
+        && inline_calls(def, syms < 64 ? 63 - syms : INT_MAX))
+    {
+        traverse(def, &color_white);
+        array_empty(&blocklist);
+        serialize_basic_blocks(def->body);
+        traverse(def, &skip_empty_blocks);
+        traverse(def, &enumerate_used_symbols);
+        syms = array_len(&symbols);
+    }
+
     if (syms < 64) {
+        traverse(def, &address_taken_analysis);
         initialize_dataflow(def);
-        do {
-            n = 0;
-            execute_iterative_dataflow(def, &live_variable_analysis);
-
-            /*traverse(&print_liveness);*/
-            n += traverse(def, &dead_store_elimination);
-            n += traverse(def, &merge_chained_assignment);
-            /*if (n) printf("Did %d changes!\n", n);*/
-        } while (n);
+        simplify(def);
+        if (optimize_loops(def)) {
+            simplify(def);
+        }
     }
 
+    clear_address_taken();
     reset_symbol_indexes();
     traverse(def, &color_white);
+    if (optimization_level > 1) {
+        tail_call_analysis(def);
+        inline_candidate(def);
+    }
 }
 
 INTERNAL void pop_optimization(void)
 {
     array_clear(&blocklist);
     array_clear(&symbols);
+    loop_finalize();
+    induction_finalize();
+    vectorize_finalize();
+    inline_finalize();
 }
@@ -47,7 +47,7 @@ static int can_merge(
         && !is_live_after(s1.t.value.symbol, &s2);
 }
 
-static void statement_array_erase(
+INTERNAL void statement_array_erase(
     struct definition *def,
     int index)
 {
@@ -70,6 +70,41 @@ static void statement_array_erase(
     }
 }
 
+INTERNAL void statement_array_insert(
+    struct definition *def,
+    struct block *target,
+    int position,
+    struct statement st)
+{
+    int i, index;
+    struct block *block;
+
+    assert(position >= 0);
+    assert(position <= target->count);
+    if (!target->count) {
+        target->head = array_len(&def->statements);
+        target->count = 1;
+        array_push_back(&def->statements, st);
+        return;
+    }
+
+    index = target->head + position;
+    array_push_back(&def->statements, st);
+    for (i = array_len(&def->statements) - 1; i > index; --i) {
+        array_get(&def->statements, i) = array_get(&def->statements, i - 1);
+    }
+
+    array_get(&def->statements, index) = st;
+    for (i = 0; i < array_len(&def->nodes); ++i) {
+        block = array_get(&def->nodes, i);
+        if (block != target && block->count && block->head >= index) {
+            block->head++;
+        }
+    }
+
+    target->count++;
+}
+
 INTERNAL int merge_chained_assignment(
     struct definition *def,
     struct block *block)
@@ -112,7 +147,8 @@ INTERNAL int dead_store_elimination(
         if (st->st == IR_ASSIGN
             && st->t.kind == DIRECT
             && !is_live_after(st->t.value.symbol, st)
-            && st->t.value.symbol->linkage == LINK_NONE)
+            && st->t.value.symbol->linkage == LINK_NONE
+            && !(has_side_effects(st->expr) && is_struct_or_union(st->t.type)))
         {
             c += 1;
             if (has_side_effects(st->expr)) {
@@ -126,3 +162,130 @@ INTERNAL int dead_store_elimination(
 
     return c;
 }
+
+static int is_local_address(struct var v)
+{
+    return v.kind == ADDRESS
+        && v.is_symbol
+        && v.value.symbol->linkage == LINK_NONE;
+}
+
+/*
+ * Determine if stack frame must be kept alive during calls, because
+ * the address of a local variable can be referenced by the callee.
+ */
+static int has_frame_references(const struct definition *def)
+{
+    int i;
+    const struct statement *st;
+
+    for (i = 0; i < array_len(&def->statements); ++i) {
+        st = &array_get(&def->statements, i);
+        switch (st->st) {
+        case IR_VA_START:
+        case IR_VLA_ALLOC:
+        case IR_ASM:
+            return 1;
+        default:
+            break;
+        }
+
+        switch (st->expr.op) {
+        default:
+            if (is_local_address(st->expr.r))
+                return 1;
+        case IR_OP_CAST:
+        case IR_OP_NOT:
+        case IR_OP_NEG:
+        case IR_OP_POPCOUNT:
+        case IR_OP_CLZ:
+        case IR_OP_CTZ:
+        case IR_OP_FFS:
+        case IR_OP_BSWAP:
+        case IR_OP_ATOMIC_LOAD:
+        case IR_OP_CALL:
+        case IR_OP_VA_ARG:
+            if (is_local_address(st->expr.l))
+                return 1;
+            break;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Only scalar results can be passed through from callee, ensuring both
+ * functions return in the same registers.
+ */
+static int is_tail_call(const struct block *block, Type type)
+{
+    assert(!block->jump[0]);
+    if (block->has_return_value) {
+        return block->expr.op == IR_OP_CALL
+            && is_scalar(type)
+            && type_equal(block->expr.type, type);
+    }
+
+    return 0;
+}
+
+INTERNAL int tail_call_analysis(struct definition *def)
+{
+    int i, n;
+    Type type;
+    struct block *block, *ret;
+    struct statement *st;
+
+    if (has_frame_references(def)) {
+        return 0;
+    }
+
+    type = type_next(def->symbol->type);
+    for (i = 0, n = 0; i < array_len(&def->nodes); ++i) {
+        block = array_get(&def->nodes, i);
+        if (!block->jump[0]) {
+            ret = block;
+            if (is_tail_call(block, type)) {
+                block->tail_call = 1;
+                n += 1;
+                continue;
+            }
+        } else if (!block->jump[1]
+            && !block->jump[0]->jump[0]
+            && !block->jump[0]->count)
+        {
+            ret = block->jump[0];
+        } else continue;
+
+        if (ret->unreachable) {
+            continue;
+        }
+
+        if (block->count) {
+            st = &array_get(&def->statements, block->head + block->count - 1);
+            if (st->expr.op != IR_OP_CALL) {
+                continue;
+            }
+
+            if (st->st == IR_EXPR) {
+                block->tail_call = !ret->has_return_value
+                    && is_void(type)
+                    && is_void(st->expr.type);
+            } else if (st->st == IR_ASSIGN) {
+                block->tail_call = ret->has_return_value
+                    && is_identity(ret->expr)
+                    && var_equal(ret->expr.l, st->t)
+                    && st->t.kind == DIRECT
+                    && st->t.value.symbol->linkage == LINK_NONE
+                    && !is_field(st->t)
+                    && is_scalar(type)
+                    && type_equal(st->expr.type, type);
+            }
+        }
+
+        n += block->tail_call;
+    }
+
+    return n;
+}
@@ -3,6 +3,21 @@
 
 #include <lacc/ir.h>
 
+/* Remove statement at index, adjusting block ranges. */
+INTERNAL void statement_array_erase(
+    struct definition *def,
+    int index);
+
+/*
+ * Insert statement at position within block, adjusting block ranges.
+ * Position equal to block count appends to the end.
+ */
+INTERNAL void statement_array_insert(
+    struct definition *def,
+    struct block *target,
+    int position,
+    struct statement st);
+
 /*
  * Optimization pass which joins together sequential assignments to the
  * same variable into a single statement.
@@ -23,9 +38,26 @@ INTERNAL int merge_chained_assignment(
 /*
  * Remove assignments to variables that are never read, as determined by
  * liveness analysis.
+ *
+ * Function calls returning struct or union keep their target, as the
+ * backend must provide storage for the result.
  */
 INTERNAL int dead_store_elimination(
     struct definition *def,
     struct block *block);
 
+/*
+ * Mark blocks ending with a call whose result is returned directly,
+ * either as the return expression itself or through a single temporary
+ * returned by the same block or an empty successor.
+ *
+ *      .t1 = call f
+ *      return .t1
+ *
+ * Calls can only be in tail position if no local variable has its
+ * address taken, as the stack frame is released before the jump.
+ * Return number of blocks marked.
+ */
+INTERNAL int tail_call_analysis(struct definition *def);
+
 #endif
@@ -0,0 +1,1106 @@
+#if !AMALGAMATION
+# define INTERNAL
+# define EXTERNAL extern
+#endif
+#include "vectorize.h"
+#include "liveness.h"
+#include "transform.h"
+#include "../parser/symtab.h"
+#include "../parser/typetree.h"
+
+#include <lacc/context.h>
+#include <lacc/type.h>
+
+#include <assert.h>
+
+#define VECTOR_SIZE 16
+
+/* Variable updated as x = x + step, once in each iteration. */
+struct stride {
+    const struct symbol *sym;
+    long step;
+    int updated;
+};
+
+/*
+ * Value computed in the loop body, with a vector holding the value for
+ * each lane.
+ */
+struct lane {
+    const struct symbol *sym;
+    struct symbol *vec;
+};
+
+/* Loop invariant operand copied to every lane of a vector. */
+struct broadcast {
+    struct var var;
+    struct symbol *vec;
+};
+
+/* Reduction s = s op x, accumulated separately for each lane. */
+struct reduction {
+    const struct symbol *sym;
+    enum optype op;
+    struct symbol *acc;
+};
+
+static array_of(struct stride) strides;
+static array_of(struct lane) lanes;
+static array_of(struct broadcast) broadcasts;
+static array_of(struct reduction) reductions;
+
+/* Blocks following the loop header, in order of execution. */
+static array_of(struct block *) body;
+
+/* Pointer accessed in the loop body, and whether it is written to. */
+struct access {
+    const struct symbol *ptr;
+    int store;
+};
+
+static array_of(struct access) accesses;
+
+/*
+ * Type of array elements accessed in the loop, determining the number
+ * of lanes. Integer values wider than the element can be truncated,
+ * as only the low order bits are observed.
+ */
+static Type element;
+static int width;
+
+/* Exit test comparing stride variable against loop invariant bound. */
+static const struct symbol *counter;
+static struct var bound;
+static int strict;
+
+static struct symbol *vector_temporary(
+    struct definition *def,
+    Type type,
+    int priority)
+{
+    int i;
+    struct symbol *sym;
+
+    sym = sym_create_temporary(type);
+    array_push_back(&def->locals, sym);
+    if (priority) {
+        for (i = array_len(&def->locals) - 1; i > 0; --i) {
+            array_get(&def->locals, i) = array_get(&def->locals, i - 1);
+        }
+        array_get(&def->locals, 0) = sym;
+    }
+
+    return sym;
+}
+
+static struct var long_immediate(long n)
+{
+    union value val = {0};
+
+    val.i = n;
+    return var_numeric(basic_type__long, val);
+}
+
+/* Reference to part of a vector with the given type and offset. */
+static struct var vector_slice(const struct symbol *vec, Type type, int offset)
+{
+    struct var var;
+
+    var = var_direct(vec);
+    var.type = type;
+    var.offset = offset;
+    return var;
+}
+
+static void append(
+    struct definition *def,
+    struct block *block,
+    struct var target,
+    struct expression expr)
+{
+    struct statement st = {IR_ASSIGN};
+
+    st.t = target;
+    st.expr = expr;
+    statement_array_insert(def, block, block->count, st);
+}
+
+static struct expression cast(Type type, struct var var)
+{
+    struct expression expr = {0};
+
+    expr.op = IR_OP_CAST;
+    expr.type = type;
+    expr.l = var;
+    return expr;
+}
+
+static struct expression operation(
+    enum optype op,
+    Type type,
+    struct var l,
+    struct var r)
+{
+    struct expression expr = {0};
+
+    expr.op = op;
+    expr.type = type;
+    expr.l = l;
+    expr.r = r;
+    return expr;
+}
+
+static int is_plain_symbol(struct var var, const struct symbol *sym)
+{
+    return var.kind == DIRECT
+        && var.value.symbol == sym
+        && !var.offset
+        && !is_field(var);
+}
+
+static int reads_symbol(struct var var, const struct symbol *sym)
+{
+    return var.is_symbol && var.value.symbol == sym;
+}
+
+static int is_unary(enum optype op)
+{
+    switch (op) {
+    case IR_OP_CAST:
+    case IR_OP_NOT:
+    case IR_OP_NEG:
+    case IR_OP_POPCOUNT:
+    case IR_OP_CLZ:
+    case IR_OP_CTZ:
+    case IR_OP_FFS:
+    case IR_OP_BSWAP:
+    case IR_OP_ATOMIC_LOAD:
+    case IR_OP_CALL:
+    case IR_OP_VA_ARG:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static struct stride *find_stride(const struct symbol *sym)
+{
+    int i;
+    struct stride *s;
+
+    for (i = 0; i < array_len(&strides); ++i) {
+        s = &array_get(&strides, i);
+        if (s->sym == sym) {
+            return s;
+        }
+    }
+
+    return NULL;
+}
+
+static struct lane *find_lane(const struct symbol *sym)
+{
+    int i;
+    struct lane *l;
+
+    for (i = 0; i < array_len(&lanes); ++i) {
+        l = &array_get(&lanes, i);
+        if (l->sym == sym) {
+            return l;
+        }
+    }
+
+    return NULL;
+}
+
+static struct reduction *find_reduction(const struct symbol *sym)
+{
+    int i;
+    struct reduction *r;
+
+    for (i = 0; i < array_len(&reductions); ++i) {
+        r = &array_get(&reductions, i);
+        if (r->sym == sym) {
+            return r;
+        }
+    }
+
+    return NULL;
+}
+
+static int same_var(struct var a, struct var b)
+{
+    if (a.kind != b.kind
+        || a.is_symbol != b.is_symbol
+        || a.offset != b.offset
+        || !type_equal(a.type, b.type))
+    {
+        return 0;
+    }
+
+    return a.is_symbol
+        ? a.value.symbol == b.value.symbol
+        : a.value.imm.u == b.value.imm.u;
+}
+
+static struct broadcast *find_broadcast(struct var var)
+{
+    int i;
+    struct broadcast *b;
+
+    for (i = 0; i < array_len(&broadcasts); ++i) {
+        b = &array_get(&broadcasts, i);
+        if (same_var(b->var, var)) {
+            return b;
+        }
+    }
+
+    return NULL;
+}
+
+static void add_access(const struct symbol *ptr, int store)
+{
+    int i;
+    struct access *a, b = {0};
+
+    for (i = 0; i < array_len(&accesses); ++i) {
+        a = &array_get(&accesses, i);
+        if (a->ptr == ptr) {
+            a->store |= store;
+            return;
+        }
+    }
+
+    b.ptr = ptr;
+    b.store = store;
+    array_push_back(&accesses, b);
+}
+
+/*
+ * Return step if statement is the only update x = x + c in the loop,
+ * for pointer or signed integer x, or zero otherwise.
+ */
+static long stride_step(const struct statement *st)
+{
+    const struct symbol *sym;
+
+    if (st->st != IR_ASSIGN
+        || st->t.kind != DIRECT
+        || st->t.offset
+        || is_field(st->t)
+        || st->expr.op != IR_OP_ADD
+        || st->expr.r.kind != IMMEDIATE
+        || st->expr.l.kind != DIRECT
+        || st->expr.l.value.symbol != st->t.value.symbol
+        || st->expr.l.offset)
+    {
+        return 0;
+    }
+
+    sym = st->t.value.symbol;
+    if (!sym->index
+        || sym->linkage != LINK_NONE
+        || is_address_taken(sym)
+        || assignment_count(sym) != 1)
+    {
+        return 0;
+    }
+
+    if (is_pointer(sym->type)) {
+        return st->expr.r.value.imm.i > 0 ? st->expr.r.value.imm.i : 0;
+    }
+
+    if (is_signed(sym->type)
+        && (type_of(sym->type) == T_INT || type_of(sym->type) == T_LONG)
+        && type_equal(st->expr.type, sym->type))
+    {
+        return st->expr.r.value.imm.i == 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Collect blocks of the loop body, which must form a single path from
+ * the header back to itself. Only the header can branch.
+ */
+static int collect_body(const struct loop *loop)
+{
+    struct block *block, *header;
+
+    header = loop->header;
+    if (header->count || !header->jump[1])
+        return 0;
+
+    if (is_loop_block(loop, header->jump[0])
+        == is_loop_block(loop, header->jump[1]))
+    {
+        return 0;
+    }
+
+    array_empty(&body);
+    block = is_loop_block(loop, header->jump[1])
+        ? header->jump[1]
+        : header->jump[0];
+
+    while (block != header) {
+        if (array_len(&body) == array_len(&loop->blocks)
+            || !block->jump[0]
+            || block->jump[1]
+            || block->has_return_value)
+        {
+            return 0;
+        }
+
+        array_push_back(&body, block);
+        block = block->jump[0];
+    }
+
+    return array_len(&body) + 1 == array_len(&loop->blocks);
+}
+
+/*
+ * Match exit test against a stride variable, normalized to the loop
+ * running while bound > counter, or bound >= counter if not strict.
+ */
+static int match_exit_test(const struct loop *loop)
+{
+    int taken;
+    struct var l, r;
+    struct stride *s;
+    struct expression expr;
+
+    expr = loop->header->expr;
+    taken = is_loop_block(loop, loop->header->jump[1]);
+    l = expr.l;
+    r = expr.r;
+    switch (expr.op) {
+    case IR_OP_EQ:
+    case IR_OP_NE:
+        if ((expr.op == IR_OP_NE) != taken)
+            return 0;
+        strict = 1;
+        if (l.kind == DIRECT && find_stride(l.value.symbol)) {
+            l = expr.r;
+            r = expr.l;
+        }
+        break;
+    case IR_OP_GE:
+    case IR_OP_GT:
+        strict = (expr.op == IR_OP_GT) == taken;
+        if (!taken) {
+            l = expr.r;
+            r = expr.l;
+        }
+        break;
+    default:
+        return 0;
+    }
+
+    if (r.kind != DIRECT || r.offset || is_field(r))
+        return 0;
+
+    if (l.kind != DIRECT
+        && (l.kind != IMMEDIATE || l.is_symbol || is_pointer(l.type)))
+    {
+        return 0;
+    }
+
+    s = find_stride(r.value.symbol);
+    if (!s || !is_invariant_operand(l) || !type_equal(l.type, r.type))
+        return 0;
+
+    counter = s->sym;
+    bound = l;
+    return 1;
+}
+
+/*
+ * Determine if values of type can be held in lanes of the vector. All
+ * real values must have the same type as the array element, while
+ * integers can be wider.
+ */
+static int is_lane_type(Type type)
+{
+    if (is_real(element)) {
+        return type_equal_unqualified(type, element);
+    }
+
+    return is_integer(type)
+        && !is_bool(type)
+        && size_of(type) >= width;
+}
+
+/* Check memory access through stride pointer. */
+static int check_access(struct var var)
+{
+    Type type;
+    struct stride *s;
+
+    assert(var.kind == DEREF);
+    type = var.type;
+    if (!var.is_symbol
+        || var.offset
+        || is_field(var)
+        || is_volatile(type)
+        || is_atomic(type))
+    {
+        return 0;
+    }
+
+    s = find_stride(var.value.symbol);
+    if (!s || s->updated || !is_pointer(s->sym->type))
+        return 0;
+
+    if (s->step != width || size_of(type) != width || !is_lane_type(type))
+        return 0;
+
+    add_access(s->sym, 0);
+    return 1;
+}
+
+static int check_lane_operand(struct var var)
+{
+    const struct symbol *sym;
+
+    switch (var.kind) {
+    case DEREF:
+        return check_access(var);
+    case IMMEDIATE:
+        if (var.is_symbol || !is_lane_type(var.type))
+            return 0;
+        break;
+    case DIRECT:
+        if (is_field(var) || !is_lane_type(var.type))
+            return 0;
+        sym = var.value.symbol;
+        if (find_lane(sym)) {
+            return !var.offset;
+        }
+        if (!is_invariant_operand(var))
+            return 0;
+        break;
+    default:
+        return 0;
+    }
+
+    if (!find_broadcast(var)) {
+        struct broadcast b = {0};
+        b.var = var;
+        array_push_back(&broadcasts, b);
+    }
+
+    return 1;
+}
+
+/*
+ * Check that expression can be computed element-wise with packed SSE2
+ * instructions, which exist for addition, subtraction and bitwise
+ * operations on all integer widths, multiplication of 16 bit integers,
+ * and arithmetic on float and double. Multiplication of 32 bit integers
+ * is also supported with SSE4.1.
+ */
+static int check_lane_expression(struct expression expr)
+{
+    if (!is_lane_type(expr.type))
+        return 0;
+
+    switch (expr.op) {
+    case IR_OP_CAST:
+        return check_lane_operand(expr.l);
+    case IR_OP_MUL:
+        if (is_integer(element) && width != 2
+            && (width != 4 || !(context.cpu & CPU_SSE4_1)))
+            return 0;
+    case IR_OP_ADD:
+    case IR_OP_SUB:
+        break;
+    case IR_OP_DIV:
+        if (!is_real(element))
+            return 0;
+        break;
+    case IR_OP_AND:
+    case IR_OP_OR:
+    case IR_OP_XOR:
+        if (is_real(element))
+            return 0;
+        break;
+    default:
+        return 0;
+    }
+
+    return check_lane_operand(expr.l) && check_lane_operand(expr.r);
+}
+
+/*
+ * Match s = s op x, where s is an integer accumulated over iterations,
+ * and not read anywhere else in the loop.
+ */
+static int check_reduction(const struct statement *st)
+{
+    struct var x;
+    const struct symbol *sym;
+    struct reduction r = {0};
+
+    sym = st->t.value.symbol;
+    if (assignment_count(sym) != 1
+        || !is_integer(element)
+        || !is_integer(sym->type)
+        || !type_equal(st->expr.type, sym->type)
+        || size_of(sym->type) != width)
+    {
+        return 0;
+    }
+
+    switch (st->expr.op) {
+    case IR_OP_ADD:
+    case IR_OP_AND:
+    case IR_OP_OR:
+    case IR_OP_XOR:
+        if (is_plain_symbol(st->expr.r, sym)) {
+            x = st->expr.l;
+            break;
+        }
+    case IR_OP_SUB:
+        if (!is_plain_symbol(st->expr.l, sym))
+            return 0;
+        x = st->expr.r;
+        break;
+    default:
+        return 0;
+    }
+
+    if (reads_symbol(x, sym) || !check_lane_operand(x))
+        return 0;
+
+    r.sym = sym;
+    r.op = st->expr.op;
+    array_push_back(&reductions, r);
+    return 1;
+}
+
+static int check_lane_statement(const struct statement *st, unsigned long live)
+{
+    struct stride *s;
+    const struct symbol *sym;
+    struct lane lane = {0};
+
+    if (st->st != IR_ASSIGN)
+        return 0;
+
+    if (stride_step(st)) {
+        s = find_stride(st->t.value.symbol);
+        assert(s);
+        s->updated = 1;
+        return 1;
+    }
+
+    switch (st->t.kind) {
+    case DEREF:
+        if (!check_access(st->t)
+            || !type_equal_unqualified(st->t.type, st->expr.type))
+        {
+            return 0;
+        }
+        add_access(st->t.value.symbol, 1);
+        return check_lane_expression(st->expr);
+    case DIRECT:
+        sym = st->t.value.symbol;
+        if (is_field(st->t)
+            || st->t.offset
+            || !sym->index
+            || sym->linkage != LINK_NONE
+            || is_address_taken(sym)
+            || find_stride(sym)
+            || find_reduction(sym))
+        {
+            return 0;
+        }
+        if (live & (1ul << (sym->index - 1))) {
+            return !find_lane(sym) && check_reduction(st);
+        }
+        if (!type_equal(st->t.type, st->expr.type)
+            || !check_lane_expression(st->expr))
+        {
+            return 0;
+        }
+        if (!find_lane(sym)) {
+            lane.sym = sym;
+            array_push_back(&lanes, lane);
+        }
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/*
+ * Stride variables can only be read in their own update, the exit test,
+ * or as pointers to memory accessed.
+ */
+static int reads_stride(const struct statement *st)
+{
+    int i;
+    const struct symbol *sym;
+
+    if (stride_step(st))
+        return 0;
+
+    for (i = 0; i < array_len(&strides); ++i) {
+        sym = array_get(&strides, i).sym;
+        if ((st->expr.l.kind != DEREF && reads_symbol(st->expr.l, sym))
+            || (!is_unary(st->expr.op)
+                && st->expr.r.kind != DEREF
+                && reads_symbol(st->expr.r, sym)))
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Take element type from the first memory access in the loop body.
+ * Vectors of bool and long double are not supported.
+ */
+static int find_element_type(struct definition *def)
+{
+    int i, j;
+    Type type;
+    struct block *block;
+    struct statement *st;
+
+    for (i = 0; i < array_len(&body); ++i) {
+        block = array_get(&body, i);
+        for (j = 0; j < block->count; ++j) {
+            st = &array_get(&def->statements, block->head + j);
+            if (st->st == IR_ASSIGN && st->t.kind == DEREF) {
+                type = st->t.type;
+            } else if (st->expr.l.kind == DEREF) {
+                type = st->expr.l.type;
+            } else if (!is_unary(st->expr.op) && st->expr.r.kind == DEREF) {
+                type = st->expr.r.type;
+            } else continue;
+
+            if (is_bool(type) || is_long_double(type) || !is_arithmetic(type))
+                return 0;
+
+            element = type_unqualified(type);
+            width = size_of(element);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static int analyze_loop(struct definition *def, const struct loop *loop)
+{
+    int i, j;
+    long step;
+    struct block *block;
+    struct statement *st;
+    struct stride s = {0};
+
+    array_empty(&strides);
+    array_empty(&lanes);
+    array_empty(&broadcasts);
+    array_empty(&reductions);
+    array_empty(&accesses);
+    if (!collect_body(loop))
+        return 0;
+
+    for (i = 0; i < array_len(&body); ++i) {
+        block = array_get(&body, i);
+        for (j = 0; j < block->count; ++j) {
+            st = &array_get(&def->statements, block->head + j);
+            step = stride_step(st);
+            if (step) {
+                s.sym = st->t.value.symbol;
+                s.step = step;
+                array_push_back(&strides, s);
+            }
+        }
+    }
+
+    if (!match_exit_test(loop) || !find_element_type(def))
+        return 0;
+
+    for (i = 0; i < array_len(&body); ++i) {
+        block = array_get(&body, i);
+        for (j = 0; j < block->count; ++j) {
+            st = &array_get(&def->statements, block->head + j);
+            if (reads_stride(st) || !check_lane_statement(st, loop->header->in))
+                return 0;
+        }
+    }
+
+    for (i = 0; i < array_len(&strides); ++i) {
+        s = array_get(&strides, i);
+        if (!is_pointer(s.sym->type) && s.sym != counter)
+            return 0;
+    }
+
+    for (i = 0; i < array_len(&accesses); ++i) {
+        if (array_get(&accesses, i).store)
+            return 1;
+    }
+
+    return array_len(&reductions) > 0;
+}
+
+/*
+ * Pairs of pointers which must be checked for overlap, where at least
+ * one of them is written to.
+ */
+static int is_alias_pair(int i, int j)
+{
+    return i < j
+        && (array_get(&accesses, i).store || array_get(&accesses, j).store);
+}
+
+static int alias_checks(void)
+{
+    int i, j, n;
+
+    for (i = 0, n = 0; i < array_len(&accesses); ++i) {
+        for (j = 0; j < array_len(&accesses); ++j) {
+            n += is_alias_pair(i, j);
+        }
+    }
+
+    return n;
+}
+
+/*
+ * Copy operand to all lanes of vector. The first element is assigned,
+ * and then doubled until the vector is filled.
+ */
+static void emit_broadcast(
+    struct definition *def,
+    struct block *block,
+    struct broadcast *b)
+{
+    int n;
+    struct var x;
+    struct expression expr;
+    static const Type *part[] = {
+        NULL,
+        &basic_type__char,
+        &basic_type__short,
+        NULL,
+        &basic_type__int,
+        NULL,
+        NULL,
+        NULL,
+        &basic_type__long
+    };
+
+    x = b->var;
+    if (is_real(element)) {
+        x.type = element;
+        expr = as_expr(x);
+    } else {
+        expr = cast(element, x);
+    }
+
+    append(def, block, vector_slice(b->vec, element, 0), expr);
+    for (n = width; n < VECTOR_SIZE; n *= 2) {
+        append(def, block,
+            vector_slice(b->vec, *part[n], n),
+            as_expr(vector_slice(b->vec, *part[n], 0)));
+    }
+}
+
+/* Initialize accumulator with identity of the reduction operation. */
+static void emit_accumulator(
+    struct definition *def,
+    struct block *block,
+    struct reduction *r)
+{
+    long identity;
+
+    identity = (r->op == IR_OP_AND) ? -1 : 0;
+    append(def, block,
+        vector_slice(r->acc, basic_type__long, 0),
+        as_expr(long_immediate(identity)));
+    append(def, block,
+        vector_slice(r->acc, basic_type__long, 8),
+        as_expr(vector_slice(r->acc, basic_type__long, 0)));
+}
+
+/*
+ * Branch to next block if pointers are equal, or at least a vector size
+ * apart. Compute |w - a| - 1, and compare unsigned.
+ */
+static void emit_alias_check(
+    struct definition *def,
+    struct block *block,
+    const struct symbol *w,
+    const struct symbol *a,
+    const struct symbol *d,
+    const struct symbol *m)
+{
+    struct var vd, vm, vw, va;
+
+    vd = var_direct(d);
+    vm = var_direct(m);
+    vw = var_direct(w);
+    va = var_direct(a);
+    vw.type = basic_type__long;
+    va.type = basic_type__long;
+    append(def, block, vd,
+        operation(IR_OP_SUB, basic_type__long, vw, va));
+    append(def, block, vm,
+        operation(IR_OP_SHR, basic_type__long, vd, long_immediate(63)));
+    append(def, block, vd,
+        operation(IR_OP_XOR, basic_type__long, vd, vm));
+    append(def, block, vd,
+        operation(IR_OP_SUB, basic_type__long, vd, vm));
+    append(def, block, vd,
+        operation(IR_OP_SUB, basic_type__long, vd, long_immediate(1)));
+    vd.type = basic_type__unsigned_long;
+    block->expr = operation(IR_OP_GT, basic_type__int, vd,
+        long_immediate(VECTOR_SIZE - 2));
+    block->expr.r.type = basic_type__unsigned_long;
+}
+
+static struct var lane_operand(struct var var, Type type)
+{
+    struct lane *l;
+    struct broadcast *b;
+
+    switch (var.kind) {
+    case DEREF:
+        var.type = type;
+        return var;
+    case DIRECT:
+        l = find_lane(var.value.symbol);
+        if (l) {
+            return var_direct(l->vec);
+        }
+    default:
+        b = find_broadcast(var);
+        assert(b);
+        return var_direct(b->vec);
+    }
+}
+
+static struct expression lane_expression(struct expression expr, Type type)
+{
+    if (expr.op == IR_OP_CAST) {
+        return as_expr(lane_operand(expr.l, type));
+    }
+
+    return operation(expr.op, type,
+        lane_operand(expr.l, type),
+        lane_operand(expr.r, type));
+}
+
+/* Translate statement in loop body to operate on vectors. */
+static void emit_vector_statement(
+    struct definition *def,
+    struct block *block,
+    const struct statement *st,
+    Type type,
+    int count)
+{
+    struct var t;
+    struct lane *l;
+    struct reduction *r;
+    struct expression expr;
+
+    if (stride_step(st)) {
+        expr = st->expr;
+        expr.r.value.imm.i *= count;
+        append(def, block, st->t, expr);
+        return;
+    }
+
+    if (st->t.kind == DEREF) {
+        t = st->t;
+        t.type = type;
+        append(def, block, t, lane_expression(st->expr, type));
+        return;
+    }
+
+    r = find_reduction(st->t.value.symbol);
+    if (r) {
+        t = var_direct(r->acc);
+        expr = st->expr;
+        if (is_plain_symbol(expr.l, r->sym)) {
+            expr.r = lane_operand(expr.r, type);
+        } else {
+            expr.r = lane_operand(expr.l, type);
+        }
+        expr.l = t;
+        expr.type = type;
+        append(def, block, t, expr);
+        return;
+    }
+
+    l = find_lane(st->t.value.symbol);
+    assert(l);
+    append(def, block, var_direct(l->vec), lane_expression(st->expr, type));
+}
+
+/* Combine lanes of accumulator with the scalar result. */
+static void emit_reduction(
+    struct definition *def,
+    struct block *block,
+    struct reduction *r,
+    int count)
+{
+    int i;
+    enum optype op;
+    struct var s;
+
+    s = var_direct(r->sym);
+    op = (r->op == IR_OP_SUB) ? IR_OP_ADD : r->op;
+    for (i = 0; i < count; ++i) {
+        append(def, block, s, operation(op, r->sym->type, s,
+            vector_slice(r->acc, r->sym->type, i * width)));
+    }
+}
+
+INTERNAL int vectorize_loop(
+    struct definition *def,
+    struct loop *loop,
+    int temporaries)
+{
+    int i, j, n, count, checks;
+    long step;
+    Type type;
+    struct var vend, pos;
+    struct block *pre, *init, *prev, *next, *head, *exit;
+    struct statement *st;
+    struct symbol *d, *m;
+    struct lane *l;
+    struct broadcast *b;
+    struct reduction *r;
+
+    if (context.no_sse
+        || count_assignments(def, loop)
+        || !analyze_loop(def, loop))
+    {
+        return 0;
+    }
+
+    checks = alias_checks();
+    n = 1 + (checks ? 2 : 0) + !is_pointer(counter->type)
+        + array_len(&lanes)
+        + array_len(&broadcasts)
+        + array_len(&reductions);
+    if (n > temporaries)
+        return 0;
+
+    count = VECTOR_SIZE / width;
+    type = type_create_vector(element, VECTOR_SIZE);
+    for (i = 0; i < array_len(&lanes); ++i) {
+        l = &array_get(&lanes, i);
+        l->vec = vector_temporary(def, type, 0);
+    }
+
+    for (i = 0; i < array_len(&broadcasts); ++i) {
+        b = &array_get(&broadcasts, i);
+        b->vec = vector_temporary(def, type, 0);
+    }
+
+    for (i = 0; i < array_len(&reductions); ++i) {
+        r = &array_get(&reductions, i);
+        r->acc = vector_temporary(def, type, 0);
+    }
+
+    pre = loop_preheader(def, loop);
+    assert(pre->jump[0] == loop->header);
+    assert(!pre->jump[1]);
+    init = loop_create_block(def, loop);
+    pre->jump[0] = init;
+
+    /*
+     * Run vector loop while bound - (count - 1) * step > counter,
+     * computed as long to not overflow for int counters.
+     */
+    step = find_stride(counter)->step;
+    vend = var_direct(vector_temporary(def, basic_type__long, 1));
+    if (bound.kind == IMMEDIATE) {
+        append(def, init, vend,
+            as_expr(long_immediate(bound.value.imm.i - (count - 1) * step)));
+    } else {
+        append(def, init, vend, is_pointer(counter->type)
+            ? as_expr(bound)
+            : cast(basic_type__long, bound));
+        append(def, init, vend, operation(IR_OP_SUB, basic_type__long,
+            vend, long_immediate((count - 1) * step)));
+    }
+
+    for (i = 0; i < array_len(&broadcasts); ++i) {
+        emit_broadcast(def, init, &array_get(&broadcasts, i));
+    }
+
+    for (i = 0; i < array_len(&reductions); ++i) {
+        emit_accumulator(def, init, &array_get(&reductions, i));
+    }
+
+    exit = loop_create_block(def, loop);
+    exit->jump[0] = loop->header;
+    for (i = 0; i < array_len(&reductions); ++i) {
+        emit_reduction(def, exit, &array_get(&reductions, i), count);
+    }
+
+    prev = init;
+    if (checks) {
+        d = vector_temporary(def, basic_type__long, 0);
+        m = vector_temporary(def, basic_type__long, 0);
+        for (i = 0; i < array_len(&accesses); ++i) {
+            for (j = 0; j < array_len(&accesses); ++j) {
+                if (!is_alias_pair(i, j))
+                    continue;
+
+                next = loop_create_block(def, loop);
+                prev->jump[prev != init] = next;
+                emit_alias_check(def, next,
+                    array_get(&accesses, i).ptr,
+                    array_get(&accesses, j).ptr, d, m);
+                next->jump[0] = exit;
+                prev = next;
+            }
+        }
+    }
+
+    head = loop_create_block(def, loop);
+    prev->jump[prev != init] = head;
+    pos = var_direct(counter);
+    if (is_pointer(counter->type)) {
+        pos.type = basic_type__long;
+    } else {
+        pos = var_direct(vector_temporary(def, basic_type__long, 1));
+        append(def, head, pos, cast(basic_type__long, var_direct(counter)));
+    }
+
+    head->expr = operation(strict ? IR_OP_GT : IR_OP_GE,
+        basic_type__int, vend, pos);
+    head->jump[0] = exit;
+    next = loop_create_block(def, loop);
+    head->jump[1] = next;
+    next->jump[0] = head;
+    for (i = 0; i < array_len(&body); ++i) {
+        for (j = 0; j < array_get(&body, i)->count; ++j) {
+            st = &array_get(&def->statements, array_get(&body, i)->head + j);
+            emit_vector_statement(def, next, st, type, count);
+        }
+    }
+
+    return 1;
+}
+
+INTERNAL void vectorize_finalize(void)
+{
+    array_clear(&strides);
+    array_clear(&lanes);
+    array_clear(&broadcasts);
+    array_clear(&reductions);
+    array_clear(&body);
+    array_clear(&accesses);
+}
@@ -0,0 +1,50 @@
+#ifndef VECTORIZE_H
+#define VECTORIZE_H
+
+#include "loop.h"
+
+#include <lacc/ir.h>
+
+/*
+ * Vectorize counted loop with a single exit test in the header, and a
+ * straight line body reading and writing arrays through pointers that
+ * advance one element each iteration.
+ *
+ *   .L1:
+ *      if .end > .p goto .L2
+ *   .L2:
+ *      *.p = *.q + *.r
+ *      .p = .p + 4
+ *      .q = .q + 4
+ *      .r = .r + 4
+ *
+ * A new loop processing 16 bytes per iteration with packed SSE2
+ * instructions is inserted in front, leaving the original loop to
+ * handle the remaining elements.
+ *
+ *   .L3:
+ *      if .end - 12 > .p goto .L4
+ *   .L4:
+ *      *.p [vector(16) int] = *.q + *.r
+ *      .p = .p + 16
+ *      .q = .q + 16
+ *      .r = .r + 16
+ *
+ * Values computed in the body cannot be carried between iterations,
+ * except integer reductions like s = s + *.p, which are accumulated
+ * separately for each lane and combined after the vector loop. The
+ * vector loop is skipped if pointers written are within 16 bytes of
+ * other pointers accessed in the loop.
+ *
+ * Liveness must be up to date. At most the given number of temporaries
+ * are created. Return non-zero if the loop was vectorized.
+ */
+INTERNAL int vectorize_loop(
+    struct definition *def,
+    struct loop *loop,
+    int temporaries);
+
+/* Free memory used for vectorization. */
+INTERNAL void vectorize_finalize(void);
+
+#endif
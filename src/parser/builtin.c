@@ -12,6 +12,15 @@
 #include <lacc/context.h>
 #include <lacc/token.h>
 
+#include <assert.h>
+#include <string.h>
+
+/*
+ * Probability of __builtin_expect being right, if not given explicitly.
+ * This is the same as assumed by GCC.
+ */
+#define EXPECT_PROBABILITY 0.9
+
 /*
  * Return 1 iff expression is a constant.
  *
@@ -103,6 +112,735 @@ static struct block *parse__builtin_va_arg(
     return block;
 }
 
+/*
+ * Bit manipulation builtins, evaluated as IR operations with operand
+ * converted to the parameter type of given size. Parity is computed
+ * from population count.
+ */
+static const struct bit_builtin {
+    const char *name;
+    enum optype op;
+    int size;
+    unsigned int is_signed : 1;
+    unsigned int is_parity : 1;
+} bit_builtins[] = {
+    {"__builtin_popcount", IR_OP_POPCOUNT, 4},
+    {"__builtin_popcountl", IR_OP_POPCOUNT, 8},
+    {"__builtin_popcountll", IR_OP_POPCOUNT, 8},
+    {"__builtin_parity", IR_OP_POPCOUNT, 4, 0, 1},
+    {"__builtin_parityl", IR_OP_POPCOUNT, 8, 0, 1},
+    {"__builtin_parityll", IR_OP_POPCOUNT, 8, 0, 1},
+    {"__builtin_clz", IR_OP_CLZ, 4},
+    {"__builtin_clzl", IR_OP_CLZ, 8},
+    {"__builtin_clzll", IR_OP_CLZ, 8},
+    {"__builtin_ctz", IR_OP_CTZ, 4},
+    {"__builtin_ctzl", IR_OP_CTZ, 8},
+    {"__builtin_ctzll", IR_OP_CTZ, 8},
+    {"__builtin_ffs", IR_OP_FFS, 4, 1},
+    {"__builtin_ffsl", IR_OP_FFS, 8, 1},
+    {"__builtin_ffsll", IR_OP_FFS, 8, 1},
+    {"__builtin_bswap16", IR_OP_BSWAP, 2},
+    {"__builtin_bswap32", IR_OP_BSWAP, 4},
+    {"__builtin_bswap64", IR_OP_BSWAP, 8},
+    {"__builtin_rotateleft8", IR_OP_ROL, 1},
+    {"__builtin_rotateleft16", IR_OP_ROL, 2},
+    {"__builtin_rotateleft32", IR_OP_ROL, 4},
+    {"__builtin_rotateleft64", IR_OP_ROL, 8},
+    {"__builtin_rotateright8", IR_OP_ROR, 1},
+    {"__builtin_rotateright16", IR_OP_ROR, 2},
+    {"__builtin_rotateright32", IR_OP_ROR, 4},
+    {"__builtin_rotateright64", IR_OP_ROR, 8}
+};
+
+static Type bit_builtin_type(const struct bit_builtin *builtin)
+{
+    switch (builtin->size) {
+    default: assert(0);
+    case 1:
+        return basic_type__unsigned_char;
+    case 2:
+        return basic_type__unsigned_short;
+    case 4:
+        return builtin->is_signed ? basic_type__int : basic_type__unsigned_int;
+    case 8:
+        return builtin->is_signed ? basic_type__long : basic_type__unsigned_long;
+    }
+}
+
+/*
+ * Parse call to one of the bit manipulation builtins, determined by the
+ * identifier just consumed.
+ */
+static struct block *parse__builtin_bits(
+    struct definition *def,
+    struct block *block)
+{
+    int i, n;
+    Type type;
+    String name;
+    struct var l, r;
+    const struct bit_builtin *builtin;
+
+    name = access_token(0)->d.string;
+    n = sizeof(bit_builtins) / sizeof(bit_builtins[0]);
+    for (i = 0; i < n; ++i) {
+        if (!strcmp(str_raw(name), bit_builtins[i].name))
+            break;
+    }
+
+    assert(i < n);
+    builtin = &bit_builtins[i];
+    type = bit_builtin_type(builtin);
+    consume('(');
+    block = assignment_expression(def, block);
+    l = eval(def, block, block->expr);
+    if (builtin->op == IR_OP_ROL || builtin->op == IR_OP_ROR) {
+        consume(',');
+        block = assignment_expression(def, block);
+        r = eval(def, block, block->expr);
+        block->expr = eval_rotate(def, block, builtin->op, type, l, r);
+    } else {
+        block->expr = eval_bit_operation(def, block, builtin->op, type, l);
+        if (builtin->is_parity) {
+            l = eval(def, block, block->expr);
+            block->expr = eval_and(def, block, l, var_int(1));
+        }
+    }
+
+    consume(')');
+    return block;
+}
+
+/*
+ * Parse constant argument to builtin, without evaluating any code.
+ * Return 1 if the result is an immediate arithmetic value.
+ */
+static int parse_constant_argument(struct var *value)
+{
+    struct block *head, *tail;
+
+    head = cfg_block_init(NULL);
+    tail = assignment_expression(NULL, head);
+    if (tail != head || !is_immediate(tail->expr)) {
+        return 0;
+    }
+
+    *value = tail->expr.l;
+    return is_arithmetic(value->type);
+}
+
+static double immediate_probability(struct var value)
+{
+    switch (type_of(value.type)) {
+    case T_FLOAT:
+        return value.value.imm.f;
+    case T_DOUBLE:
+        return value.value.imm.d;
+    case T_LDOUBLE:
+        return get_long_double(value.value.imm);
+    default:
+        return is_signed(value.type)
+            ? (double) value.value.imm.i
+            : (double) value.value.imm.u;
+    }
+}
+
+/*
+ * Parse __builtin_expect(exp, c), or the same with probability as a
+ * third argument. The result is exp converted to long, but comparisons
+ * are kept as is to be used directly as branch condition. The expected
+ * value is only used as hint if it is an integer constant.
+ */
+static struct block *parse__builtin_expect(
+    struct definition *def,
+    struct block *block)
+{
+    int has_hint;
+    double p;
+    String name;
+    struct var value, c;
+
+    name = access_token(0)->d.string;
+    consume('(');
+    block = assignment_expression(def, block);
+    if (!is_comparison(block->expr)) {
+        value = eval(def, block, block->expr);
+        block->expr = eval_cast(def, block, value, basic_type__long);
+    }
+
+    consume(',');
+    has_hint = parse_constant_argument(&c) && is_integer(c.type);
+    p = EXPECT_PROBABILITY;
+    if (!strcmp(str_raw(name), "__builtin_expect_with_probability")) {
+        consume(',');
+        if (!parse_constant_argument(&value)
+            || (p = immediate_probability(value)) < 0.0
+            || p > 1.0)
+        {
+            error("Probability must be a constant in the range [0, 1].");
+            exit(1);
+        }
+    }
+
+    consume(')');
+    if (has_hint) {
+        eval_expect(block, c.value.imm.u != 0, p);
+    }
+
+    return block;
+}
+
+/*
+ * Parse __builtin_prefetch(addr, rw, locality), where the last two
+ * arguments are optional constants. The default is to prefetch for
+ * reading, with high temporal locality.
+ */
+static struct block *parse__builtin_prefetch(
+    struct definition *def,
+    struct block *block)
+{
+    int rw, locality;
+    struct var addr, value;
+
+    rw = 0;
+    locality = 3;
+    consume('(');
+    block = assignment_expression(def, block);
+    addr = create_var(def,
+        type_create_pointer(type_set_const(basic_type__void)));
+    addr = eval_assign(def, block, addr, block->expr);
+
+    if (try_consume(',')) {
+        if (!parse_constant_argument(&value)
+            || !is_integer(value.type)
+            || (value.value.imm.u != 0 && value.value.imm.u != 1))
+        {
+            error("Prefetch read/write argument must be 0 or 1.");
+            exit(1);
+        }
+
+        rw = value.value.imm.i;
+        if (try_consume(',')) {
+            if (!parse_constant_argument(&value)
+                || !is_integer(value.type)
+                || value.value.imm.u > 3)
+            {
+                error("Prefetch locality must be in the range [0, 3].");
+                exit(1);
+            }
+
+            locality = value.value.imm.i;
+        }
+    }
+
+    consume(')');
+    eval__builtin_prefetch(def, block, addr, rw, locality);
+    block->expr = as_expr(var_void());
+    return block;
+}
+
+/*
+ * Memory order constants, matching predefined __ATOMIC_* macros.
+ */
+enum memory_order {
+    MO_RELAXED,
+    MO_CONSUME,
+    MO_ACQUIRE,
+    MO_RELEASE,
+    MO_ACQ_REL,
+    MO_SEQ_CST
+};
+
+/*
+ * Atomic builtins operate on integer or pointer objects of size 1, 2, 4
+ * or 8. Loads and read-modify-write operations are the same for every
+ * memory order on x86_64, only stores and fences are affected.
+ */
+static const struct atomic_builtin {
+    const char *name;
+    enum {
+        A_LOAD,                 /* (ptr, order) */
+        A_LOAD_PTR,             /* (ptr, ret, order) */
+        A_STORE,                /* (ptr, val, order) */
+        A_STORE_PTR,            /* (ptr, val, order) */
+        A_EXCHANGE,             /* (ptr, val, order) */
+        A_EXCHANGE_PTR,         /* (ptr, val, ret, order) */
+        A_COMPARE_EXCHANGE,     /* (ptr, expected, desired, weak, s, f) */
+        A_COMPARE_EXCHANGE_PTR, /* (ptr, expected, desired, weak, s, f) */
+        A_FETCH_OP,             /* (ptr, val, order) */
+        A_OP_FETCH,             /* (ptr, val, order) */
+        A_TEST_AND_SET,         /* (ptr, order) */
+        A_CLEAR,                /* (ptr, order) */
+        A_THREAD_FENCE,         /* (order) */
+        A_SIGNAL_FENCE,         /* (order) */
+        A_LOCK_FREE,            /* (size, ptr) */
+        S_FETCH_OP,             /* (ptr, val) */
+        S_OP_FETCH,             /* (ptr, val) */
+        S_BOOL_CAS,             /* (ptr, old, new) */
+        S_VAL_CAS,              /* (ptr, old, new) */
+        S_LOCK_TEST_AND_SET,    /* (ptr, val) */
+        S_LOCK_RELEASE,         /* (ptr) */
+        S_SYNCHRONIZE           /* () */
+    } kind;
+    enum optype op;
+} atomic_builtins[] = {
+    {"__atomic_load_n", A_LOAD},
+    {"__atomic_load", A_LOAD_PTR},
+    {"__atomic_store_n", A_STORE},
+    {"__atomic_store", A_STORE_PTR},
+    {"__atomic_exchange_n", A_EXCHANGE},
+    {"__atomic_exchange", A_EXCHANGE_PTR},
+    {"__atomic_compare_exchange_n", A_COMPARE_EXCHANGE},
+    {"__atomic_compare_exchange", A_COMPARE_EXCHANGE_PTR},
+    {"__atomic_fetch_add", A_FETCH_OP, IR_OP_ADD},
+    {"__atomic_fetch_sub", A_FETCH_OP, IR_OP_SUB},
+    {"__atomic_fetch_and", A_FETCH_OP, IR_OP_AND},
+    {"__atomic_fetch_or", A_FETCH_OP, IR_OP_OR},
+    {"__atomic_fetch_xor", A_FETCH_OP, IR_OP_XOR},
+    {"__atomic_add_fetch", A_OP_FETCH, IR_OP_ADD},
+    {"__atomic_sub_fetch", A_OP_FETCH, IR_OP_SUB},
+    {"__atomic_and_fetch", A_OP_FETCH, IR_OP_AND},
+    {"__atomic_or_fetch", A_OP_FETCH, IR_OP_OR},
+    {"__atomic_xor_fetch", A_OP_FETCH, IR_OP_XOR},
+    {"__atomic_test_and_set", A_TEST_AND_SET},
+    {"__atomic_clear", A_CLEAR},
+    {"__atomic_thread_fence", A_THREAD_FENCE},
+    {"__atomic_signal_fence", A_SIGNAL_FENCE},
+    {"__atomic_always_lock_free", A_LOCK_FREE},
+    {"__atomic_is_lock_free", A_LOCK_FREE},
+    {"__sync_fetch_and_add", S_FETCH_OP, IR_OP_ADD},
+    {"__sync_fetch_and_sub", S_FETCH_OP, IR_OP_SUB},
+    {"__sync_fetch_and_and", S_FETCH_OP, IR_OP_AND},
+    {"__sync_fetch_and_or", S_FETCH_OP, IR_OP_OR},
+    {"__sync_fetch_and_xor", S_FETCH_OP, IR_OP_XOR},
+    {"__sync_add_and_fetch", S_OP_FETCH, IR_OP_ADD},
+    {"__sync_sub_and_fetch", S_OP_FETCH, IR_OP_SUB},
+    {"__sync_and_and_fetch", S_OP_FETCH, IR_OP_AND},
+    {"__sync_or_and_fetch", S_OP_FETCH, IR_OP_OR},
+    {"__sync_xor_and_fetch", S_OP_FETCH, IR_OP_XOR},
+    {"__sync_bool_compare_and_swap", S_BOOL_CAS},
+    {"__sync_val_compare_and_swap", S_VAL_CAS},
+    {"__sync_lock_test_and_set", S_LOCK_TEST_AND_SET},
+    {"__sync_lock_release", S_LOCK_RELEASE},
+    {"__sync_synchronize", S_SYNCHRONIZE}
+};
+
+static int is_atomic_size(size_t size)
+{
+    return size == 1 || size == 2 || size == 4 || size == 8;
+}
+
+/*
+ * Parse pointer to object operated on atomically. Generic variants of
+ * load, store, exchange and compare exchange have the same restriction
+ * on type, as there is no library fallback for larger objects.
+ */
+static struct block *parse_atomic_pointer(
+    struct definition *def,
+    struct block *block,
+    struct var *ptr)
+{
+    Type type;
+
+    block = assignment_expression(def, block);
+    *ptr = rvalue(def, block, eval(def, block, block->expr));
+    if (!is_pointer(ptr->type)) {
+        error("Atomic operation requires a pointer, was %t.", ptr->type);
+        exit(1);
+    }
+
+    type = type_deref(ptr->type);
+    if ((!is_integer(type) && !is_pointer(type))
+        || !is_atomic_size(size_of(type)))
+    {
+        error("Atomic operation on %t is not supported.", type);
+        exit(1);
+    }
+
+    return block;
+}
+
+static struct block *parse_atomic_value(
+    struct definition *def,
+    struct block *block,
+    struct var *value)
+{
+    block = assignment_expression(def, block);
+    *value = rvalue(def, block, eval(def, block, block->expr));
+    return block;
+}
+
+/*
+ * Parse value through pointer to object of the same type as operated
+ * on, as used by the generic atomic builtins.
+ */
+static struct block *parse_atomic_reference(
+    struct definition *def,
+    struct block *block,
+    struct var ptr,
+    struct var *ref)
+{
+    block = assignment_expression(def, block);
+    *ref = eval_deref(def, block, eval(def, block, block->expr));
+    if (!type_equal_unqualified(ref->type, type_deref(ptr.type))) {
+        error("Atomic operand %t does not match object type %t.",
+            ref->type, type_deref(ptr.type));
+        exit(1);
+    }
+
+    return block;
+}
+
+/*
+ * Memory order is usually a constant, otherwise the strongest order is
+ * assumed after evaluating the argument.
+ */
+static struct block *parse_memory_order(
+    struct definition *def,
+    struct block *block,
+    enum memory_order *order)
+{
+    struct var value;
+
+    block = assignment_expression(def, block);
+    if (is_immediate(block->expr)
+        && is_integer(block->expr.type)
+        && block->expr.l.value.imm.u <= MO_SEQ_CST)
+    {
+        *order = block->expr.l.value.imm.u;
+    } else {
+        value = eval(def, block, block->expr);
+        if (!is_integer(value.type)) {
+            error("Memory order must be an integer, was %t.", value.type);
+            exit(1);
+        }
+        *order = MO_SEQ_CST;
+    }
+
+    return block;
+}
+
+/* Sequentially consistent store is done by exchange. */
+static void atomic_store(
+    struct definition *def,
+    struct block *block,
+    struct var ptr,
+    struct var value,
+    enum memory_order order)
+{
+    enum optype op;
+
+    op = (order == MO_SEQ_CST) ? IR_OP_ATOMIC_XCHG : IR_OP_ATOMIC_STORE;
+    eval_expression_statement(def, block,
+        eval_atomic(def, block, op, ptr, value));
+}
+
+/*
+ * Fetch and apply operation, yielding either the old or new value. Sub
+ * is done by adding the negated value.
+ */
+static struct expression atomic_fetch_op(
+    struct definition *def,
+    struct block *block,
+    enum optype op,
+    struct var ptr,
+    struct var value,
+    int is_new_value)
+{
+    Type type;
+    struct var old;
+    struct expression expr;
+
+    switch (op) {
+    default: assert(0);
+    case IR_OP_SUB:
+        value = eval(def, block, eval_neg(def, block, value));
+    case IR_OP_ADD:
+        expr = eval_atomic(def, block, IR_OP_ATOMIC_ADD, ptr, value);
+        break;
+    case IR_OP_AND:
+        expr = eval_atomic(def, block, IR_OP_ATOMIC_AND, ptr, value);
+        break;
+    case IR_OP_OR:
+        expr = eval_atomic(def, block, IR_OP_ATOMIC_OR, ptr, value);
+        break;
+    case IR_OP_XOR:
+        expr = eval_atomic(def, block, IR_OP_ATOMIC_XOR, ptr, value);
+        break;
+    }
+
+    if (!is_new_value) {
+        return expr;
+    }
+
+    type = expr.type;
+    value = expr.r;
+    old = eval(def, block, expr);
+    if (is_pointer(type)) {
+        old = eval(def, block, eval_cast(def, block, old, value.type));
+    }
+
+    switch (expr.op) {
+    default: assert(0);
+    case IR_OP_ATOMIC_ADD:
+        expr = eval_add(def, block, old, value);
+        break;
+    case IR_OP_ATOMIC_AND:
+        expr = eval_and(def, block, old, value);
+        break;
+    case IR_OP_ATOMIC_OR:
+        expr = eval_or(def, block, old, value);
+        break;
+    case IR_OP_ATOMIC_XOR:
+        expr = eval_xor(def, block, old, value);
+        break;
+    }
+
+    return eval_cast(def, block, eval(def, block, expr), type);
+}
+
+/*
+ * Compare and swap, writing the value found back to expected if it was
+ * not equal. Result is a new block where the success flag is the
+ * expression.
+ */
+static struct block *atomic_compare_exchange(
+    struct definition *def,
+    struct block *block,
+    struct var ptr,
+    struct var expected,
+    struct var desired)
+{
+    struct var ok, old, cur;
+    struct block *fail, *next;
+
+    cur = eval_copy(def, block, expected);
+    old = eval_atomic_cas(def, block, ptr, cur, desired);
+    ok = create_var(def, basic_type__bool);
+    eval_assign(def, block, ok, eval_cmp_eq(def, block, old, cur));
+
+    fail = cfg_block_init(def);
+    next = cfg_block_init(def);
+    block->expr = as_expr(ok);
+    block->jump[0] = fail;
+    block->jump[1] = next;
+    eval_assign(def, fail, expected, as_expr(old));
+    fail->jump[0] = next;
+    next->expr = as_expr(ok);
+    return next;
+}
+
+/*
+ * Parse call to one of the __atomic or __sync builtins, determined by
+ * the identifier just consumed. Operations only supported by libatomic,
+ * and nand, are not implemented.
+ */
+static struct block *parse__builtin_atomic(
+    struct definition *def,
+    struct block *block)
+{
+    int i, n;
+    Type type;
+    String name;
+    enum memory_order order;
+    struct var ptr, value, ref, old;
+    const struct atomic_builtin *builtin;
+
+    name = access_token(0)->d.string;
+    n = sizeof(atomic_builtins) / sizeof(atomic_builtins[0]);
+    for (i = 0; i < n; ++i) {
+        if (!strcmp(str_raw(name), atomic_builtins[i].name))
+            break;
+    }
+
+    assert(i < n);
+    builtin = &atomic_builtins[i];
+    consume('(');
+    switch (builtin->kind) {
+    case A_LOAD:
+        block = parse_atomic_pointer(def, block, &ptr);
+        consume(',');
+        block = parse_memory_order(def, block, &order);
+        block->expr =
+            eval_atomic(def, block, IR_OP_ATOMIC_LOAD, ptr, var_void());
+        break;
+    case A_LOAD_PTR:
+        block = parse_atomic_pointer(def, block, &ptr);
+        consume(',');
+        block = parse_atomic_reference(def, block, ptr, &ref);
+        consume(',');
+        block = parse_memory_order(def, block, &order);
+        old = eval(def, block,
+            eval_atomic(def, block, IR_OP_ATOMIC_LOAD, ptr, var_void()));
+        eval_assign(def, block, ref, as_expr(old));
+        block->expr = as_expr(var_void());
+        break;
+    case A_STORE:
+    case A_STORE_PTR:
+        block = parse_atomic_pointer(def, block, &ptr);
+        consume(',');
+        if (builtin->kind == A_STORE) {
+            block = parse_atomic_value(def, block, &value);
+        } else {
+            block = parse_atomic_reference(def, block, ptr, &value);
+        }
+        consume(',');
+        block = parse_memory_order(def, block, &order);
+        atomic_store(def, block, ptr, value, order);
+        block->expr = as_expr(var_void());
+        break;
+    case A_EXCHANGE:
+        block = parse_atomic_pointer(def, block, &ptr);
+        consume(',');
+        block = parse_atomic_value(def, block, &value);
+        consume(',');
+        block = parse_memory_order(def, block, &order);
+        block->expr = eval_atomic(def, block, IR_OP_ATOMIC_XCHG, ptr, value);
+        break;
+    case A_EXCHANGE_PTR:
+        block = parse_atomic_pointer(def, block, &ptr);
+        consume(',');
+        block = parse_atomic_reference(def, block, ptr, &value);
+        consume(',');
+        block = parse_atomic_reference(def, block, ptr, &ref);
+        consume(',');
+        block = parse_memory_order(def, block, &order);
+        old = eval(def, block,
+            eval_atomic(def, block, IR_OP_ATOMIC_XCHG, ptr, value));
+        eval_assign(def, block, ref, as_expr(old));
+        block->expr = as_expr(var_void());
+        break;
+    case A_COMPARE_EXCHANGE:
+    case A_COMPARE_EXCHANGE_PTR:
+        block = parse_atomic_pointer(def, block, &ptr);
+        consume(',');
+        block = parse_atomic_reference(def, block, ptr, &ref);
+        consume(',');
+        if (builtin->kind == A_COMPARE_EXCHANGE) {
+            block = parse_atomic_value(def, block, &value);
+        } else {
+            block = parse_atomic_reference(def, block, ptr, &value);
+        }
+        consume(',');
+        block = parse_memory_order(def, block, &order);
+        consume(',');
+        block = parse_memory_order(def, block, &order);
+        consume(',');
+        block = parse_memory_order(def, block, &order);
+        block = atomic_compare_exchange(def, block, ptr, ref, value);
+        break;
+    case A_FETCH_OP:
+    case A_OP_FETCH:
+    case S_FETCH_OP:
+    case S_OP_FETCH:
+        block = parse_atomic_pointer(def, block, &ptr);
+        consume(',');
+        block = parse_atomic_value(def, block, &value);
+        if (builtin->kind == A_FETCH_OP || builtin->kind == A_OP_FETCH) {
+            consume(',');
+            block = parse_memory_order(def, block, &order);
+        }
+        block->expr = atomic_fetch_op(def, block, builtin->op, ptr, value,
+            builtin->kind == A_OP_FETCH || builtin->kind == S_OP_FETCH);
+        break;
+    case A_TEST_AND_SET:
+    case A_CLEAR:
+        block = parse_atomic_value(def, block, &ptr);
+        if (!is_pointer(ptr.type)) {
+            error("Atomic operation requires a pointer, was %t.", ptr.type);
+            exit(1);
+        }
+        consume(',');
+        block = parse_memory_order(def, block, &order);
+        type = type_create_pointer(basic_type__unsigned_char);
+        ptr = eval(def, block, eval_cast(def, block, ptr, type));
+        if (builtin->kind == A_CLEAR) {
+            atomic_store(def, block, ptr, var_int(0), order);
+            block->expr = as_expr(var_void());
+        } else {
+            old = eval(def, block,
+                eval_atomic(def, block, IR_OP_ATOMIC_XCHG, ptr, var_int(1)));
+            block->expr = eval_cast(def, block, old, basic_type__bool);
+        }
+        break;
+    case A_THREAD_FENCE:
+    case A_SIGNAL_FENCE:
+        block = parse_memory_order(def, block, &order);
+        if (builtin->kind == A_THREAD_FENCE && order == MO_SEQ_CST) {
+            eval_fence(def, block);
+        }
+        block->expr = as_expr(var_void());
+        break;
+    case A_LOCK_FREE:
+        if (!parse_constant_argument(&value) || !is_integer(value.type)) {
+            error("Object size must be an integer constant.");
+            exit(1);
+        }
+        consume(',');
+        assignment_expression(NULL, cfg_block_init(NULL));
+        value = imm_unsigned(basic_type__bool,
+            is_atomic_size(value.value.imm.u));
+        block->expr = as_expr(value);
+        break;
+    case S_BOOL_CAS:
+    case S_VAL_CAS:
+        block = parse_atomic_pointer(def, block, &ptr);
+        consume(',');
+        block = parse_atomic_value(def, block, &ref);
+        consume(',');
+        block = parse_atomic_value(def, block, &value);
+        type = type_unqualified(type_deref(ptr.type));
+        ref = eval(def, block, eval_cast(def, block, ref, type));
+        old = eval_atomic_cas(def, block, ptr, ref, value);
+        if (builtin->kind == S_BOOL_CAS) {
+            block->expr = eval_cmp_eq(def, block, old, ref);
+            old = eval(def, block, block->expr);
+            block->expr = eval_cast(def, block, old, basic_type__bool);
+        } else {
+            block->expr = as_expr(old);
+        }
+        break;
+    case S_LOCK_TEST_AND_SET:
+        block = parse_atomic_pointer(def, block, &ptr);
+        consume(',');
+        block = parse_atomic_value(def, block, &value);
+        block->expr = eval_atomic(def, block, IR_OP_ATOMIC_XCHG, ptr, value);
+        break;
+    case S_LOCK_RELEASE:
+        block = parse_atomic_pointer(def, block, &ptr);
+        atomic_store(def, block, ptr, var_int(0), MO_RELEASE);
+        block->expr = as_expr(var_void());
+        break;
+    case S_SYNCHRONIZE:
+        eval_fence(def, block);
+        block->expr = as_expr(var_void());
+        break;
+    }
+
+    consume(')');
+    return block;
+}
+
+/*
+ * Parse __builtin_unreachable or __builtin_trap. The current block ends
+ * here, and parsing continues in a new block that has no predecessor.
+ */
+static struct block *parse__builtin_unreachable(
+    struct definition *def,
+    struct block *block)
+{
+    String name;
+
+    name = access_token(0)->d.string;
+    consume('(');
+    consume(')');
+    block->unreachable = 1;
+    block->trap = !strcmp(str_raw(name), "__builtin_trap");
+    block = cfg_block_init(def);
+    block->expr = as_expr(var_void());
+    return block;
+}
+
 /*
  * Implement alloca as a normal VLA.
  *
@@ -169,43 +907,140 @@ static void define__builtin_va_list(void)
 /* Save memcpy reference for backend. */
 INTERNAL const struct symbol *decl_memcpy = NULL;
 
+INTERNAL const struct symbol *decl_memset = NULL;
+
+INTERNAL const struct symbol *decl_tls_get_addr = NULL;
+
 /*
  * Code generation uses memcpy when dealing with large blocks of data,
- * so we need a declaration visible in the symbol table.
+ * so we need a declaration visible in the symbol table. The other
+ * memory functions are declared for use by their builtin counterparts.
  *
  *   void *memcpy(void *dest, const void *src, unsigned long n);
+ *   void *memmove(void *dest, const void *src, unsigned long n);
+ *   void *memset(void *s, int c, unsigned long n);
+ *   int memcmp(const void *s1, const void *s2, unsigned long n);
  *
- * If the compiler is invoked with -nostdinc, then it should not be
+ * If the compiler is invoked with -nostdinc, then they should not be
  * included, and backend will use other means to copy.
  */
-static void declare_memcpy(void)
+static void declare_memory_functions(void)
 {
-    Type t, dest, src;
+    Type t, ptr, cptr;
 
     if (context.nostdinc)
         return;
 
-    dest = type_create_pointer(basic_type__void);
-    src = type_set_const(basic_type__void);
-    src = type_create_pointer(src);
+    ptr = type_create_pointer(basic_type__void);
+    cptr = type_create_pointer(type_set_const(basic_type__void));
 
-    t = type_create_function(dest);
-    type_add_member(t, str_c("dest"), dest);
-    type_add_member(t, str_c("src"), src);
+    t = type_create_function(ptr);
+    type_add_member(t, str_c("dest"), ptr);
+    type_add_member(t, str_c("src"), cptr);
     type_add_member(t, str_c("n"), basic_type__unsigned_long);
     type_seal(t);
 
     decl_memcpy =
         sym_add(&ns_ident, str_c("memcpy"), t, SYM_DECLARATION, LINK_EXTERN);
+    sym_add(&ns_ident, str_c("memmove"), t, SYM_DECLARATION, LINK_EXTERN);
+
+    t = type_create_function(ptr);
+    type_add_member(t, str_c("s"), ptr);
+    type_add_member(t, str_c("c"), basic_type__int);
+    type_add_member(t, str_c("n"), basic_type__unsigned_long);
+    type_seal(t);
+    decl_memset =
+        sym_add(&ns_ident, str_c("memset"), t, SYM_DECLARATION, LINK_EXTERN);
+
+    t = type_create_function(basic_type__int);
+    type_add_member(t, str_c("s1"), cptr);
+    type_add_member(t, str_c("s2"), cptr);
+    type_add_member(t, str_c("n"), basic_type__unsigned_long);
+    type_seal(t);
+    sym_add(&ns_ident, str_c("memcmp"), t, SYM_DECLARATION, LINK_EXTERN);
+}
+
+/*
+ * Parse reference to __builtin_memcpy, __builtin_memmove,
+ * __builtin_memset or __builtin_memcmp, which are replaced by the
+ * corresponding library function. The call is parsed as normal, and
+ * expanded inline by the backend if size is constant.
+ */
+static struct block *parse__builtin_memory(
+    struct definition *def,
+    struct block *block)
+{
+    String name;
+    const char *str;
+    struct symbol *sym;
+
+    str = str_raw(access_token(0)->d.string) + strlen("__builtin_");
+    name = str_c(str);
+    sym = sym_lookup(&ns_ident, name);
+    if (!sym) {
+        error("Missing declaration of %s, needed for __builtin_%s.",
+            str, str);
+        exit(1);
+    }
+
+    if (!is_function(sym->type)) {
+        error("Expected %s to be a function, needed for __builtin_%s.",
+            str, str);
+        exit(1);
+    }
+
+    block->expr = as_expr(var_direct(sym));
+    return block;
+}
+
+/*
+ * Thread local variables in position independent code are resolved by
+ * the dynamic linker through a call to
+ *
+ *   void *__tls_get_addr(void *ti);
+ *
+ */
+static void declare_tls_get_addr(void)
+{
+    Type t, ptr;
+
+    ptr = type_create_pointer(basic_type__void);
+    t = type_create_function(ptr);
+    type_add_member(t, str_c("ti"), ptr);
+    type_seal(t);
+    decl_tls_get_addr = sym_add(&ns_ident,
+        str_c("__tls_get_addr"), t, SYM_DECLARATION, LINK_EXTERN);
 }
 
 INTERNAL void register_builtins(void)
 {
+    int i;
+
     define__builtin_va_list();
     sym_create_builtin(str_c("__builtin_alloca"), parse__builtin_alloca);
     sym_create_builtin(str_c("__builtin_va_start"), parse__builtin_va_start);
     sym_create_builtin(str_c("__builtin_va_arg"), parse__builtin_va_arg);
     sym_create_builtin(str_c("__builtin_constant_p"), parse__builtin_constant_p);
+    sym_create_builtin(str_c("__builtin_expect"), parse__builtin_expect);
+    sym_create_builtin(str_c("__builtin_expect_with_probability"),
+        parse__builtin_expect);
+    sym_create_builtin(str_c("__builtin_prefetch"), parse__builtin_prefetch);
+    sym_create_builtin(str_c("__builtin_unreachable"),
+        parse__builtin_unreachable);
+    sym_create_builtin(str_c("__builtin_trap"), parse__builtin_unreachable);
+    for (i = 0; i < sizeof(bit_builtins) / sizeof(bit_builtins[0]); ++i) {
+        sym_create_builtin(str_c(bit_builtins[i].name), parse__builtin_bits);
+    }
+
+    for (i = 0; i < sizeof(atomic_builtins) / sizeof(atomic_builtins[0]); ++i) {
+        sym_create_builtin(str_c(atomic_builtins[i].name),
+            parse__builtin_atomic);
+    }
 
-    declare_memcpy();
+    sym_create_builtin(str_c("__builtin_memcpy"), parse__builtin_memory);
+    sym_create_builtin(str_c("__builtin_memmove"), parse__builtin_memory);
+    sym_create_builtin(str_c("__builtin_memset"), parse__builtin_memory);
+    sym_create_builtin(str_c("__builtin_memcmp"), parse__builtin_memory);
+    declare_memory_functions();
+    declare_tls_get_addr();
 }
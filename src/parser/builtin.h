@@ -9,4 +9,10 @@
  */
 INTERNAL void register_builtins(void);
 
+/*
+ * Holds the declaration for memset, used to clear large objects. Not
+ * set if compiling with -nostdinc.
+ */
+EXTERNAL const struct symbol *decl_memset;
+
 #endif
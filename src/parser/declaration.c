@@ -10,10 +10,13 @@
 #include "statement.h"
 #include "symtab.h"
 #include "typetree.h"
+#include <lacc/array.h>
 #include <lacc/context.h>
 #include <lacc/token.h>
 
 #include <assert.h>
+#include <limits.h>
+#include <string.h>
 
 static const Type *get_typedef(String str)
 {
@@ -27,6 +30,177 @@ static const Type *get_typedef(String str)
     return NULL;
 }
 
+/*
+ * Compare attribute name, which can also be written with surrounding
+ * double underscores. For example, __aligned__ is the same as aligned.
+ */
+static int is_attribute(String str, const char *name)
+{
+    size_t len;
+    const char *raw;
+
+    raw = str_raw(str);
+    len = str_len(str);
+    if (len > 4 && !strncmp(raw, "__", 2) && !strcmp(raw + len - 2, "__")) {
+        raw += 2;
+        len -= 4;
+    }
+
+    return strlen(name) == len && !strncmp(raw, name, len);
+}
+
+static String attribute_string_argument(void)
+{
+    String str;
+
+    consume('(');
+    consume(STRING);
+    str = access_token(0)->d.string;
+    consume(')');
+    return str;
+}
+
+static void attribute(struct attribute *attr)
+{
+    int depth;
+    size_t align;
+    String str;
+    struct var val;
+
+    peek();
+    if (!access_token(1)->is_expandable) {
+        error("Expected attribute name.");
+        exit(1);
+    }
+
+    next();
+    str = access_token(0)->d.string;
+    if (is_attribute(str, "aligned")) {
+        align = 16;
+        if (try_consume('(')) {
+            val = constant_expression();
+            if (!is_integer(val.type)
+                || !val.value.imm.u
+                || (val.value.imm.u & (val.value.imm.u - 1)))
+            {
+                error("Alignment must be a power of two.");
+                exit(1);
+            }
+            align = val.value.imm.u;
+            consume(')');
+        }
+        if (align > attr->aligned) {
+            attr->aligned = align;
+        }
+    } else if (is_attribute(str, "vector_size")) {
+        consume('(');
+        val = constant_expression();
+        if (!is_integer(val.type) || val.kind != IMMEDIATE) {
+            error("Vector size must be an integer constant.");
+            exit(1);
+        }
+        attr->vector_size = val.value.imm.u;
+        consume(')');
+    } else if (is_attribute(str, "packed")) {
+        attr->is_packed = 1;
+    } else if (is_attribute(str, "hot")) {
+        attr->is_hot = 1;
+    } else if (is_attribute(str, "cold")) {
+        attr->is_cold = 1;
+    } else if (is_attribute(str, "noinline")) {
+        attr->is_noinline = 1;
+    } else if (is_attribute(str, "always_inline")) {
+        attr->is_always_inline = 1;
+    } else if (is_attribute(str, "unused")) {
+        attr->is_unused = 1;
+    } else if (is_attribute(str, "section")) {
+        attr->section = attribute_string_argument();
+        attr->has_section = 1;
+    } else if (is_attribute(str, "visibility")) {
+        str = attribute_string_argument();
+        attr->has_visibility = 1;
+        if (!strcmp(str_raw(str), "default")) {
+            attr->visibility = VISIBILITY_DEFAULT;
+        } else if (!strcmp(str_raw(str), "hidden")) {
+            attr->visibility = VISIBILITY_HIDDEN;
+        } else if (!strcmp(str_raw(str), "protected")) {
+            attr->visibility = VISIBILITY_PROTECTED;
+        } else if (!strcmp(str_raw(str), "internal")) {
+            attr->visibility = VISIBILITY_INTERNAL;
+        } else {
+            error("Invalid visibility '%s'.", str_raw(str));
+            exit(1);
+        }
+    } else if (try_consume('(')) {
+        for (depth = 1; depth > 0; next()) {
+            switch (peek()) {
+            case '(':
+                depth++;
+                break;
+            case ')':
+                depth--;
+                break;
+            case END:
+                error("Unterminated attribute argument list.");
+                exit(1);
+            default:
+                break;
+            }
+        }
+    }
+}
+
+/*
+ * Parse any number of GNU attribute specifiers, accumulating the
+ * attributes given. Each specifier has a comma separated list of
+ * attributes, possibly empty.
+ *
+ *     __attribute__((aligned(64), section(".data.hot")))
+ *
+ * Attributes that do not have any meaning to us are skipped, including
+ * their arguments.
+ */
+static void attribute_specifier_list(struct attribute *attr)
+{
+    while (try_consume(ATTRIBUTE)) {
+        consume('(');
+        consume('(');
+        while (peek() != ')') {
+            if (peek() != ',') {
+                attribute(attr);
+            }
+            if (!try_consume(',')) {
+                break;
+            }
+        }
+        consume(')');
+        consume(')');
+    }
+}
+
+/*
+ * Create vector type from attribute vector_size applied to arithmetic
+ * base type. Only 16 byte vectors fitting in a single SSE register are
+ * supported.
+ */
+static Type vector_type(Type type, size_t size)
+{
+    Type vec;
+
+    if (!is_arithmetic(type) || is_bool(type) || is_long_double(type)) {
+        error("Invalid vector element type.");
+        exit(1);
+    }
+
+    if (size != 16) {
+        error("Unsupported vector size %lu, must be 16 bytes.", size);
+        exit(1);
+    }
+
+    vec = type_create_vector(type_unqualified(type), size);
+    return type_apply_qualifiers(vec, type);
+}
+
 static struct block *parameter_declarator(
     struct definition *def,
     struct block *block,
@@ -85,6 +259,7 @@ static struct block *parameter_list(
         }
 
         block = parameter_declarator(def, block, base, &base, &name, &length);
+        attribute_specifier_list(&info.attr);
         if (is_void(base)) {
             if (nmembers(*func)) {
                 error("Incomplete type in parameter list.");
@@ -376,11 +551,17 @@ static struct block *direct_declarator(
     return block;
 }
 
+/*
+ * Parse pointer declarator with qualifiers. Attributes applied to the
+ * pointer type are ignored.
+ */
 static Type pointer(Type type)
 {
+    struct attribute attr = {0};
+
+    consume('*');
     type = type_create_pointer(type);
     while (1) {
-        next();
         switch (peek()) {
         case CONST:
             type = type_set_const(type);
@@ -388,12 +569,19 @@ static Type pointer(Type type)
         case VOLATILE:
             type = type_set_volatile(type);
             break;
+        case ATOMIC:
+            type = type_set_atomic(type);
+            break;
         case RESTRICT:
             type = type_set_restrict(type);
             break;
+        case ATTRIBUTE:
+            attribute_specifier_list(&attr);
+            continue;
         default:
             return type;
         }
+        next();
     }
 }
 
@@ -423,20 +611,72 @@ INTERNAL struct block *declarator(
     return parameter_declarator(def, block, base, type, name, NULL);
 }
 
-static void member_declaration_list(Type type)
-{
+/*
+ * Struct or union member declarator. Members are added to the type
+ * after parsing the closing brace, as attributes following it can
+ * change the layout.
+ */
+struct member_declarator {
     String name;
+    Type type;
+    size_t width;
+    unsigned int is_field : 1;
+    struct attribute attr;
+};
+
+static void add_member_declarator(
+    Type type,
+    const struct attribute *attr,
+    struct member_declarator *decl)
+{
+    size_t align;
+
+    if (decl->is_field) {
+        type_add_field(type, decl->name, decl->type, decl->width);
+    } else if (str_is_empty(decl->name)) {
+        type_add_anonymous_member(type, decl->type);
+    } else if (decl->attr.aligned || decl->attr.is_packed) {
+        align = (attr->is_packed || decl->attr.is_packed)
+            ? 1 : type_alignment(decl->type);
+        if (decl->attr.aligned > align) {
+            align = decl->attr.aligned;
+        }
+        type_add_aligned_member(type, decl->name, decl->type, align);
+    } else {
+        type_add_member(type, decl->name, decl->type);
+    }
+}
+
+/*
+ * Parse member declarations and the closing brace, followed by
+ * attributes applied to the struct or union type.
+ */
+static void member_declaration_list(Type type, struct attribute *attr)
+{
+    int i;
     struct var expr;
-    Type decl_base, decl_type;
+    Type decl_base;
+    struct member_declarator decl;
+    struct declaration_specifier_info info;
+    array_of(struct member_declarator) members = {0};
 
     do {
-        decl_base = declaration_specifiers(NULL);
+        decl_base = declaration_specifiers(&info);
+        if (info.storage_class || info.is_register || info.is_thread_local) {
+            error("Unexpected storage class in member declaration.");
+        } else if (info.is_inline || info.is_noreturn) {
+            error("Unexpected function specifier.");
+        }
+
         while (1) {
-            name = str_empty();
-            declarator(NULL, NULL, decl_base, &decl_type, &name);
+            memset(&decl, 0, sizeof(decl));
+            decl.name = str_empty();
+            decl.attr = info.attr;
+            declarator(NULL, NULL, decl_base, &decl.type, &decl.name);
+            attribute_specifier_list(&decl.attr);
             if (is_struct_or_union(type) && peek() == ':') {
-                if (!is_integer(decl_type)) {
-                    error("Unsupported type '%t' for bit-field.", decl_type);
+                if (!is_integer(decl.type)) {
+                    error("Unsupported type '%t' for bit-field.", decl.type);
                     exit(1);
                 }
 
@@ -447,18 +687,17 @@ static void member_declaration_list(Type type)
                     exit(1);
                 }
 
-                type_add_field(type, name, decl_type, expr.value.imm.u);
-            } else if (str_is_empty(name)) {
-                if (is_struct_or_union(decl_type)) {
-                    type_add_anonymous_member(type, decl_type);
-                } else {
-                    error("Missing name in member declarator.");
-                    exit(1);
-                }
-            } else {
-                type_add_member(type, name, decl_type);
+                decl.is_field = 1;
+                decl.width = expr.value.imm.u;
+                attribute_specifier_list(&decl.attr);
+            } else if (str_is_empty(decl.name)
+                && !is_struct_or_union(decl.type))
+            {
+                error("Missing name in member declarator.");
+                exit(1);
             }
 
+            array_push_back(&members, decl);
             if (!try_consume(',')) {
                 break;
             }
@@ -467,7 +706,22 @@ static void member_declaration_list(Type type)
         consume(';');
     } while (peek() != '}');
 
+    consume('}');
+    attribute_specifier_list(attr);
+    if (attr->is_packed) {
+        type_set_packed(type);
+    }
+
+    if (attr->aligned) {
+        type_set_alignment(type, attr->aligned);
+    }
+
+    for (i = 0; i < array_len(&members); ++i) {
+        add_member_declarator(type, attr, &array_get(&members, i));
+    }
+
     type_seal(type);
+    array_clear(&members);
 }
 
 /*
@@ -478,12 +732,14 @@ static void member_declaration_list(Type type)
 static Type struct_or_union_declaration(enum token_type t)
 {
     struct symbol *sym = NULL;
+    struct attribute attr = {0};
     Type type = {0};
     String name;
     enum type kind;
 
     assert(t == STRUCT || t == UNION);
     kind = (t == STRUCT) ? T_STRUCT : T_UNION;
+    attribute_specifier_list(&attr);
     if (try_consume(IDENTIFIER)) {
         name = access_token(0)->d.string;
         sym = sym_lookup(&ns_tag, name);
@@ -513,9 +769,8 @@ static Type struct_or_union_declaration(enum token_type t)
             type = type_create(kind);
         }
 
-        member_declaration_list(type);
+        member_declaration_list(type, &attr);
         assert(size_of(type));
-        consume('}');
     } else if (!sym) {
         error("Invalid declaration.");
         exit(1);
@@ -524,17 +779,24 @@ static Type struct_or_union_declaration(enum token_type t)
     return type;
 }
 
-static void enumerator_list(void)
+/*
+ * Parse enumerators and attributes following the closing brace. Return
+ * int, or the smallest integer type able to represent all values if
+ * the enum is packed.
+ */
+static Type enumerator_list(struct attribute *attr)
 {
+    struct attribute ignored = {0};
     String name;
     struct var val;
     struct symbol *sym;
-    int count = 0;
+    int count = 0, min = 0, max = 0;
 
     consume('{');
     do {
         consume(IDENTIFIER);
         name = access_token(0)->d.string;
+        attribute_specifier_list(&ignored);
         if (try_consume('=')) {
             val = constant_expression();
             if (!is_integer(val.type)) {
@@ -548,28 +810,50 @@ static void enumerator_list(void)
             basic_type__int,
             SYM_CONSTANT,
             LINK_NONE);
-        sym->value.constant.i = count++;
+        sym->value.constant.i = count;
+        if (count < min) {
+            min = count;
+        } else if (count > max) {
+            max = count;
+        }
+        count++;
         if (!try_consume(','))
             break;
     } while (peek() != '}');
     consume('}');
+    attribute_specifier_list(attr);
+    if (!attr->is_packed) {
+        return basic_type__int;
+    } else if (min >= 0) {
+        return max <= UCHAR_MAX ? basic_type__unsigned_char
+            : max <= USHRT_MAX ? basic_type__unsigned_short
+            : basic_type__unsigned_int;
+    } else {
+        return (min >= SCHAR_MIN && max <= SCHAR_MAX) ? basic_type__char
+            : (min >= SHRT_MIN && max <= SHRT_MAX) ? basic_type__short
+            : basic_type__int;
+    }
 }
 
 /*
- * Consume enum definition, which represents an int type.
+ * Consume enum definition, which represents an int type unless packed.
  *
  * Use value.constant as a sentinel to represent definition, checked on
  * lookup to detect duplicate definitions.
  */
-static void enum_declaration(void)
+static Type enum_declaration(void)
 {
     String name;
     struct symbol *tag;
+    struct attribute attr = {0};
 
+    attribute_specifier_list(&attr);
     if (try_consume(IDENTIFIER)) {
         name = access_token(0)->d.string;
         tag = sym_lookup(&ns_tag, name);
-        if (!tag || tag->depth < current_scope_depth(&ns_tag)) {
+        if (!tag
+            || (tag->depth < current_scope_depth(&ns_tag) && peek() == '{'))
+        {
             tag = sym_add(
                 &ns_tag,
                 name,
@@ -586,12 +870,13 @@ static void enum_declaration(void)
                 error("Redefiniton of enum '%s'.", str_raw(tag->name));
                 exit(1);
             }
-            enumerator_list();
+            tag->type = enumerator_list(&attr);
             tag->value.constant.i = 1;
         }
-    } else {
-        enumerator_list();
+        return tag->type;
     }
+
+    return enumerator_list(&attr);
 }
 
 /*
@@ -655,13 +940,18 @@ INTERNAL Type declaration_specifiers(struct declaration_specifier_info *info)
         Q_NONE,
         Q_CONST = 1,
         Q_VOLATILE = 2,
-        Q_CONST_VOLATILE = Q_CONST | Q_VOLATILE
+        Q_CONST_VOLATILE = Q_CONST | Q_VOLATILE,
+        Q_ATOMIC = 4
     } qual = 0;
+    struct attribute attr, *ap;
 
     if (info) {
         memset(info, 0, sizeof(*info));
     }
 
+    memset(&attr, 0, sizeof(attr));
+    ap = info ? &info->attr : &attr;
+
     while (1) {
         t = peek();
         switch (t) {
@@ -737,6 +1027,29 @@ INTERNAL Type declaration_specifiers(struct declaration_specifier_info *info)
             next();
             qual |= Q_VOLATILE;
             break;
+        case ATOMIC:
+            next();
+            if (peek() != '(') {
+                qual |= Q_ATOMIC;
+                break;
+            }
+            if (base || modifier || sign) {
+                error("Unexpected '_Atomic' type specifier.");
+                exit(1);
+            }
+            consume('(');
+            type = declaration_specifiers(NULL);
+            if (peek() != ')') {
+                declarator(NULL, NULL, type, &type, NULL);
+            }
+            consume(')');
+            if (is_const(type) || is_volatile(type) || is_atomic(type)) {
+                error("Qualified type %t in '_Atomic' specifier.", type);
+                exit(1);
+            }
+            type = type_set_atomic(type);
+            base = B_AGGREGATE;
+            break;
         case IDENTIFIER:
             if (base || modifier || sign) goto done;
             tagged = get_typedef(access_token(1)->d.string);
@@ -758,7 +1071,7 @@ INTERNAL Type declaration_specifiers(struct declaration_specifier_info *info)
         case ENUM:
             if (base || modifier || sign) goto done;
             next();
-            enum_declaration();
+            type = enum_declaration();
             base = B_ENUM;
             break;
         case INLINE:
@@ -791,6 +1104,19 @@ INTERNAL Type declaration_specifiers(struct declaration_specifier_info *info)
                 info->is_register = 1;
             }
             break;
+        case THREAD_LOCAL:
+            next();
+            if (!info) {
+                error("Unexpected '_Thread_local' specifier.");
+            } else if (info->is_thread_local) {
+                error("Multiple '_Thread_local' specifiers.");
+            } else {
+                info->is_thread_local = 1;
+            }
+            break;
+        case ATTRIBUTE:
+            attribute_specifier_list(ap);
+            break;
         case AUTO:
         case STATIC:
         case EXTERN:
@@ -812,6 +1138,7 @@ INTERNAL Type declaration_specifiers(struct declaration_specifier_info *info)
 done:
     switch (base) {
     case B_AGGREGATE:
+    case B_ENUM:
         break;
     case B_VOID:
         type.type = T_VOID;
@@ -823,7 +1150,6 @@ done:
         type.type = T_CHAR;
         type.is_unsigned = sign == S_UNSIGNED;
         break;
-    case B_ENUM:
     case B_NONE:
     case B_INT:
         type.type = T_INT;
@@ -850,10 +1176,17 @@ done:
         break;
     }
 
+    if (ap->vector_size) {
+        type = vector_type(type, ap->vector_size);
+        ap->vector_size = 0;
+    }
+
     if (qual & Q_CONST)
         type = type_set_const(type);
     if (qual & Q_VOLATILE)
         type = type_set_volatile(type);
+    if (qual & Q_ATOMIC)
+        type = type_set_atomic(type);
 
     return type;
 }
@@ -996,6 +1329,38 @@ INTERNAL struct block *declare_vla(
     return block;
 }
 
+/*
+ * Apply attributes to a declared symbol. Function specific attributes
+ * are accumulated over all declarations.
+ */
+static void apply_attributes(struct symbol *sym, const struct attribute *attr)
+{
+    if (sym->symtype == SYM_TYPEDEF) {
+        return;
+    }
+
+    if (attr->aligned > sym->alignment) {
+        sym->alignment = attr->aligned;
+    }
+
+    if (attr->has_section) {
+        sym->section = attr->section;
+        sym->has_section = 1;
+    }
+
+    if (attr->has_visibility) {
+        sym->visibility = attr->visibility;
+        sym->has_visibility = 1;
+    }
+
+    if (is_function(sym->type)) {
+        sym->hot |= attr->is_hot;
+        sym->cold |= attr->is_cold;
+        sym->noinline |= attr->is_noinline;
+        sym->always_inline |= attr->is_always_inline;
+    }
+}
+
 /*
  * Parse declaration, possibly with initializer. New symbols are added
  * to the symbol table.
@@ -1008,13 +1373,16 @@ static struct block *init_declarator(
     struct block *parent,
     Type base,
     enum symtype symtype,
-    enum linkage linkage)
+    enum linkage linkage,
+    const struct declaration_specifier_info *info)
 {
     Type type;
     String name = SHORT_STRING_INIT(""), asm_name = SHORT_STRING_INIT("");
     struct symbol *sym;
+    struct attribute attr;
     const struct member *param;
 
+    attr = info->attr;
     if (linkage == LINK_INTERN && current_scope_depth(&ns_ident) != 0) {
         declarator(def, cfg_block_init(def), base, &type, &name);
     } else {
@@ -1025,9 +1393,20 @@ static struct block *init_declarator(
         return parent;
     }
 
+    attribute_specifier_list(&attr);
+    if (attr.vector_size) {
+        type = vector_type(type, attr.vector_size);
+    }
+
     if (symtype == SYM_TYPEDEF) {
-        /* */
+        if (attr.aligned) {
+            type = type_create_aligned(type, attr.aligned);
+        }
     } else if (is_function(type)) {
+        if (info->is_thread_local) {
+            error("Function '%s' cannot be thread local.", str_raw(name));
+            exit(1);
+        }
         symtype = SYM_DECLARATION;
         linkage = (linkage == LINK_NONE) ? LINK_EXTERN : linkage;
         if (linkage == LINK_INTERN && current_scope_depth(&ns_ident)) {
@@ -1052,6 +1431,7 @@ static struct block *init_declarator(
         consume(STRING);
         asm_name = access_token(0)->d.string;
         consume(')');
+        attribute_specifier_list(&attr);
     } else if (is_function(type) && !is_complete(type) && peek() != ';') {
         push_scope(&ns_ident);
         parent = parameter_declaration_list(def, parent, type);
@@ -1059,6 +1439,12 @@ static struct block *init_declarator(
     }
 
     sym = sym_add(&ns_ident, name, type, symtype, linkage);
+    if (info->is_thread_local) {
+        sym->tls = 1;
+    }
+
+    apply_attributes(sym, &attr);
+
     if (str_len(asm_name)) {
         sym->name = asm_name;
         sym->n = 0;
@@ -1227,6 +1613,11 @@ INTERNAL struct block *declaration(
         break;
     }
 
+    if (info.is_thread_local && linkage == LINK_NONE) {
+        error("Thread local variable must have static storage duration.");
+        exit(1);
+    }
+
     switch (peek()) {
     case '*':
     case '(':
@@ -1242,13 +1633,14 @@ INTERNAL struct block *declaration(
         if (info.from_typedef && is_array(base) && !is_complete(base)) {
             type = type_next(base);
             type = type_create_incomplete(type);
+            type = type_create_aligned(type, type_alignment(base));
             type = type_apply_qualifiers(type, base);
             assert(type_equal(type, base));
         }
 
         if (linkage == LINK_INTERN || linkage == LINK_EXTERN) {
             decl = cfg_init();
-            init_declarator(decl, decl->body, type, symtype, linkage);
+            init_declarator(decl, decl->body, type, symtype, linkage, &info);
             if (!decl->symbol) {
                 cfg_discard(decl);
             } else if (is_function(decl->symbol->type)) {
@@ -1261,7 +1653,7 @@ INTERNAL struct block *declaration(
                 return parent;
             }
         } else {
-            parent = init_declarator(def, parent, type, symtype, linkage);
+            parent = init_declarator(def, parent, type, symtype, linkage, &info);
         }
 
         if (!try_consume(','))
@@ -20,11 +20,32 @@ INTERNAL struct block *declarator(
     Type *type,
     String *name);
 
+/*
+ * GNU attributes given by __attribute__((...)). Attributes not listed
+ * here are parsed, but have no effect.
+ */
+struct attribute {
+    size_t aligned;
+    size_t vector_size;
+    String section;
+    unsigned int has_section : 1;
+    unsigned int is_packed : 1;
+    unsigned int is_hot : 1;
+    unsigned int is_cold : 1;
+    unsigned int is_noinline : 1;
+    unsigned int is_always_inline : 1;
+    unsigned int is_unused : 1;
+    unsigned int visibility : 2;
+    unsigned int has_visibility : 1;
+};
+
 struct declaration_specifier_info {
+    struct attribute attr;
     enum token_type storage_class;
     unsigned int is_inline : 1;
     unsigned int is_noreturn : 1;
     unsigned int is_register : 1;
+    unsigned int is_thread_local : 1;
     unsigned int from_typedef : 1;
 };
 
@@ -37,7 +58,7 @@ INTERNAL struct block *declare_vla(
     struct symbol *sym);
 
 #define FIRST_type_qualifier \
-    CONST: case VOLATILE
+    CONST: case VOLATILE: case ATOMIC
 
 #define FIRST_type_specifier \
     VOID: case BOOL: case CHAR: case SHORT: case INT: case LONG: case FLOAT: \
@@ -45,7 +66,8 @@ INTERNAL struct block *declare_vla(
 
 #define FIRST_type_name \
     FIRST_type_qualifier: \
-    case FIRST_type_specifier
+    case FIRST_type_specifier: \
+    case ATTRIBUTE
 
 #define FIRST(s) FIRST_ ## s
 
@@ -451,6 +451,17 @@ INTERNAL struct expression eval_cast(
 
     var = rvalue(def, block, var);
 
+    if (is_vector(var.type) || is_vector(type)) {
+        if (!is_vector(var.type) || !is_vector(type)
+            || size_of(var.type) != size_of(type))
+        {
+            error("Cannot cast %t to %t.", var.type, type);
+            exit(1);
+        }
+        var.type = type;
+        return as_expr(var);
+    }
+
     if (!is_scalar(var.type) || !is_scalar(type)) {
         error("Cannot cast %t to %t.", var.type, type);
         exit(1);
@@ -509,6 +520,188 @@ static struct var eval_long_double_op(
     return var_numeric(basic_type__long_double, put_long_double(l));
 }
 
+/*
+ * Convert operand of vector operation to the given vector type. Scalar
+ * operands are broadcast to all elements of a new temporary.
+ */
+static struct var vector_operand(
+    struct definition *def,
+    struct block *block,
+    struct var var,
+    Type type)
+{
+    int i, n;
+    Type elem;
+    struct var tmp, ref;
+
+    var = rvalue(def, block, var);
+    if (is_vector(var.type)) {
+        if (!is_compatible_unqualified(var.type, type)) {
+            error("Incompatible vector operands of type %t and %t.",
+                var.type, type);
+            exit(1);
+        }
+        return var;
+    }
+
+    if (!is_arithmetic(var.type)) {
+        error("Invalid operand of type %t to vector operation.", var.type);
+        exit(1);
+    }
+
+    elem = type_next(type);
+    var = cast_operand(def, block, var, elem);
+    tmp = create_var(def, type);
+    ref = tmp;
+    ref.type = elem;
+    n = size_of(type) / size_of(elem);
+    for (i = 0; i < n; ++i) {
+        ref.offset = i * size_of(elem);
+        ir_assign(def, block, ref, as_expr(var));
+    }
+
+    tmp.lvalue = 0;
+    return tmp;
+}
+
+/*
+ * Determine if vector operation has a packed SSE2 instruction, or
+ * SSE4.1 if available. Other operations, like integer division, are
+ * evaluated one element at a time.
+ */
+static int is_packed_vector_op(enum optype op, Type elem)
+{
+    if (context.no_sse) {
+        return 0;
+    }
+
+    switch (op) {
+    case IR_OP_ADD:
+    case IR_OP_SUB:
+    case IR_OP_AND:
+    case IR_OP_OR:
+    case IR_OP_XOR:
+        return 1;
+    case IR_OP_MUL:
+        return is_real(elem) || size_of(elem) == 2
+            || (size_of(elem) == 4 && (context.cpu & CPU_SSE4_1));
+    case IR_OP_DIV:
+        return is_real(elem);
+    default:
+        return 0;
+    }
+}
+
+static struct expression eval_vector_element_op(
+    struct definition *def,
+    struct block *block,
+    enum optype op,
+    struct var l,
+    struct var r)
+{
+    switch (op) {
+    default: assert(0);
+    case IR_OP_ADD: return eval_add(def, block, l, r);
+    case IR_OP_SUB: return eval_sub(def, block, l, r);
+    case IR_OP_MUL: return eval_mul(def, block, l, r);
+    case IR_OP_DIV: return eval_div(def, block, l, r);
+    case IR_OP_MOD: return eval_mod(def, block, l, r);
+    case IR_OP_AND: return eval_and(def, block, l, r);
+    case IR_OP_OR: return eval_or(def, block, l, r);
+    case IR_OP_XOR: return eval_xor(def, block, l, r);
+    }
+}
+
+/*
+ * Element-wise arithmetic on GCC vector types. One of the operands can
+ * be scalar, which is then applied to each element.
+ */
+static struct expression eval_vector_op(
+    struct definition *def,
+    struct block *block,
+    enum optype op,
+    struct var l,
+    struct var r)
+{
+    int i, n;
+    Type type, elem;
+    struct var res, ref;
+
+    type = type_unqualified(is_vector(l.type) ? l.type : r.type);
+    l = vector_operand(def, block, l, type);
+    r = vector_operand(def, block, r, type);
+    switch (op) {
+    case IR_OP_MOD:
+    case IR_OP_AND:
+    case IR_OP_OR:
+    case IR_OP_XOR:
+        if (!is_integer(type_next(type))) {
+            error("Invalid operands to bitwise operation on vector %t.",
+                type);
+            exit(1);
+        }
+    default:
+        break;
+    }
+
+    elem = type_next(type);
+    if (is_packed_vector_op(op, elem)) {
+        return create_binary_expression(op, type, l, r);
+    }
+
+    res = create_var(def, type);
+    ref = res;
+    ref.type = l.type = r.type = elem;
+    n = size_of(type) / size_of(elem);
+    for (i = 0; i < n; ++i) {
+        eval_assign(def, block, ref,
+            eval_vector_element_op(def, block, op, l, r));
+        ref.offset += size_of(elem);
+        l.offset += size_of(elem);
+        r.offset += size_of(elem);
+    }
+
+    res.lvalue = 0;
+    return as_expr(res);
+}
+
+INTERNAL struct var eval_vector_element(
+    struct definition *def,
+    struct block *block,
+    struct var var,
+    struct var index)
+{
+    Type elem;
+    struct var ptr;
+
+    assert(is_vector(var.type));
+    assert(var.kind == DIRECT || var.kind == DEREF);
+    if (!is_integer(index.type)) {
+        error("Vector subscript must have integer type.");
+        exit(1);
+    }
+
+    elem = type_apply_qualifiers(type_next(var.type), var.type);
+    if (index.kind == IMMEDIATE) {
+        var.offset += index.value.imm.i * size_of(elem);
+        var.type = elem;
+        return var;
+    }
+
+    /*
+     * Temporary results are not l-values, but still live in memory and
+     * can be indexed through their address.
+     */
+    if (var.kind == DIRECT) {
+        var.lvalue = 1;
+    }
+
+    ptr = eval_addr(def, block, var);
+    ptr.type = type_create_pointer(elem);
+    ptr = eval(def, block, eval_add(def, block, ptr, index));
+    return eval_deref(def, block, ptr);
+}
+
 INTERNAL struct expression eval_mul(
     struct definition *def,
     struct block *block,
@@ -517,6 +710,10 @@ INTERNAL struct expression eval_mul(
 {
     Type type;
 
+    if (is_vector(l.type) || is_vector(r.type)) {
+        return eval_vector_op(def, block, IR_OP_MUL, l, r);
+    }
+
     if (!is_arithmetic(l.type) || !is_arithmetic(r.type)) {
         error("Operands to multiplication must be of arithmetic type.");
         exit(1);
@@ -558,6 +755,10 @@ INTERNAL struct expression eval_div(
 {
     Type type;
 
+    if (is_vector(l.type) || is_vector(r.type)) {
+        return eval_vector_op(def, block, IR_OP_DIV, l, r);
+    }
+
     if (!is_arithmetic(l.type) || !is_arithmetic(r.type)) {
         error("Operands to division must be of arithmetic type.");
         exit(1);
@@ -596,6 +797,10 @@ INTERNAL struct expression eval_mod(
 {
     Type type = basic_type__void;
 
+    if (is_vector(l.type) || is_vector(r.type)) {
+        return eval_vector_op(def, block, IR_OP_MOD, l, r);
+    }
+
     if (is_arithmetic(l.type) && is_arithmetic(r.type)) {
         type = usual_arithmetic_conversion(l.type, r.type);
     }
@@ -639,6 +844,10 @@ INTERNAL struct expression eval_add(
     struct var tmp;
     Type type;
 
+    if (is_vector(l.type) || is_vector(r.type)) {
+        return eval_vector_op(def, block, IR_OP_ADD, l, r);
+    }
+
     l = rvalue(def, block, l);
     r = rvalue(def, block, r);
     if (is_integer(l.type) && is_pointer(r.type)) {
@@ -739,6 +948,10 @@ INTERNAL struct expression eval_sub(
     struct expression expr;
     Type type, t1, t2;
 
+    if (is_vector(l.type) || is_vector(r.type)) {
+        return eval_vector_op(def, block, IR_OP_SUB, l, r);
+    }
+
     l = rvalue(def, block, l);
     r = rvalue(def, block, r);
 
@@ -974,6 +1187,84 @@ INTERNAL struct expression eval_cmp_gt(
     return create_binary_expression(IR_OP_GT, basic_type__int, l, r);
 }
 
+static int is_shift_of(struct statement *st, struct var t, Type type)
+{
+    return st->st == IR_ASSIGN
+        && st->t.kind == DIRECT
+        && st->t.value.symbol == t.value.symbol
+        && t.kind == DIRECT
+        && is_temporary(t.value.symbol)
+        && (st->expr.op == IR_OP_SHL || st->expr.op == IR_OP_SHR)
+        && type_equal(st->expr.type, type)
+        && st->expr.r.kind == IMMEDIATE;
+}
+
+/*
+ * Recognize rotate written as bitwise or of two shifts of the same
+ * unsigned operand, where the shifts were just evaluated.
+ *
+ *   .t1 = x << 3
+ *   .t2 = x >> 29
+ *   .t3 = .t1 | .t2
+ *
+ * Shift statements are removed, and replaced by rotate expression.
+ */
+static int is_rotate(
+    struct definition *def,
+    struct block *block,
+    Type type,
+    struct var l,
+    struct var r,
+    struct expression *expr)
+{
+    int i;
+    unsigned long k;
+    struct statement *s1, *s2;
+    struct var x;
+
+    if (!def || !is_unsigned(type) || block->count < 2) {
+        return 0;
+    }
+
+    i = block->head + block->count - 2;
+    if (i + 2 != array_len(&def->statements)) {
+        return 0;
+    }
+
+    s1 = &array_get(&def->statements, i);
+    s2 = &array_get(&def->statements, i + 1);
+    if (!is_shift_of(s1, l, type)
+        || !is_shift_of(s2, r, type)
+        || s1->expr.op == s2->expr.op
+        || s1->expr.r.value.imm.u + s2->expr.r.value.imm.u
+            != size_of(type) * 8)
+    {
+        return 0;
+    }
+
+    x = s1->expr.l;
+    if ((x.kind != DIRECT && x.kind != DEREF)
+        || x.kind != s2->expr.l.kind
+        || x.value.symbol != s2->expr.l.value.symbol
+        || x.offset != s2->expr.l.offset
+        || is_field(x)
+        || is_field(s2->expr.l)
+        || is_volatile(x.type)
+        || !type_equal(x.type, type))
+    {
+        return 0;
+    }
+
+    k = (s1->expr.op == IR_OP_SHL)
+        ? s1->expr.r.value.imm.u
+        : s2->expr.r.value.imm.u;
+
+    array_len(&def->statements) -= 2;
+    block->count -= 2;
+    *expr = create_binary_expression(IR_OP_ROL, type, x, imm_unsigned(type, k));
+    return 1;
+}
+
 INTERNAL struct expression eval_or(
     struct definition *def,
     struct block *block,
@@ -981,6 +1272,11 @@ INTERNAL struct expression eval_or(
     struct var r)
 {
     Type type;
+    struct expression expr;
+
+    if (is_vector(l.type) || is_vector(r.type)) {
+        return eval_vector_op(def, block, IR_OP_OR, l, r);
+    }
 
     if (!is_integer(l.type) || !is_integer(r.type)) {
         error("Operands to bitwise or must have integer type.");
@@ -1001,6 +1297,10 @@ INTERNAL struct expression eval_or(
         return as_expr(l);
     }
 
+    if (is_rotate(def, block, type, l, r, &expr)) {
+        return expr;
+    }
+
     return create_binary_expression(IR_OP_OR, type, l, r);
 }
 
@@ -1012,6 +1312,10 @@ INTERNAL struct expression eval_xor(
 {
     Type type;
 
+    if (is_vector(l.type) || is_vector(r.type)) {
+        return eval_vector_op(def, block, IR_OP_XOR, l, r);
+    }
+
     if (!is_integer(l.type) || !is_integer(r.type)) {
         error("Operands to bitwise xor must have integer type.");
         exit(1);
@@ -1042,6 +1346,10 @@ INTERNAL struct expression eval_and(
 {
     Type type;
 
+    if (is_vector(l.type) || is_vector(r.type)) {
+        return eval_vector_op(def, block, IR_OP_AND, l, r);
+    }
+
     if (!is_integer(l.type) || !is_integer(r.type)) {
         error("Operands to bitwise and must have integer type.");
         exit(1);
@@ -1181,6 +1489,106 @@ INTERNAL struct expression eval_neg(
     return eval_sub(def, block, var_int(0), var);
 }
 
+INTERNAL struct expression eval_bit_operation(
+    struct definition *def,
+    struct block *block,
+    enum optype op,
+    Type type,
+    struct var var)
+{
+    int n, w;
+    unsigned long u, v;
+
+    if (!is_integer(var.type)) {
+        error("Operand of bit operation must have integer type.");
+        exit(1);
+    }
+
+    var = cast_operand(def, block, var, type);
+    if (var.kind == IMMEDIATE) {
+        w = size_of(type) * 8;
+        u = var.value.imm.u;
+        if (w < 64) {
+            u &= (1ul << w) - 1;
+        }
+
+        switch (op) {
+        default: assert(0);
+        case IR_OP_POPCOUNT:
+            for (n = 0; u; u &= u - 1)
+                n++;
+            break;
+        case IR_OP_CLZ:
+            for (n = w; u; u >>= 1)
+                n--;
+            break;
+        case IR_OP_CTZ:
+            for (n = u ? 0 : w; u && !(u & 1); u >>= 1)
+                n++;
+            break;
+        case IR_OP_FFS:
+            for (n = u ? 1 : 0; u && !(u & 1); u >>= 1)
+                n++;
+            break;
+        case IR_OP_BSWAP:
+            for (n = 0, v = 0; n < w; n += 8)
+                v = (v << 8) | ((u >> n) & 0xFF);
+            return as_expr(imm_unsigned(type, v));
+        }
+
+        return as_expr(var_int(n));
+    }
+
+    if (op == IR_OP_BSWAP) {
+        return create_expression(op, type, var);
+    }
+
+    return create_expression(op, basic_type__int, var);
+}
+
+INTERNAL struct expression eval_rotate(
+    struct definition *def,
+    struct block *block,
+    enum optype op,
+    Type type,
+    struct var l,
+    struct var r)
+{
+    int w;
+    unsigned long u, k;
+
+    assert(op == IR_OP_ROL || op == IR_OP_ROR);
+    assert(is_unsigned(type));
+    if (!is_integer(l.type) || !is_integer(r.type)) {
+        error("Rotate operands must have integer type.");
+        exit(1);
+    }
+
+    w = size_of(type) * 8;
+    l = cast_operand(def, block, l, type);
+    r = cast_operand(def, block, r, type);
+    if (r.kind == IMMEDIATE) {
+        k = r.value.imm.u % w;
+        if (!k) {
+            return as_expr(l);
+        }
+
+        if (l.kind == IMMEDIATE) {
+            u = l.value.imm.u;
+            if (op == IR_OP_ROR) {
+                k = w - k;
+            }
+
+            l = imm_unsigned(type, (u << k) | (u >> (w - k)));
+            return as_expr(l);
+        }
+
+        r = imm_unsigned(type, k);
+    }
+
+    return create_binary_expression(op, type, l, r);
+}
+
 INTERNAL struct expression eval_call(
     struct definition *def,
     struct block *block,
@@ -1263,6 +1671,59 @@ static struct expression eval_rvalue(
     return expr;
 }
 
+/* Sum of branch weights assigned from expected probability. */
+#define EXPECT_WEIGHT 10000
+
+/*
+ * Branch weights from __builtin_expect, applied if the expression is
+ * next used directly as a branch condition in the same block.
+ */
+static struct {
+    const struct block *block;
+    int count;
+    struct expression expr;
+    unsigned short weight[2];
+} expectation;
+
+static int is_same_operand(struct var a, struct var b)
+{
+    return a.kind == b.kind
+        && a.is_symbol == b.is_symbol
+        && a.offset == b.offset
+        && a.field_width == b.field_width
+        && a.field_offset == b.field_offset
+        && type_equal(a.type, b.type)
+        && (a.is_symbol
+            ? a.value.symbol == b.value.symbol
+            : a.value.imm.u == b.value.imm.u);
+}
+
+static int is_expected(const struct block *block)
+{
+    return expectation.block == block
+        && expectation.count == block->count
+        && expectation.expr.op == block->expr.op
+        && type_equal(expectation.expr.type, block->expr.type)
+        && is_same_operand(expectation.expr.l, block->expr.l)
+        && (!is_comparison(block->expr)
+            || is_same_operand(expectation.expr.r, block->expr.r));
+}
+
+INTERNAL void eval_expect(
+    const struct block *block,
+    int taken,
+    double probability)
+{
+    assert(taken == 0 || taken == 1);
+    assert(probability >= 0.0 && probability <= 1.0);
+    expectation.block = block;
+    expectation.count = block->count;
+    expectation.expr = block->expr;
+    expectation.weight[taken] =
+        (unsigned short) (probability * EXPECT_WEIGHT + 0.5);
+    expectation.weight[!taken] = EXPECT_WEIGHT - expectation.weight[taken];
+}
+
 /*
  * Ensure expression has scalar type.
  *
@@ -1292,6 +1753,14 @@ INTERNAL struct block *scalar(
         block->expr = as_expr(tmp);
     }
 
+    if (expectation.block == block) {
+        if (is_expected(block)) {
+            block->weight[0] = expectation.weight[0];
+            block->weight[1] = expectation.weight[1];
+        }
+        expectation.block = NULL;
+    }
+
     return block;
 }
 
@@ -1698,7 +2167,7 @@ static struct expression eval_prepare_assign(
             expr = eval_cast(def, block, var, target);
         }
     } else if (
-        !(is_struct_or_union(target)
+        !((is_struct_or_union(target) || is_vector(target))
             && is_compatible_unqualified(target, expr.type)))
     {
         error("Incompatible value of type %t assigned to variable of type %t.",
@@ -1927,6 +2396,93 @@ INTERNAL void eval_push_param(
     append_statement(def, block, stmt);
 }
 
+INTERNAL void eval__builtin_prefetch(
+    struct definition *def,
+    struct block *block,
+    struct var address,
+    int write,
+    int locality)
+{
+    struct statement stmt = {IR_PREFETCH};
+
+    assert(block);
+    assert(is_pointer(address.type));
+    assert(write == 0 || write == 1);
+    assert(locality >= 0 && locality <= 3);
+    stmt.t = var_int((write << 2) | locality);
+    stmt.expr = as_expr(address);
+    append_statement(def, block, stmt);
+}
+
+/*
+ * Atomic operations are done on integer or pointer objects, with the
+ * operand converted to the same type. Arithmetic on pointers is done
+ * as unsigned long, without scaling by the size pointed to.
+ */
+INTERNAL struct expression eval_atomic(
+    struct definition *def,
+    struct block *block,
+    enum optype op,
+    struct var ptr,
+    struct var value)
+{
+    Type type;
+    struct expression expr;
+
+    assert(is_pointer(ptr.type));
+    type = type_unqualified(type_deref(ptr.type));
+    assert(is_integer(type) || is_pointer(type));
+    expr = create_expression(op, type, ptr);
+    if (op != IR_OP_ATOMIC_LOAD) {
+        if (is_pointer(type)
+            && op != IR_OP_ATOMIC_STORE
+            && op != IR_OP_ATOMIC_XCHG)
+        {
+            type = basic_type__unsigned_long;
+        }
+
+        value = rvalue(def, block, value);
+        expr.r = eval(def, block, eval_cast(def, block, value, type));
+    }
+
+    return expr;
+}
+
+INTERNAL struct var eval_atomic_cas(
+    struct definition *def,
+    struct block *block,
+    struct var ptr,
+    struct var expected,
+    struct var desired)
+{
+    Type type;
+    struct var old;
+    struct expression expr;
+
+    assert(is_pointer(ptr.type));
+    type = type_unqualified(type_deref(ptr.type));
+    assert(is_integer(type) || is_pointer(type));
+    expected = rvalue(def, block, expected);
+    expected = eval(def, block, eval_cast(def, block, expected, type));
+    desired = rvalue(def, block, desired);
+    desired = eval(def, block, eval_cast(def, block, desired, type));
+    expr = create_binary_expression(IR_OP_ATOMIC_CAS, type, ptr, desired);
+    old = create_var(def, type);
+    eval_push_param(def, block, as_expr(expected));
+    ir_assign(def, block, old, expr);
+    old.lvalue = 0;
+    return old;
+}
+
+INTERNAL void eval_fence(struct definition *def, struct block *block)
+{
+    struct statement stmt = {IR_FENCE};
+
+    assert(block);
+    stmt.expr = as_expr(var_int(0));
+    append_statement(def, block, stmt);
+}
+
 INTERNAL void eval__builtin_va_start(
     struct definition *def,
     struct block *block,
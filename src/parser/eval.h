@@ -15,6 +15,16 @@ INTERNAL struct var rvalue(
     struct block *block,
     struct var var);
 
+/*
+ * Record that the expression in block is expected to evaluate to true
+ * or false with given probability. Branch weights are assigned by the
+ * next call to scalar, if the same expression is used as condition.
+ */
+INTERNAL void eval_expect(
+    const struct block *block,
+    int taken,
+    double probability);
+
 /*
  * Convert expression to scalar value, changing type of string constants
  * to pointer from array.
@@ -41,6 +51,17 @@ INTERNAL struct var eval_addr(
     struct block *block,
     struct var var);
 
+/*
+ * Evaluate v[i] for GCC vector type, where index is integer. Constant
+ * index refers directly to the element, otherwise it is accessed
+ * through a pointer.
+ */
+INTERNAL struct var eval_vector_element(
+    struct definition *def,
+    struct block *block,
+    struct var var,
+    struct var index);
+
 /* Evaluate *a. */
 INTERNAL struct var eval_deref(
     struct definition *def,
@@ -74,6 +95,26 @@ INTERNAL struct expression eval_neg(
     struct block *block,
     struct var l);
 
+/*
+ * Evaluate bit manipulation builtin, with operand converted to given
+ * parameter type. Result is int, except for byte swap.
+ */
+INTERNAL struct expression eval_bit_operation(
+    struct definition *def,
+    struct block *block,
+    enum optype op,
+    Type type,
+    struct var l);
+
+/* Rotate left or right, with operands converted to unsigned type. */
+INTERNAL struct expression eval_rotate(
+    struct definition *def,
+    struct block *block,
+    enum optype op,
+    Type type,
+    struct var l,
+    struct var r);
+
 INTERNAL struct expression eval_mod(
     struct definition *def,
     struct block *block,
@@ -249,6 +290,42 @@ INTERNAL struct expression eval_vla_size(
     struct block *block,
     Type type);
 
+/*
+ * Evaluate prefetch builtin, with read/write and locality hints given
+ * as constants in the range [0, 1] and [0, 3].
+ */
+INTERNAL void eval__builtin_prefetch(
+    struct definition *def,
+    struct block *block,
+    struct var address,
+    int write,
+    int locality);
+
+/*
+ * Evaluate atomic operation on object pointed to, yielding the old
+ * value. The result of atomic store is not meaningful.
+ */
+INTERNAL struct expression eval_atomic(
+    struct definition *def,
+    struct block *block,
+    enum optype op,
+    struct var ptr,
+    struct var value);
+
+/*
+ * Atomic compare and swap, yielding the value read from memory. The
+ * swap succeeded if it is equal to the expected value.
+ */
+INTERNAL struct var eval_atomic_cas(
+    struct definition *def,
+    struct block *block,
+    struct var ptr,
+    struct var expected,
+    struct var desired);
+
+/* Full memory barrier. */
+INTERNAL void eval_fence(struct definition *def, struct block *block);
+
 /* Evaluate va_start builtin function. */
 INTERNAL void eval__builtin_va_start(
     struct definition *def,
@@ -41,6 +41,14 @@ static struct block *cast_expression(
     struct definition *def,
     struct block *block);
 
+static struct block *atomic_assignment(
+    struct definition *def,
+    struct block *block,
+    enum token_type t,
+    struct var target,
+    struct var value,
+    int postfix);
+
 static const struct symbol *find_symbol(String name)
 {
     const struct symbol *sym = sym_lookup(&ns_ident, name);
@@ -61,11 +69,15 @@ static const struct symbol *find_symbol(String name)
  * String constants become IMMEDIATE of type [] char, with a reference
  * to the new symbol containing the string literal. Decays into char *
  * on evaluation.
+ *
+ * Thread local variables are accessed through a pointer, as computing
+ * the address can require a call to __tls_get_addr.
  */
 static struct block *primary_expression(
     struct definition *def,
     struct block *block)
 {
+    struct var ptr;
     const struct symbol *sym;
     const struct token *tok;
 
@@ -76,6 +88,11 @@ static struct block *primary_expression(
         sym = find_symbol(tok->d.string);
         if (sym->symtype == SYM_BUILTIN) {
             block = sym->value.handler(def, block);
+        } else if (sym->tls && def) {
+            ptr = eval_addr(def, block, var_direct(sym));
+            ptr = eval_assign(def, block, create_var(def, ptr.type),
+                as_expr(ptr));
+            block->expr = as_expr(eval_deref(def, block, ptr));
         } else {
             block->expr = as_expr(var_direct(sym));
         }
@@ -157,11 +174,20 @@ static struct block *postfix(
                 next();
                 value = eval(def, block, block->expr);
                 block = expression(def, block);
-                block->expr =
-                    eval_add(def, block, value, eval(def, block, block->expr));
-                block->expr =
-                    as_expr(
-                        eval_deref(def, block, eval(def, block, block->expr)));
+                if (is_vector(value.type)) {
+                    block->expr =
+                        as_expr(
+                            eval_vector_element(def, block, value,
+                                eval(def, block, block->expr)));
+                } else {
+                    block->expr =
+                        eval_add(def, block, value,
+                            eval(def, block, block->expr));
+                    block->expr =
+                        as_expr(
+                            eval_deref(def, block,
+                                eval(def, block, block->expr)));
+                }
                 consume(']');
             } while (peek() == '[');
             root = block->expr;
@@ -253,6 +279,12 @@ static struct block *postfix(
         case INCREMENT:
             next();
             value = eval(def, block, root);
+            if (is_atomic(value.type)) {
+                block = atomic_assignment(def, block, PLUS_ASSIGN, value,
+                    var_int(1), 1);
+                root = block->expr;
+                break;
+            }
             copy = eval_copy(def, block, value);
             root = eval_add(def, block, value, var_int(1));
             eval_assign(def, block, value, root);
@@ -262,6 +294,12 @@ static struct block *postfix(
         case DECREMENT:
             next();
             value = eval(def, block, root);
+            if (is_atomic(value.type)) {
+                block = atomic_assignment(def, block, MINUS_ASSIGN, value,
+                    var_int(1), 1);
+                root = block->expr;
+                break;
+            }
             copy = eval_copy(def, block, value);
             root = eval_sub(def, block, value, var_int(1));
             eval_assign(def, block, value, root);
@@ -430,6 +468,10 @@ exprsize:   head = begin_throwaway_block(def);
         next();
         block = unary_expression(def, block);
         value = eval(def, block, block->expr);
+        if (is_atomic(value.type)) {
+            block = atomic_assignment(def, block, PLUS_ASSIGN, value, var_int(1), 0);
+            break;
+        }
         block->expr = eval_add(def, block, value, var_int(1));
         block->expr = as_expr(eval_assign(def, block, value, block->expr));
         break;
@@ -437,6 +479,10 @@ exprsize:   head = begin_throwaway_block(def);
         next();
         block = unary_expression(def, block);
         value = eval(def, block, block->expr);
+        if (is_atomic(value.type)) {
+            block = atomic_assignment(def, block, MINUS_ASSIGN, value, var_int(1), 0);
+            break;
+        }
         block->expr = eval_sub(def, block, value, var_int(1));
         block->expr = as_expr(eval_assign(def, block, value, block->expr));
         break;
@@ -911,6 +957,263 @@ INTERNAL struct block *conditional_expression(
     return block;
 }
 
+static struct expression compound_operation(
+    struct definition *def,
+    struct block *block,
+    enum token_type t,
+    struct var target,
+    struct var value)
+{
+    switch (t) {
+    default: assert(0);
+    case MUL_ASSIGN:
+        return eval_mul(def, block, target, value);
+    case DIV_ASSIGN:
+        return eval_div(def, block, target, value);
+    case MOD_ASSIGN:
+        return eval_mod(def, block, target, value);
+    case PLUS_ASSIGN:
+        return eval_add(def, block, target, value);
+    case MINUS_ASSIGN:
+        return eval_sub(def, block, target, value);
+    case AND_ASSIGN:
+        return eval_and(def, block, target, value);
+    case OR_ASSIGN:
+        return eval_or(def, block, target, value);
+    case XOR_ASSIGN:
+        return eval_xor(def, block, target, value);
+    case RSHIFT_ASSIGN:
+        return eval_rshift(def, block, target, value);
+    case LSHIFT_ASSIGN:
+        return eval_lshift(def, block, target, value);
+    }
+}
+
+/*
+ * Create temporary that is never allocated to a register, such that
+ * its representation can be accessed as a different type.
+ */
+static struct var create_memory_var(struct definition *def, Type type)
+{
+    struct var var;
+    struct symbol *sym;
+
+    sym = sym_create_temporary(type);
+    sym->memory = 1;
+    array_push_back(&def->locals, sym);
+    var = var_direct(sym);
+    var.lvalue = 1;
+    return var;
+}
+
+/*
+ * Access object as an unsigned integer of the same size, through its
+ * address.
+ */
+static struct var representation(
+    struct definition *def,
+    struct block *block,
+    struct var var,
+    Type bits)
+{
+    struct var ptr;
+
+    ptr = eval_addr(def, block, var);
+    ptr = eval(def, block,
+        eval_cast(def, block, ptr, type_create_pointer(bits)));
+    return eval_deref(def, block, ptr);
+}
+
+/*
+ * Assignment to an object of _Atomic floating point, struct or union
+ * type operates on its representation, with the same instructions as
+ * an unsigned integer of the same size. Compound assignment is always
+ * a compare and swap loop. Objects that are not 1, 2, 4 or 8 bytes
+ * cannot be updated lock-free, and are not supported.
+ */
+static struct block *atomic_object_assignment(
+    struct definition *def,
+    struct block *block,
+    enum token_type t,
+    struct var target,
+    struct var value,
+    int postfix)
+{
+    Type type, bits;
+    struct var ptr, old, new, prev;
+    struct block *loop, *retry, *next;
+
+    type = type_unqualified(target.type);
+    switch (size_of(type)) {
+    case 1:
+        bits = basic_type__unsigned_char;
+        break;
+    case 2:
+        bits = basic_type__unsigned_short;
+        break;
+    case 4:
+        bits = basic_type__unsigned_int;
+        break;
+    case 8:
+        bits = basic_type__unsigned_long;
+        break;
+    default:
+        error("Assignment to %t is not lock-free, and not supported.",
+            target.type);
+        exit(1);
+    }
+
+    ptr = eval_addr(def, block, target);
+    ptr = eval(def, block,
+        eval_cast(def, block, ptr, type_create_pointer(bits)));
+    new = create_memory_var(def, type);
+    if (t == '=') {
+        value = eval_assign(def, block, new, as_expr(value));
+        eval_expression_statement(def, block,
+            eval_atomic(def, block, IR_OP_ATOMIC_XCHG, ptr,
+                representation(def, block, new, bits)));
+        block->expr = as_expr(value);
+        return block;
+    }
+
+    old = create_memory_var(def, type);
+    value = rvalue(def, block, value);
+    eval_assign(def, block, representation(def, block, old, bits),
+        eval_atomic(def, block, IR_OP_ATOMIC_LOAD, ptr, var_void()));
+    loop = cfg_block_init(def);
+    retry = cfg_block_init(def);
+    next = cfg_block_init(def);
+    block->jump[0] = loop;
+    block = loop;
+    block->expr = compound_operation(def, block, t, old, value);
+    eval_assign(def, block, new, block->expr);
+    prev = eval_atomic_cas(def, block, ptr,
+        representation(def, block, old, bits),
+        representation(def, block, new, bits));
+    block->expr = eval_cmp_eq(def, block, prev,
+        representation(def, block, old, bits));
+    block->jump[0] = retry;
+    block->jump[1] = next;
+    eval_assign(def, retry, representation(def, retry, old, bits),
+        as_expr(prev));
+    retry->jump[0] = loop;
+    block = next;
+    block->expr = as_expr(postfix ? old : new);
+    return block;
+}
+
+/*
+ * Assignment to an object of _Atomic integer or pointer type is done
+ * as a sequentially consistent exchange. Compound assignment, and
+ * increment or decrement, is an atomic read-modify-write, using lock
+ * add, and, or or xor where possible, and otherwise a compare and swap
+ * loop. Evaluate to the old value if postfix is set, otherwise to the
+ * new value.
+ */
+static struct block *atomic_assignment(
+    struct definition *def,
+    struct block *block,
+    enum token_type t,
+    struct var target,
+    struct var value,
+    int postfix)
+{
+    Type type;
+    struct var ptr, old, new, delta, prev;
+    struct block *loop, *retry, *next;
+
+    type = type_unqualified(target.type);
+    if (!target.lvalue || is_field(target)) {
+        error("Target of assignment must be an atomic lvalue.");
+        exit(1);
+    }
+
+    if (!is_integer(type) && !is_pointer(type)) {
+        return atomic_object_assignment(def, block, t, target, value,
+            postfix);
+    }
+
+    ptr = eval_addr(def, block, target);
+    new = create_var(def, type);
+    if (t == '=') {
+        new = eval_assign(def, block, new, as_expr(value));
+        eval_expression_statement(def, block,
+            eval_atomic(def, block, IR_OP_ATOMIC_XCHG, ptr, new));
+        block->expr = as_expr(new);
+        return block;
+    }
+
+    old = create_var(def, type);
+    value = rvalue(def, block, value);
+    switch (t) {
+    case PLUS_ASSIGN:
+    case MINUS_ASSIGN:
+        if (!is_integer(value.type) || is_bool(type)
+            || (is_pointer(type) && !size_of(type_deref(type))))
+        {
+            break;
+        }
+        delta = value;
+        if (is_pointer(type)) {
+            delta = eval(def, block,
+                eval_mul(def, block,
+                    eval(def, block,
+                        eval_cast(def, block, delta, basic_type__unsigned_long)),
+                    imm_unsigned(basic_type__unsigned_long,
+                        size_of(type_deref(type)))));
+        }
+        if (t == MINUS_ASSIGN) {
+            delta = eval(def, block, eval_neg(def, block, delta));
+        }
+        eval_assign(def, block, old,
+            eval_atomic(def, block, IR_OP_ATOMIC_ADD, ptr, delta));
+        goto done;
+    case AND_ASSIGN:
+    case OR_ASSIGN:
+    case XOR_ASSIGN:
+        if (!is_integer(value.type) || !is_integer(type) || is_bool(type)) {
+            break;
+        }
+        eval_assign(def, block, old,
+            eval_atomic(def, block,
+                t == AND_ASSIGN ? IR_OP_ATOMIC_AND
+                    : t == OR_ASSIGN ? IR_OP_ATOMIC_OR : IR_OP_ATOMIC_XOR,
+                ptr, value));
+        goto done;
+    default:
+        break;
+    }
+
+    /*
+     * Compute the new value from the last value read, and try to swap
+     * it in until no other thread has modified the object in between.
+     */
+    eval_assign(def, block, old,
+        eval_atomic(def, block, IR_OP_ATOMIC_LOAD, ptr, var_void()));
+    loop = cfg_block_init(def);
+    retry = cfg_block_init(def);
+    next = cfg_block_init(def);
+    block->jump[0] = loop;
+    block = loop;
+    block->expr = compound_operation(def, block, t, old, value);
+    eval_assign(def, block, new, block->expr);
+    prev = eval_atomic_cas(def, block, ptr, old, new);
+    block->expr = eval_cmp_eq(def, block, prev, old);
+    block->jump[0] = retry;
+    block->jump[1] = next;
+    eval_assign(def, retry, old, as_expr(prev));
+    retry->jump[0] = loop;
+    block = next;
+    block->expr = as_expr(postfix ? old : new);
+    return block;
+
+done:
+    block->expr = compound_operation(def, block, t, old, value);
+    eval_assign(def, block, new, block->expr);
+    block->expr = as_expr(postfix ? old : new);
+    return block;
+}
+
 INTERNAL struct block *assignment_expression(
     struct definition *def,
     struct block *block)
@@ -940,42 +1243,14 @@ INTERNAL struct block *assignment_expression(
 
     target = eval(def, block, block->expr);
     block = assignment_expression(def, block);
+    if (is_atomic(target.type)) {
+        value = eval(def, block, block->expr);
+        return atomic_assignment(def, block, t, target, value, 0);
+    }
+
     if (t != '=') {
         value = eval(def, block, block->expr);
-        switch (t) {
-        default:
-            assert(0);
-        case MUL_ASSIGN:
-            block->expr = eval_mul(def, block, target, value);
-            break;
-        case DIV_ASSIGN:
-            block->expr = eval_div(def, block, target, value);
-            break;
-        case MOD_ASSIGN:
-            block->expr = eval_mod(def, block, target, value);
-            break;
-        case PLUS_ASSIGN:
-            block->expr = eval_add(def, block, target, value);
-            break;
-        case MINUS_ASSIGN:
-            block->expr = eval_sub(def, block, target, value);
-            break;
-        case AND_ASSIGN:
-            block->expr = eval_and(def, block, target, value);
-            break;
-        case OR_ASSIGN:
-            block->expr = eval_or(def, block, target, value);
-            break;
-        case XOR_ASSIGN:
-            block->expr = eval_xor(def, block, target, value);
-            break;
-        case RSHIFT_ASSIGN:
-            block->expr = eval_rshift(def, block, target, value);
-            break;
-        case LSHIFT_ASSIGN:
-            block->expr = eval_lshift(def, block, target, value);
-            break;
-        }
+        block->expr = compound_operation(def, block, t, target, value);
     }
 
     value = eval_assign(def, block, target, block->expr);
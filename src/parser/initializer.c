@@ -2,6 +2,7 @@
 # define INTERNAL
 # define EXTERNAL extern
 #endif
+#include "builtin.h"
 #include "eval.h"
 #include "expression.h"
 #include "initializer.h"
@@ -12,6 +13,13 @@
 
 #include <assert.h>
 
+/*
+ * Automatic objects with at least this many bytes not initialized to a
+ * non-zero value are cleared with memset, instead of assigning zero to
+ * each element.
+ */
+#define MEMSET_THRESHOLD 32
+
 typedef array_of(struct statement) InitializerList;
 
 /*
@@ -432,6 +440,8 @@ static int try_parse_index(size_t *index)
  *      foo = "Hi"
  *      foo[3] = 0
  *      foo[4] = 0
+ *
+ * Vector types are initialized like arrays of their elements.
  */
 static struct block *initialize_array(
     struct definition *def,
@@ -444,14 +454,14 @@ static struct block *initialize_array(
     Type type, elem;
     size_t initial, width, count, i, c;
 
-    assert(is_array(target.type));
+    assert(is_array(target.type) || is_vector(target.type));
     assert(target.kind == DIRECT);
 
     i = c = 0;
-    count = type_array_len(target.type);
     type = target.type;
     elem = type_next(type);
     width = size_of(elem);
+    count = is_vector(type) ? size_of(type) / width : type_array_len(type);
     initial = target.offset;
 
     /*
@@ -533,6 +543,12 @@ static struct block *initialize_member(
         } else {
             block = initialize_array(def, block, values, target, DESIGNATOR);
         }
+    } else if (is_vector(target.type) && !block->has_init_value
+        && try_consume('{'))
+    {
+        block = initialize_array(def, block, values, target, CURRENT);
+        try_consume(',');
+        consume('}');
     } else {
         if (!block->has_init_value) {
             if (try_consume('{')) {
@@ -561,7 +577,7 @@ static struct block *initialize_object(
     if (try_consume('{')) {
         if (is_struct_or_union(target.type)) {
             block = initialize_struct_or_union(def, block, values, target, CURRENT);
-        } else if (is_array(target.type)) {
+        } else if (is_array(target.type) || is_vector(target.type)) {
             block = initialize_array(def, block, values, target, CURRENT);
         } else {
             block = initialize_object(def, block, values, target);
@@ -609,6 +625,7 @@ static void zero_initialize(
             ? type_create_array(basic_type__char, size)
             : type_create_array(basic_type__long, size / 8);
     case T_ARRAY:
+    case T_VECTOR:
         var = target;
         target.type = type_next(target.type);
         for (i = 0; i < size / size_of(target.type); ++i) {
@@ -754,8 +771,12 @@ static void initialize_padding(
             break;
         }
 
+        /* Static objects are implicitly zero between assignments. */
         assert(prev.offset <= next.offset);
-        zero_initialize_bytes(def, block, prev, next.offset - prev.offset);
+        if (prev.value.symbol->linkage == LINK_NONE) {
+            zero_initialize_bytes(def, block, prev, next.offset - prev.offset);
+        }
+
         prev.offset = next.offset;
     }
 }
@@ -828,21 +849,30 @@ static void normalize_field_assignment(InitializerList *block)
 /*
  * Initializer blocks should always result in a list of assignment
  * operations writing to all bits of the target object, in order.
+ * Objects with static storage duration can leave out whole bytes that
+ * are zero, but all other bits are assigned.
  *
  * Some additional constrants are put on field assignments; the first
  * assignment to a field on a new offset must have field_offset 0.
  */
-static size_t validate_contiguous_initialization(InitializerList *block)
+static size_t validate_contiguous_initialization(
+    InitializerList *block,
+    struct var target)
 {
-    int i;
+    int i, sparse;
     size_t bits = 0;
     struct statement st;
     struct var field, prev;
 
+    sparse = target.value.symbol->linkage != LINK_NONE;
     for (i = 0; i < array_len(block); ++i) {
         st = array_get(block, i);
         assert(st.st == IR_ASSIGN);
         field = st.t;
+        if (sparse && field.offset * 8 > bits) {
+            assert(!field.field_offset);
+            bits = field.offset * 8;
+        }
 
         if (field.field_width) {
             assert(!field.field_offset
@@ -858,6 +888,11 @@ static size_t validate_contiguous_initialization(InitializerList *block)
     }
 
     assert(bits % 8 == 0);
+    if (sparse) {
+        assert(bits <= size_of(target.type) * 8);
+        bits = size_of(target.type) * 8;
+    }
+
     return bits / 8;
 }
 
@@ -896,19 +931,53 @@ static void sort_and_trim(InitializerList *values)
     }
 }
 
+/*
+ * Floating point zero is represented with all bits zero, except for
+ * long double which is kept in a separate table.
+ */
+static int is_zero_assignment(const struct statement *st)
+{
+    unsigned long bits;
+
+    assert(st->st == IR_ASSIGN);
+    if (!is_identity(st->expr)
+        || st->expr.l.kind != IMMEDIATE
+        || st->expr.l.is_symbol)
+    {
+        return 0;
+    }
+
+    bits = st->expr.l.value.imm.u;
+    if (is_float(st->expr.type)) {
+        bits &= 0xFFFFFFFFu;
+    } else if (!is_integer(st->expr.type)
+        && !is_pointer(st->expr.type)
+        && !is_double(st->expr.type))
+    {
+        return 0;
+    }
+
+    return bits == 0;
+}
+
 /*
  * Fill in any missing padding initialization in assignment statement
  * list.
  *
  * The input block contains a list of assignments to the same variable,
  * possibly sparsely covering the full size of the type.
+ *
+ * Objects with static storage duration are instead left with a sparse
+ * list of non-zero assignments, in increasing order of offset. Memory
+ * between them is filled with zero by the backend, making size of the
+ * IR proportional to the non-zero content of large tables.
  */
 static void postprocess_object_initialization(
     struct definition *def,
     InitializerList *values,
     struct var target)
 {
-    int i, has_field;
+    int i, j, has_field;
     struct statement st;
     struct var prev, next;
     InitializerList block;
@@ -938,13 +1007,88 @@ static void postprocess_object_initialization(
     next.offset = size_of(target.type);
     next.field_offset = 0;
     initialize_padding(def, &block, prev, next);
-    if (has_field) {
+    if (has_field && array_len(&block) > 1) {
         normalize_field_assignment(&block);
     }
 
+    if (target.value.symbol->linkage != LINK_NONE) {
+        for (i = 0, j = 0; i < array_len(&block); ++i) {
+            st = array_get(&block, i);
+            if (st.t.field_offset || !is_zero_assignment(&st)) {
+                array_get(&block, j++) = st;
+            }
+        }
+        array_len(&block) = j;
+    }
+
     release_initializer_block(*values);
     *values = block;
-    assert(validate_contiguous_initialization(&block) == size_of(target.type));
+    assert(validate_contiguous_initialization(&block, target)
+        == size_of(target.type));
+}
+
+/*
+ * Clear automatic object with a call to memset, followed by the list of
+ * assignments with non-zero value. This replaces zero initialization of
+ * padding and missing elements, which for large objects would generate
+ * a long list of assignments. Return 0 if object should be initialized
+ * by postprocessing the assignments instead.
+ */
+static int memset_object_initialization(
+    struct definition *def,
+    struct block *block,
+    InitializerList *values,
+    struct var target)
+{
+    int i;
+    Type type;
+    size_t size, bytes;
+    struct statement st;
+    struct expression args[3];
+
+    assert(!target.offset);
+    size = size_of(target.type);
+    if (!decl_memset
+        || target.value.symbol->linkage != LINK_NONE
+        || size < MEMSET_THRESHOLD)
+    {
+        return 0;
+    }
+
+    sort_and_trim(values);
+    for (i = 0, bytes = 0; i < array_len(values); ++i) {
+        st = array_get(values, i);
+        if (is_zero_assignment(&st)) {
+            array_erase(values, i);
+            i--;
+        } else if (st.t.field_width) {
+            bytes += (st.t.field_width + 7) / 8;
+        } else {
+            bytes += size_of(st.t.type);
+        }
+    }
+
+    if (size - bytes < MEMSET_THRESHOLD) {
+        return 0;
+    }
+
+    type = decl_memset->type;
+    assert(nmembers(type) == 3);
+    args[0] = as_expr(eval_addr(def, block, target));
+    args[1] = as_expr(var_int(0));
+    args[2] = as_expr(imm_unsigned(basic_type__unsigned_long, size));
+    for (i = 0; i < 3; ++i) {
+        args[i] = eval_prepare_arg(def, block, args[i],
+            get_member(type, i)->type);
+    }
+
+    for (i = 0; i < 3; ++i) {
+        eval_push_param(def, block, args[i]);
+    }
+
+    eval_expression_statement(def, block,
+        eval_call(def, block, var_direct(decl_memset)));
+    return 1;
 }
 
 INTERNAL struct block *initializer(
@@ -958,7 +1102,9 @@ INTERNAL struct block *initializer(
     if (peek() == '{' || is_array(sym->type)) {
         values = get_initializer_list();
         block = initialize_object(def, block, &values, target);
-        postprocess_object_initialization(def, &values, target);
+        if (!memset_object_initialization(def, block, &values, target)) {
+            postprocess_object_initialization(def, &values, target);
+        }
         array_concat(&def->statements, &values);
         block->count += array_len(&values);
         release_initializer_block(values);
@@ -966,6 +1112,13 @@ INTERNAL struct block *initializer(
         block = read_initializer_element(def, block, sym);
         eval_assign(def, block, target, block->expr);
         block->has_init_value = 0;
+        if (sym->linkage != LINK_NONE
+            && is_zero_assignment(&array_back(&def->statements)))
+        {
+            assert(block->count > 0);
+            array_len(&def->statements) -= 1;
+            block->count--;
+        }
     }
 
     assert(!block->has_init_value);
@@ -207,6 +207,22 @@ INTERNAL void cfg_define(struct definition *def, const struct symbol *sym)
     deque_push_back(&definitions, def);
 }
 
+INTERNAL const struct definition *get_inline_definition(
+    const struct symbol *sym)
+{
+    int i;
+    struct definition *def;
+
+    for (i = 0; i < array_len(&inline_definitions); ++i) {
+        def = array_get(&inline_definitions, i);
+        if (def->symbol == sym) {
+            return def;
+        }
+    }
+
+    return NULL;
+}
+
 static struct definition *pop_inline_function(void)
 {
     int i;
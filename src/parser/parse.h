@@ -30,6 +30,13 @@ INTERNAL void cfg_discard(struct definition *def);
 /* Create a basic block associated with control flow graph. */
 INTERNAL struct block *cfg_block_init(struct definition *def);
 
+/*
+ * Get definition of inline function parsed so far, which is not yet
+ * compiled. Return NULL if not found.
+ */
+INTERNAL const struct definition *get_inline_definition(
+    const struct symbol *sym);
+
 INTERNAL struct block *begin_throwaway_block(struct definition *def);
 
 INTERNAL void restore_block(struct definition *def);
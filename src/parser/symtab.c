@@ -94,6 +94,13 @@ static Type get_string_type(size_t len)
  */
 static struct hash_table functions;
 
+/*
+ * Intern string literals and floating point constants per translation
+ * unit, so that each distinct value is only emitted once. Literals are
+ * keyed on the registered string, and constants on their bit pattern.
+ */
+static struct hash_table strings, constants;
+
 /*
  * Deallocate all memory owned by namespace.
  */
@@ -138,6 +145,8 @@ INTERNAL void symtab_clear(void)
 
     array_empty(&string_types);
     hash_clear(&functions, NULL);
+    hash_clear(&strings, NULL);
+    hash_clear(&constants, NULL);
 }
 
 INTERNAL void symtab_finalize(void)
@@ -153,6 +162,8 @@ INTERNAL void symtab_finalize(void)
     array_clear(&temporaries);
     array_clear(&string_types);
     hash_destroy(&functions);
+    hash_destroy(&strings);
+    hash_destroy(&constants);
 }
 
 INTERNAL void push_scope(struct namespace *ns)
@@ -498,11 +509,48 @@ INTERNAL struct symbol *sym_create_label(void)
     return sym;
 }
 
+/*
+ * Build hash key from the significant bytes of a floating point value,
+ * which always fit in a short string. Types of different size give
+ * keys of different length.
+ */
+static String constant_key(Type type, union value val)
+{
+    String key;
+    size_t len;
+    union {
+        long double ld;
+        char arr[16];
+    } conv;
+
+    memset(&key, 0, sizeof(key));
+    if (is_long_double(type)) {
+        len = 10;
+        conv.ld = get_long_double(val);
+        memcpy(key.small.buf, conv.arr, len);
+    } else {
+        len = size_of(type);
+        assert(len == 4 || len == 8);
+        memcpy(key.small.buf, &val, len);
+    }
+
+    key.small.cap = SHORT_STRING_LEN - len;
+    return key;
+}
+
 INTERNAL struct symbol *sym_create_constant(Type type, union value val)
 {
     static int n;
+    String key;
     struct symbol *sym;
 
+    key = constant_key(type, val);
+    sym = hash_lookup(&constants, key);
+    if (sym) {
+        assert(type_equal(sym->type, type));
+        return sym;
+    }
+
     sym = alloc_sym();
     sym->type = type;
     sym->value.constant = val;
@@ -511,6 +559,7 @@ INTERNAL struct symbol *sym_create_constant(Type type, union value val)
     sym->name = prefix_constant;
     sym->n = ++n;
     array_push_back(&ns_ident.symbols, sym);
+    hash_insert(&constants, key, sym, NULL);
     return sym;
 }
 
@@ -518,6 +567,9 @@ INTERNAL struct symbol *sym_create_constant(Type type, union value val)
  * Store string value directly on symbol, memory ownership is in string
  * table from previously called str_register. The symbol now exists as
  * if declared static char .LC[] = "...".
+ *
+ * Registered strings with equal value compare equal, and share the
+ * same symbol within a translation unit.
  */
 INTERNAL struct symbol *sym_create_string(String str)
 {
@@ -525,6 +577,11 @@ INTERNAL struct symbol *sym_create_string(String str)
     struct symbol *sym;
     size_t len;
 
+    sym = hash_lookup(&strings, str);
+    if (sym) {
+        return sym;
+    }
+
     len = str_len(str);
     sym = alloc_sym();
     sym->type = get_string_type(len + 1);
@@ -534,6 +591,7 @@ INTERNAL struct symbol *sym_create_string(String str)
     sym->name = prefix_string;
     sym->n = ++n;
     array_push_back(&ns_ident.symbols, sym);
+    hash_insert(&strings, str, sym, NULL);
     return sym;
 }
 
@@ -553,6 +611,25 @@ INTERNAL void sym_discard(struct symbol *sym)
     array_push_back(&temporaries, sym);
 }
 
+INTERNAL enum visibility sym_visibility(const struct symbol *sym)
+{
+    if (sym->linkage != LINK_EXTERN) {
+        return VISIBILITY_DEFAULT;
+    }
+
+    if (sym->has_visibility) {
+        return sym->visibility;
+    }
+
+    switch (sym->symtype) {
+    case SYM_DEFINITION:
+    case SYM_TENTATIVE:
+        return context.visibility;
+    default:
+        return VISIBILITY_DEFAULT;
+    }
+}
+
 INTERNAL int is_temporary(const struct symbol *sym)
 {
     return str_eq(prefix_temporary, sym->name);
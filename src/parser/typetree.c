@@ -39,15 +39,25 @@ struct typetree {
     unsigned int is_const : 1;
     unsigned int is_volatile : 1;
     unsigned int is_restrict : 1;
+    unsigned int is_atomic : 1;
     unsigned int is_vararg : 1;
     unsigned int is_flexible : 1;
     unsigned int is_vla : 1;
     unsigned int is_incomplete : 1;
+    unsigned int is_packed : 1;
 
     /*
-     * Total storage size in bytes for struct, union and basic types,
-     * equal to what is returned for sizeof. Number of elements in case
-     * of array type.
+     * Alignment of struct or union. Before the type is sealed, this is
+     * the minimum alignment given by attributes on the type or any of
+     * its members. Array and arithmetic types have non-zero alignment
+     * only if declared by typedef with aligned attribute.
+     */
+    size_t align;
+
+    /*
+     * Total storage size in bytes for struct, union, vector and basic
+     * types, equal to what is returned for sizeof. Number of elements
+     * in case of array type.
      */
     size_t size;
 
@@ -67,8 +77,8 @@ struct typetree {
     array_of(struct member) members;
 
     /*
-     * Function return value, pointer target, array base, or pointer to
-     * tagged struct or union type. Tag indirections are used to avoid
+     * Function return value, pointer target, array or vector element,
+     * or pointer to tagged struct or union type. Tag indirections are used to avoid
      * loops in type trees.
      */
     Type next;
@@ -110,17 +120,20 @@ static Type get_type_handle(int ref)
             type.is_const = t->next.is_const;
             type.is_volatile = t->next.is_volatile;
             type.is_restrict = t->next.is_restrict;
+            type.is_atomic = t->next.is_atomic;
             type.ref = t->next.ref;
             type.is_pointer = 1;
             type.is_pointer_const = t->is_const;
             type.is_pointer_volatile = t->is_volatile;
             type.is_pointer_restrict = t->is_restrict;
+            type.is_pointer_atomic = t->is_atomic;
         }
         break;
     case T_FUNCTION:
     case T_ARRAY:
     case T_STRUCT:
     case T_UNION:
+    case T_VECTOR:
         type.ref = ref;
     default:
         type.type = t->type;
@@ -128,6 +141,7 @@ static Type get_type_handle(int ref)
         type.is_volatile = t->is_volatile;
         type.is_const = t->is_const;
         type.is_restrict = t->is_restrict;
+        type.is_atomic = t->is_atomic;
         break;
     }
 
@@ -185,10 +199,12 @@ INTERNAL Type type_unqualified(Type type)
         type.is_pointer_const = 0;
         type.is_pointer_volatile = 0;
         type.is_pointer_restrict = 0;
+        type.is_pointer_atomic = 0;
     } else {
         type.is_const = 0;
         type.is_volatile = 0;
         type.is_restrict = 0;
+        type.is_atomic = 0;
     }
 
     return type;
@@ -324,17 +340,29 @@ static void reset_field_alignment(Type type, Type clear)
 }
 
 /*
- * Add necessary padding to parent struct such that new member type can
- * be added. Union types need no padding.
+ * Natural alignment of member added to struct or union. Members of
+ * packed types are not aligned.
+ */
+static size_t member_alignment(Type parent, Type type)
+{
+    struct typetree *t;
+
+    t = get_typetree_handle(parent.ref);
+    return t->is_packed ? 1 : type_alignment(type);
+}
+
+/*
+ * Add necessary padding to parent struct such that new member with the
+ * given alignment can be added. Union types need no padding.
  *
  * In case a member is added after a bit field, allow overlapping the
  * field backing type if there is room for it.
  */
-static size_t adjust_member_alignment(Type parent, Type type)
+static size_t adjust_member_alignment(Type parent, size_t align)
 {
     struct typetree *t;
     struct member *mb;
-    size_t align, bytes, offset;
+    size_t bytes, offset;
     int i;
 
     assert(is_struct_or_union(parent));
@@ -363,7 +391,6 @@ static size_t adjust_member_alignment(Type parent, Type type)
         }
     }
 
-    align = type_alignment(type);
     if (t->size % align) {
         t->size += align - (t->size % align);
         assert(t->size % align == 0);
@@ -382,6 +409,7 @@ INTERNAL Type type_create_pointer(Type next)
         t = get_typetree_handle(type.ref);
         t->is_const = is_const(next);
         t->is_volatile = is_volatile(next);
+        t->is_atomic = is_atomic(next);
         next = type_unqualified(next);
         next.is_pointer = 0;
         t->next = next;
@@ -405,11 +433,26 @@ INTERNAL Type type_create_function(Type next)
     return type;
 }
 
+/*
+ * Elements of an array must be placed consecutively, which is not
+ * possible if the element size is not a multiple of its alignment.
+ */
+static void check_array_element(Type next)
+{
+    if ((is_array(next) || is_arithmetic(next))
+        && size_of(next) % type_alignment(next))
+    {
+        error("Alignment of array elements is greater than element size.");
+        exit(1);
+    }
+}
+
 INTERNAL Type type_create_array(Type next, size_t count)
 {
     Type type;
     struct typetree *t;
 
+    check_array_element(next);
     if (count * size_of(next) > LONG_MAX) {
         error("Array is too large (%lu elements).", count);
         exit(1);
@@ -422,11 +465,25 @@ INTERNAL Type type_create_array(Type next, size_t count)
     return type;
 }
 
+INTERNAL Type type_create_vector(Type next, size_t size)
+{
+    Type type;
+    struct typetree *t;
+
+    assert(is_arithmetic(next));
+    type = type_create(T_VECTOR);
+    t = get_typetree_handle(type.ref);
+    t->size = size;
+    t->next = type_unqualified(next);
+    return type;
+}
+
 INTERNAL Type type_create_incomplete(Type next)
 {
     Type type;
     struct typetree *t;
 
+    check_array_element(next);
     type = type_create(T_ARRAY);
     t = get_typetree_handle(type.ref);
     t->next = next;
@@ -485,6 +542,22 @@ INTERNAL Type type_set_restrict(Type type)
     return type;
 }
 
+INTERNAL Type type_set_atomic(Type type)
+{
+    if (is_array(type) || is_function(type)) {
+        error("Cannot apply '_Atomic' qualifier to %t.", type);
+        exit(1);
+    }
+
+    if (type.is_pointer) {
+        type.is_pointer_atomic = 1;
+    } else {
+        type.is_atomic = 1;
+    }
+
+    return type;
+}
+
 INTERNAL Type type_apply_qualifiers(Type type, Type other)
 {
     if (is_const(other))
@@ -493,6 +566,8 @@ INTERNAL Type type_apply_qualifiers(Type type, Type other)
         type = type_set_volatile(type);
     if (is_restrict(other))
         type = type_set_restrict(type);
+    if (is_atomic(other))
+        type = type_set_atomic(type);
     return type;
 }
 
@@ -579,26 +654,94 @@ INTERNAL void type_set_tag(Type type, const struct symbol *tag)
 
 INTERNAL size_t type_alignment(Type type)
 {
-    int i;
-    size_t m = 0, d;
+    struct typetree *t;
     assert(is_object(type));
 
     switch (type_of(type)) {
     case T_ARRAY:
-        return type_alignment(type_next(type));
+        t = get_typetree_handle(type.ref);
+        return t->align ? t->align : type_alignment(t->next);
     case T_STRUCT:
     case T_UNION:
-        for (i = 0; i < nmembers(type); ++i) {
-            d = type_alignment(get_member(type, i)->type);
-            if (d > m) m = d;
-        }
-        assert(m);
-        return m;
+        t = get_typetree_handle(type.ref);
+        assert(t->align);
+        return t->align;
     default:
+        if (is_arithmetic(type) && type.ref) {
+            t = get_typetree_handle(type.ref);
+            return t->align;
+        }
         return size_of(type);
     }
 }
 
+INTERNAL void type_set_packed(Type type)
+{
+    struct typetree *t;
+
+    assert(is_struct_or_union(type));
+    t = get_typetree_handle(type.ref);
+    t->is_packed = 1;
+}
+
+INTERNAL void type_set_alignment(Type type, size_t align)
+{
+    struct typetree *t;
+
+    assert(is_struct_or_union(type));
+    t = get_typetree_handle(type.ref);
+    if (align > t->align) {
+        t->align = align;
+    }
+}
+
+INTERNAL Type type_create_aligned(Type type, size_t align)
+{
+    Type copy;
+    struct typetree *t, *orig;
+
+    if (align <= type_alignment(type)) {
+        return type;
+    }
+
+    switch (type_of(type)) {
+    case T_STRUCT:
+    case T_UNION:
+        if (!size_of(type)) {
+            error("Cannot change alignment of incomplete type %t.", type);
+            exit(1);
+        }
+    case T_ARRAY:
+        copy = type_create(type_of(type));
+        t = get_typetree_handle(copy.ref);
+        orig = get_typetree_handle(type.ref);
+        *t = *orig;
+        memset(&t->members, 0, sizeof(t->members));
+        array_concat(&t->members, &orig->members);
+        break;
+    case T_VOID:
+    case T_POINTER:
+    case T_FUNCTION:
+    case T_VECTOR:
+        error("Cannot change alignment of type %t.", type);
+        exit(1);
+    default:
+        assert(is_arithmetic(type));
+        copy = type_create(type_of(type));
+        copy.is_unsigned = type.is_unsigned;
+        t = get_typetree_handle(copy.ref);
+        t->is_unsigned = type.is_unsigned;
+        break;
+    }
+
+    t->align = align;
+    if (is_struct_or_union(type) && t->size % align) {
+        t->size += align - (t->size % align);
+    }
+
+    return type_apply_qualifiers(copy, type);
+}
+
 INTERNAL int nmembers(Type type)
 {
     struct typetree *t = get_typetree_handle(type.ref);
@@ -617,11 +760,14 @@ INTERNAL struct member *get_member(Type type, int n)
 
 INTERNAL struct member *type_add_member(Type parent, String name, Type type)
 {
+    size_t align;
     struct member m = {0};
 
     assert(is_struct_or_union(parent) || is_function(parent));
     if (!is_function(parent)) {
-        m.offset = adjust_member_alignment(parent, type);
+        align = member_alignment(parent, type);
+        type_set_alignment(parent, align);
+        m.offset = adjust_member_alignment(parent, align);
     }
 
     m.name = name;
@@ -629,6 +775,23 @@ INTERNAL struct member *type_add_member(Type parent, String name, Type type)
     return add_member(parent, m);
 }
 
+INTERNAL struct member *type_add_aligned_member(
+    Type parent,
+    String name,
+    Type type,
+    size_t align)
+{
+    struct member m = {0};
+
+    assert(is_struct_or_union(parent));
+    assert(align);
+    type_set_alignment(parent, align);
+    m.offset = adjust_member_alignment(parent, align);
+    m.name = name;
+    m.type = type;
+    return add_member(parent, m);
+}
+
 /*
  * Attempt to place next field member right after the previous one.
  *
@@ -726,13 +889,16 @@ INTERNAL void type_add_field(Type parent, String name, Type type, size_t width)
         t = get_typetree_handle(parent.ref);
         if (!pack_field_member(t, &m)) {
             m.field_offset = 0;
-            m.offset = adjust_member_alignment(parent, type);
+            m.offset = adjust_member_alignment(parent, type_alignment(type));
         }
     }
 
     if (!width) {
         reset_field_alignment(parent, type);
     } else {
+        if (!str_is_empty(name)) {
+            type_set_alignment(parent, type_alignment(type));
+        }
         add_member(parent, m);
     }
 }
@@ -740,7 +906,7 @@ INTERNAL void type_add_field(Type parent, String name, Type type, size_t width)
 INTERNAL void type_add_anonymous_member(Type parent, Type type)
 {
     int i;
-    size_t offset;
+    size_t offset, align;
     struct member m;
     struct typetree *t;
 
@@ -748,13 +914,16 @@ INTERNAL void type_add_anonymous_member(Type parent, Type type)
     assert(is_struct_or_union(type));
     t = get_typetree_handle(type.ref);
     if (is_struct(parent) && is_union(type)) {
-        offset = adjust_member_alignment(parent, type);
+        align = member_alignment(parent, type);
+        type_set_alignment(parent, align);
+        offset = adjust_member_alignment(parent, align);
         for (i = 0; i < nmembers(type); ++i) {
             m = array_get(&t->members, i);
             m.offset += offset;
             add_member(parent, m);
         }
     } else if (is_union(parent) && is_struct(type)) {
+        type_set_alignment(parent, member_alignment(parent, type));
         for (i = 0; i < nmembers(type); ++i) {
             m = array_get(&t->members, i);
             add_member(parent, m);
@@ -769,33 +938,26 @@ INTERNAL void type_add_anonymous_member(Type parent, Type type)
 
 /*
  * Remove anonymous field members, which are only kept for alignment
- * during type construction. Return largest remaining member alignment.
+ * during type construction. Return number of remaining members.
  */
 static size_t remove_anonymous_fields(struct typetree *t)
 {
     int i;
-    size_t align, maxalign;
     struct member *m;
 
-    maxalign = 0;
     for (i = array_len(&t->members) - 1; i >= 0; --i) {
         m = &array_get(&t->members, i);
         if (str_is_empty(m->name)) {
             array_erase(&t->members, i);
-        } else {
-            align = type_alignment(m->type);
-            if (align > maxalign) {
-                maxalign = align;
-            }
         }
     }
 
-    return maxalign;
+    return array_len(&t->members);
 }
 
 /*
  * Adjust aggregate type size to be a multiple of strongest member
- * alignment.
+ * alignment, which is tracked while adding members.
  *
  * This function should only be called only once all members have been
  * added.
@@ -803,22 +965,21 @@ static size_t remove_anonymous_fields(struct typetree *t)
 INTERNAL void type_seal(Type type)
 {
     struct typetree *t;
-    size_t align;
 
     t = get_typetree_handle(type.ref);
     if (t->type == T_FUNCTION) {
         t->is_incomplete = 0;
     } else {
         assert(is_struct_or_union(type));
-        align = remove_anonymous_fields(t);
-        if (align == 0) {
+        if (!remove_anonymous_fields(t)) {
             error("%s has no named members.",
                 is_struct(type) ? "Struct" : "Union");
             exit(1);
         }
 
-        if (t->size % align) {
-            t->size += align - (t->size % align);
+        assert(t->align);
+        if (t->size % t->align) {
+            t->size += t->align - (t->size % t->align);
         }
     }
 }
@@ -891,6 +1052,7 @@ static int typetree_equal(const struct typetree *a, const struct typetree *b)
         || a->is_const != b->is_const
         || a->is_volatile != b->is_volatile
         || a->is_restrict != b->is_restrict
+        || a->is_atomic != b->is_atomic
         || a->is_unsigned != b->is_unsigned
         || a->is_vararg != b->is_vararg
         || a->is_flexible != b->is_flexible
@@ -968,6 +1130,19 @@ static int typetree_equal_unqualified(
     return 1;
 }
 
+/*
+ * Arithmetic types reference a typetree only to carry alignment given
+ * by typedef, which is not part of the type identity.
+ */
+static Type remove_alignment(Type type)
+{
+    if (type.type >= T_BOOL && type.type <= T_LDOUBLE) {
+        type.ref = 0;
+    }
+
+    return type;
+}
+
 INTERNAL int type_equal(Type a, Type b)
 {
     struct typetree *ta, *tb;
@@ -978,6 +1153,8 @@ INTERNAL int type_equal(Type a, Type b)
         } data;
     } x, y;
 
+    a = remove_alignment(a);
+    b = remove_alignment(b);
     x.type = a;
     y.type = b;
 
@@ -1008,6 +1185,8 @@ INTERNAL int type_equal_unqualified(Type a, Type b)
         } data;
     } x, y;
 
+    a = remove_alignment(a);
+    b = remove_alignment(b);
     x.type = type_unqualified(a);
     y.type = type_unqualified(b);
 
@@ -1036,7 +1215,7 @@ INTERNAL Type promote_integer(Type type)
         type = basic_type__int;
     }
 
-    return type;
+    return remove_alignment(type);
 }
 
 INTERNAL Type default_argument_promotion(Type type)
@@ -1076,7 +1255,7 @@ INTERNAL Type usual_arithmetic_conversion(Type t1, Type t2)
         }
     }
 
-    return type_unqualified(res);
+    return remove_alignment(type_unqualified(res));
 }
 
 INTERNAL int is_compatible(Type l, Type r)
@@ -1088,7 +1267,8 @@ INTERNAL int is_compatible(Type l, Type r)
     if (type_of(l) != type_of(r)
         || is_const(l) != is_const(r)
         || is_volatile(l) != is_volatile(r)
-        || is_restrict(l) != is_restrict(r))
+        || is_restrict(l) != is_restrict(r)
+        || is_atomic(l) != is_atomic(r))
     {
         return 0;
     }
@@ -1164,6 +1344,7 @@ INTERNAL size_t size_of(Type type)
         return 16;
     case T_STRUCT:
     case T_UNION:
+    case T_VECTOR:
         t = get_typetree_handle(type.ref);
         return t->size;
     case T_ARRAY:
@@ -1213,7 +1394,7 @@ INTERNAL Type type_next(Type type)
         return type_deref(type);
     }
 
-    assert(is_function(type) || is_array(type));
+    assert(is_function(type) || is_array(type) || is_vector(type));
     t = get_typetree_handle(type.ref);
     return t->next;
 }
@@ -1265,6 +1446,9 @@ INTERNAL int fprinttype(FILE *stream, Type type, const struct symbol *expand)
     const char *s;
     int i, n = 0;
 
+    if (is_atomic(type))
+        n += fputs("_Atomic ", stream);
+
     if (is_const(type))
         n += fputs("const ", stream);
 
@@ -1348,6 +1532,11 @@ INTERNAL int fprinttype(FILE *stream, Type type, const struct symbol *expand)
         }
         n += fprinttype(stream, t->next, NULL);
         break;
+    case T_VECTOR:
+        t = get_typetree_handle(type.ref);
+        n += fprintf(stream, "vector(%lu) ", t->size);
+        n += fprinttype(stream, t->next, NULL);
+        break;
     case T_STRUCT:
     case T_UNION:
         t = get_typetree_handle(type.ref);
@@ -25,12 +25,19 @@ INTERNAL Type type_create_pointer(Type next);
 INTERNAL Type type_create_function(Type next);
 INTERNAL Type type_create_array(Type next, size_t count);
 INTERNAL Type type_create_incomplete(Type next);
+
+/*
+ * Create GCC vector type of the given size in bytes, with elements of
+ * arithmetic type next.
+ */
+INTERNAL Type type_create_vector(Type next, size_t size);
 INTERNAL Type type_create_vla(Type next, const struct symbol *count);
 
-/* Add const, volatile, and restrict qualifiers to type. */
+/* Add const, volatile, restrict, and _Atomic qualifiers to type. */
 INTERNAL Type type_set_const(Type type);
 INTERNAL Type type_set_volatile(Type type);
 INTERNAL Type type_set_restrict(Type type);
+INTERNAL Type type_set_atomic(Type type);
 
 /* Get type without any (top level) qualifiers. */
 INTERNAL Type type_unqualified(Type type);
@@ -51,6 +58,36 @@ INTERNAL Type get_type_placeholder(void);
  */
 INTERNAL struct member *type_add_member(Type parent, String name, Type type);
 
+/*
+ * Add struct or union member with alignment given by attributes,
+ * instead of the natural alignment of the member type.
+ */
+INTERNAL struct member *type_add_aligned_member(
+    Type parent,
+    String name,
+    Type type,
+    size_t align);
+
+/*
+ * Set packed attribute on struct or union, placing members without
+ * padding. Must be set before adding members.
+ */
+INTERNAL void type_set_packed(Type type);
+
+/*
+ * Increase alignment of struct or union type, which is at least the
+ * strictest alignment of any member.
+ */
+INTERNAL void type_set_alignment(Type type, size_t align);
+
+/*
+ * Create copy of struct, union, array or arithmetic type with stricter
+ * alignment, leaving the original type unchanged. Size of struct or
+ * union copy is padded to a multiple of the new alignment. Used for
+ * typedef with aligned attribute.
+ */
+INTERNAL Type type_create_aligned(Type type, size_t align);
+
 /*
  * Add unnamed struct or union member, which itself has to be struct or
  * union type.
@@ -185,7 +185,21 @@ INTERNAL void define(struct macro macro)
     struct macro *ref;
     static String
         builtin__file__ = SHORT_STRING_INIT("__FILE__"),
-        builtin__line__ = SHORT_STRING_INIT("__LINE__");
+        builtin__line__ = SHORT_STRING_INIT("__LINE__"),
+        builtin__attribute__ = SHORT_STRING_INIT("__attribute__");
+
+    /*
+     * Attributes are understood by the parser. Ignore definitions that
+     * would remove them, like glibc does for compilers not defining
+     * __GNUC__.
+     */
+    if (macro.type == FUNCTION_LIKE
+        && !array_len(&macro.replacement)
+        && str_eq(builtin__attribute__, macro.name))
+    {
+        release_token_array(macro.replacement);
+        return;
+    }
 
     new_macro_added = 0;
     ref = hash_insert(&macro_hash_table, macro.name, &macro, macro_hash_add);
@@ -842,9 +856,26 @@ INTERNAL void register_builtin_definitions(enum cstd version)
     register_macro("__SIZEOF_LONG__", "8");
     register_macro("__SIZEOF_POINTER__", "8");
     register_macro("__lacc__", "");
+    register_macro("__ATOMIC_RELAXED", "0");
+    register_macro("__ATOMIC_CONSUME", "1");
+    register_macro("__ATOMIC_ACQUIRE", "2");
+    register_macro("__ATOMIC_RELEASE", "3");
+    register_macro("__ATOMIC_ACQ_REL", "4");
+    register_macro("__ATOMIC_SEQ_CST", "5");
 
 #ifdef x86_64
     register_macro("__x86_64__", "1");
+    if (context.cpu & CPU_SSE3) register_macro("__SSE3__", "1");
+    if (context.cpu & CPU_SSSE3) register_macro("__SSSE3__", "1");
+    if (context.cpu & CPU_SSE4_1) register_macro("__SSE4_1__", "1");
+    if (context.cpu & CPU_SSE4_2) register_macro("__SSE4_2__", "1");
+    if (context.cpu & CPU_POPCNT) register_macro("__POPCNT__", "1");
+    if (context.cpu & CPU_AVX) register_macro("__AVX__", "1");
+    if (context.cpu & CPU_AVX2) register_macro("__AVX2__", "1");
+    if (context.cpu & CPU_BMI) register_macro("__BMI__", "1");
+    if (context.cpu & CPU_BMI2) register_macro("__BMI2__", "1");
+    if (context.cpu & CPU_LZCNT) register_macro("__LZCNT__", "1");
+    if (context.cpu & CPU_PRFCHW) register_macro("__PRFCHW__", "1");
 #endif
 #ifdef ARM64
     register_macro("__arm64__", "1");
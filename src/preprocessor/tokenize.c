@@ -49,8 +49,8 @@ INTERNAL const struct token basic_token[] = {
             TOK(DOT, "."),              TOK(SLASH, "/"),
 /* 0x30 */  IDN(RESTRICT, "restrict"),  TOK(ALIGNOF, "_Alignof"),
             TOK(BOOL, "_Bool"),         IDN(NORETURN, "_Noreturn"),
-            {0},                        {0},
-            {0},                        {0},
+            IDN(ATOMIC, "_Atomic"),     IDN(THREAD_LOCAL, "_Thread_local"),
+            IDN(ATTRIBUTE, "__attribute__"), {0},
 /* 0x38 */  IDN(STATIC_ASSERT, "_Static_assert"),     {0},
             TOK(COLON, ":"),            TOK(SEMICOLON, ";"),
             TOK(LT, "<"),               TOK(ASSIGN, "="),
@@ -80,7 +80,7 @@ INTERNAL const struct token basic_token[] = {
             IDN(SIGNED, "__signed"),    IDN(SIGNED, "__signed__"),
             IDN(RESTRICT, "__restrict"),IDN(RESTRICT, "__restrict__"),
 /* 0x70 */  IDN(VOLATILE, "__volatile"),IDN(VOLATILE, "__volatile__"),
-            {0},                        {0},
+            IDN(THREAD_LOCAL, "__thread"), IDN(ATTRIBUTE, "__attribute"),
             {NUMBER},                   {IDENTIFIER, 1},
             {STRING},                   {PARAM},
 /* 0x78 */  {PREP_NUMBER},              {PREP_CHAR},
@@ -658,6 +658,11 @@ static struct token tokenize_internal(const char *in, const char **endptr)
                     if (in[2] == '_' && in[3] == '_' && E(4))
                         return T(ASM + 1, 7);
                 }
+                if (!strncmp(in, "ttribute", 8)) {
+                    if (E(8)) return T(ASM + 11, 11);
+                    if (in[8] == '_' && in[9] == '_' && E(10))
+                        return T(ATTRIBUTE, 13);
+                }
                 break;
             case 'i':
                 if (M5('n', 'l', 'i', 'n', 'e')) {
@@ -680,6 +685,10 @@ static struct token tokenize_internal(const char *in, const char **endptr)
                         return T(ASM + 7, 12);
                 }
                 break;
+            case 't':
+                if (M5('h', 'r', 'e', 'a', 'd') && E(5))
+                    return T(ASM + 10, 8);
+                break;
             case 'v':
                 if (M7('o', 'l', 'a', 't', 'i', 'l', 'e')) {
                     if (E(7)) return T(ASM + 8, 10);
@@ -692,6 +701,8 @@ static struct token tokenize_internal(const char *in, const char **endptr)
         case 'A':
             if (M6('l', 'i', 'g', 'n', 'o', 'f') && E(6))
                 return T(ALIGNOF, 8);
+            if (M5('t', 'o', 'm', 'i', 'c') && E(5))
+                return T(ATOMIC, 7);
             break;
         case 'B':
             if (M3('o', 'o', 'l') && E(3)) return T(BOOL, 5);
@@ -704,6 +715,10 @@ static struct token tokenize_internal(const char *in, const char **endptr)
             if (!strncmp(in, "tatic_assert", 12) && E(12))
                 return T(STATIC_ASSERT, 14);
             break;
+        case 'T':
+            if (!strncmp(in, "hread_local", 11) && E(11))
+                return T(THREAD_LOCAL, 13);
+            break;
         }
         break;
     case '*':
@@ -0,0 +1,32 @@
+#include <stdio.h>
+
+struct point {
+	int x, y;
+};
+
+static _Atomic double d = 1.5;
+static _Atomic float f;
+static _Atomic struct point p;
+
+/* Called by GCC after compound assignment to floating point objects. */
+void __atomic_feraiseexcept(int excepts) {
+	(void) excepts;
+}
+
+int main(void) {
+	struct point q = {3, 4}, r;
+	double a, b;
+
+	a = d += 2.25;
+	b = d++;
+	--d;
+	d /= 0.5;
+	f = 2;
+	f *= 3.5f;
+	f -= 1;
+	r = (p = q);
+	printf("%f %f %f %f\n", a, b, d, f);
+	q = p;
+	printf("%d %d %d %d\n", q.x, q.y, r.x, r.y);
+	return 0;
+}
@@ -0,0 +1,96 @@
+#include <stdatomic.h>
+#include <stdio.h>
+
+struct ring {
+	atomic_uint head;
+	atomic_uint tail;
+	int data[8];
+};
+
+static atomic_int counter = ATOMIC_VAR_INIT(3);
+static _Atomic(long) total;
+static int values[16];
+static int *_Atomic cursor = values;
+static atomic_flag lock = ATOMIC_FLAG_INIT;
+
+static int push(struct ring *r, int value) {
+	unsigned head = atomic_load_explicit(&r->head, memory_order_relaxed),
+		tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+
+	if (head - tail == 8)
+		return 0;
+	r->data[head % 8] = value;
+	atomic_store_explicit(&r->head, head + 1, memory_order_release);
+	return 1;
+}
+
+static int pop(struct ring *r, int *value) {
+	unsigned tail = atomic_load_explicit(&r->tail, memory_order_relaxed),
+		head = atomic_load_explicit(&r->head, memory_order_acquire);
+
+	if (head == tail)
+		return 0;
+	*value = r->data[tail % 8];
+	atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+	return 1;
+}
+
+int main(void) {
+	int i, v, expected;
+	struct ring r;
+	_Atomic unsigned char c = 250;
+	_Atomic short s;
+
+	atomic_init(&r.head, 0);
+	atomic_init(&r.tail, 0);
+	for (i = 0; push(&r, i * i); ++i)
+		;
+	while (pop(&r, &v))
+		printf("%d ", v);
+	printf("(%d)\n", i);
+
+	printf("%d\n", counter++);
+	printf("%d\n", ++counter);
+	printf("%d\n", counter--);
+	printf("%d\n", counter += 10);
+	printf("%d\n", counter -= 2);
+	printf("%d\n", counter *= 3);
+	printf("%d\n", counter /= 2);
+	printf("%d\n", counter <<= 1);
+	printf("%d\n", counter |= 0x100);
+	printf("%d\n", counter &= 0xff0);
+	printf("%d\n", counter ^= 0x11);
+	printf("%d\n", counter = -1);
+
+	total = 100;
+	total -= 250;
+	printf("%ld\n", atomic_fetch_add(&total, 50));
+	printf("%ld\n", atomic_fetch_sub(&total, 1));
+	printf("%ld\n", atomic_exchange(&total, 7));
+	printf("%ld\n", atomic_load(&total));
+
+	cursor += 3;
+	cursor++;
+	--cursor;
+	printf("%d\n", (int) (cursor - values));
+
+	c += 10;
+	s = 1000;
+	s *= 100;
+	printf("%d %d\n", c, s);
+
+	expected = 0;
+	printf("%d ", atomic_compare_exchange_strong(&counter, &expected, 5));
+	printf("%d %d\n", expected, atomic_load(&counter));
+	printf("%d ", atomic_compare_exchange_weak(&counter, &expected, 5));
+	printf("%d %d\n", expected, atomic_load(&counter));
+
+	printf("%d ", atomic_flag_test_and_set(&lock));
+	printf("%d ", atomic_flag_test_and_set(&lock));
+	atomic_flag_clear(&lock);
+	printf("%d\n", atomic_flag_test_and_set_explicit(&lock, memory_order_acquire));
+	atomic_thread_fence(memory_order_seq_cst);
+	atomic_signal_fence(memory_order_acq_rel);
+	printf("%d\n", atomic_is_lock_free(&total));
+	return 0;
+}
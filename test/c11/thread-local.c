@@ -0,0 +1,42 @@
+#include <stdio.h>
+
+struct point {
+	int x, y;
+};
+
+extern _Thread_local int count;
+
+_Thread_local int count = 3;
+__thread long list[4] = {1, 2, 3, 4};
+
+static _Thread_local struct point origin = {7, 8};
+static __thread char buffer[16];
+
+int *address(void) {
+	return &count;
+}
+
+static int next(void) {
+	static _Thread_local int n;
+	return ++n;
+}
+
+int main(void) {
+	int i;
+
+	count++;
+	*address() += 2;
+	for (i = 0; i < 4; ++i) {
+		list[i] *= count;
+	}
+
+	origin.y += origin.x;
+	buffer[0] = 'a';
+	buffer[1] = buffer[0] + 1;
+	next();
+	next();
+
+	printf("%d, %ld, %ld, {%d, %d}, %s, %d\n",
+		count, list[0], list[3], origin.x, origin.y, buffer, next());
+	return 0;
+}
@@ -0,0 +1,65 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+static double nan(void) {
+	double zero = 0.0;
+	return zero / zero;
+}
+
+static int sum(const int *a, int n) {
+	int i, s = 0;
+	if (!a) {
+		fprintf(stderr, "Missing array\n");
+		exit(1);
+	}
+
+	for (i = 0; i < n; ++i) {
+		if (a[i] < 0)
+			continue;
+		s += a[i];
+	}
+
+	return s;
+}
+
+static int equal(double x, double y) {
+	if (x == y)
+		return 1;
+	return 0;
+}
+
+static int not_equal(double x, double y) {
+	int n = 0;
+	while (x != y) {
+		n++;
+		if (n > 3)
+			break;
+	}
+	return n;
+}
+
+static int truth(double x) {
+	return x ? 1 : 2;
+}
+
+static int search(const char *str, char c) {
+	int i = 0;
+	while (str[i]) {
+		if (str[i] == c)
+			return i;
+		i++;
+	}
+	return -1;
+}
+
+int main(void) {
+	int a[] = {1, -2, 3, 7, -1};
+	double x = nan();
+
+	printf("%d\n", sum(a, 5));
+	printf("%d %d %d\n", equal(1.0, 1.0), equal(x, x), equal(x, 1.0));
+	printf("%d %d %d\n", not_equal(1.0, 1.0), not_equal(x, x), not_equal(2.0, 1.0));
+	printf("%d %d %d\n", truth(0.0), truth(x), truth(-1.0));
+	printf("%d %d\n", search("hello", 'l'), search("hello", 'x'));
+	return 0;
+}
@@ -0,0 +1,35 @@
+int printf(const char *, ...);
+
+static const unsigned int crc[8] = {
+    0x00000000, 0x77073096, 0xEE0E612C, 0x990951BA,
+    0x076DC419, 0x706AF48F, 0xE963A535, 0x9E6495A3
+};
+
+const struct {
+    short lo, hi;
+} ranges[3] = {{0, 9}, {65, 90}, {97, 122}};
+
+const int zeros[64] = {0};
+
+int value = 7;
+int *const address = &value;
+const char *const words[] = {"alpha", "beta", "gamma"};
+
+const char *mutable[] = {"first", "second"};
+const volatile int status = 1;
+
+int main(void) {
+    static const double weights[4] = {0.25, 0.5, 1.0, 2.0};
+    int i;
+
+    mutable[1] = words[2];
+    *address += 1;
+    for (i = 0; i < 8; ++i) {
+        printf("%08x ", crc[i]);
+    }
+
+    printf("\n%d %d %d %d\n", ranges[1].lo, ranges[2].hi, zeros[63], value);
+    printf("%s %s %s %d %g\n", words[0], mutable[0], mutable[1], status,
+        weights[1] + weights[3]);
+    return 0;
+}
@@ -0,0 +1,29 @@
+#!/bin/sh
+
+cc=$1
+src=$2
+dir=$3
+
+# Constant objects without relocations go in .rodata, and objects with
+# addresses in .data.rel.ro when compiling position independent code.
+check()
+{
+	objdump -t ${dir}/${src}.o | awk -v pic="$1" '
+		$NF ~ /^(crc|ranges|zeros|weights)/ && $(NF-2) != ".rodata" { fail=1; }
+		$NF ~ /^(address|words)$/ && $(NF-2) != (pic ? ".data.rel.ro" : ".rodata") { fail=1; }
+		$NF ~ /^(value|mutable|status)$/ && $(NF-2) != ".data" { fail=1; }
+		END { exit fail }'
+}
+
+$cc -fPIC -c ${src}.c -o ${dir}/${src}.o || exit 1
+cc ${dir}/${src}.o -o ${dir}/${src}.out 2> /dev/null || exit 1
+${dir}/${src}.out | diff - ${dir}/${src}.ans.txt > /dev/null || exit 1
+check 1 || exit 1
+
+$cc -fno-PIC -c ${src}.c -o ${dir}/${src}.o || exit 1
+check 0 || exit 1
+
+$cc -fPIC -S ${src}.c -o ${dir}/${src}.s || exit 1
+grep -E "\.section\s\.data\.rel\.ro" ${dir}/${src}.s > /dev/null || exit 1
+
+exit 0
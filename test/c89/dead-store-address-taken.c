@@ -0,0 +1,27 @@
+int *g;
+
+static void increment(void) {
+    *g += 1;
+}
+
+static int read(int *p) {
+    return *p;
+}
+
+int main(void) {
+    int a, b, c, r;
+
+    g = &a;
+    a = 5;
+    increment();
+    b = a;
+
+    c = 3;
+    r = read(&c);
+    c = 4;
+    r += c;
+
+    a = 10;
+    b += *g;
+    return b + r;
+}
@@ -0,0 +1,68 @@
+#include <limits.h>
+#include <stdio.h>
+
+static int ival[] = {0, 1, -1, 7, -7, 100, -100, 12345, -12345,
+	INT_MAX, INT_MIN, INT_MIN + 1};
+static unsigned uval[] = {0, 1, 7, 100, 12345, UINT_MAX, 2147483648u,
+	3000000000u};
+static long lval[] = {0, 1, -1, 7, -7, 1000000000000L, -1000000000000L,
+	LONG_MAX, LONG_MIN, LONG_MIN + 1};
+static unsigned long ulval[] = {0, 1, 7, 1000000000000ul, ULONG_MAX,
+	9223372036854775808ul, 4294967296ul};
+
+#define N(a) (sizeof(a) / sizeof((a)[0]))
+
+static void test_int(void) {
+	int i, x;
+
+	for (i = 0; i < N(ival); ++i) {
+		x = ival[i];
+		printf("%d %d %d %d %d %d\n", x / 2, x % 2, x / 8, x % 8, x / 3, x % 3);
+		printf("%d %d %d %d %d %d\n", x / 7, x % 7, x / 10, x % 10, x / -4, x % -4);
+		printf("%d %d %d %d\n", x / -3, x % -3, x / 641, x % INT_MAX);
+		printf("%d %d %d %d %d\n", x * 3, x * 10, x * 17, x * 31, x * 72);
+	}
+}
+
+static void test_unsigned(void) {
+	int i;
+	unsigned x;
+
+	for (i = 0; i < N(uval); ++i) {
+		x = uval[i];
+		printf("%u %u %u %u %u %u\n", x / 2, x % 2, x / 16, x % 16, x / 3, x % 3);
+		printf("%u %u %u %u %u %u\n", x / 7, x % 7, x / 10, x % 10, x / 19, x % 19);
+		printf("%u %u %u %u\n", x / 2147483648u, x / 3000000000u, x % 2147483649u, x * 9);
+	}
+}
+
+static void test_long(void) {
+	int i;
+	long x;
+
+	for (i = 0; i < N(lval); ++i) {
+		x = lval[i];
+		printf("%ld %ld %ld %ld %ld %ld\n", x / 2, x % 2, x / 1024, x % 1024, x / 3, x % 3);
+		printf("%ld %ld %ld %ld\n", x / 1000000007, x % 1000000007, x / -7, x % -7);
+		printf("%ld %ld %ld\n", x % 4294967296L, x * 5, x * 63);
+	}
+}
+
+static void test_unsigned_long(void) {
+	int i;
+	unsigned long x;
+
+	for (i = 0; i < N(ulval); ++i) {
+		x = ulval[i];
+		printf("%lu %lu %lu %lu\n", x / 10, x % 10, x / 7, x % 7);
+		printf("%lu %lu %lu\n", x / 9223372036854775809ul, x % 4294967296ul, x * 6);
+	}
+}
+
+int main(void) {
+	test_int();
+	test_unsigned();
+	test_long();
+	test_unsigned_long();
+	return 0;
+}
@@ -0,0 +1,29 @@
+int printf(const char *, ...);
+
+int value = 3;
+int counter;
+static int total;
+const int table[4] = {1, 2, 3, 5};
+const char *const greeting = "hello";
+
+int unused(void) {
+    return counter + table[0];
+}
+
+__attribute__((cold)) static int fail(int n) {
+    printf("fail %d\n", n);
+    return 1;
+}
+
+static int twice(int n) {
+    return n * 2;
+}
+
+int main(void) {
+    total = twice(value) + table[3];
+    if (total != 11) {
+        return fail(total);
+    }
+    printf("%s %d %d\n", greeting, total, counter);
+    return 0;
+}
@@ -0,0 +1,27 @@
+#!/bin/sh
+
+cc=$1
+src=$2
+dir=$3
+
+# Each function and object is placed in a separate section, allowing
+# the linker to discard what is not referenced.
+$cc -ffunction-sections -fdata-sections -c ${src}.c -o ${dir}/${src}.o || exit 1
+objdump -h ${dir}/${src}.o | awk '
+	{ found[$2] = 1; }
+	END {
+		n = split(".text.main .text.twice .text.unused .text.unlikely.fail .data.value .bss.total .rodata.table", names, " ");
+		for (i = 1; i <= n; i++) {
+			if (!found[names[i]]) exit 1;
+		}
+	}' || exit 1
+
+cc -Wl,--gc-sections ${dir}/${src}.o -o ${dir}/${src}.out 2> /dev/null || exit 1
+${dir}/${src}.out | diff - ${dir}/${src}.ans.txt > /dev/null || exit 1
+nm ${dir}/${src}.out | grep -w unused > /dev/null && exit 1
+
+$cc -ffunction-sections -fdata-sections -S ${src}.c -o ${dir}/${src}.s || exit 1
+grep -E "\.section\s\.text\.twice," ${dir}/${src}.s > /dev/null || exit 1
+grep -E "\.section\s\.bss\.total,.*@nobits" ${dir}/${src}.s > /dev/null || exit 1
+
+exit 0
@@ -0,0 +1,28 @@
+int printf(const char *, ...);
+
+static const char *greeting(void) {
+    return "Hello, literal pool";
+}
+
+static double scale(double d) {
+    return d * 2.75 + 0.5;
+}
+
+static float scalef(float f) {
+    return f * 2.75f + 0.5f;
+}
+
+static long double scalel(long double ld) {
+    return ld * 2.75L + 0.5L;
+}
+
+int main(void) {
+    const char *nul = "with\0null", *str = greeting();
+
+    printf("%s %s\n", str, "Hello, literal pool" + 7);
+    printf("%s %s %d\n", nul, nul + 5, nul[4]);
+    printf("%f %f\n", scale(2.75), scale(0.5) * 2.75);
+    printf("%f %f\n", scalef(2.75f), scalef(0.5f) * 2.75f);
+    printf("%Lf %Lf\n", scalel(2.75L), scalel(0.5L) * 2.75L);
+    return 0;
+}
@@ -0,0 +1,29 @@
+#!/bin/sh
+
+cc=$1
+src=$2
+dir=$3
+$cc -c ${src}.c -o ${dir}/${src}.o || exit 1
+cc ${dir}/${src}.o -o ${dir}/${src}.out 2> /dev/null || exit 1
+${dir}/${src}.out | diff - ${dir}/${src}.ans.txt > /dev/null || exit 1
+
+# Identical strings and constants are only emitted once, in mergeable
+# sections. Strings with embedded null characters cannot be merged.
+readelf -SW ${dir}/${src}.o | sed 's/^.*\] //' | awk '
+	BEGIN { missing=4; }
+	$1 == ".rodata.str1.1" && $6 == "01" && $7 == "AMS" { missing -= 1; }
+	$1 == ".rodata.cst4" && $5 == "000008" && $7 == "AM" { missing -= 1; }
+	$1 == ".rodata.cst8" && $5 == "000010" && $7 == "AM" { missing -= 1; }
+	$1 == ".rodata.cst16" && $5 == "000020" && $7 == "AM" { missing -= 1; }
+	END { exit missing }' || exit 1
+
+[ $(readelf -p .rodata.str1.1 ${dir}/${src}.o | grep -c "Hello") -eq 1 ] \
+	|| exit 1
+readelf -p .rodata.str1.1 ${dir}/${src}.o | grep "with" > /dev/null && exit 1
+
+$cc -S ${src}.c -o ${dir}/${src}.s || exit 1
+grep -E "\.section\s\.rodata\.str1\.1,\"aMS\",@progbits,1" ${dir}/${src}.s \
+	> /dev/null || exit 1
+[ $(grep -c "Hello" ${dir}/${src}.s) -eq 1 ] || exit 1
+
+exit 0
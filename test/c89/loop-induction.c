@@ -0,0 +1,90 @@
+int printf(const char *, ...);
+
+static int sum(int *a, int n) {
+    int i, s = 0;
+    for (i = 0; i < n; i++) {
+        s += a[i];
+    }
+    return s;
+}
+
+static long count(const char *str, long n, char c) {
+    long i, k = 0;
+    for (i = 0; i != n; ++i) {
+        k += str[i] == c;
+    }
+    return k + i;
+}
+
+static int reverse(short *a, int n) {
+    int i, s = 0;
+    for (i = n - 1; i >= 0; i -= 2) {
+        s = s * 3 + a[i];
+    }
+    return s;
+}
+
+static int scale(double *d, int n) {
+    int i = 0;
+    while (i < n) {
+        d[i] = d[i] * 2 + i;
+        i++;
+    }
+    return i;
+}
+
+static int local(int n) {
+    int i, a[8], s = 0;
+    for (i = 0; i < 8; ++i) {
+        a[i] = i * n;
+    }
+    for (i = 0; i < 8; ++i) {
+        s += a[i] * a[7 - i];
+    }
+    return s;
+}
+
+static int pre_increment(int *a, int n) {
+    int i = 0, s = 0;
+    while (i < n - 1) {
+        i++;
+        s += a[i];
+    }
+    return s;
+}
+
+static int step_first(int *a, int n) {
+    int i = -2, s = 0;
+    do {
+        i += 2;
+        s += a[i] * 3;
+    } while (i < n - 2);
+    return s;
+}
+
+static int break_after_increment(int *a, int n) {
+    int i = 0, s = 0;
+    for (;;) {
+        i++;
+        if (i >= n)
+            break;
+        s += a[i];
+    }
+    return s;
+}
+
+int main(void) {
+    int a[6] = {1, 2, 3, 4, 5, 6};
+    short b[5] = {7, -3, 2, 9, 1};
+    double d[3] = {0.5, 1.5, 2.5};
+    printf("%d %d\n", sum(a, 6), sum(a + 2, 0));
+    printf("%ld\n", count("abracadabra", 11, 'a'));
+    printf("%d %d\n", reverse(b, 5), reverse(b, 4));
+    printf("%d\n", scale(d, 3));
+    printf("%f %f %f\n", d[0], d[1], d[2]);
+    printf("%d\n", local(3));
+    printf("%d %d\n", pre_increment(a, 6), pre_increment(a, 1));
+    printf("%d %d\n", step_first(a, 6), step_first(a, 1));
+    printf("%d %d\n", break_after_increment(a, 6), break_after_increment(a, 1));
+    return 0;
+}
@@ -0,0 +1,44 @@
+int printf(const char *, ...);
+
+static int sum(int *a, int n, int k) {
+    int i, j, s = 0;
+    for (i = 0; i < n; ++i) {
+        for (j = 0; j < n; ++j) {
+            s += a[j] * (k + 3) + (long) n;
+        }
+    }
+    return s;
+}
+
+static int conditional(int n, int d) {
+    int i, q = 0, s = 0;
+    for (i = 0; i < n; ++i) {
+        if (d != 0) {
+            q = 100 / d;
+        }
+        s += q + i * 2;
+    }
+    return s;
+}
+
+static int zero_trip(int n, int k) {
+    int i, t = k;
+    while (n > 0) {
+        t = k * 7;
+        n--;
+    }
+    for (i = 0; i < n; ++i) {
+        t += i;
+    }
+    return t;
+}
+
+int main(void) {
+    int a[5] = {1, 2, 3, 4, 5};
+    printf("%d\n", sum(a, 5, 2));
+    printf("%d\n", conditional(4, 3));
+    printf("%d\n", conditional(4, 0));
+    printf("%d\n", zero_trip(0, 3));
+    printf("%d\n", zero_trip(2, 3));
+    return 0;
+}
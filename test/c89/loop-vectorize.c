@@ -0,0 +1,205 @@
+int printf(const char *, ...);
+
+static void add(int *a, const int *b, const int *c, int n) {
+    int i;
+    for (i = 0; i < n; ++i) {
+        a[i] = b[i] + c[i];
+    }
+}
+
+static int sum(const int *a, int n) {
+    int i, s = 0;
+    for (i = 0; i < n; ++i) {
+        s += a[i];
+    }
+    return s;
+}
+
+static int negate(const int *a, int n) {
+    int i, s = 100;
+    for (i = 0; i < n; i++) {
+        s -= a[i];
+    }
+    return s;
+}
+
+static void saxpy(float *y, const float *x, float a, int n) {
+    int i;
+    for (i = 0; i < n; i++) {
+        y[i] += a * x[i];
+    }
+}
+
+static void bytes(unsigned char *a, const unsigned char *b, int k, int n) {
+    int i;
+    for (i = 0; i < n; ++i) {
+        a[i] = b[i] + a[i] + k;
+    }
+}
+
+static void shorts(short *y, const short *x, int n) {
+    int i;
+    for (i = 0; i < n; ++i) {
+        y[i] = y[i] * x[i] - 3;
+    }
+}
+
+static long checksum(const long *a, long n) {
+    long i, s = 0;
+    for (i = 0; i < n; i++) {
+        s ^= a[i];
+    }
+    return s;
+}
+
+static void divide(double *a, const double *b, int n) {
+    int i;
+    for (i = 0; i <= n; ++i) {
+        a[i] = a[i] / b[i] - 1.5;
+    }
+}
+
+static void scale(double *d, double f, int n) {
+    int i = 0;
+    while (i < n) {
+        d[i] = d[i] * f;
+        i++;
+    }
+}
+
+static void matrix(int m[8][13], const int *row) {
+    int i, j;
+    for (i = 0; i < 8; ++i) {
+        for (j = 0; j != 13; j++) {
+            m[i][j] = m[i][j] + row[j] - i;
+        }
+    }
+}
+
+static int carried(int *a, const int *b, int n) {
+    int i, t = 0;
+    for (i = 0; i < n; ++i) {
+        t = b[i] * 2;
+        a[i + 1] = a[i] ^ t;
+    }
+    return t;
+}
+
+int g[100];
+
+static void global(int k) {
+    int i;
+    for (i = 0; i < 100; i++) {
+        g[i] = g[i] + k;
+    }
+}
+
+int main(void) {
+    int i, j, n, a[64], b[64], c[64], m[8][13];
+    float x[37], y[37];
+    unsigned char u[50], v[50];
+    short s[21], t[21];
+    long l[9];
+    double d[12], e[12];
+
+    for (n = 0; n < 20; n += 3) {
+        for (i = 0; i < 64; ++i) {
+            a[i] = -1;
+            b[i] = i * 3;
+            c[i] = 1000 - i;
+        }
+        add(a, b, c, n);
+        for (i = 0; i < 22; ++i) {
+            printf("%d ", a[i]);
+        }
+        printf("| %d %d\n", sum(b, n), negate(c, n));
+    }
+
+    add(a, a, a, 64);
+    add(a + 1, a, c, 20);
+    add(a, a + 3, c, 20);
+    add(a + 40, a + 20, a + 30, 20);
+    for (i = 0; i < 64; ++i) {
+        printf("%d ", a[i]);
+    }
+    printf("\n");
+
+    for (i = 0; i < 37; ++i) {
+        x[i] = i * 0.5f;
+        y[i] = 1.0f / (i + 1);
+    }
+    saxpy(y, x, 2.5f, 37);
+    saxpy(y + 2, y, -1.0f, 30);
+    for (i = 0; i < 37; ++i) {
+        printf("%g ", y[i]);
+    }
+    printf("\n");
+
+    for (i = 0; i < 50; ++i) {
+        u[i] = i * 7;
+        v[i] = 250 - i;
+    }
+    bytes(u, v, 300, 50);
+    bytes(u + 20, u, -1, 30);
+    for (i = 0; i < 50; ++i) {
+        printf("%u ", u[i]);
+    }
+    printf("\n");
+
+    for (i = 0; i < 21; ++i) {
+        s[i] = i * 1000 - 7000;
+        t[i] = 3 - i;
+    }
+    shorts(s, t, 21);
+    for (i = 0; i < 21; ++i) {
+        printf("%d ", s[i]);
+    }
+    printf("\n");
+
+    for (i = 0; i < 9; ++i) {
+        l[i] = (long) i << (i * 5);
+    }
+    printf("%ld %ld %ld\n", checksum(l, 9), checksum(l, 8), checksum(l + 1, 2));
+
+    for (i = 0; i < 12; ++i) {
+        d[i] = i + 0.25;
+        e[i] = 12 - i;
+    }
+    divide(d, e, 10);
+    scale(d + 1, -0.5, 9);
+    for (i = 0; i < 12; ++i) {
+        printf("%g ", d[i]);
+    }
+    printf("\n");
+
+    for (i = 0; i < 13; ++i) {
+        c[i] = i * i;
+    }
+    for (i = 0; i < 8; ++i) {
+        for (j = 0; j < 13; ++j) {
+            m[i][j] = i * 100 + j;
+        }
+    }
+    matrix(m, c);
+    matrix(m, m[3]);
+    for (i = 0; i < 8; ++i) {
+        for (j = 0; j < 13; ++j) {
+            printf("%d ", m[i][j]);
+        }
+        printf("\n");
+    }
+
+    for (i = 0; i < 64; ++i) {
+        a[i] = i;
+    }
+    printf("%d: ", carried(a, b, 40));
+    for (i = 0; i < 42; ++i) {
+        printf("%d ", a[i]);
+    }
+    printf("\n");
+
+    global(5);
+    global(-2);
+    printf("%d %d\n", g[0], g[99]);
+    return 0;
+}
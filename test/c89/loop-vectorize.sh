@@ -0,0 +1,15 @@
+#!/bin/sh
+
+cc=$1
+src=$2
+dir=$3
+$cc -O3 -c ${src}.c -o ${dir}/${src}.o || exit 1
+cc ${dir}/${src}.o -o ${dir}/${src}.out 2> /dev/null || exit 1
+${dir}/${src}.out | diff - ${dir}/${src}.ans.txt > /dev/null || exit 1
+
+$cc -O3 -S ${src}.c -o ${dir}/${src}.s || exit 1
+for instr in paddd paddb pmullw pxor addps mulps divpd mulpd ; do
+    grep -E "\s${instr}\s" ${dir}/${src}.s > /dev/null || exit 1
+done
+
+exit 0
@@ -0,0 +1,36 @@
+int printf(const char *, ...);
+
+static int positive(unsigned x, unsigned y) {
+	int d = (int) (x - y);
+	if (d > 0) {
+		return 1;
+	}
+	return d == 0 ? 0 : -1;
+}
+
+static int masked(int a, int b) {
+	int c = a & b;
+	if (c) {
+		return c;
+	}
+	return (a | b) >= 0;
+}
+
+static unsigned long widen(unsigned a) {
+	unsigned b = a + 0;
+	return b;
+}
+
+static long narrow(long a) {
+	int b = (int) a;
+	b = b - 0;
+	return (unsigned) b;
+}
+
+int main(void) {
+	printf("%d %d %d\n",
+		positive(0x80000000u, 1), positive(3, 3), positive(1, 2));
+	printf("%d %d %d\n", masked(6, 3), masked(4, 3), masked(-4, 3));
+	printf("%lu %ld\n", widen(0xFFFFFFFFu), narrow(-1L));
+	return 0;
+}
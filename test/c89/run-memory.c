@@ -0,0 +1,37 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int counter;
+static int table[64];
+static const char *names[] = {"zero", "one", "two", "three"};
+int (*output)(const char *, FILE *) = fputs;
+
+static void done(void) {
+	printf("done %d\n", counter);
+}
+
+static int compare(const void *a, const void *b) {
+	return *(const int *) b - *(const int *) a;
+}
+
+int main(int argc, char *argv[]) {
+	int i;
+	char buf[64];
+
+	atexit(done);
+	for (i = 1; i < argc; ++i) {
+		printf("%d: %s\n", i, argv[i]);
+	}
+
+	for (i = 0; i < 64; ++i) {
+		table[i] = (i * 37) % 64;
+		counter += table[i] & 1;
+	}
+
+	qsort(table, 64, sizeof(int), compare);
+	sprintf(buf, "%s %d %d %.2f\n", names[argc % 4], table[0], table[63],
+		counter / 3.0);
+	output(buf, stdout);
+	return (int) strlen(buf) + argc;
+}
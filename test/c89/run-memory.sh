@@ -0,0 +1,15 @@
+#!/bin/sh
+
+cc=$1
+src=$2
+dir=$3
+
+# Compile and run in memory, without writing an object file. Arguments
+# after the input file are passed to main.
+$cc -run ${src}.c | diff - ${dir}/${src}.ans.txt > /dev/null || exit 1
+$cc -run ${src}.c a "b c" > ${dir}/${src}.txt
+test $? -eq 20 || exit 1
+printf "1: a\n2: b c\nthree 63 0 10.67\ndone 32\n" \
+	| diff - ${dir}/${src}.txt > /dev/null || exit 1
+
+exit 0
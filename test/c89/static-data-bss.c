@@ -0,0 +1,36 @@
+int printf(const char *, ...);
+
+struct point {
+    char tag;
+    int x : 5;
+    int y : 11;
+    double weight;
+};
+
+static int zeros[1 << 18] = {0};
+static double reals[1024] = {0.0, -0.0};
+static struct point origin[256] = {{0}};
+static char *pointers[512] = {0};
+
+long sparse[1 << 18] = {1, [100] = 2, [(1 << 18) - 1] = 3};
+struct point points[4] = {{'a', 1, 2, 0.5}, [3] = {'d', -3, 0, 0}};
+char name[100] = "sparse";
+
+int main(void) {
+    static int counter = 0;
+    long sum = 0;
+    int i;
+
+    for (i = 0; i < 1 << 18; ++i) {
+        sum += zeros[i] + sparse[i];
+    }
+
+    for (i = 0; i < 256; ++i) {
+        sum += origin[i].tag + origin[i].x + origin[i].y;
+    }
+
+    printf("%ld %d %s %g %g\n", sum, counter++, name, reals[0], reals[1]);
+    printf("%d %d %c %d %d %g\n", pointers[511] == 0, points[1].x,
+        points[3].tag, points[3].x, points[0].y, points[0].weight);
+    return 0;
+}
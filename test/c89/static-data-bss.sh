@@ -0,0 +1,20 @@
+#!/bin/sh
+
+cc=$1
+src=$2
+dir=$3
+$cc -c ${src}.c -o ${dir}/${src}.o || exit 1
+cc ${dir}/${src}.o -o ${dir}/${src}.out 2> /dev/null || exit 1
+${dir}/${src}.out | diff - ${dir}/${src}.ans.txt > /dev/null || exit 1
+
+# Objects initialized to zero go in .bss, leaving .data with only the
+# definitions that have some non-zero value.
+size ${dir}/${src}.o | awk '
+	NR == 2 && $2 < 2200000 && $3 > 1050000 { ok = 1; }
+	END { exit !ok }' || exit 1
+
+$cc -S ${src}.c -o ${dir}/${src}.s || exit 1
+grep -E "^\s\.bss$" ${dir}/${src}.s > /dev/null || exit 1
+[ $(grep -c "\.zero" ${dir}/${src}.s) -lt 20 ] || exit 1
+
+exit 0
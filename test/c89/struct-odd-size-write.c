@@ -0,0 +1,67 @@
+int printf(const char *, ...);
+
+struct s3 { char c[3]; };
+struct s5 { char c[5]; };
+struct s6 { char c[6]; };
+struct s7 { char c[7]; };
+
+struct outer {
+	struct s3 a;
+	char p;
+	struct s5 b;
+	char q;
+	struct s6 c;
+	char r, s;
+	struct s7 d;
+	char t;
+};
+
+static struct s6 make(int k) {
+	struct s6 v = {{1, 2, 3, 4, 5, 0}};
+	v.c[5] = k;
+	return v;
+}
+
+static int sum(struct s7 v) {
+	int i, n = 0;
+	for (i = 0; i < 7; ++i) {
+		n += v.c[i];
+	}
+	return n;
+}
+
+int main(void) {
+	struct s3 a = {{9, 8, 7}};
+	struct s5 b = {{1, 2, 3, 4, 5}};
+	struct s7 d = {{1, 1, 1, 1, 1, 1, 1}}, arr[3];
+	struct outer w, *pw = &w;
+	char s[40] = "hello", t[10] = "abcdef";
+	int i, n = 0;
+
+	w.p = 'p';
+	w.q = 'q';
+	w.r = 'r';
+	w.s = 's';
+	w.t = 't';
+	w.a = a;
+	w.b = b;
+	w.c = make(6);
+	w.d = d;
+	printf("%c%c%c%c%c %d %d %d %d\n",
+		w.p, w.q, w.r, w.s, w.t, w.a.c[2], w.b.c[4], w.c.c[5], sum(w.d));
+
+	arr[0].c[6] = 'x';
+	arr[2].c[0] = 'y';
+	arr[1] = d;
+	printf("%c %c %d\n", arr[0].c[6], arr[2].c[0], sum(arr[1]));
+
+	pw->c = make(3);
+	pw->a = a;
+	printf("%c %c %c %d\n", pw->p, pw->r, pw->s, pw->c.c[5]);
+
+	for (i = 5; i < 40; ++i) {
+		n += s[i] != 0;
+	}
+
+	return printf("%s %s %d\n", s, t, n + t[6] + t[9]);
+}
@@ -0,0 +1,65 @@
+#include <stdlib.h>
+#include <stdio.h>
+
+static int odd(unsigned n);
+
+static int even(unsigned n) {
+	if (n == 0) return 1;
+	return odd(n - 1);
+}
+
+static int odd(unsigned n) {
+	if (n == 0) return 0;
+	return even(n - 1);
+}
+
+static long sum(long n, long acc) {
+	if (n == 0) return acc;
+	return sum(n - 1, acc + n);
+}
+
+static double half(int n, double d) {
+	if (n == 0) return d;
+	return half(n - 1, d + .5);
+}
+
+static void count(int n, int *p) {
+	if (n) {
+		*p += 1;
+		count(n - 1, p);
+	}
+}
+
+static int (*fp)(unsigned) = even;
+
+static int indirect(unsigned n) {
+	return fp(n);
+}
+
+struct pair { long a, b; };
+
+static struct pair swap(struct pair p, int n) {
+	struct pair q;
+	if (n == 0) return p;
+	q.a = p.b;
+	q.b = p.a;
+	return swap(q, n - 1);
+}
+
+static int many(int a, int b, int c, int d, int e, int f, int g) {
+	if (a == 0) return g;
+	return many(a - 1, b, c, d, e, f, g + 1);
+}
+
+int main(int argc, char *argv[]) {
+	int n = argc > 1 ? atoi(argv[1]) : 1000, c = 0;
+	struct pair p = {1, 2};
+
+	count(n, &c);
+	p = swap(p, 100);
+	printf("%d, %d, %d\n", even(2 * n), odd(2 * n + 1), indirect(2 * n));
+	printf("%d, %d, %d\n", sum(n, 0) == (long) n * (n + 1) / 2, c == n,
+		half(2 * n, 0) == n);
+	printf("%ld, %ld, %d\n", p.a, p.b, many(100, 0, 0, 0, 0, 0, 0));
+	return 0;
+}
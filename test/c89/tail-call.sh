@@ -0,0 +1,10 @@
+#!/bin/sh
+
+cc=$1
+src=$2
+dir=$3
+$cc -O2 -c ${src}.c -o ${dir}/${src}.o || exit 1
+cc ${dir}/${src}.o -o ${dir}/${src}.out 2> /dev/null || exit 1
+(ulimit -s 1024; ${dir}/${src}.out 1000000) | diff - ${dir}/${src}.ans.txt > /dev/null || exit 1
+
+exit 0
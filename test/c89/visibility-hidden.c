@@ -0,0 +1,29 @@
+int printf(const char *, ...);
+
+int counter;
+int values[3] = {1, 2, 3};
+const char *name = "visible";
+
+int square(int x);
+
+__attribute__((visibility("default"))) int api(int x) {
+    counter++;
+    return square(x) + values[x % 3];
+}
+
+int square(int x) {
+    return x * x;
+}
+
+__attribute__((visibility("protected"))) int next(void) {
+    return ++counter;
+}
+
+int main(void) {
+    int i, sum = 0;
+    for (i = 0; i < 5; ++i) {
+        sum += api(i) + next();
+    }
+    printf("%s %d %d\n", name, sum, counter);
+    return 0;
+}
@@ -0,0 +1,34 @@
+#!/bin/sh
+
+cc=$1
+src=$2
+dir=$3
+
+# Definitions get visibility from -fvisibility unless overridden by
+# attribute. Hidden and protected functions are called directly, and
+# hidden objects addressed relative to %rip without going through GOT.
+$cc -fPIC -fvisibility=hidden -c ${src}.c -o ${dir}/${src}.o || exit 1
+cc ${dir}/${src}.o -o ${dir}/${src}.out 2> /dev/null || exit 1
+${dir}/${src}.out | diff - ${dir}/${src}.ans.txt > /dev/null || exit 1
+
+readelf -sW ${dir}/${src}.o | awk '
+	$NF ~ /^(counter|values|name|square|main)$/ && $6 != "HIDDEN" { fail=1; }
+	$NF == "api" && $6 != "DEFAULT" { fail=1; }
+	$NF == "next" && $6 != "PROTECTED" { fail=1; }
+	END { exit fail }' || exit 1
+
+readelf -rW ${dir}/${src}.o | awk '
+	$5 ~ /^(counter|values|name|next)$/ && $3 != "R_X86_64_PC32" { fail=1; }
+	END { exit fail }' || exit 1
+
+# Only symbols with default or protected visibility are exported.
+cc -shared ${dir}/${src}.o -o ${dir}/${src}.so 2> /dev/null || exit 1
+nm -D --defined-only ${dir}/${src}.so | awk '
+	$3 !~ /^(api|next)$/ { fail=1; }
+	END { exit fail }' || exit 1
+
+$cc -fPIC -fvisibility=hidden -S ${src}.c -o ${dir}/${src}.s || exit 1
+grep -E "\.hidden\s+square" ${dir}/${src}.s > /dev/null || exit 1
+grep -E "counter@GOTPCREL" ${dir}/${src}.s > /dev/null && exit 1
+
+exit 0
@@ -0,0 +1,79 @@
+#include <stdio.h>
+
+struct point {
+	int x, y;
+};
+
+static int square(int x) {
+	return x * x;
+}
+
+static int get_x(const struct point *p) {
+	return p->x;
+}
+
+static int clamp(int v, int lo, int hi) {
+	if (v < lo) return lo;
+	if (v > hi) return hi;
+	return v;
+}
+
+static struct point make(int x, int y) {
+	struct point p;
+	p.x = x;
+	p.y = y;
+	return p;
+}
+
+static void bump(int *c) {
+	(*c)++;
+}
+
+static int increment(int v) {
+	int *p = &v;
+	*p += 1;
+	return v;
+}
+
+static int factorial(int n) {
+	return n < 2 ? 1 : n * factorial(n - 1);
+}
+
+static char lower(char c) {
+	return (c >= 'A' && c <= 'Z') ? c + 32 : c;
+}
+
+static inline int twice(int a) {
+	return square(a) + square(a);
+}
+
+static inline int is_even(int a) {
+	return (a & 1) == 0;
+}
+
+static int distance(struct point a, struct point b) {
+	return square(a.x - b.x) + square(a.y - b.y);
+}
+
+int main(void) {
+	int i, s = 0, c = 0;
+	struct point p = make(3, 4), q[3] = {{1, 2}, {5, 6}, {7, 8}};
+	char str[] = "Hello World";
+
+	for (i = 0; i < 3; ++i) {
+		s += square(get_x(&q[i])) + clamp(i * 10, 5, 15);
+		bump(&c);
+		if (is_even(i)) {
+			bump(&c);
+		}
+	}
+
+	for (i = 0; str[i]; ++i) {
+		str[i] = lower(str[i]);
+	}
+
+	printf("%d %d %d %d\n", s, c, get_x(&p), twice(3));
+	printf("%d %d %s\n", increment(4), factorial(6), str);
+	printf("%d\n", distance(p, q[2]));
+	return clamp(square(3), 0, 5) - 5;
+}
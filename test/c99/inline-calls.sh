@@ -0,0 +1,13 @@
+#!/bin/sh
+
+cc=$1
+src=$2
+dir=$3
+$cc -O2 -c ${src}.c -o ${dir}/${src}.o || exit 1
+cc ${dir}/${src}.o -o ${dir}/${src}.out 2> /dev/null || exit 1
+${dir}/${src}.out | diff - ${dir}/${src}.ans.txt > /dev/null || exit 1
+
+$cc -O2 -S ${src}.c -o ${dir}/${src}.s || exit 1
+grep -E "call\s+(get_x|bump|lower)" ${dir}/${src}.s > /dev/null && exit 1
+
+exit 0
@@ -0,0 +1,109 @@
+#include <stddef.h>
+#include <stdio.h>
+
+struct inner {
+	int i;
+};
+
+typedef struct inner inner64 __attribute__((aligned(64)));
+typedef int int16 __attribute__((aligned(16)));
+typedef int16 int32 __attribute__((aligned(32)));
+typedef char pad[4] __attribute__((aligned(64)));
+
+struct plain {
+	char c;
+	struct inner x;
+};
+
+struct aligned_typedef {
+	char c;
+	inner64 x;
+};
+
+struct aligned_scalar {
+	char c;
+	int16 x;
+	const int32 y;
+};
+
+struct aligned_array {
+	pad a;
+	int n;
+	pad b;
+};
+
+struct before_specifiers {
+	char c;
+	__attribute__((aligned(8))) char d;
+};
+
+struct after_specifiers {
+	char c;
+	char __attribute__((aligned(8))) d;
+};
+
+struct after_declarator {
+	char c;
+	char d __attribute__((aligned(8)));
+};
+
+struct each_declarator {
+	char c;
+	__attribute__((aligned(16))) int a, b __attribute__((aligned(4)));
+};
+
+enum __attribute__((packed)) small {
+	A1, B1
+};
+
+enum medium {
+	A2, B2 = 300
+} __attribute__((packed));
+
+enum negative {
+	A3 = -1, B3 = 100
+} __attribute__((packed));
+
+int16 g1;
+char g2;
+int16 g3;
+
+static int load(int *p) {
+	return *p;
+}
+
+int main(void) {
+	int16 x = 3, *px = &x;
+	enum negative n = A3;
+
+	printf("%lu %lu\n", sizeof(struct inner), _Alignof(struct inner));
+	printf("%lu %lu %lu\n",
+		sizeof(struct plain), sizeof(struct aligned_typedef),
+		offsetof(struct aligned_typedef, x));
+	printf("%lu %lu %lu %lu\n",
+		_Alignof(inner64), sizeof(int16), _Alignof(int16), _Alignof(int32));
+	printf("%lu %lu %lu\n",
+		sizeof(struct aligned_scalar), offsetof(struct aligned_scalar, x),
+		offsetof(struct aligned_scalar, y));
+	printf("%lu %lu\n", sizeof(pad), _Alignof(pad));
+	printf("%lu %lu %lu\n",
+		sizeof(struct aligned_array), offsetof(struct aligned_array, n),
+		offsetof(struct aligned_array, b));
+	printf("%lu %lu\n",
+		sizeof(struct before_specifiers),
+		offsetof(struct before_specifiers, d));
+	printf("%lu %lu\n",
+		sizeof(struct after_specifiers),
+		offsetof(struct after_specifiers, d));
+	printf("%lu %lu\n",
+		sizeof(struct after_declarator),
+		offsetof(struct after_declarator, d));
+	printf("%lu %lu %lu\n",
+		sizeof(struct each_declarator), offsetof(struct each_declarator, a),
+		offsetof(struct each_declarator, b));
+	printf("%lu %lu %lu %d\n",
+		sizeof(enum small), sizeof(enum medium), sizeof(enum negative),
+		n < 0);
+	printf("%d %d\n", (int) ((size_t) &g1 % 16), (int) ((size_t) &g3 % 16));
+	return load(px) + x;
+}
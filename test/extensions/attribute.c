@@ -0,0 +1,77 @@
+#include <stddef.h>
+#include <stdio.h>
+
+struct __attribute__((packed)) packed {
+	char c;
+	int i;
+	short s;
+};
+
+struct trailing {
+	char c;
+	long l;
+} __attribute__((__packed__));
+
+struct member {
+	char c;
+	int i __attribute__((aligned(32)));
+};
+
+struct aligned {
+	char c;
+} __attribute__((aligned(16)));
+
+union number {
+	char c;
+	double d;
+} __attribute__((packed, aligned(4)));
+
+typedef struct { int x; } pair __attribute__((aligned(8)));
+
+int line __attribute__((aligned(64))) = 1;
+long buffer[3] __attribute__((aligned(32)));
+static int data __attribute__((section(".data.attribute"))) = 5;
+
+__attribute__((noinline)) static int increment(int x) {
+	return x + 1;
+}
+
+static inline __attribute__((always_inline)) int square(int x) {
+	return x * x;
+}
+
+__attribute__((cold)) void fail(const char *msg) {
+	printf("fail: %s\n", msg);
+}
+
+__attribute__((hot, visibility("hidden"))) int load(int *p) {
+	return *p;
+}
+
+enum __attribute__((unused)) color {
+	RED __attribute__((unused)),
+	GREEN
+} __attribute__((unused));
+
+int main(int argc __attribute__((unused)), char *argv[]) {
+	int __attribute__((unused)) u, *__attribute__((unused)) p = &data;
+
+	printf("%lu %lu %lu\n",
+		sizeof(struct packed), offsetof(struct packed, s),
+		_Alignof(struct packed));
+	printf("%lu %lu\n",
+		sizeof(struct trailing), offsetof(struct trailing, l));
+	printf("%lu %lu %lu\n",
+		sizeof(struct member), offsetof(struct member, i),
+		_Alignof(struct member));
+	printf("%lu %lu\n", sizeof(struct aligned), _Alignof(struct aligned));
+	printf("%lu %lu\n", sizeof(union number), _Alignof(union number));
+	printf("%lu\n", _Alignof(pair));
+	printf("%d %d\n",
+		(int) ((size_t) &line % 64), (int) ((size_t) buffer % 32));
+	if (argc > 5) {
+		fail(argv[0]);
+	}
+
+	return increment(data) + square(argc) + load(p) + GREEN;
+}
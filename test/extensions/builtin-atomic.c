@@ -0,0 +1,56 @@
+#include <stdio.h>
+int counter;
+long lc;
+char cc;
+short sc;
+int *ptr;
+int arr[4];
+
+int main(void) {
+	int v, e, i;
+	unsigned char flag = 0;
+	__atomic_store_n(&counter, 5, __ATOMIC_RELAXED);
+	__atomic_store_n(&counter, 6, __ATOMIC_SEQ_CST);
+	v = __atomic_load_n(&counter, __ATOMIC_ACQUIRE);
+	printf("%d\n", v);
+	printf("%d\n", __atomic_fetch_add(&counter, 3, __ATOMIC_SEQ_CST));
+	printf("%d\n", __atomic_add_fetch(&counter, 3, __ATOMIC_SEQ_CST));
+	printf("%d\n", __atomic_fetch_sub(&counter, 1, __ATOMIC_SEQ_CST));
+	printf("%d\n", __atomic_sub_fetch(&counter, 1, __ATOMIC_SEQ_CST));
+	printf("%d\n", __atomic_fetch_or(&counter, 0x100, 5));
+	printf("%d\n", __atomic_fetch_and(&counter, 0xff, 5));
+	printf("%d\n", __atomic_xor_fetch(&counter, 0xf, 5));
+	__atomic_fetch_or(&counter, 0x1000, 5);
+	printf("%d\n", counter);
+	e = 10;
+	printf("%d ", __atomic_compare_exchange_n(&counter, &e, 42, 0, 5, 5));
+	printf("%d %d\n", e, counter);
+	e = counter;
+	printf("%d ", __atomic_compare_exchange_n(&counter, &e, 42, 0, 5, 5));
+	printf("%d %d\n", e, counter);
+	printf("%d\n", __atomic_exchange_n(&counter, 7, 5));
+	printf("%d ", __atomic_test_and_set(&flag, 5));
+	printf("%d ", __atomic_test_and_set(&flag, 5));
+	__atomic_clear(&flag, 5);
+	printf("%d\n", flag);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	__sync_synchronize();
+	printf("%ld\n", __sync_fetch_and_add(&lc, 10L));
+	printf("%ld\n", __sync_add_and_fetch(&lc, 10L));
+	printf("%d\n", __sync_fetch_and_sub(&cc, 1));
+	printf("%d\n", __sync_sub_and_fetch(&sc, 300));
+	printf("%d\n", __sync_bool_compare_and_swap(&counter, 7, 8));
+	printf("%d\n", __sync_val_compare_and_swap(&counter, 7, 9));
+	printf("%d\n", __sync_lock_test_and_set(&counter, 1));
+	__sync_lock_release(&counter);
+	ptr = arr;
+	__atomic_fetch_add(&ptr, sizeof(int), 5);
+	printf("%d\n", (int) (ptr - arr));
+	printf("%d %d\n", __atomic_always_lock_free(4, 0), __atomic_is_lock_free(8, 0));
+	for (i = 0; i < 10; ++i)
+		__atomic_fetch_add(&arr[i & 3], i, 0);
+	printf("%d %d %d %d\n", arr[0], arr[1], arr[2], arr[3]);
+	__atomic_load(&counter, &v, 5);
+	printf("%d %d\n", v, counter);
+	return 0;
+}
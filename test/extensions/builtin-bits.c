@@ -0,0 +1,45 @@
+#include <stdio.h>
+
+static unsigned rotate32(unsigned x) {
+	return (x << 5) | (x >> 27);
+}
+
+static unsigned long rotate64(unsigned long x) {
+	return (x >> 13) | (x << 51);
+}
+
+static int bits(unsigned x) {
+	return __builtin_popcount(x) + __builtin_parity(x) + __builtin_ffs((int) x);
+}
+
+static int scan(unsigned long x) {
+	return x ? __builtin_clzl(x) * 100 + __builtin_ctzl(x) : -1;
+}
+
+int main(void) {
+	unsigned v[] = {0, 1, 0x80000000u, 0xdeadbeef, 12345, 0xffffffffu};
+	unsigned long l[] = {0, 1, 0x8000000000000000ul, 0xdeadbeefcafebabeul};
+	int i;
+
+	for (i = 0; i < sizeof(v) / sizeof(v[0]); ++i) {
+		printf("%08x: %d %08x %04x %08x\n", v[i], bits(v[i]),
+			__builtin_bswap32(v[i]), __builtin_bswap16((unsigned short) v[i]),
+			rotate32(v[i]));
+		if (v[i]) {
+			printf("%d %d\n", __builtin_clz(v[i]), __builtin_ctz(v[i]));
+		}
+	}
+
+	for (i = 0; i < sizeof(l) / sizeof(l[0]); ++i) {
+		printf("%016lx: %d %d %d %d %016lx %016lx\n", l[i],
+			__builtin_popcountl(l[i]), __builtin_parityll(l[i]),
+			__builtin_ffsl((long) l[i]), scan(l[i]),
+			__builtin_bswap64(l[i]), rotate64(l[i]));
+	}
+
+	printf("%d %d %d %d %x %d\n",
+		__builtin_popcount(0xF0F0), __builtin_clz(1),
+		__builtin_ctzll(1ul << 40), __builtin_ffs(0),
+		__builtin_bswap32(0x11223344), __builtin_parity(7));
+	return __builtin_constant_p(__builtin_popcount(3)) != 1;
+}
@@ -0,0 +1,51 @@
+#include <stdio.h>
+
+static int errors;
+
+static int sum(const int *p, int n) {
+	int i, s = 0;
+
+	for (i = 0; i < n; ++i) {
+		if (__builtin_expect(p[i] < 0, 0)) {
+			errors++;
+			continue;
+		}
+		s += p[i];
+	}
+
+	return s;
+}
+
+static int pick(int x) {
+	if (__builtin_expect_with_probability(x == 3, 1, 0.05))
+		return x * 7;
+	return x + 1;
+}
+
+static unsigned scale(unsigned x) {
+	if (x > 100)
+		__builtin_unreachable();
+	return x * 2;
+}
+
+static int check(int x) {
+	if (x > 5)
+		__builtin_trap();
+	return x;
+}
+
+static long expect(long x, const char *s) {
+	return __builtin_expect(x, 2)
+		+ (__builtin_expect(!!s, 1) && __builtin_expect(x > 3 && x < 9, 1));
+}
+
+int main(void) {
+	int a[] = {1, -2, 3, -4, 5}, s;
+
+	s = sum(a, 5);
+	printf("%d %d\n", s, errors);
+	printf("%d %d\n", pick(3), pick(4));
+	printf("%u %d\n", scale(40), check(3));
+	printf("%ld %ld %ld\n", expect(1, "a"), expect(5, "b"), expect(5, NULL));
+	return 0;
+}
@@ -0,0 +1,91 @@
+#include <string.h>
+#include <stdio.h>
+
+struct point {
+	int x : 5, y : 11;
+	char tag;
+	double v[5];
+};
+
+static int hash(const void *ptr, int n) {
+	int i, h = 0;
+	const unsigned char *p = ptr;
+
+	for (i = 0; i < n; ++i) {
+		h = h * 31 + p[i];
+	}
+
+	return h;
+}
+
+static int sign(int n) {
+	return (n > 0) - (n < 0);
+}
+
+static void copy(char *a, const char *b) {
+	memcpy(a, b, 3);
+	memcpy(a + 3, b, 12);
+	memcpy(a + 20, b, 16);
+	__builtin_memcpy(a + 40, b, 31);
+	__builtin_memcpy(a + 80, b, 100);
+}
+
+static void move(char *a) {
+	memmove(a + 1, a, 7);
+	memmove(a + 20, a + 23, 13);
+	__builtin_memmove(a + 40, a + 33, 50);
+	__builtin_memmove(a + 100, a + 110, 64);
+}
+
+static void set(char *a, int c) {
+	memset(a, 0, 5);
+	memset(a + 10, 0xAB, 27);
+	memset(a + 50, c, 200);
+	__builtin_memset(a + 1, c + 1, 9);
+	__builtin_memset(a + 300, 0, 300);
+	__builtin_memset(a + 600, c, 400);
+}
+
+static void compare(const char *a, const char *b) {
+	printf("%d %d %d %d\n",
+		sign(memcmp(a, b, 1)),
+		sign(memcmp(a, a, 32)),
+		sign(memcmp("abc", "abd", 3)),
+		sign(__builtin_memcmp("ab", "aa", 2)));
+	printf("%d %d %d\n",
+		sign(memcmp("abcdefghij", "abcdefghik", 10)),
+		sign(memcmp("\xff\x01", "\x01\xff", 2)),
+		sign(__builtin_memcmp(b, b + 1, 20)));
+}
+
+static int initialize(int k) {
+	int a[40] = {1, 2, [20] = 5, [10] = 0};
+	struct point p[4] = {{1, 2, 'c', {0.0, 1.5}}, {-1, k}};
+	char s[100] = "hello";
+
+	a[30] = k;
+	return hash(a, sizeof(a)) + hash(p, sizeof(p)) + hash(s, sizeof(s));
+}
+
+int main(void) {
+	int i;
+	char a[1024], b[256];
+
+	for (i = 0; i < sizeof(a); ++i) {
+		a[i] = i * 7;
+	}
+
+	for (i = 0; i < sizeof(b); ++i) {
+		b[i] = i * 3;
+	}
+
+	copy(a, b);
+	printf("%d\n", hash(a, sizeof(a)));
+	move(a);
+	printf("%d\n", hash(a, sizeof(a)));
+	set(a, 7);
+	printf("%d\n", hash(a, sizeof(a)));
+	compare(a, b);
+	printf("%d\n", initialize(42));
+	return memset(b, 1, 16) != b;
+}
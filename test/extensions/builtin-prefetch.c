@@ -0,0 +1,46 @@
+#include <stdio.h>
+
+struct node {
+	struct node *next;
+	int value;
+};
+
+static int table[256];
+
+static int walk(struct node *n) {
+	int sum = 0;
+
+	while (n) {
+		__builtin_prefetch(n->next);
+		__builtin_prefetch(n->next, 1);
+		__builtin_prefetch(&n->value, 0, 0);
+		__builtin_prefetch(n, 1, 1);
+		__builtin_prefetch(n, 0, 2);
+		sum += n->value;
+		n = n->next;
+	}
+
+	return sum;
+}
+
+int main(void) {
+	int i, sum = 0;
+	struct node a = {0, 1}, b = {&a, 2}, c = {&b, 3};
+
+	for (i = 0; i < 256; ++i) {
+		__builtin_prefetch(table + i + 16, 1, 3);
+		table[i] = i;
+	}
+
+	for (i = 0; i < 256; ++i) {
+		__builtin_prefetch(&table[i + 16]);
+		sum += table[i];
+	}
+
+	__builtin_prefetch(table);
+	__builtin_prefetch((void *) 0);
+	__builtin_prefetch(0);
+	__builtin_prefetch("prefetch", 0, 0);
+	printf("%d %d\n", walk(&c), sum);
+	return 0;
+}
@@ -0,0 +1,67 @@
+typedef int int4 __attribute__((vector_size(16)));
+
+int printf(const char *, ...);
+
+#ifdef FEATURES
+int features[] = {__SSE4_1__, __SSE4_2__, __POPCNT__, __AVX__, __AVX2__,
+	__BMI__, __BMI2__, __LZCNT__};
+#endif
+
+static int bits(unsigned x) {
+	return __builtin_popcount(x) + __builtin_clz(x);
+}
+
+static int trailing(unsigned long x) {
+	return __builtin_ctzl(x);
+}
+
+static long shl(long a, int b) {
+	return a << b;
+}
+
+static int sar(int a, int b) {
+	return a >> b;
+}
+
+static unsigned long shr(unsigned long a, int b) {
+	return a >> b;
+}
+
+static int4 mul(int4 a, int4 b) {
+	return a * b;
+}
+
+static double mix(double a, float b, int i) {
+	return a * b + i - a / (b + 1);
+}
+
+static void scale(int *a, const int *b, int n) {
+	int i;
+	for (i = 0; i < n; ++i) {
+		a[i] = a[i] * b[i] + 1;
+	}
+}
+
+int main(void) {
+	int i, a[23], b[23];
+	int4 v = {1, -2, 3, 40000}, w;
+
+	w = mul(v, v + 7);
+	printf("%d %d %d %d\n", w[0], w[1], w[2], w[3]);
+	printf("%d %d %d\n", bits(1u), bits(0xF0F0F00u), trailing(1ul << 50));
+	printf("%ld %d %lu\n", shl(-3, 33), sar(-1000, 3), shr(-1ul, 60));
+	printf("%f %f\n", mix(2.5, 1.5f, 3), mix(-1.0, 0.25f, -7));
+
+	for (i = 0; i < 23; ++i) {
+		a[i] = i - 11;
+		b[i] = i * 3;
+	}
+
+	scale(a, b, 23);
+	for (i = 0; i < 23; ++i) {
+		printf("%d ", a[i]);
+	}
+
+	printf("\n");
+	return 0;
+}
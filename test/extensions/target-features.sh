@@ -0,0 +1,23 @@
+#!/bin/sh
+
+cc=$1
+src=$2
+dir=$3
+
+$cc -march=x86-64-v3 -DFEATURES -c ${src}.c -o ${dir}/${src}.o || exit 1
+$cc -march=x86-64 -DFEATURES -c ${src}.c -o ${dir}/${src}.o 2> /dev/null && exit 1
+
+$cc -O3 -march=native -c ${src}.c -o ${dir}/${src}.o || exit 1
+cc ${dir}/${src}.o -o ${dir}/${src}.out 2> /dev/null || exit 1
+${dir}/${src}.out | diff - ${dir}/${src}.ans.txt > /dev/null || exit 1
+
+$cc -O3 -march=x86-64-v3 -S ${src}.c -o ${dir}/${src}.s || exit 1
+for instr in popcntl lzcntl tzcntq shlxq sarxl shrxq vpmulld vaddsd ; do
+    grep -E "\s${instr}\s" ${dir}/${src}.s > /dev/null || exit 1
+done
+
+$cc -O3 -march=x86-64 -S ${src}.c -o ${dir}/${src}.s || exit 1
+grep -E "\s(popcnt|lzcnt|tzcnt|shlx|sarx|shrx|v[a-z]+)[lq]?\s" \
+    ${dir}/${src}.s > /dev/null && exit 1
+
+exit 0
@@ -0,0 +1,105 @@
+typedef float v4sf __attribute__((vector_size(16)));
+typedef double v2df __attribute__((vector_size(16)));
+typedef int v4si __attribute__((vector_size(16)));
+typedef unsigned short v8hu __attribute__((vector_size(16)));
+typedef char v16qi __attribute__((vector_size(16)));
+typedef long __attribute__((vector_size(16))) v2di;
+
+int printf(const char *, ...);
+
+struct point {
+	char c;
+	v4sf p;
+};
+
+static v4si global = {1, 2, 3};
+
+static v4sf madd(v4sf a, v4sf b, v4sf c) {
+	return a * b + c;
+}
+
+static v2df scale(v2df *p, double d) {
+	return *p * d;
+}
+
+static struct point translate(struct point pt, float d) {
+	pt.p = pt.p - d;
+	return pt;
+}
+
+static void print_v4sf(v4sf v) {
+	printf("{%f, %f, %f, %f}\n", v[0], v[1], v[2], v[3]);
+}
+
+static void print_v4si(v4si v) {
+	int i;
+	for (i = 0; i < 4; ++i) {
+		printf("%d ", v[i]);
+	}
+	printf("\n");
+}
+
+int main(void) {
+	int i;
+	v4sf a = {1.0f, 2.0f, 3.0f, 4.0f}, b = {0.5f, 0.25f, 2.0f, -1.0f};
+	v2df d = {1.5, -2.5};
+	v4si x = {10, -20, 30, -40}, y = {3, 7, -5, 9};
+	v8hu h = {1, 2, 3, 4, 5, 6, 7, 65535};
+	v16qi q = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16};
+	v2di l = {1L << 40, -3};
+	struct point pt = {'a', {1, 2, 3, 4}};
+
+	print_v4sf(a + b);
+	print_v4sf(a - b);
+	print_v4sf(a * b);
+	print_v4sf(a / b);
+	print_v4sf(madd(a, b, a));
+	print_v4sf(a + 1);
+	print_v4sf(2.0f * b);
+
+	d = scale(&d, 3.0);
+	printf("%f %f\n", d[0], d[1]);
+	d = d / d;
+	printf("%f %f\n", d[0], d[1]);
+
+	print_v4si(x + y);
+	print_v4si(x - y);
+	print_v4si(x * y);
+	print_v4si(x / y);
+	print_v4si(x % y);
+	print_v4si(x & y);
+	print_v4si(x | y);
+	print_v4si(x ^ y);
+	print_v4si(global);
+	global += x;
+	print_v4si(global);
+
+	h = h * h + 1;
+	for (i = 0; i < 8; ++i) {
+		printf("%u ", h[i]);
+	}
+	printf("\n");
+
+	q = q * q - q;
+	for (i = 0; i < 16; ++i) {
+		printf("%d ", q[i]);
+	}
+	printf("\n");
+
+	l = l * 3 + l;
+	printf("%ld %ld\n", l[0], l[1]);
+
+	a[2] = 42.0f;
+	for (i = 0; i < 4; ++i) {
+		a[i] += i;
+	}
+	print_v4sf(a);
+	print_v4sf((v4sf) ((v4si) b & (v4si) a));
+
+	pt = translate(pt, 0.5f);
+	printf("%c ", pt.c);
+	print_v4sf(pt.p);
+
+	printf("%lu %lu\n", sizeof(v4sf), sizeof(struct point));
+	return (x + y)[3];
+}
@@ -76,5 +76,31 @@ $lacc linker/bar.c -lfoo -L$bin -o $bin/a.out
 c=$(check "a.out"); result="$?"; retval=$((retval + result))
 
 echo "[-fno-PIC: ${a}] [-fPIC: ${b}] [-shared: ${c}]"
+
+# Built-in linker, where ld would have created .got.plt
+builtin()
+{
+	if [ $? -ne 0 ] || readelf -S "$bin/$1" | grep -q "\.got\.plt"
+	then
+		echo "${red}Not linked with built-in linker!${reset}";
+		return 1
+	fi
+
+	check "$1"
+}
+
+$lacc -fuse-ld=lacc -fno-PIC linker/foo.c linker/bar.c -o $bin/builtin
+d=$(builtin "builtin"); result="$?"; retval=$((retval + result))
+
+$lacc -fuse-ld=lacc -fPIC linker/foo.c linker/bar.c -o $bin/builtin
+e=$(builtin "builtin"); result="$?"; retval=$((retval + result))
+
+$lacc -fuse-ld=lacc linker/bar.c -lfoo -L$bin -o $bin/builtin
+f=$(builtin "builtin"); result="$?"; retval=$((retval + result))
+
+$lacc -fuse-ld=lacc -static linker/foo.c linker/bar.c -o $bin/builtin
+g=$(builtin "builtin"); result="$?"; retval=$((retval + result))
+
+echo "[-fuse-ld=lacc: ${d}] [-fPIC: ${e}] [-shared: ${f}] [-static: ${g}]"
 rm -f foo.o bar.o
 exit $retval